@@ -0,0 +1,53 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * crc32_glue.c - CRC32 using the ARMv8 CRC32 instructions
+ *
+ * The instructions are optional in ARMv8.0, so their presence is checked
+ * in ID_AA64ISAR0_EL1 before first use.
+ */
+
+#include <efi_loader.h>
+#include <linux/types.h>
+#include <u-boot/crc.h>
+
+#define ID_AA64ISAR0_CRC32_SHIFT	16
+
+static int __efi_runtime_data crc32_insn = -1;
+
+static bool __efi_runtime crc32_have_insn(void)
+{
+	u64 isar0;
+
+	if (crc32_insn < 0) {
+		asm volatile("mrs %0, id_aa64isar0_el1" : "=r" (isar0));
+		crc32_insn = !!((isar0 >> ID_AA64ISAR0_CRC32_SHIFT) & 0xf);
+	}
+
+	return crc32_insn;
+}
+
+uint32_t __efi_runtime crc32_no_comp(uint32_t crc, const unsigned char *buf,
+				     uint len)
+{
+	if (!crc32_have_insn())
+		return crc32_no_comp_generic(crc, buf, len);
+
+	for (; len && ((ulong)buf & 7); len--)
+		crc = __builtin_aarch64_crc32b(crc, *buf++);
+
+	for (; len >= 8; len -= 8, buf += 8)
+		crc = __builtin_aarch64_crc32x(crc, *(const u64 *)buf);
+
+	if (len & 4) {
+		crc = __builtin_aarch64_crc32w(crc, *(const u32 *)buf);
+		buf += 4;
+	}
+	if (len & 2) {
+		crc = __builtin_aarch64_crc32h(crc, *(const u16 *)buf);
+		buf += 2;
+	}
+	if (len & 1)
+		crc = __builtin_aarch64_crc32b(crc, *buf);
+
+	return crc;
+}
@@ -0,0 +1,45 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * sha512_ce_glue.c - SHA-384/SHA-512 using the ARMv8.2 SHA512 instructions
+ *
+ * The instructions are optional, so their presence is checked in
+ * ID_AA64ISAR0_EL1 before first use.
+ */
+
+#include <linux/types.h>
+#include <u-boot/sha512.h>
+
+#define ID_AA64ISAR0_SHA2_SHIFT		12
+#define ID_AA64ISAR0_SHA2_SHA512	2
+
+extern void sha512_armv8_ce_process(uint64_t state[8], uint8_t const *src,
+				    uint32_t blocks);
+
+static int sha512_insn = -1;
+
+static bool sha512_have_insn(void)
+{
+	u64 isar0;
+
+	if (sha512_insn < 0) {
+		asm volatile("mrs %0, id_aa64isar0_el1" : "=r" (isar0));
+		sha512_insn = ((isar0 >> ID_AA64ISAR0_SHA2_SHIFT) & 0xf) >=
+			ID_AA64ISAR0_SHA2_SHA512;
+	}
+
+	return sha512_insn;
+}
+
+void sha512_process(sha512_context *ctx, const unsigned char *data,
+		    unsigned int blocks)
+{
+	if (!blocks)
+		return;
+
+	if (!sha512_have_insn()) {
+		sha512_process_generic(ctx, data, blocks);
+		return;
+	}
+
+	sha512_armv8_ce_process(ctx->state, data, blocks);
+}
@@ -53,7 +53,7 @@ static unsigned int riscv_cboz_block_size __section(".data");
  * Return: true or false
  *
  */
-static bool __riscv_isa_extension_available(unsigned int bit)
+bool __riscv_isa_extension_available(unsigned int bit)
 {
 	if (bit >= RISCV_ISA_EXT_MAX)
 		return false;
@@ -438,7 +438,7 @@ static void match_isa_ext(const char *name, const char *name_end)
 
 		if ((name_end - name == strlen(ext->name)) &&
 		    !strncasecmp(name, ext->name, name_end - name)) {
-			if (ext->validate && !ext->validate(ext, riscv_isa))
+			if (!ext->validate || !ext->validate(ext, riscv_isa))
 				riscv_isa_set_ext(ext, riscv_isa);
 			break;
 		}
@@ -661,6 +661,15 @@ int riscv_cpu_setup(void)
 		csr_write(CSR_FCSR, 0);
 	}
 
+	/*
+	 * Enable the vector unit. The string and hash routines check the VS
+	 * field before using it, so they keep to the scalar code on harts
+	 * and in phases where this has not been done.
+	 */
+	if (IS_ENABLED(CONFIG_RISCV_ISA_V) &&
+	    __riscv_isa_extension_available(RISCV_ISA_EXT_v))
+		csr_set(MODE_PREFIX(status), SR_VS_INITIAL);
+
 	if (CONFIG_IS_ENABLED(RISCV_MMODE)) {
 		/*
 		 * Enable perf counters for cycle, time,
@@ -2,6 +2,9 @@
 
 #ifndef _ASM_CPUFEATURE_H
 #define _ASM_CPUFEATURE_H
+
+#include <linux/types.h>
+
 struct riscv_isa_ext_data {
 	const unsigned int id;
 	const char *name;
@@ -34,4 +37,17 @@ struct riscv_isa_ext_data {
 	_RISCV_ISA_EXT_DATA(_name, _id, _sub_exts, ARRAY_SIZE(_sub_exts), NULL)
 #define __RISCV_ISA_EXT_SUPERSET_VALIDATE(_name, _id, _sub_exts, _validate) \
 	_RISCV_ISA_EXT_DATA(_name, _id, _sub_exts, ARRAY_SIZE(_sub_exts), _validate)
+
+/**
+ * __riscv_isa_extension_available() - Check whether given extension
+ * is available or not
+ *
+ * The extensions are read from the device tree by the CPU setup, so this
+ * returns false before that has run.
+ *
+ * @bit: bit position of the desired extension, RISCV_ISA_EXT_...
+ * Return: true or false
+ */
+bool __riscv_isa_extension_available(unsigned int bit);
+
 #endif
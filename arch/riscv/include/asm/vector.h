@@ -0,0 +1,60 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Helpers for the routines using the RVV 1.0 vector extension
+ *
+ * The compiler is not allowed to emit vector instructions, so these
+ * routines are written in assembly and only called once the vector unit
+ * has been switched on, see riscv_cpu_setup(). The VS field of the status
+ * register reads as zero on harts without it, so checking that field is
+ * enough to decide whether vector instructions may be used.
+ */
+
+#ifndef __ASM_RISCV_VECTOR_H
+#define __ASM_RISCV_VECTOR_H
+
+#include <asm/encoding.h>
+
+/* Copies and fills shorter than this are left to the scalar routines */
+#define RISCV_VECTOR_MIN_LEN	64
+
+#ifdef __ASSEMBLY__
+
+/*
+ * Tail-call \func in place of the scalar code which follows if \len is at
+ * least RISCV_VECTOR_MIN_LEN and the vector unit is on. Clobbers t0 and t1.
+ */
+.macro	vector_tail func, len
+#ifdef CONFIG_RISCV_ISA_V
+	li	t0, RISCV_VECTOR_MIN_LEN
+	bltu	\len, t0, .Lscalar\@
+	csrr	t0, MODE_PREFIX(status)
+	li	t1, SR_VS
+	and	t0, t0, t1
+	beqz	t0, .Lscalar\@
+	tail	\func
+.Lscalar\@:
+#endif
+.endm
+
+#else
+
+#include <linux/types.h>
+
+/**
+ * riscv_vector_enabled() - Check whether vector instructions may be used
+ *
+ * This is false on harts without the vector unit and before it is switched
+ * on. Operating systems also leave it off while calling EFI runtime
+ * services, which keeps those from touching the vector registers.
+ *
+ * Return: true if the vector unit is on
+ */
+static inline bool riscv_vector_enabled(void)
+{
+	return IS_ENABLED(CONFIG_RISCV_ISA_V) &&
+		(csr_read(MODE_PREFIX(status)) & SR_VS);
+}
+
+#endif /* __ASSEMBLY__ */
+
+#endif /* __ASM_RISCV_VECTOR_H */
@@ -0,0 +1,49 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * crc32_zvbc_glue.c - CRC32 using the RISC-V Zvbc extension
+ *
+ * Zvbc is looked up in the ISA string of the device tree once it has been
+ * parsed, and the result kept in runtime data, as crc32_no_comp() is also
+ * an EFI runtime service helper and must not call into boot-time code. The
+ * vector unit being on is checked on every call, which also keeps EFI
+ * runtime services called by an operating system on the software
+ * implementation.
+ */
+
+#include <efi_loader.h>
+#include <event.h>
+#include <asm/cpufeature.h>
+#include <asm/hwcap.h>
+#include <asm/vector.h>
+#include <linux/types.h>
+#include <u-boot/crc.h>
+
+/* buffers shorter than this are not worth the setup of the folding loop */
+#define CRC32_ZVBC_MIN	256
+
+/* @len must be a multiple of 16 and at least 64 */
+extern u32 crc32_zvbc_fold(u32 crc, const u8 *p, ulong len);
+
+static bool __efi_runtime_data crc32_zvbc;
+
+static int crc32_zvbc_init(void)
+{
+	crc32_zvbc = __riscv_isa_extension_available(RISCV_ISA_EXT_ZVBC);
+
+	return 0;
+}
+EVENT_SPY_SIMPLE(EVT_DM_POST_INIT_R, crc32_zvbc_init);
+
+uint32_t __efi_runtime crc32_no_comp(uint32_t crc, const unsigned char *buf,
+				     uint len)
+{
+	uint body;
+
+	if (len < CRC32_ZVBC_MIN || !crc32_zvbc || !riscv_vector_enabled())
+		return crc32_no_comp_generic(crc, buf, len);
+
+	body = len & ~15;
+	crc = crc32_zvbc_fold(crc, buf, body);
+
+	return crc32_no_comp_generic(crc, buf + body, len - body);
+}
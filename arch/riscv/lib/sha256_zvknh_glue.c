@@ -0,0 +1,37 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * sha256_zvknh_glue.c - SHA-256 using the RISC-V Zvknha/Zvknhb extensions
+ *
+ * Either extension is looked up in the ISA string of the device tree, and
+ * the vector unit being on is checked on every call.
+ */
+
+#include <asm/cpufeature.h>
+#include <asm/hwcap.h>
+#include <asm/vector.h>
+#include <linux/types.h>
+#include <u-boot/sha256.h>
+
+extern void sha256_zvknh_process(uint32_t state[8], const uint8_t *data,
+				 uint32_t blocks);
+
+static bool sha256_have_zvknh(void)
+{
+	return riscv_vector_enabled() &&
+		(__riscv_isa_extension_available(RISCV_ISA_EXT_ZVKNHA) ||
+		 __riscv_isa_extension_available(RISCV_ISA_EXT_ZVKNHB));
+}
+
+void sha256_process(sha256_context *ctx, const unsigned char *data,
+		    unsigned int blocks)
+{
+	if (!blocks)
+		return;
+
+	if (!sha256_have_zvknh()) {
+		sha256_process_generic(ctx, data, blocks);
+		return;
+	}
+
+	sha256_zvknh_process(ctx->state, data, blocks);
+}
@@ -15,6 +15,7 @@
 #include <asm/io.h>
 #include <asm/malloc.h>
 #include <asm/state.h>
+#include <asm/test.h>
 #include <dm/ofnode.h>
 #include <linux/delay.h>
 #include <linux/libfdt.h>
@@ -24,6 +25,16 @@ DECLARE_GLOBAL_DATA_PTR;
 /* Enable access to PCI memory with map_sysmem() */
 static bool enable_pci_map;
 
+/* Register windows handled by an emulator rather than plain memory */
+#define SANDBOX_MMIO_WINDOWS	4
+
+static struct sandbox_mmio_window {
+	void *base;
+	ulong size;
+	const struct sandbox_mmio_ops *ops;
+	void *priv;
+} mmio_windows[SANDBOX_MMIO_WINDOWS];
+
 #ifdef CONFIG_PCI
 /* Last device that was mapped into memory, and length of mapping */
 static struct udevice *map_dev;
@@ -266,9 +277,55 @@ void sandbox_map_list(void)
 	}
 }
 
+int sandbox_mmio_add(void *base, ulong size,
+		     const struct sandbox_mmio_ops *ops, void *priv)
+{
+	struct sandbox_mmio_window *win;
+
+	for (win = mmio_windows; win < mmio_windows + SANDBOX_MMIO_WINDOWS;
+	     win++) {
+		if (win->ops)
+			continue;
+		win->base = base;
+		win->size = size;
+		win->ops = ops;
+		win->priv = priv;
+		return 0;
+	}
+
+	return -ENOSPC;
+}
+
+void sandbox_mmio_remove(void *base)
+{
+	struct sandbox_mmio_window *win;
+
+	for (win = mmio_windows; win < mmio_windows + SANDBOX_MMIO_WINDOWS;
+	     win++)
+		if (win->ops && win->base == base)
+			memset(win, '\0', sizeof(*win));
+}
+
+static struct sandbox_mmio_window *sandbox_mmio_find(const void *addr)
+{
+	struct sandbox_mmio_window *win;
+
+	for (win = mmio_windows; win < mmio_windows + SANDBOX_MMIO_WINDOWS;
+	     win++)
+		if (win->ops && addr >= win->base &&
+		    addr < win->base + win->size)
+			return win;
+
+	return NULL;
+}
+
 unsigned long sandbox_read(const void *addr, enum sandboxio_size_t size)
 {
 	struct sandbox_state *state = state_get_current();
+	struct sandbox_mmio_window *win = sandbox_mmio_find(addr);
+
+	if (win)
+		return win->ops->read(win->priv, addr - win->base, size);
 
 	if (!state->allow_memio)
 		return 0;
@@ -290,6 +347,12 @@ unsigned long sandbox_read(const void *addr, enum sandboxio_size_t size)
 void sandbox_write(void *addr, unsigned int val, enum sandboxio_size_t size)
 {
 	struct sandbox_state *state = state_get_current();
+	struct sandbox_mmio_window *win = sandbox_mmio_find(addr);
+
+	if (win) {
+		win->ops->write(win->priv, addr - win->base, val, size);
+		return;
+	}
 
 	if (!state->allow_memio)
 		return;
@@ -23,8 +23,10 @@
 #include <unistd.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/time.h>
 #include <sys/types.h>
+#include <linux/aio_abi.h>
 #include <linux/compiler_attributes.h>
 #include <linux/types.h>
 
@@ -67,6 +69,87 @@ ssize_t os_write(int fd, const void *buf, size_t count)
 	return ret;
 }
 
+struct os_aio {
+	aio_context_t ctx;
+	struct iocb cb;
+};
+
+int os_aio_start(int fd, void *buf, size_t count, off_t offset, bool write,
+		 void **handlep)
+{
+	struct iocb *cbs[1];
+	struct os_aio *aio;
+	int err;
+
+	aio = os_malloc(sizeof(*aio));
+	if (!aio)
+		return -ENOMEM;
+	memset(aio, '\0', sizeof(*aio));
+	if (syscall(SYS_io_setup, 1, &aio->ctx)) {
+		err = -errno;
+		os_free(aio);
+		return err;
+	}
+
+	aio->cb.aio_fildes = fd;
+	aio->cb.aio_lio_opcode = write ? IOCB_CMD_PWRITE : IOCB_CMD_PREAD;
+	aio->cb.aio_buf = (uintptr_t)buf;
+	aio->cb.aio_nbytes = count;
+	aio->cb.aio_offset = offset;
+	cbs[0] = &aio->cb;
+	if (syscall(SYS_io_submit, aio->ctx, 1, cbs) != 1) {
+		err = -errno;
+		syscall(SYS_io_destroy, aio->ctx);
+		os_free(aio);
+		return err;
+	}
+	*handlep = aio;
+
+	return 0;
+}
+
+int os_aio_poll(void *handle, ssize_t *resultp)
+{
+	struct timespec timeout = { 0, 0 };
+	struct os_aio *aio = handle;
+	struct io_event event;
+	long ret;
+
+	ret = syscall(SYS_io_getevents, aio->ctx, 0, 1, &event, &timeout);
+	if (!ret)
+		return -EAGAIN;
+	*resultp = ret < 0 ? -errno : event.res;
+	syscall(SYS_io_destroy, aio->ctx);
+	os_free(aio);
+
+	return 0;
+}
+
+int os_thread_create(void *(*func)(void *arg), void *arg, void **threadp)
+{
+	pthread_t thread;
+	int err;
+
+	err = pthread_create(&thread, NULL, func, arg);
+	if (err)
+		return -err;
+	*threadp = (void *)thread;
+
+	return 0;
+}
+
+int os_thread_join(void *thread)
+{
+	return -pthread_join((pthread_t)thread, NULL);
+}
+
+int os_get_nprocs(void)
+{
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+
+	return count > 0 ? count : 1;
+}
+
 int os_printf(const char *fmt, ...)
 {
 	va_list args;
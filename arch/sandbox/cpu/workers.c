@@ -0,0 +1,51 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Worker pool backend for sandbox, running secondary workers as host threads
+ */
+
+#include <os.h>
+#include <workers.h>
+#include <linux/kernel.h>
+
+static void *threads[CONFIG_WORKERS_MAX];
+static uint started;
+
+static void *sandbox_worker(void *arg)
+{
+	workers_secondary((uintptr_t)arg);
+
+	return NULL;
+}
+
+/*
+ * Use one thread per host CPU, but always at least one so that tests
+ * exercise the parallel path even on a single-CPU host
+ */
+uint workers_arch_max(void)
+{
+	return clamp(os_get_nprocs() - 1, 1, CONFIG_WORKERS_MAX - 1);
+}
+
+int workers_arch_start(uint count)
+{
+	int ret;
+
+	for (started = 0; started < count; started++) {
+		ret = os_thread_create(sandbox_worker,
+				       (void *)(uintptr_t)(started + 1),
+				       &threads[started]);
+		if (ret)
+			break;
+	}
+	if (!started)
+		return ret;
+
+	/* the threads started so far take all the jobs between them */
+	return 0;
+}
+
+void workers_arch_wait(void)
+{
+	while (started)
+		os_thread_join(threads[--started]);
+}
@@ -9,6 +9,7 @@
 #define __ASM_TEST_H
 
 #include <pci_ids.h>
+#include <asm/io.h>
 
 struct unit_test_state;
 
@@ -285,6 +286,112 @@ uint sandbox_pci_read_bar(u32 barval, int type, uint size);
  */
 void sandbox_set_enable_memio(bool enable);
 
+/**
+ * struct sandbox_mmio_ops - Operations for an emulated register window
+ *
+ * @read: Read a register, returning its value
+ * @write: Write a register
+ */
+struct sandbox_mmio_ops {
+	ulong (*read)(void *priv, ulong offset, enum sandboxio_size_t size);
+	void (*write)(void *priv, ulong offset, uint val,
+		      enum sandboxio_size_t size);
+};
+
+/**
+ * sandbox_mmio_add() - Route readl/writel() on a region to an emulator
+ *
+ * Accesses within the region are passed to @ops instead of memory, whether or
+ * not memory I/O is enabled with sandbox_set_enable_memio(). This allows
+ * drivers which poll status registers or write doorbells to be tested.
+ *
+ * @base: Start of the region
+ * @size: Size of the region in bytes
+ * @ops: Operations to call for each access
+ * @priv: Private pointer passed to @ops
+ * Return: 0 if OK, -ENOSPC if too many regions are registered
+ */
+int sandbox_mmio_add(void *base, ulong size,
+		     const struct sandbox_mmio_ops *ops, void *priv);
+
+/**
+ * sandbox_mmio_remove() - Stop emulating a region
+ *
+ * @base: Start of the region, as passed to sandbox_mmio_add()
+ */
+void sandbox_mmio_remove(void *base);
+
+/**
+ * sandbox_nvme_get_stats() - Read and reset the emulated NVMe statistics
+ *
+ * @dev: sandbox_nvme device
+ * @doorbellsp: Returns the number of submission queue doorbell writes
+ * @commandsp: Returns the number of commands executed
+ * @max_batchp: Returns the most commands submitted with one doorbell write
+ * Return: 0 if OK
+ */
+int sandbox_nvme_get_stats(struct udevice *dev, uint *doorbellsp,
+			   uint *commandsp, uint *max_batchp);
+
+/**
+ * sandbox_mmc_get_stats() - Read and reset the emulated MMC statistics
+ *
+ * @dev: sandbox MMC device
+ * @transfersp: Returns the number of data transfers, by command or queued task
+ * @max_blocksp: Returns the most blocks moved by one transfer
+ * @max_queuedp: Returns the most tasks queued at once with command queueing
+ * Return: 0 if OK
+ */
+int sandbox_mmc_get_stats(struct udevice *dev, uint *transfersp,
+			  uint *max_blocksp, uint *max_queuedp);
+
+/**
+ * sandbox_mmc_set_b_max() - Set the block count limit of the emulated host
+ *
+ * @dev: sandbox MMC device
+ * @b_max: Most blocks to transfer with one command or queued task
+ */
+void sandbox_mmc_set_b_max(struct udevice *dev, uint b_max);
+
+/**
+ * sandbox_virtio_get_stats() - Read and reset the emulated virtio statistics
+ *
+ * @dev: sandbox virtio transport device
+ * @notifiesp: Returns the number of times the driver notified the device
+ * @requestsp: Returns the number of block requests completed
+ * @max_batchp: Returns the most block requests completed for one notification
+ * Return: 0 if OK
+ */
+int sandbox_virtio_get_stats(struct udevice *dev, uint *notifiesp,
+			     uint *requestsp, uint *max_batchp);
+
+/**
+ * sandbox_virtio_set_features() - Set the features offered by the device
+ *
+ * These are used when the driver for the device is next probed.
+ *
+ * @dev: sandbox virtio transport device
+ * @features: Feature bits (1 << VIRTIO_..._F_...)
+ */
+void sandbox_virtio_set_features(struct udevice *dev, u64 features);
+
+/**
+ * sandbox_virtio_net_rx() - Receive a packet on the emulated network device
+ *
+ * The packet is spread over @nbufs of the receive buffers posted by the
+ * driver, as a device does when VIRTIO_NET_F_MRG_RXBUF is negotiated.
+ *
+ * @dev: sandbox virtio transport device
+ * @pkt: Packet data
+ * @len: Packet length in bytes
+ * @flags: Header flags (VIRTIO_NET_HDR_F_...)
+ * @nbufs: Number of buffers to use
+ * Return: 0 if OK, -ENOSPC if too few buffers are posted, -E2BIG if the
+ *	packet does not fit in them
+ */
+int sandbox_virtio_net_rx(struct udevice *dev, const void *pkt, int len,
+			  u8 flags, uint nbufs);
+
 /**
  * sandbox_cros_ec_set_test_flags() - Set behaviour for testing purposes
  *
@@ -0,0 +1,108 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * CRC32 using the PCLMULQDQ carry-less multiply instruction
+ *
+ * The input is folded 64 bytes at a time into four 128-bit accumulators,
+ * which are then folded into one and reduced to 32 bits with a Barrett
+ * reduction, as described in Intel's "Fast CRC Computation for Generic
+ * Polynomials Using PCLMULQDQ Instruction". The constants are those for the
+ * bit-reflected CRC32 polynomial 0xedb88320, as used by Linux.
+ */
+
+#include <cpuid.h>
+#include <efi_loader.h>
+#include <immintrin.h>
+#include <linux/types.h>
+#include <u-boot/crc.h>
+
+/* buffers shorter than this are not worth the setup of the folding loop */
+#define CRC32_PCLMUL_MIN	256
+
+static int __efi_runtime_data crc32_pclmul = -1;
+
+static bool __efi_runtime crc32_have_pclmul(void)
+{
+	uint eax, ebx, ecx, edx;
+
+	if (crc32_pclmul < 0) {
+		crc32_pclmul = __get_cpuid(1, &eax, &ebx, &ecx, &edx) &&
+			(ecx & bit_PCLMUL) && (ecx & bit_SSE4_1);
+	}
+
+	return crc32_pclmul;
+}
+
+#define CRC32_PCLMUL_TARGET	__attribute__((target("pclmul,sse4.1")))
+
+static inline __m128i CRC32_PCLMUL_TARGET fold(__m128i acc, __m128i k,
+					       __m128i data)
+{
+	return _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(acc, k, 0x00),
+					   _mm_clmulepi64_si128(acc, k, 0x11)),
+			     data);
+}
+
+/* @len must be a multiple of 16 and at least 64 */
+static uint32_t __efi_runtime CRC32_PCLMUL_TARGET
+crc32_pclmul_fold(uint32_t crc, const u8 *p, uint len)
+{
+	const __m128i r2r1 = _mm_set_epi64x(0x1c6e41596, 0x154442bd4);
+	const __m128i r4r3 = _mm_set_epi64x(0x0ccaa009e, 0x1751997d0);
+	const __m128i r5 = _mm_set_epi64x(0, 0x163cd6124);
+	const __m128i rupoly = _mm_set_epi64x(0x1f7011641, 0x1db710641);
+	const __m128i mask32 = _mm_set_epi32(0, 0, 0, ~0);
+	__m128i x1, x2, x3, x4, t;
+
+	x1 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)p),
+			   _mm_cvtsi32_si128(crc));
+	x2 = _mm_loadu_si128((const __m128i *)(p + 16));
+	x3 = _mm_loadu_si128((const __m128i *)(p + 32));
+	x4 = _mm_loadu_si128((const __m128i *)(p + 48));
+	p += 64;
+	len -= 64;
+
+	for (; len >= 64; len -= 64, p += 64) {
+		x1 = fold(x1, r2r1, _mm_loadu_si128((const __m128i *)p));
+		x2 = fold(x2, r2r1, _mm_loadu_si128((const __m128i *)(p + 16)));
+		x3 = fold(x3, r2r1, _mm_loadu_si128((const __m128i *)(p + 32)));
+		x4 = fold(x4, r2r1, _mm_loadu_si128((const __m128i *)(p + 48)));
+	}
+
+	/* fold the four accumulators, then any remaining blocks, into one */
+	x1 = fold(x1, r4r3, x2);
+	x1 = fold(x1, r4r3, x3);
+	x1 = fold(x1, r4r3, x4);
+	for (; len >= 16; len -= 16, p += 16)
+		x1 = fold(x1, r4r3, _mm_loadu_si128((const __m128i *)p));
+
+	/* 128 to 64 bits, appending the 32 zero bits of the CRC */
+	t = _mm_clmulepi64_si128(r4r3, x1, 0x01);
+	x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), t);
+
+	/* 64 to 32 bits */
+	t = _mm_srli_si128(x1, 4);
+	x1 = _mm_clmulepi64_si128(_mm_and_si128(x1, mask32), r5, 0x00);
+	x1 = _mm_xor_si128(x1, t);
+
+	/* Barrett reduction to the final 32 bits */
+	t = x1;
+	x1 = _mm_clmulepi64_si128(_mm_and_si128(x1, mask32), rupoly, 0x10);
+	x1 = _mm_clmulepi64_si128(_mm_and_si128(x1, mask32), rupoly, 0x00);
+	x1 = _mm_xor_si128(x1, t);
+
+	return _mm_extract_epi32(x1, 1);
+}
+
+uint32_t __efi_runtime crc32_no_comp(uint32_t crc, const unsigned char *buf,
+				     uint len)
+{
+	uint body;
+
+	if (len < CRC32_PCLMUL_MIN || !crc32_have_pclmul())
+		return crc32_no_comp_generic(crc, buf, len);
+
+	body = len & ~15;
+	crc = crc32_pclmul_fold(crc, buf, body);
+
+	return crc32_no_comp_generic(crc, buf + body, len - body);
+}
@@ -0,0 +1,126 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * SHA-256 using the x86 SHA extensions (SHA-NI)
+ *
+ * Each SHA256RNDS2 does two rounds on the state split as ABEF and CDGH,
+ * while SHA256MSG1 and SHA256MSG2 extend the message schedule four words
+ * at a time.
+ */
+
+#include <cpuid.h>
+#include <immintrin.h>
+#include <linux/types.h>
+#include <u-boot/sha256.h>
+
+static int sha256_shani = -1;
+
+static bool sha256_have_shani(void)
+{
+	uint eax, ebx, ecx, edx;
+
+	if (sha256_shani < 0) {
+		sha256_shani = __get_cpuid(1, &eax, &ebx, &ecx, &edx) &&
+			(ecx & bit_SSSE3) && (ecx & bit_SSE4_1) &&
+			__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) &&
+			(ebx & bit_SHA);
+	}
+
+	return sha256_shani;
+}
+
+static const u32 sha256_shani_k[64] __aligned(16) = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+	0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+	0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+	0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+	0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+	0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+#define SHA256_SHANI_TARGET	__attribute__((target("sha,ssse3,sse4.1")))
+
+/* Next four words of the schedule, from the previous sixteen (oldest first) */
+static inline __m128i SHA256_SHANI_TARGET
+sha256_shani_next(__m128i w0, __m128i w1, __m128i w2, __m128i w3)
+{
+	__m128i tmp;
+
+	tmp = _mm_add_epi32(_mm_sha256msg1_epu32(w0, w1),
+			    _mm_alignr_epi8(w3, w2, 4));
+
+	return _mm_sha256msg2_epu32(tmp, w3);
+}
+
+static void SHA256_SHANI_TARGET sha256_shani_blocks(u32 state[8],
+						    const u8 *data,
+						    uint blocks)
+{
+	const __m128i bswap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL,
+					     0x0405060700010203ULL);
+	const __m128i *k = (const __m128i *)sha256_shani_k;
+	__m128i abef, cdgh, abef_save, cdgh_save, msg[4], tmp;
+	uint i;
+
+	/* A..D and E..H to ABEF and CDGH, highest lane first */
+	tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)state), 0xb1);
+	cdgh = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)(state + 4)),
+				 0x1b);
+	abef = _mm_alignr_epi8(tmp, cdgh, 8);
+	cdgh = _mm_blend_epi16(cdgh, tmp, 0xf0);
+
+	for (; blocks; blocks--, data += 64) {
+		abef_save = abef;
+		cdgh_save = cdgh;
+
+		/* msg[] holds the last sixteen words of the schedule */
+		for (i = 0; i < 16; i++) {
+			if (i < 4) {
+				tmp = _mm_loadu_si128((const __m128i *)data + i);
+				msg[i] = _mm_shuffle_epi8(tmp, bswap);
+			} else {
+				msg[i & 3] = sha256_shani_next(msg[i & 3],
+							       msg[(i + 1) & 3],
+							       msg[(i + 2) & 3],
+							       msg[(i + 3) & 3]);
+			}
+
+			tmp = _mm_add_epi32(msg[i & 3], _mm_load_si128(&k[i]));
+			cdgh = _mm_sha256rnds2_epu32(cdgh, abef, tmp);
+			tmp = _mm_shuffle_epi32(tmp, 0x0e);
+			abef = _mm_sha256rnds2_epu32(abef, cdgh, tmp);
+		}
+
+		abef = _mm_add_epi32(abef, abef_save);
+		cdgh = _mm_add_epi32(cdgh, cdgh_save);
+	}
+
+	/* and back to A..D and E..H */
+	tmp = _mm_shuffle_epi32(abef, 0x1b);
+	cdgh = _mm_shuffle_epi32(cdgh, 0xb1);
+	_mm_storeu_si128((__m128i *)state, _mm_blend_epi16(tmp, cdgh, 0xf0));
+	_mm_storeu_si128((__m128i *)(state + 4), _mm_alignr_epi8(cdgh, tmp, 8));
+}
+
+void sha256_process(sha256_context *ctx, const unsigned char *data,
+		    unsigned int blocks)
+{
+	if (!blocks)
+		return;
+
+	if (!sha256_have_shani()) {
+		sha256_process_generic(ctx, data, blocks);
+		return;
+	}
+
+	sha256_shani_blocks(ctx->state, data, blocks);
+}
@@ -0,0 +1,215 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * SHA-384/SHA-512 using AVX2 for the message schedule
+ *
+ * x86 has no SHA-512 round instructions before the SHA512 extension, so the
+ * rounds stay scalar, built with BMI2 so that the rotates use RORX. The
+ * message schedule is extended four words at a time in AVX2 registers and
+ * the round constants are added in while at it, which takes that work off
+ * the critical path of the rounds.
+ */
+
+#include <cpuid.h>
+#include <immintrin.h>
+#include <linux/types.h>
+#include <u-boot/sha512.h>
+
+static int sha512_avx2 = -1;
+
+static bool sha512_have_avx2(void)
+{
+	uint eax, ebx, ecx, edx, xcr0, xcr0_hi;
+
+	if (sha512_avx2 < 0) {
+		sha512_avx2 = __get_cpuid(1, &eax, &ebx, &ecx, &edx) &&
+			(ecx & bit_OSXSAVE) && (ecx & bit_AVX) &&
+			__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) &&
+			(ebx & bit_AVX2) && (ebx & bit_BMI2);
+		/* the OS must also save the YMM registers */
+		if (sha512_avx2) {
+			asm volatile("xgetbv" : "=a" (xcr0), "=d" (xcr0_hi)
+				     : "c" (0));
+			sha512_avx2 = (xcr0 & 6) == 6;
+		}
+	}
+
+	return sha512_avx2;
+}
+
+static const u64 sha512_avx2_k[80] __aligned(32) = {
+	0x428a2f98d728ae22ULL, 0x7137449123ef65cdULL,
+	0xb5c0fbcfec4d3b2fULL, 0xe9b5dba58189dbbcULL,
+	0x3956c25bf348b538ULL, 0x59f111f1b605d019ULL,
+	0x923f82a4af194f9bULL, 0xab1c5ed5da6d8118ULL,
+	0xd807aa98a3030242ULL, 0x12835b0145706fbeULL,
+	0x243185be4ee4b28cULL, 0x550c7dc3d5ffb4e2ULL,
+	0x72be5d74f27b896fULL, 0x80deb1fe3b1696b1ULL,
+	0x9bdc06a725c71235ULL, 0xc19bf174cf692694ULL,
+	0xe49b69c19ef14ad2ULL, 0xefbe4786384f25e3ULL,
+	0x0fc19dc68b8cd5b5ULL, 0x240ca1cc77ac9c65ULL,
+	0x2de92c6f592b0275ULL, 0x4a7484aa6ea6e483ULL,
+	0x5cb0a9dcbd41fbd4ULL, 0x76f988da831153b5ULL,
+	0x983e5152ee66dfabULL, 0xa831c66d2db43210ULL,
+	0xb00327c898fb213fULL, 0xbf597fc7beef0ee4ULL,
+	0xc6e00bf33da88fc2ULL, 0xd5a79147930aa725ULL,
+	0x06ca6351e003826fULL, 0x142929670a0e6e70ULL,
+	0x27b70a8546d22ffcULL, 0x2e1b21385c26c926ULL,
+	0x4d2c6dfc5ac42aedULL, 0x53380d139d95b3dfULL,
+	0x650a73548baf63deULL, 0x766a0abb3c77b2a8ULL,
+	0x81c2c92e47edaee6ULL, 0x92722c851482353bULL,
+	0xa2bfe8a14cf10364ULL, 0xa81a664bbc423001ULL,
+	0xc24b8b70d0f89791ULL, 0xc76c51a30654be30ULL,
+	0xd192e819d6ef5218ULL, 0xd69906245565a910ULL,
+	0xf40e35855771202aULL, 0x106aa07032bbd1b8ULL,
+	0x19a4c116b8d2d0c8ULL, 0x1e376c085141ab53ULL,
+	0x2748774cdf8eeb99ULL, 0x34b0bcb5e19b48a8ULL,
+	0x391c0cb3c5c95a63ULL, 0x4ed8aa4ae3418acbULL,
+	0x5b9cca4f7763e373ULL, 0x682e6ff3d6b2b8a3ULL,
+	0x748f82ee5defb2fcULL, 0x78a5636f43172f60ULL,
+	0x84c87814a1f0ab72ULL, 0x8cc702081a6439ecULL,
+	0x90befffa23631e28ULL, 0xa4506cebde82bde9ULL,
+	0xbef9a3f7b2c67915ULL, 0xc67178f2e372532bULL,
+	0xca273eceea26619cULL, 0xd186b8c721c0c207ULL,
+	0xeada7dd6cde0eb1eULL, 0xf57d4f7fee6ed178ULL,
+	0x06f067aa72176fbaULL, 0x0a637dc5a2c898a6ULL,
+	0x113f9804bef90daeULL, 0x1b710b35131c471bULL,
+	0x28db77f523047d84ULL, 0x32caab7b40c72493ULL,
+	0x3c9ebe0a15c9bebcULL, 0x431d67c49c100d4cULL,
+	0x4cc5d4becb3e42b6ULL, 0x597f299cfc657e2aULL,
+	0x5fcb6fab3ad6faecULL, 0x6c44198c4a475817ULL,
+};
+
+#define SHA512_AVX2_TARGET	__attribute__((target("avx2,bmi2")))
+
+static inline __m256i SHA512_AVX2_TARGET ror256(__m256i x, int n)
+{
+	return _mm256_or_si256(_mm256_srli_epi64(x, n),
+			       _mm256_slli_epi64(x, 64 - n));
+}
+
+static inline __m128i SHA512_AVX2_TARGET ror128(__m128i x, int n)
+{
+	return _mm_or_si128(_mm_srli_epi64(x, n), _mm_slli_epi64(x, 64 - n));
+}
+
+static inline __m256i SHA512_AVX2_TARGET s0_256(__m256i x)
+{
+	return _mm256_xor_si256(_mm256_xor_si256(ror256(x, 1), ror256(x, 8)),
+				_mm256_srli_epi64(x, 7));
+}
+
+static inline __m128i SHA512_AVX2_TARGET s1_128(__m128i x)
+{
+	return _mm_xor_si128(_mm_xor_si128(ror128(x, 19), ror128(x, 61)),
+			     _mm_srli_epi64(x, 6));
+}
+
+/* Fill in @wk with the message schedule plus the round constants */
+static void SHA512_AVX2_TARGET sha512_avx2_schedule(u64 w[80], u64 wk[80],
+						    const u8 *data)
+{
+	const __m256i bswap = _mm256_set_epi64x(0x08090a0b0c0d0e0fULL,
+						0x0001020304050607ULL,
+						0x08090a0b0c0d0e0fULL,
+						0x0001020304050607ULL);
+	__m256i x;
+	__m128i lo, hi;
+	int t;
+
+	for (t = 0; t < 16; t += 4) {
+		x = _mm256_loadu_si256((const __m256i *)(data + t * 8));
+		x = _mm256_shuffle_epi8(x, bswap);
+		_mm256_store_si256((__m256i *)&w[t], x);
+	}
+
+	for (; t < 80; t += 4) {
+		/* everything but sigma1, which needs the words just computed */
+		x = _mm256_add_epi64(_mm256_load_si256((__m256i *)&w[t - 16]),
+				     s0_256(_mm256_loadu_si256((__m256i *)
+							       &w[t - 15])));
+		x = _mm256_add_epi64(x, _mm256_loadu_si256((__m256i *)
+							   &w[t - 7]));
+
+		lo = _mm_add_epi64(_mm256_castsi256_si128(x),
+				   s1_128(_mm_load_si128((__m128i *)&w[t - 2])));
+		hi = _mm_add_epi64(_mm256_extracti128_si256(x, 1), s1_128(lo));
+		_mm_store_si128((__m128i *)&w[t], lo);
+		_mm_store_si128((__m128i *)&w[t + 2], hi);
+	}
+
+	for (t = 0; t < 80; t += 4) {
+		x = _mm256_add_epi64(_mm256_load_si256((__m256i *)&w[t]),
+				     _mm256_load_si256((__m256i *)
+						       &sha512_avx2_k[t]));
+		_mm256_store_si256((__m256i *)&wk[t], x);
+	}
+}
+
+#define ROR64(x, n)	(((x) >> (n)) | ((x) << (64 - (n))))
+#define E0(x)		(ROR64(x, 28) ^ ROR64(x, 34) ^ ROR64(x, 39))
+#define E1(x)		(ROR64(x, 14) ^ ROR64(x, 18) ^ ROR64(x, 41))
+#define CH(x, y, z)	((z) ^ ((x) & ((y) ^ (z))))
+#define MAJ(x, y, z)	(((x) & (y)) | ((z) & ((x) | (y))))
+
+/* One round, the caller rotates the names of the working variables */
+#define ROUND(a, b, c, d, e, f, g, h, wk) do {				\
+	u64 t1 = h + E1(e) + CH(e, f, g) + (wk);			\
+									\
+	d += t1;							\
+	h = t1 + E0(a) + MAJ(a, b, c);					\
+} while (0)
+
+static void SHA512_AVX2_TARGET sha512_avx2_blocks(u64 state[8],
+						  const u8 *data, uint blocks)
+{
+	u64 w[80] __aligned(32), wk[80] __aligned(32);
+	u64 a, b, c, d, e, f, g, h;
+	int t;
+
+	for (; blocks; blocks--, data += SHA512_BLOCK_SIZE) {
+		sha512_avx2_schedule(w, wk, data);
+
+		a = state[0];
+		b = state[1];
+		c = state[2];
+		d = state[3];
+		e = state[4];
+		f = state[5];
+		g = state[6];
+		h = state[7];
+
+		for (t = 0; t < 80; t += 8) {
+			ROUND(a, b, c, d, e, f, g, h, wk[t]);
+			ROUND(h, a, b, c, d, e, f, g, wk[t + 1]);
+			ROUND(g, h, a, b, c, d, e, f, wk[t + 2]);
+			ROUND(f, g, h, a, b, c, d, e, wk[t + 3]);
+			ROUND(e, f, g, h, a, b, c, d, wk[t + 4]);
+			ROUND(d, e, f, g, h, a, b, c, wk[t + 5]);
+			ROUND(c, d, e, f, g, h, a, b, wk[t + 6]);
+			ROUND(b, c, d, e, f, g, h, a, wk[t + 7]);
+		}
+
+		state[0] += a;
+		state[1] += b;
+		state[2] += c;
+		state[3] += d;
+		state[4] += e;
+		state[5] += f;
+		state[6] += g;
+		state[7] += h;
+	}
+}
+
+void sha512_process(sha512_context *ctx, const unsigned char *data,
+		    unsigned int blocks)
+{
+	if (!blocks)
+		return;
+
+	if (!sha512_have_avx2()) {
+		sha512_process_generic(ctx, data, blocks);
+		return;
+	}
+
+	sha512_avx2_blocks(ctx->state, data, blocks);
+}
@@ -26,6 +26,7 @@
 #include <malloc.h>
 #include <memalign.h>
 #include <asm/global_data.h>
+#include <cyclic.h>
 #ifdef CONFIG_DM_HASH
 #include <dm.h>
 #include <u-boot/hash.h>
@@ -1290,15 +1291,104 @@ int calculate_hash(const void *data, int data_len, const char *name,
 	return 0;
 }
 
+/*
+ * Amount of data passed to each hash algorithm in turn, small enough to stay
+ * in the cache so that several digests take a single pass over the data
+ */
+#define FIT_HASH_CHUNK		0x10000
+
+void fit_image_hash_start(const void *fit, int image_noffset,
+			  struct fit_image_hashes *hashes)
+{
+	struct fit_image_hash *hash;
+	const char *algo;
+	int noffset, ignore;
+
+	hashes->count = 0;
+
+	/* calculate_hash() uses the hash uclass instead */
+	if (!tools_build() && IS_ENABLED(CONFIG_DM_HASH))
+		return;
+
+	fdt_for_each_subnode(noffset, fit, image_noffset) {
+		const char *name = fit_get_name(fit, noffset, NULL);
+
+		if (strncmp(name, FIT_HASH_NODENAME, strlen(FIT_HASH_NODENAME)))
+			continue;
+		if (hashes->count == FIT_MAX_HASH_NODES)
+			break;
+		if (fit_image_hash_get_algo(fit, noffset, &algo))
+			continue;
+		if (!tools_build()) {
+			fit_image_hash_get_ignore(fit, noffset, &ignore);
+			if (ignore)
+				continue;
+		}
+
+		hash = &hashes->hash[hashes->count];
+		if (hash_progressive_lookup_algo(algo, &hash->algo) ||
+		    hash->algo->hash_init(hash->algo, &hash->ctx))
+			continue;
+		hash->noffset = noffset;
+		hash->value_len = 0;
+		hashes->count++;
+	}
+}
+
+void fit_image_hash_update(struct fit_image_hashes *hashes, const void *data,
+			   size_t size, bool last)
+{
+	struct fit_image_hash *hash;
+	const char *p = data;
+	size_t len;
+	int i;
+
+	do {
+		len = size > FIT_HASH_CHUNK ? FIT_HASH_CHUNK : size;
+		for (i = 0; i < hashes->count; i++) {
+			hash = &hashes->hash[i];
+			/* the context is freed on error */
+			if (hash->ctx &&
+			    hash->algo->hash_update(hash->algo, hash->ctx, p,
+						    len, last && len == size))
+				hash->ctx = NULL;
+		}
+		p += len;
+		size -= len;
+#ifndef USE_HOSTCC
+		schedule();
+#endif
+	} while (size);
+}
+
+void fit_image_hash_finish(struct fit_image_hashes *hashes)
+{
+	struct fit_image_hash *hash;
+	int i;
+
+	for (i = 0; i < hashes->count; i++) {
+		hash = &hashes->hash[i];
+		if (hash->ctx &&
+		    !hash->algo->hash_finish(hash->algo, hash->ctx, hash->value,
+					     sizeof(hash->value)))
+			hash->value_len = hash->algo->digest_size;
+		hash->ctx = NULL;
+	}
+}
+
 static int fit_image_check_hash(const void *fit, int noffset, const void *data,
-				size_t size, char **err_msgp)
+				size_t size,
+				const struct fit_image_hashes *hashes,
+				char **err_msgp)
 {
-	ALLOC_CACHE_ALIGN_BUFFER(uint8_t, value, FIT_MAX_HASH_LEN);
-	int value_len;
+	ALLOC_CACHE_ALIGN_BUFFER(uint8_t, buf, FIT_MAX_HASH_LEN);
+	const uint8_t *value = NULL;
+	int value_len = 0;
 	const char *algo;
 	uint8_t *fit_value;
 	int fit_value_len;
 	int ignore;
+	int i;
 
 	*err_msgp = NULL;
 
@@ -1322,9 +1412,21 @@ static int fit_image_check_hash(const void *fit, int noffset, const void *data,
 		return -1;
 	}
 
-	if (calculate_hash(data, size, algo, value, &value_len)) {
-		*err_msgp = "Unsupported hash algorithm";
-		return -1;
+	for (i = 0; i < hashes->count; i++) {
+		if (hashes->hash[i].noffset == noffset) {
+			value = hashes->hash[i].value;
+			value_len = hashes->hash[i].value_len;
+			break;
+		}
+	}
+
+	/* not hashed progressively, or that failed */
+	if (!value_len) {
+		value = buf;
+		if (calculate_hash(data, size, algo, buf, &value_len)) {
+			*err_msgp = "Unsupported hash algorithm";
+			return -1;
+		}
 	}
 
 	if (value_len != fit_value_len) {
@@ -1341,6 +1443,20 @@ static int fit_image_check_hash(const void *fit, int noffset, const void *data,
 int fit_image_verify_with_data(const void *fit, int image_noffset,
 			       const void *key_blob, const void *data,
 			       size_t size)
+{
+	struct fit_image_hashes hashes;
+
+	fit_image_hash_start(fit, image_noffset, &hashes);
+	fit_image_hash_update(&hashes, data, size, true);
+	fit_image_hash_finish(&hashes);
+
+	return fit_image_verify_hashed(fit, image_noffset, key_blob, data, size,
+				       &hashes);
+}
+
+int fit_image_verify_hashed(const void *fit, int image_noffset,
+			    const void *key_blob, const void *data,
+			    size_t size, const struct fit_image_hashes *hashes)
 {
 	int		noffset = 0;
 	char		*err_msg = "";
@@ -1367,7 +1483,7 @@ int fit_image_verify_with_data(const void *fit, int image_noffset,
 		if (!strncmp(name, FIT_HASH_NODENAME,
 			     strlen(FIT_HASH_NODENAME))) {
 			if (fit_image_check_hash(fit, noffset, data, size,
-						 &err_msg))
+						 hashes, &err_msg))
 				goto error;
 			puts("+ ");
 		} else if (FIT_IMAGE_ENABLE_VERIFY && verify_all &&
@@ -0,0 +1,501 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Streaming decompression of images
+ *
+ * The compressed data is fed in arbitrary chunks, as it is read from storage,
+ * and decompressed straight into the final output buffer. Only the
+ * decompressor state and, for lz4, one compressed block are kept besides.
+ */
+
+#define LOG_CATEGORY	LOGC_BOOT
+
+#include <errno.h>
+#include <gzip.h>
+#include <image.h>
+#include <log.h>
+#include <malloc.h>
+#include <u-boot/lz4.h>
+#include <u-boot/zlib.h>
+#include <linux/kernel.h>
+#include <linux/zstd.h>
+#include <asm/unaligned.h>
+
+#define LZ4F_BLOCKUNCOMPRESSED_FLAG	0x80000000U
+#define LZ4F_SKIPPABLE_MAGIC		0x184D2A50
+#define LZ4F_SKIPPABLE_MASK		0xFFFFFFF0
+
+enum lz4_state {
+	LZ4_MAGIC,		/* frame magic, or the end of the data */
+	LZ4_FRAME,		/* flags and block descriptor */
+	LZ4_FRAME_REST,		/* optional content size and header checksum */
+	LZ4_BLOCK_HEADER,
+	LZ4_BLOCK,
+	LZ4_CHECKSUM,		/* optional content checksum */
+	LZ4_SKIP_SIZE,		/* size of a skippable frame */
+	LZ4_SKIP,		/* contents of a skippable frame */
+};
+
+struct lz4_stream {
+	enum lz4_state state;
+	bool has_content_size;
+	bool has_block_checksum;
+	bool has_content_checksum;
+	u32 block_header;
+	ulong need;		/* bytes needed to complete the current item */
+	ulong staged;		/* bytes of the current item held in @stage */
+	u8 hdr[sizeof(u64) + 1];	/* room to stage small items */
+	u8 *stage;
+	ulong stage_size;
+};
+
+struct zstd_stream {
+	zstd_dstream *zds;
+	void *workspace;
+	bool in_frame;		/* the dstream is within a frame */
+	u8 hdr[2 * sizeof(u32)];	/* magic and skippable frame size */
+	uint hdr_len;
+	ulong skip;		/* bytes of a skippable frame left to skip */
+};
+
+static int gzip_stream_write(struct image_decomp_stream *st, const u8 *in,
+			     ulong len)
+{
+	z_stream *s = st->priv;
+	int r;
+
+	if (!s) {
+		int offset = gzip_parse_header(in, len);
+
+		/* the first chunk must hold the whole gzip header */
+		if (offset < 0)
+			return -EINVAL;
+		s = calloc(1, sizeof(*s));
+		if (!s)
+			return -ENOMEM;
+		s->zalloc = gzalloc;
+		s->zfree = gzfree;
+		if (inflateInit2(s, -MAX_WBITS) != Z_OK) {
+			free(s);
+			return -EINVAL;
+		}
+		st->priv = s;
+		in += offset;
+		len -= offset;
+	}
+
+	s->next_in = (u8 *)in;
+	s->avail_in = len;
+	s->next_out = st->out + st->out_len;
+	s->avail_out = st->out_size - st->out_len;
+	while (s->avail_in) {
+		r = inflate(s, Z_NO_FLUSH);
+		st->out_len = s->next_out - (u8 *)st->out;
+		if (r == Z_STREAM_END) {
+			/* only a single gzip member is supported */
+			st->done = true;
+			st->ended = true;
+			break;
+		}
+		if (r == Z_BUF_ERROR && !s->avail_out)
+			return -ENOSPC;
+		if (r != Z_OK) {
+			log_debug("inflate() returned %d\n", r);
+			return -EINVAL;
+		}
+	}
+
+	return 0;
+}
+
+static void gzip_stream_free(struct image_decomp_stream *st)
+{
+	z_stream *s = st->priv;
+
+	if (s)
+		inflateEnd(s);
+	free(s);
+}
+
+static int lz4_stream_item(struct image_decomp_stream *st,
+			   struct lz4_stream *s, const u8 *in)
+{
+	u32 magic, size;
+	int ret;
+
+	switch (s->state) {
+	case LZ4_MAGIC:
+		magic = get_unaligned_le32(in);
+		if ((magic & LZ4F_SKIPPABLE_MASK) == LZ4F_SKIPPABLE_MAGIC) {
+			s->state = LZ4_SKIP_SIZE;
+			s->need = sizeof(u32);
+			break;
+		}
+		if (magic != LZ4F_MAGIC) {
+			/* anything after a complete frame is ignored */
+			if (!st->done)
+				return -EPROTONOSUPPORT;
+			st->ended = true;
+			break;
+		}
+		st->done = false;
+		s->state = LZ4_FRAME;
+		s->need = 2;
+		break;
+	case LZ4_FRAME: {
+		u8 flags = in[0], block_desc = in[1];
+		ulong stage_size;
+
+		if ((flags >> 6) != 1)
+			return -EPROTONOSUPPORT;
+		if ((flags & 0x03) || (block_desc & 0x8f) ||
+		    ((block_desc >> 4) & 7) < 4)
+			return -EINVAL;
+		/* as with ulz4fn(), only independent blocks are supported */
+		if (!(flags & BIT(5)))
+			return -EPROTONOSUPPORT;
+		s->has_block_checksum = flags & BIT(4);
+		s->has_content_size = flags & BIT(3);
+		s->has_content_checksum = flags & BIT(2);
+		stage_size = (1UL << (8 + 2 * ((block_desc >> 4) & 7))) +
+			     sizeof(u32);
+		/* each frame may have a different maximum block size */
+		if (stage_size > s->stage_size) {
+			free(s->stage);
+			s->stage_size = 0;
+			s->stage = malloc(stage_size);
+			if (!s->stage)
+				return -ENOMEM;
+			s->stage_size = stage_size;
+		}
+		s->state = LZ4_FRAME_REST;
+		s->need = (s->has_content_size ? sizeof(u64) : 0) + 1;
+		break;
+	}
+	case LZ4_FRAME_REST:
+		s->state = LZ4_BLOCK_HEADER;
+		s->need = sizeof(u32);
+		break;
+	case LZ4_BLOCK_HEADER:
+		s->block_header = get_unaligned_le32(in);
+		size = s->block_header & ~LZ4F_BLOCKUNCOMPRESSED_FLAG;
+		if (!size) {
+			/* end mark; any content checksum is not checked */
+			if (s->has_content_checksum) {
+				s->state = LZ4_CHECKSUM;
+				s->need = sizeof(u32);
+				break;
+			}
+			st->done = true;
+			s->state = LZ4_MAGIC;
+			s->need = sizeof(u32);
+			break;
+		}
+		s->need = size + (s->has_block_checksum ? sizeof(u32) : 0);
+		if (s->need > s->stage_size)
+			return -EINVAL;
+		s->state = LZ4_BLOCK;
+		break;
+	case LZ4_BLOCK:
+		size = s->block_header & ~LZ4F_BLOCKUNCOMPRESSED_FLAG;
+		if (s->block_header & LZ4F_BLOCKUNCOMPRESSED_FLAG) {
+			if (size > st->out_size - st->out_len)
+				return -ENOSPC;
+			memcpy(st->out + st->out_len, in, size);
+			ret = size;
+		} else {
+			ret = LZ4_decompress_safe((const char *)in,
+						  st->out + st->out_len, size,
+						  st->out_size - st->out_len);
+			if (ret < 0)
+				return st->out_len == st->out_size ? -ENOSPC :
+					-EPROTO;
+		}
+		st->out_len += ret;
+		s->state = LZ4_BLOCK_HEADER;
+		s->need = sizeof(u32);
+		break;
+	case LZ4_CHECKSUM:
+		st->done = true;
+		s->state = LZ4_MAGIC;
+		s->need = sizeof(u32);
+		break;
+	case LZ4_SKIP_SIZE:
+		s->need = get_unaligned_le32(in);
+		s->state = s->need ? LZ4_SKIP : LZ4_MAGIC;
+		if (!s->need)
+			s->need = sizeof(u32);
+		break;
+	case LZ4_SKIP:
+		break;
+	}
+
+	return 0;
+}
+
+static int lz4_stream_write(struct image_decomp_stream *st, const u8 *in,
+			    ulong len)
+{
+	struct lz4_stream *s = st->priv;
+	ulong copy;
+	int ret;
+
+	if (!s) {
+		s = calloc(1, sizeof(*s));
+		if (!s)
+			return -ENOMEM;
+		s->state = LZ4_MAGIC;
+		s->need = sizeof(u32);
+		st->priv = s;
+	}
+
+	while (len && !st->ended) {
+		if (s->state == LZ4_SKIP) {
+			/* skippable frames are dropped as they go by */
+			copy = min(len, s->need);
+			s->need -= copy;
+			if (!s->need) {
+				s->state = LZ4_MAGIC;
+				s->need = sizeof(u32);
+			}
+			ret = 0;
+		} else if (!s->staged && len >= s->need) {
+			/* items which are complete in the input are used in place */
+			copy = s->need;
+			ret = lz4_stream_item(st, s, in);
+		} else {
+			u8 *stage = s->need <= sizeof(s->hdr) ? s->hdr :
+				    s->stage;
+
+			copy = min(len, s->need - s->staged);
+			memcpy(stage + s->staged, in, copy);
+			s->staged += copy;
+			if (s->staged < s->need)
+				break;
+			s->staged = 0;
+			ret = lz4_stream_item(st, s, stage);
+		}
+		if (ret)
+			return ret;
+		in += copy;
+		len -= copy;
+	}
+
+	return 0;
+}
+
+static void lz4_stream_free(struct image_decomp_stream *st)
+{
+	struct lz4_stream *s = st->priv;
+
+	if (s)
+		free(s->stage);
+	free(s);
+}
+
+/* Feed part of a frame to the dstream, returning the bytes it took */
+static long zstd_stream_frame(struct image_decomp_stream *st,
+			      struct zstd_stream *s, const u8 *in, ulong len)
+{
+	zstd_out_buffer out;
+	zstd_in_buffer inb;
+	size_t ret;
+
+	inb.src = in;
+	inb.size = len;
+	inb.pos = 0;
+	out.dst = st->out;
+	out.size = st->out_size;
+	out.pos = st->out_len;
+	while (inb.pos < inb.size) {
+		size_t in_pos = inb.pos, out_pos = out.pos;
+
+		ret = zstd_decompress_stream(s->zds, &out, &inb);
+		st->out_len = out.pos;
+		if (zstd_is_error(ret)) {
+			log_debug("zstd error %d\n", zstd_get_error_code(ret));
+			return zstd_get_error_code(ret) ==
+				ZSTD_error_dstSize_tooSmall ? -ENOSPC : -EINVAL;
+		}
+		if (!ret) {
+			/* the next frame starts afresh */
+			zstd_reset_dstream(s->zds);
+			s->in_frame = false;
+			st->done = true;
+			break;
+		}
+		/* no progress, so the output buffer is full */
+		if (inb.pos == in_pos && out.pos == out_pos)
+			return -ENOSPC;
+	}
+
+	return inb.pos;
+}
+
+static int zstd_stream_write(struct image_decomp_stream *st, const u8 *in,
+			     ulong len)
+{
+	struct zstd_stream *s = st->priv;
+	ulong copy, need;
+	size_t wsize;
+	long ret;
+	u32 magic;
+
+	if (!s) {
+		/*
+		 * The output goes straight to the final buffer, which stays put
+		 * between calls, so no window buffer is needed, only room for
+		 * one compressed block.
+		 */
+		wsize = zstd_dctx_workspace_bound() + ZSTD_BLOCKSIZE_MAX + 64;
+		s = calloc(1, sizeof(*s));
+		if (!s)
+			return -ENOMEM;
+		st->priv = s;
+		s->workspace = malloc(wsize);
+		if (!s->workspace)
+			return -ENOMEM;
+		s->zds = zstd_init_dstream(0, s->workspace, wsize);
+		if (!s->zds)
+			return -EINVAL;
+		ret = ZSTD_DCtx_setParameter(s->zds, ZSTD_d_stableOutBuffer, 1);
+		if (zstd_is_error(ret))
+			return -EINVAL;
+	}
+
+	while (len && !st->ended) {
+		if (s->in_frame) {
+			ret = zstd_stream_frame(st, s, in, len);
+			if (ret < 0)
+				return ret;
+			copy = ret;
+		} else if (s->skip) {
+			/* skippable frames are dropped as they go by */
+			copy = min(len, s->skip);
+			s->skip -= copy;
+		} else {
+			/* between frames, collect the next magic */
+			need = sizeof(u32);
+			if (s->hdr_len >= sizeof(u32) &&
+			    (get_unaligned_le32(s->hdr) &
+			     ZSTD_MAGIC_SKIPPABLE_MASK) ==
+			    ZSTD_MAGIC_SKIPPABLE_START)
+				need += sizeof(u32);
+			copy = min(len, need - s->hdr_len);
+			memcpy(s->hdr + s->hdr_len, in, copy);
+			s->hdr_len += copy;
+			in += copy;
+			len -= copy;
+			if (s->hdr_len < need)
+				break;
+			magic = get_unaligned_le32(s->hdr);
+			if (need > sizeof(u32)) {
+				s->skip = get_unaligned_le32(s->hdr + 4);
+				s->hdr_len = 0;
+			} else if (magic == ZSTD_MAGICNUMBER) {
+				s->in_frame = true;
+				st->done = false;
+				s->hdr_len = 0;
+				ret = zstd_stream_frame(st, s, s->hdr,
+							sizeof(u32));
+				if (ret < 0)
+					return ret;
+			} else if ((magic & ZSTD_MAGIC_SKIPPABLE_MASK) !=
+				   ZSTD_MAGIC_SKIPPABLE_START) {
+				/* anything after a complete frame is ignored */
+				if (!st->done)
+					return -EINVAL;
+				st->ended = true;
+			}
+			continue;
+		}
+		in += copy;
+		len -= copy;
+	}
+
+	return 0;
+}
+
+static void zstd_stream_free(struct image_decomp_stream *st)
+{
+	struct zstd_stream *s = st->priv;
+
+	if (s)
+		free(s->workspace);
+	free(s);
+}
+
+bool image_decomp_stream_supported(int comp)
+{
+	switch (comp) {
+	case IH_COMP_GZIP:
+		return CONFIG_IS_ENABLED(GZIP);
+	case IH_COMP_LZ4:
+		return CONFIG_IS_ENABLED(LZ4);
+	case IH_COMP_ZSTD:
+		return CONFIG_IS_ENABLED(ZSTD);
+	default:
+		return false;
+	}
+}
+
+int image_decomp_stream_start(struct image_decomp_stream *st, int comp,
+			      void *out, ulong out_size)
+{
+	if (!image_decomp_stream_supported(comp))
+		return -EPROTONOSUPPORT;
+
+	memset(st, '\0', sizeof(*st));
+	st->comp = comp;
+	st->out = out;
+	st->out_size = out_size;
+
+	return 0;
+}
+
+int image_decomp_stream_write(struct image_decomp_stream *st, const void *in,
+			      ulong len)
+{
+	/* anything after the end of the compressed data is ignored */
+	if (st->ended || !len)
+		return 0;
+
+	switch (st->comp) {
+	case IH_COMP_GZIP:
+		if (CONFIG_IS_ENABLED(GZIP))
+			return gzip_stream_write(st, in, len);
+		break;
+	case IH_COMP_LZ4:
+		if (CONFIG_IS_ENABLED(LZ4))
+			return lz4_stream_write(st, in, len);
+		break;
+	case IH_COMP_ZSTD:
+		if (CONFIG_IS_ENABLED(ZSTD))
+			return zstd_stream_write(st, in, len);
+		break;
+	}
+
+	return -EPROTONOSUPPORT;
+}
+
+int image_decomp_stream_finish(struct image_decomp_stream *st, ulong *out_len)
+{
+	switch (st->comp) {
+	case IH_COMP_GZIP:
+		if (CONFIG_IS_ENABLED(GZIP))
+			gzip_stream_free(st);
+		break;
+	case IH_COMP_LZ4:
+		if (CONFIG_IS_ENABLED(LZ4))
+			lz4_stream_free(st);
+		break;
+	case IH_COMP_ZSTD:
+		if (CONFIG_IS_ENABLED(ZSTD))
+			zstd_stream_free(st);
+		break;
+	}
+	st->priv = NULL;
+	if (out_len)
+		*out_len = st->out_len;
+
+	return st->done ? 0 : -EINVAL;
+}
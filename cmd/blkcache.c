@@ -4,6 +4,7 @@
  * Author: Eric Nelson<eric@nelint.com>
  *
  */
+#include <blk.h>
 #include <command.h>
 #include <config.h>
 #include <malloc.h>
@@ -13,31 +14,42 @@
 static int blkc_show(struct cmd_tbl *cmdtp, int flag,
 		     int argc, char *const argv[])
 {
+	struct block_cache_dev_stats dstats;
 	struct block_cache_stats stats;
+	int i;
+
 	blkcache_stats(&stats);
 
 	printf("hits: %u\n"
 	       "misses: %u\n"
 	       "entries: %u\n"
-	       "max blocks/entry: %u\n"
-	       "max cache entries: %u\n",
-	       stats.hits, stats.misses, stats.entries,
-	       stats.max_blocks_per_entry, stats.max_entries);
+	       "bytes: %lu\n"
+	       "max bytes: %lu\n"
+	       "max readahead: %lu\n",
+	       stats.hits, stats.misses, stats.entries, stats.bytes,
+	       stats.max_bytes, stats.max_readahead);
+
+	for (i = 0; !blkcache_dev_stats(i, &dstats); i++)
+		printf("%s %d: hits %u, misses %u, readahead blocks %lu\n",
+		       blk_get_uclass_name(dstats.iftype), dstats.devnum,
+		       dstats.hits, dstats.misses, dstats.readahead);
+
 	return 0;
 }
 
 static int blkc_configure(struct cmd_tbl *cmdtp, int flag,
 			  int argc, char *const argv[])
 {
-	unsigned blocks_per_entry, max_entries;
+	unsigned long max_bytes, max_readahead;
+
 	if (argc != 3)
 		return CMD_RET_USAGE;
 
-	blocks_per_entry = simple_strtoul(argv[1], 0, 0);
-	max_entries = simple_strtoul(argv[2], 0, 0);
-	blkcache_configure(blocks_per_entry, max_entries);
-	printf("changed to max of %u entries of %u blocks each\n",
-	       max_entries, blocks_per_entry);
+	max_bytes = simple_strtoul(argv[1], 0, 0);
+	max_readahead = simple_strtoul(argv[2], 0, 0);
+	blkcache_configure(max_bytes, max_readahead);
+	printf("changed to max of %lu bytes, %lu bytes readahead\n",
+	       max_bytes, max_readahead);
 	return 0;
 }
 
@@ -70,6 +82,6 @@ U_BOOT_CMD(
 	blkcache, 4, 0, do_blkcache,
 	"block cache diagnostics and control",
 	"show - show and reset statistics\n"
-	"blkcache configure <blocks> <entries> "
-	"- set max blocks per entry and max cache entries\n"
+	"blkcache configure <bytes> <readahead> "
+	"- set max cache size and max readahead, in bytes\n"
 );
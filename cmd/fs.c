@@ -29,7 +29,7 @@ static int do_load_wrapper(struct cmd_tbl *cmdtp, int flag, int argc,
 }
 
 U_BOOT_CMD(
-	load,	7,	0,	do_load_wrapper,
+	load,	8,	0,	do_load_wrapper,
 	"load binary file from a filesystem",
 	"<interface> [<dev[:part]> [<addr> [<filename> [bytes [pos]]]]]\n"
 	"    - Load binary file 'filename' from partition 'part' on device\n"
@@ -38,6 +38,11 @@ U_BOOT_CMD(
 	"      If 'bytes' is 0 or omitted, the file is read until the end.\n"
 	"      'pos' gives the file byte position to start reading from.\n"
 	"      If 'pos' is 0 or omitted, the file is read from the start."
+#if CONFIG_IS_ENABLED(IMAGE_DECOMP_STREAM)
+	"\nload -z <interface> [<dev[:part]> [<addr> [<filename> [bytes]]]]\n"
+	"    - Load and decompress a gzip, lz4 or zstd compressed file while\n"
+	"      it is read. 'bytes' limits the decompressed size."
+#endif
 );
 
 static int do_save_wrapper(struct cmd_tbl *cmdtp, int flag, int argc,
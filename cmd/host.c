@@ -256,7 +256,7 @@ static int do_host(struct cmd_tbl *cmdtp, int flag, int argc,
 U_BOOT_CMD(
 	host, 8, 1, do_host,
 	"Miscellaneous host commands",
-	"load hostfs - <addr> <filename> [<bytes> <offset>]  - "
+	"load [-z] hostfs - <addr> <filename> [<bytes> <offset>]  - "
 		"load a file from host\n"
 	"host ls hostfs - <filename>                    - list files on host\n"
 	"host save hostfs - <addr> <filename> <bytes> [<offset>] - "
@@ -159,6 +159,10 @@ static int initr_reloc_global_data(void)
 	 */
 	if (IS_ENABLED(CONFIG_OF_EMBED))
 		fdtdec_setup_embed();
+#if CONFIG_IS_ENABLED(OF_PHANDLE_CACHE)
+	/* this was allocated before relocation */
+	gd->fdt_phandle_cache = NULL;
+#endif
 
 #ifdef CONFIG_EFI_LOADER
 	/*
@@ -263,6 +267,9 @@ static int initr_dm(void)
 	gd->dm_root = NULL;
 #ifdef CONFIG_TIMER
 	gd->timer = NULL;
+#endif
+#if CONFIG_IS_ENABLED(DM_COMPAT_INDEX)
+	gd->dm_compat_index = NULL;
 #endif
 	bootstage_start(BOOTSTAGE_ID_ACCUM_DM_R, "dm_r");
 	ret = dm_init_and_scan(false);
@@ -165,10 +165,14 @@ static int __maybe_unused hash_finish_crc16_ccitt(struct hash_algo *algo,
 						  void *ctx, void *dest_buf,
 						  int size)
 {
+	uint16_t crc;
+
 	if (size < algo->digest_size)
 		return -1;
 
-	*((uint16_t *)dest_buf) = *((uint16_t *)ctx);
+	/* big-endian, as crc16_ccitt_wd_buf() gives it */
+	crc = cpu_to_be16(*((uint16_t *)ctx));
+	memcpy(dest_buf, &crc, sizeof(crc));
 	free(ctx);
 	return 0;
 }
@@ -192,10 +196,14 @@ static int __maybe_unused hash_update_crc32(struct hash_algo *algo, void *ctx,
 static int __maybe_unused hash_finish_crc32(struct hash_algo *algo, void *ctx,
 					    void *dest_buf, int size)
 {
+	uint32_t crc;
+
 	if (size < algo->digest_size)
 		return -1;
 
-	*((uint32_t *)dest_buf) = *((uint32_t *)ctx);
+	/* big-endian, as crc32_wd_buf() gives it */
+	crc = cpu_to_be32(*((uint32_t *)ctx));
+	memcpy(dest_buf, &crc, sizeof(crc));
 	free(ctx);
 	return 0;
 }
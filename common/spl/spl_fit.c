@@ -21,6 +21,12 @@
 
 DECLARE_GLOBAL_DATA_PTR;
 
+#ifdef CONFIG_SPL_FIT_HASH_CHUNK_SIZE
+#define SPL_FIT_HASH_CHUNK	CONFIG_SPL_FIT_HASH_CHUNK_SIZE
+#else
+#define SPL_FIT_HASH_CHUNK	0
+#endif
+
 struct spl_fit_info {
 	const void *fit;	/* Pointer to a valid FIT blob */
 	size_t ext_data_offset;	/* Offset to FIT external data (end of FIT) */
@@ -193,6 +199,46 @@ static int get_aligned_image_size(struct spl_load_info *info, int data_size,
 	return ALIGN(data_size, spl_get_bl_len(info));
 }
 
+/**
+ * spl_fit_read_hashed() - read an image, hashing it chunk by chunk
+ *
+ * Each chunk is hashed right after it is read, while it is still in the
+ * cache, instead of taking a separate pass over the image afterwards.
+ *
+ * @info:	points to information about the device to load data from
+ * @offset:	offset to read from, aligned to the block length
+ * @size:	number of bytes to read, aligned to the block length
+ * @buf:	buffer to read into
+ * @overhead:	offset of the image data in @buf
+ * @length:	length of the image data
+ * @hashes:	hash state from fit_image_hash_start()
+ * Return: number of bytes read
+ */
+static ulong spl_fit_read_hashed(struct spl_load_info *info, ulong offset,
+				 ulong size, void *buf, ulong overhead,
+				 ulong length, struct fit_image_hashes *hashes)
+{
+	ulong chunk = roundup(SPL_FIT_HASH_CHUNK, spl_get_bl_len(info));
+	ulong pos = 0, len, count, start, end;
+
+	while (pos < size) {
+		len = min(chunk, size - pos);
+		count = info->read(info, offset + pos, len, buf + pos);
+
+		/* the part of the chunk which holds image data */
+		start = max(pos, overhead);
+		end = min(pos + count, overhead + length);
+		if (start < end)
+			fit_image_hash_update(hashes, buf + start, end - start,
+					      end == overhead + length);
+		pos += count;
+		if (count < len)
+			break;
+	}
+
+	return pos;
+}
+
 /**
  * load_simple_fit(): load the image described in a certain FIT node
  * @info:	points to information about the device to load data from
@@ -225,6 +271,8 @@ static int load_simple_fit(struct spl_load_info *info, ulong fit_offset,
 	const void *data;
 	const void *fit = ctx->fit;
 	bool external_data = false;
+	struct fit_image_hashes hashes;
+	bool hashed = false;
 
 	log_debug("starting\n");
 	if (CONFIG_IS_ENABLED(BOOTMETH_VBE) &&
@@ -305,8 +353,18 @@ static int load_simple_fit(struct spl_load_info *info, ulong fit_offset,
 		log_debug("reading from offset %x / %lx size %lx to %p: ",
 			  offset, read_offset, size, src_ptr);
 
-		if (info->read(info, read_offset, size, src_ptr) < length)
+		if (CONFIG_IS_ENABLED(FIT_SIGNATURE) && SPL_FIT_HASH_CHUNK) {
+			fit_image_hash_start(fit, node, &hashes);
+			if (spl_fit_read_hashed(info, read_offset, size,
+						src_ptr, overhead, length,
+						&hashes) < length)
+				return -EIO;
+			fit_image_hash_finish(&hashes);
+			hashed = true;
+		} else if (info->read(info, read_offset, size, src_ptr) <
+			   length) {
 			return -EIO;
+		}
 
 		debug("External data: dst=%p, offset=%x, size=%lx\n",
 		      src_ptr, offset, (unsigned long)length);
@@ -325,7 +383,10 @@ static int load_simple_fit(struct spl_load_info *info, ulong fit_offset,
 	if (CONFIG_IS_ENABLED(FIT_SIGNATURE)) {
 		printf("## Checking hash(es) for Image %s ... ",
 		       fit_get_name(fit, node, NULL));
-		if (!fit_image_verify_with_data(fit, node, gd_fdt_blob(), src,
+		if (hashed ?
+		    !fit_image_verify_hashed(fit, node, gd_fdt_blob(), src,
+					     length, &hashes) :
+		    !fit_image_verify_with_data(fit, node, gd_fdt_blob(), src,
 						length))
 			return -EPERM;
 		puts("OK\n");
@@ -11,10 +11,12 @@
 #include <log.h>
 #include <malloc.h>
 #include <part.h>
+#include <asm/cache.h>
 #include <dm/device-internal.h>
 #include <dm/lists.h>
 #include <dm/uclass-internal.h>
 #include <linux/err.h>
+#include <u-boot/schedule.h>
 
 #define blk_get_ops(dev)	((struct blk_ops *)(dev)->driver->ops)
 
@@ -429,19 +431,13 @@ static int blk_buffer_aligned(struct bounce_buffer *state)
 	return 1;	/* Default, any buffer is OK */
 }
 
-long blk_read(struct udevice *dev, lbaint_t start, lbaint_t blkcnt, void *buf)
+static long blk_read_uncached(struct udevice *dev, lbaint_t start,
+			      lbaint_t blkcnt, void *buf)
 {
 	struct blk_desc *desc = dev_get_uclass_plat(dev);
 	const struct blk_ops *ops = blk_get_ops(dev);
 	ulong blks_read;
 
-	if (!ops->read)
-		return -ENOSYS;
-
-	if (blkcache_read(desc->uclass_id, desc->devnum,
-			  start, blkcnt, desc->blksz, buf))
-		return blkcnt;
-
 	if (IS_ENABLED(CONFIG_BOUNCE_BUFFER) && desc->bb) {
 		struct blk_bounce_buffer bbstate = { .dev = dev };
 		int ret;
@@ -460,6 +456,64 @@ long blk_read(struct udevice *dev, lbaint_t start, lbaint_t blkcnt, void *buf)
 		blks_read = ops->read(dev, start, blkcnt, buf);
 	}
 
+	return blks_read;
+}
+
+/*
+ * Read a cache-line aligned range around the request, possibly including
+ * readahead, so that neighbouring and following requests hit the cache.
+ * Returns blkcnt on success or 0 if the caller should read the request as-is.
+ */
+static long blk_read_ahead(struct udevice *dev, lbaint_t start,
+			   lbaint_t blkcnt, void *buf)
+{
+	struct blk_desc *desc = dev_get_uclass_plat(dev);
+	lbaint_t rstart, rcnt;
+	void *rbuf;
+	long ret;
+
+	rcnt = blkcache_readahead(desc->uclass_id, desc->devnum, start, blkcnt,
+				  desc->blksz, desc->lba, &rstart);
+	if (!rcnt || (rstart == start && rcnt == blkcnt))
+		return 0;
+
+	rbuf = memalign(ARCH_DMA_MINALIGN, rcnt * desc->blksz);
+	if (!rbuf)
+		return 0;
+
+	ret = blk_read_uncached(dev, rstart, rcnt, rbuf);
+	if (ret == rcnt) {
+		blkcache_fill(desc->uclass_id, desc->devnum, rstart, rcnt,
+			      desc->blksz, rbuf);
+		memcpy(buf, rbuf + (start - rstart) * desc->blksz,
+		       blkcnt * desc->blksz);
+		ret = blkcnt;
+	} else {
+		ret = 0;
+	}
+	free(rbuf);
+
+	return ret;
+}
+
+long blk_read(struct udevice *dev, lbaint_t start, lbaint_t blkcnt, void *buf)
+{
+	struct blk_desc *desc = dev_get_uclass_plat(dev);
+	const struct blk_ops *ops = blk_get_ops(dev);
+	ulong blks_read;
+
+	if (!ops->read)
+		return -ENOSYS;
+
+	if (blkcache_read(desc->uclass_id, desc->devnum,
+			  start, blkcnt, desc->blksz, buf))
+		return blkcnt;
+
+	if (CONFIG_IS_ENABLED(BLOCK_CACHE) &&
+	    blk_read_ahead(dev, start, blkcnt, buf) == blkcnt)
+		return blkcnt;
+
+	blks_read = blk_read_uncached(dev, start, blkcnt, buf);
 	if (blks_read == blkcnt)
 		blkcache_fill(desc->uclass_id, desc->devnum, start, blkcnt,
 			      desc->blksz, buf);
@@ -478,6 +532,7 @@ long blk_write(struct udevice *dev, lbaint_t start, lbaint_t blkcnt,
 		return -ENOSYS;
 
 	blkcache_invalidate(desc->uclass_id, desc->devnum);
+	desc->write_gen++;
 
 	if (IS_ENABLED(CONFIG_BOUNCE_BUFFER) && desc->bb) {
 		struct blk_bounce_buffer bbstate = { .dev = dev };
@@ -510,10 +565,103 @@ long blk_erase(struct udevice *dev, lbaint_t start, lbaint_t blkcnt)
 		return -ENOSYS;
 
 	blkcache_invalidate(desc->uclass_id, desc->devnum);
+	desc->write_gen++;
 
 	return ops->erase(dev, start, blkcnt);
 }
 
+static int blk_submit(struct udevice *dev, struct blk_request *req)
+{
+	struct blk_desc *desc = dev_get_uclass_plat(dev);
+	const struct blk_ops *ops = blk_get_ops(dev);
+	int ret;
+
+	req->done = false;
+	req->priv = NULL;
+
+	/* bounce buffers are only handled for synchronous transfers */
+	if (ops->submit && !(IS_ENABLED(CONFIG_BOUNCE_BUFFER) && desc->bb)) {
+		if (req->write) {
+			blkcache_invalidate(desc->uclass_id, desc->devnum);
+			desc->write_gen++;
+		} else if (blkcache_read(desc->uclass_id, desc->devnum,
+					 req->start, req->blkcnt, desc->blksz,
+					 req->buffer)) {
+			req->result = req->blkcnt;
+			req->done = true;
+			return 0;
+		}
+
+		ret = ops->submit(dev, req);
+		if (ret != -EBUSY)
+			return ret;
+	}
+
+	if (req->write)
+		req->result = blk_write(dev, req->start, req->blkcnt,
+					req->buffer);
+	else
+		req->result = blk_read(dev, req->start, req->blkcnt,
+				       req->buffer);
+	req->done = true;
+
+	return 0;
+}
+
+int blk_submit_read(struct udevice *dev, lbaint_t start, lbaint_t blkcnt,
+		    void *buffer, struct blk_request *req)
+{
+	req->start = start;
+	req->blkcnt = blkcnt;
+	req->buffer = buffer;
+	req->write = false;
+
+	return blk_submit(dev, req);
+}
+
+int blk_submit_write(struct udevice *dev, lbaint_t start, lbaint_t blkcnt,
+		     const void *buffer, struct blk_request *req)
+{
+	req->start = start;
+	req->blkcnt = blkcnt;
+	req->buffer = (void *)buffer;
+	req->write = true;
+
+	return blk_submit(dev, req);
+}
+
+long blk_poll(struct udevice *dev, struct blk_request *req)
+{
+	struct blk_desc *desc = dev_get_uclass_plat(dev);
+	const struct blk_ops *ops = blk_get_ops(dev);
+	int ret;
+
+	if (req->done)
+		return req->result;
+
+	ret = ops->poll(dev, req);
+	if (ret)
+		return ret;
+	if (!req->done)
+		return -EAGAIN;
+
+	if (!req->write && req->result == req->blkcnt)
+		blkcache_fill(desc->uclass_id, desc->devnum, req->start,
+			      req->blkcnt, desc->blksz, req->buffer);
+
+	return req->result;
+}
+
+long blk_wait(struct udevice *dev, struct blk_request *req)
+{
+	long ret;
+
+	while ((ret = blk_poll(dev, req)) == -EAGAIN)
+		schedule();
+
+	return ret;
+}
+
 ulong blk_dread(struct blk_desc *desc, lbaint_t start, lbaint_t blkcnt,
 		void *buffer)
 {
@@ -5,153 +5,310 @@
  *
  */
 #include <blk.h>
+#include <errno.h>
 #include <log.h>
 #include <malloc.h>
 #include <part.h>
 #include <asm/global_data.h>
 #include <linux/ctype.h>
+#include <linux/kernel.h>
 #include <linux/list.h>
+#include <linux/log2.h>
+
+/*
+ * The cache is made up of fixed-size lines of BLKCACHE_LINE_SIZE bytes, each
+ * holding the aligned run of blocks that starts at (line * blocks-per-line).
+ * Lines are found through a hash table keyed on (iftype, devnum, line) and
+ * evicted in LRU order once the configured byte budget is reached.
+ */
+#define BLKCACHE_LINE_SIZE	4096
+#define BLKCACHE_HASH_BITS	8
+#define BLKCACHE_HASH_SIZE	(1 << BLKCACHE_HASH_BITS)
+
+/* initial readahead window, in lines, once sequential access is seen */
+#define BLKCACHE_RA_INIT_LINES	4
 
 struct block_cache_node {
-	struct list_head lh;
+	struct hlist_node hn;
+	struct list_head lru;
 	int iftype;
 	int devnum;
-	lbaint_t start;
-	lbaint_t blkcnt;
+	lbaint_t line;
 	unsigned long blksz;
-	char *cache;
+	char cache[];
+};
+
+/* per-device statistics and sequential-access tracking */
+struct block_cache_dev {
+	struct list_head list;
+	int iftype;
+	int devnum;
+	lbaint_t next;		/* block following the previous request */
+	lbaint_t ra_blocks;	/* current readahead window */
+	bool sequential;	/* last request followed the one before */
+	unsigned hits;
+	unsigned misses;
+	unsigned long readahead;
 };
 
-static LIST_HEAD(block_cache);
+static struct hlist_head block_cache_hash[BLKCACHE_HASH_SIZE];
+static LIST_HEAD(block_cache_lru);
+static LIST_HEAD(block_cache_devs);
 
 static struct block_cache_stats _stats = {
-	.max_blocks_per_entry = 8,
-	.max_entries = 32
+	.max_bytes = CONFIG_BLOCK_CACHE_SIZE,
+	.max_readahead = CONFIG_BLOCK_CACHE_READAHEAD,
 };
 
+/* block sizes are powers of two, so lines can be addressed with shifts */
+static int line_shift(unsigned long blksz)
+{
+	return max(ilog2(BLKCACHE_LINE_SIZE) - ilog2(blksz), 0);
+}
+
+static lbaint_t line_blocks(unsigned long blksz)
+{
+	return (lbaint_t)1 << line_shift(blksz);
+}
+
+static unsigned long line_bytes(unsigned long blksz)
+{
+	return line_blocks(blksz) * blksz;
+}
+
+static struct hlist_head *cache_bucket(int iftype, int devnum, lbaint_t line)
+{
+	u64 key = ((u64)line << 12) ^ ((u64)iftype << 6) ^ devnum;
+
+	/* multiplicative hash, as used by hash_64() in Linux */
+	key *= 0x61c8864680b583ebull;
+
+	return &block_cache_hash[key >> (64 - BLKCACHE_HASH_BITS)];
+}
+
 static struct block_cache_node *cache_find(int iftype, int devnum,
-					   lbaint_t start, lbaint_t blkcnt,
-					   unsigned long blksz)
+					   lbaint_t line, unsigned long blksz)
 {
 	struct block_cache_node *node;
 
-	list_for_each_entry(node, &block_cache, lh)
-		if ((node->iftype == iftype) &&
-		    (node->devnum == devnum) &&
-		    (node->blksz == blksz) &&
-		    (node->start <= start) &&
-		    (node->start + node->blkcnt >= start + blkcnt)) {
-			if (block_cache.next != &node->lh) {
-				/* maintain MRU ordering */
-				list_del(&node->lh);
-				list_add(&node->lh, &block_cache);
-			}
+	hlist_for_each_entry(node, cache_bucket(iftype, devnum, line), hn)
+		if (node->line == line && node->devnum == devnum &&
+		    node->iftype == iftype && node->blksz == blksz)
 			return node;
-		}
-	return 0;
+
+	return NULL;
+}
+
+static void cache_drop(struct block_cache_node *node)
+{
+	debug("drop: line " LBAF "\n", node->line);
+	hlist_del(&node->hn);
+	list_del(&node->lru);
+	_stats.bytes -= line_bytes(node->blksz);
+	_stats.entries--;
+	free(node);
+}
+
+static struct block_cache_dev *cache_dev(int iftype, int devnum, bool create)
+{
+	struct block_cache_dev *bdev;
+
+	list_for_each_entry(bdev, &block_cache_devs, list)
+		if (bdev->iftype == iftype && bdev->devnum == devnum)
+			return bdev;
+
+	if (!create)
+		return NULL;
+
+	bdev = calloc(1, sizeof(*bdev));
+	if (!bdev)
+		return NULL;
+	bdev->iftype = iftype;
+	bdev->devnum = devnum;
+	list_add_tail(&bdev->list, &block_cache_devs);
+
+	return bdev;
 }
 
 int blkcache_read(int iftype, int devnum,
 		  lbaint_t start, lbaint_t blkcnt,
 		  unsigned long blksz, void *buffer)
 {
-	struct block_cache_node *node = cache_find(iftype, devnum, start,
-						   blkcnt, blksz);
-	if (node) {
-		const char *src = node->cache + (start - node->start) * blksz;
-		memcpy(buffer, src, blksz * blkcnt);
-		debug("hit: start " LBAF ", count " LBAFU "\n",
-		      start, blkcnt);
-		++_stats.hits;
-		return 1;
+	int shift = line_shift(blksz);
+	lbaint_t lblks = line_blocks(blksz);
+	struct block_cache_dev *bdev;
+	struct block_cache_node *node;
+	lbaint_t blk, end = start + blkcnt;
+
+	bdev = cache_dev(iftype, devnum, true);
+	if (bdev) {
+		bdev->sequential = start && bdev->next == start;
+		if (!bdev->sequential)
+			bdev->ra_blocks = 0;
+		bdev->next = end;
+	}
+
+	/* requests too big to be cached are never in the cache */
+	if (blkcnt * blksz > _stats.max_bytes / 4)
+		goto miss;
+
+	for (blk = start; blk < end; blk = round_down(blk, lblks) + lblks)
+		if (!cache_find(iftype, devnum, blk >> shift, blksz))
+			goto miss;
+
+	for (blk = start; blk < end; ) {
+		lbaint_t line = blk >> shift;
+		lbaint_t offset = blk & (lblks - 1);
+		lbaint_t count = min(end - blk, lblks - offset);
+
+		node = cache_find(iftype, devnum, line, blksz);
+		memcpy(buffer, node->cache + offset * blksz, count * blksz);
+		/* maintain MRU ordering */
+		list_move(&node->lru, &block_cache_lru);
+		buffer += count * blksz;
+		blk += count;
 	}
 
+	debug("hit: start " LBAF ", count " LBAFU "\n",
+	      start, blkcnt);
+	++_stats.hits;
+	if (bdev)
+		++bdev->hits;
+	return 1;
+
+miss:
 	debug("miss: start " LBAF ", count " LBAFU "\n",
 	      start, blkcnt);
 	++_stats.misses;
+	if (bdev)
+		++bdev->misses;
 	return 0;
 }
 
+lbaint_t blkcache_readahead(int iftype, int devnum,
+			    lbaint_t start, lbaint_t blkcnt,
+			    unsigned long blksz, lbaint_t lba,
+			    lbaint_t *rstart)
+{
+	lbaint_t lblks = line_blocks(blksz);
+	struct block_cache_dev *bdev;
+	lbaint_t first, end, want, ra = 0;
+
+	if (blkcnt * blksz > _stats.max_bytes / 4)
+		return 0;
+
+	/*
+	 * A request that directly follows the previous one on the same device
+	 * starts a readahead window, which doubles on each further sequential
+	 * miss until it reaches the configured limit.
+	 */
+	bdev = cache_dev(iftype, devnum, false);
+	if (bdev && bdev->sequential) {
+		if (bdev->ra_blocks)
+			ra = bdev->ra_blocks * 2;
+		else
+			ra = BLKCACHE_RA_INIT_LINES * lblks;
+		ra = min(ra, (lbaint_t)(_stats.max_readahead / blksz));
+	}
+
+	first = round_down(start, lblks);
+	want = round_up(start + blkcnt, lblks);
+	if ((want + ra - first) * blksz > _stats.max_bytes / 4)
+		ra = 0;
+	end = want + ra;
+	if (lba && end > lba)
+		end = max(lba, start + blkcnt);
+
+	if (bdev && ra) {
+		bdev->ra_blocks = ra;
+		if (end > want)
+			bdev->readahead += end - want;
+	}
+
+	*rstart = first;
+
+	return end - first;
+}
+
 void blkcache_fill(int iftype, int devnum,
 		   lbaint_t start, lbaint_t blkcnt,
 		   unsigned long blksz, void const *buffer)
 {
-	lbaint_t bytes;
+	int shift = line_shift(blksz);
+	lbaint_t lblks = line_blocks(blksz);
+	unsigned long bytes = line_bytes(blksz);
 	struct block_cache_node *node;
+	lbaint_t line, end;
 
 	/* don't cache big stuff */
-	if (blkcnt > _stats.max_blocks_per_entry)
+	if (blkcnt * blksz > _stats.max_bytes / 4)
 		return;
 
-	if (_stats.max_entries == 0)
-		return;
+	/* only whole lines are cached */
+	line = round_up(start, lblks) >> shift;
+	end = (start + blkcnt) >> shift;
 
-	bytes = blksz * blkcnt;
-	if (_stats.max_entries <= _stats.entries) {
-		/* pop LRU */
-		node = (struct block_cache_node *)block_cache.prev;
-		list_del(&node->lh);
-		_stats.entries--;
-		debug("drop: start " LBAF ", count " LBAFU "\n",
-		      node->start, node->blkcnt);
-		if (node->blkcnt * node->blksz < bytes) {
-			free(node->cache);
-			node->cache = 0;
-		}
-	} else {
-		node = malloc(sizeof(*node));
-		if (!node)
-			return;
-		node->cache = 0;
-	}
+	for (; line < end; line++) {
+		const char *src = buffer + ((line << shift) - start) * blksz;
 
-	if (!node->cache) {
-		node->cache = malloc(bytes);
-		if (!node->cache) {
-			free(node);
-			return;
-		}
-	}
+		node = cache_find(iftype, devnum, line, blksz);
+		if (!node) {
+			while (_stats.bytes + bytes > _stats.max_bytes &&
+			       !list_empty(&block_cache_lru))
+				/* pop LRU */
+				cache_drop(list_last_entry(&block_cache_lru,
+							   struct block_cache_node,
+							   lru));
 
-	debug("fill: start " LBAF ", count " LBAFU "\n",
-	      start, blkcnt);
+			node = malloc(sizeof(*node) + bytes);
+			if (!node)
+				return;
 
-	node->iftype = iftype;
-	node->devnum = devnum;
-	node->start = start;
-	node->blkcnt = blkcnt;
-	node->blksz = blksz;
-	memcpy(node->cache, buffer, bytes);
-	list_add(&node->lh, &block_cache);
-	_stats.entries++;
+			node->iftype = iftype;
+			node->devnum = devnum;
+			node->line = line;
+			node->blksz = blksz;
+			hlist_add_head(&node->hn,
+				       cache_bucket(iftype, devnum, line));
+			list_add(&node->lru, &block_cache_lru);
+			_stats.bytes += bytes;
+			_stats.entries++;
+		} else {
+			list_move(&node->lru, &block_cache_lru);
+		}
+
+		debug("fill: line " LBAF "\n", line);
+		memcpy(node->cache, src, bytes);
+	}
 }
 
 void blkcache_invalidate(int iftype, int devnum)
 {
-	struct list_head *entry, *n;
-	struct block_cache_node *node;
+	struct block_cache_node *node, *n;
+	struct block_cache_dev *bdev;
+
+	list_for_each_entry_safe(node, n, &block_cache_lru, lru)
+		if (iftype == -1 ||
+		    (node->iftype == iftype && node->devnum == devnum))
+			cache_drop(node);
 
-	list_for_each_safe(entry, n, &block_cache) {
-		node = (struct block_cache_node *)entry;
+	list_for_each_entry(bdev, &block_cache_devs, list)
 		if (iftype == -1 ||
-		    (node->iftype == iftype && node->devnum == devnum)) {
-			list_del(entry);
-			free(node->cache);
-			free(node);
-			--_stats.entries;
+		    (bdev->iftype == iftype && bdev->devnum == devnum)) {
+			bdev->next = 0;
+			bdev->ra_blocks = 0;
+			bdev->sequential = false;
 		}
-	}
 }
 
-void blkcache_configure(unsigned blocks, unsigned entries)
+void blkcache_configure(unsigned long max_bytes, unsigned long max_readahead)
 {
 	/* invalidate cache if there is a change */
-	if ((blocks != _stats.max_blocks_per_entry) ||
-	    (entries != _stats.max_entries))
+	if (max_bytes != _stats.max_bytes)
 		blkcache_invalidate(-1, 0);
 
-	_stats.max_blocks_per_entry = blocks;
-	_stats.max_entries = entries;
+	_stats.max_bytes = max_bytes;
+	_stats.max_readahead = max_readahead;
 
 	_stats.hits = 0;
 	_stats.misses = 0;
@@ -164,7 +321,36 @@ void blkcache_stats(struct block_cache_stats *stats)
 	_stats.misses = 0;
 }
 
+int blkcache_dev_stats(int idx, struct block_cache_dev_stats *stats)
+{
+	struct block_cache_dev *bdev;
+
+	list_for_each_entry(bdev, &block_cache_devs, list) {
+		if (idx--)
+			continue;
+
+		stats->iftype = bdev->iftype;
+		stats->devnum = bdev->devnum;
+		stats->hits = bdev->hits;
+		stats->misses = bdev->misses;
+		stats->readahead = bdev->readahead;
+		bdev->hits = 0;
+		bdev->misses = 0;
+		bdev->readahead = 0;
+		return 0;
+	}
+
+	return -ENOENT;
+}
+
 void blkcache_free(void)
 {
+	struct block_cache_dev *bdev, *n;
+
 	blkcache_invalidate(-1, 0);
+
+	list_for_each_entry_safe(bdev, n, &block_cache_devs, list) {
+		list_del(&bdev->list);
+		free(bdev);
+	}
 }
@@ -55,9 +55,40 @@ static unsigned long host_block_write(struct udevice *dev,
 	return -EIO;
 }
 
+static int host_block_submit(struct udevice *dev, struct blk_request *req)
+{
+	struct blk_desc *desc = dev_get_uclass_plat(dev);
+	struct udevice *host_dev = dev_get_parent(dev);
+	struct host_sb_plat *plat = dev_get_plat(host_dev);
+
+	/* if the host cannot do asynchronous I/O, do it synchronously */
+	if (os_aio_start(plat->fd, req->buffer, req->blkcnt * desc->blksz,
+			 req->start * desc->blksz, req->write, &req->priv))
+		return -EBUSY;
+
+	return 0;
+}
+
+static int host_block_poll(struct udevice *dev, struct blk_request *req)
+{
+	struct blk_desc *desc = dev_get_uclass_plat(dev);
+	ssize_t len;
+
+	if (os_aio_poll(req->priv, &len))
+		return 0;
+
+	req->priv = NULL;
+	req->result = len >= 0 ? len / desc->blksz : -EIO;
+	req->done = true;
+
+	return 0;
+}
+
 static const struct blk_ops sandbox_host_blk_ops = {
 	.read	= host_block_read,
 	.write	= host_block_write,
+	.submit	= host_block_submit,
+	.poll	= host_block_poll,
 };
 
 U_BOOT_DRIVER(sandbox_host_blk) = {
@@ -33,6 +33,7 @@
 #include <linux/err.h>
 #include <linux/list.h>
 #include <power-domain.h>
+#include <uthread.h>
 #include <linux/printk.h>
 
 DECLARE_GLOBAL_DATA_PTR;
@@ -478,15 +479,135 @@ static int device_get_dma_constraints(struct udevice *dev)
 	return 0;
 }
 
+/**
+ * struct probe_claim - a device being probed by a thread, or waited for
+ *
+ * These are held on the stack of device_probe() and device_probe_wait(), so
+ * that threads probing devices in parallel can tell when a device is still
+ * being probed by another thread
+ *
+ * @dev: Device
+ * @thread: Thread probing @dev, or waiting for it
+ * @wait: true if @thread is waiting for another thread to finish probing @dev
+ * @sibling: Node in the list of claims
+ */
+struct probe_claim {
+	struct udevice *dev;
+	struct uthread *thread;
+	bool wait;
+	struct list_head sibling;
+};
+
+#if CONFIG_IS_ENABLED(DM_PROBE_PARALLEL)
+static LIST_HEAD(probe_claims);
+
+/* Find the thread probing @dev, or waited for by @thread if @wait */
+static struct probe_claim *probe_claim_find(struct udevice *dev,
+					    struct uthread *thread, bool wait)
+{
+	struct probe_claim *claim;
+
+	list_for_each_entry(claim, &probe_claims, sibling) {
+		if (claim->wait == wait &&
+		    (wait ? claim->thread == thread : claim->dev == dev))
+			return claim;
+	}
+
+	return NULL;
+}
+
+/* Check whether @thread is waiting, perhaps indirectly, for @self */
+static bool probe_waits_for(struct uthread *thread, struct uthread *self)
+{
+	struct probe_claim *claim;
+	int limit = list_count_nodes(&probe_claims);
+
+	while (thread != self) {
+		claim = probe_claim_find(NULL, thread, true);
+		if (!claim || !limit--)
+			return false;
+		claim = probe_claim_find(claim->dev, NULL, false);
+		if (!claim)
+			return false;
+		thread = claim->thread;
+	}
+
+	return true;
+}
+
+/**
+ * device_probe_wait() - Check whether a device is active
+ *
+ * If another thread is still probing the device, this waits for it to finish,
+ * unless that thread is itself waiting for this one, in which case the device
+ * is used as it is, just as when probing recursively in a single thread.
+ *
+ * @dev: Device to check
+ * Return: true if the device is active, false if it needs to be probed
+ */
+static bool device_probe_wait(struct udevice *dev)
+{
+	struct probe_claim *owner, wait;
+
+	/* a device is claimed only while it is marked active */
+	if (!(dev_get_flags(dev) & DM_FLAG_ACTIVATED))
+		return false;
+	if (list_empty(&probe_claims))
+		return true;
+
+	wait.dev = dev;
+	wait.thread = uthread_self();
+	wait.wait = true;
+	list_add(&wait.sibling, &probe_claims);
+	while ((owner = probe_claim_find(dev, NULL, false)) &&
+	       owner->thread != wait.thread &&
+	       !probe_waits_for(owner->thread, wait.thread))
+		uthread_schedule();
+	list_del(&wait.sibling);
+
+	return dev_get_flags(dev) & DM_FLAG_ACTIVATED;
+}
+
+static void device_probe_claim(struct udevice *dev, struct probe_claim *claim)
+{
+	if (!(gd->flags & GD_FLG_RELOC))
+		return;
+	claim->dev = dev;
+	claim->thread = uthread_self();
+	claim->wait = false;
+	list_add(&claim->sibling, &probe_claims);
+}
+
+static void device_probe_release(struct probe_claim *claim)
+{
+	if (claim->dev)
+		list_del(&claim->sibling);
+}
+#else
+static bool device_probe_wait(struct udevice *dev)
+{
+	return dev_get_flags(dev) & DM_FLAG_ACTIVATED;
+}
+
+static void device_probe_claim(struct udevice *dev, struct probe_claim *claim)
+{
+}
+
+static void device_probe_release(struct probe_claim *claim)
+{
+}
+#endif
+
 int device_probe(struct udevice *dev)
 {
+	struct probe_claim claim = { .dev = NULL };
 	const struct driver *drv;
 	int ret;
 
 	if (!dev)
 		return -EINVAL;
 
-	if (dev_get_flags(dev) & DM_FLAG_ACTIVATED)
+	if (device_probe_wait(dev))
 		return 0;
 
 	ret = device_notify(dev, EVT_DM_PRE_PROBE);
@@ -512,11 +633,12 @@ int device_probe(struct udevice *dev)
 		 * (e.g. PCI bridge devices). Test the flags again
 		 * so that we don't mess up the device.
 		 */
-		if (dev_get_flags(dev) & DM_FLAG_ACTIVATED)
+		if (device_probe_wait(dev))
 			return 0;
 	}
 
 	dev_or_flags(dev, DM_FLAG_ACTIVATED);
+	device_probe_claim(dev, &claim);
 
 	if (CONFIG_IS_ENABLED(POWER_DOMAIN) && dev->parent &&
 	    (device_get_uclass_id(dev) != UCLASS_POWER_DOMAIN) &&
@@ -600,6 +722,7 @@ int device_probe(struct udevice *dev)
 	ret = device_notify(dev, EVT_DM_POST_PROBE);
 	if (ret)
 		goto fail_event;
+	device_probe_release(&claim);
 
 	return 0;
 fail_event:
@@ -610,6 +733,7 @@ fail_uclass:
 	}
 fail:
 	dev_bic_flags(dev, DM_FLAG_ACTIVATED);
+	device_probe_release(&claim);
 
 	device_free(dev);
 
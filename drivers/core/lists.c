@@ -11,6 +11,8 @@
 #include <debug_uart.h>
 #include <errno.h>
 #include <log.h>
+#include <malloc.h>
+#include <asm/global_data.h>
 #include <dm/device.h>
 #include <dm/device-internal.h>
 #include <dm/lists.h>
@@ -19,6 +21,9 @@
 #include <dm/util.h>
 #include <fdtdec.h>
 #include <linux/compiler.h>
+#include <linux/err.h>
+
+DECLARE_GLOBAL_DATA_PTR;
 
 struct driver *lists_driver_lookup_name(const char *name)
 {
@@ -196,6 +201,140 @@ static int driver_check_compatible(const struct udevice_id *of_match,
 	return -ENOENT;
 }
 
+#if CONFIG_IS_ENABLED(DM_COMPAT_INDEX)
+/**
+ * struct dm_compat_entry - a compatible string supported by a driver
+ *
+ * @hash: Hash of the compatible string
+ * @drv: Index of the driver in the driver linker list
+ * @next: Index of the next entry in the same bucket plus one, or 0 if none
+ */
+struct dm_compat_entry {
+	u32 hash;
+	u16 drv;
+	u16 next;
+};
+
+/**
+ * struct dm_compat_index - hash index of the drivers' compatible strings
+ *
+ * The entries in each bucket are in linker-list order, so the first match
+ * found is the driver which a search through the driver list would find.
+ *
+ * @mask: Number of buckets minus one, where the number is a power of two
+ * @bucket: Index of the first entry in each bucket plus one, or 0 if empty
+ * @entry: One entry for each compatible string of each driver
+ */
+struct dm_compat_index {
+	uint mask;
+	u16 *bucket;
+	struct dm_compat_entry entry[];
+};
+
+/* FNV-1a */
+static u32 compat_hash(const char *compat)
+{
+	u32 hash = 2166136261U;
+
+	while (*compat)
+		hash = (hash ^ (u8)*compat++) * 16777619U;
+
+	return hash;
+}
+
+static struct dm_compat_index *compat_index_build(void)
+{
+	struct driver *driver = ll_entry_start(struct driver, driver);
+	const int n_ents = ll_entry_count(struct driver, driver);
+	const struct udevice_id *of_match;
+	struct dm_compat_index *index;
+	struct dm_compat_entry *ent;
+	uint count = 0, buckets = 1;
+	int i;
+
+	for (i = 0; i < n_ents; i++) {
+		for (of_match = driver[i].of_match;
+		     of_match && of_match->compatible; of_match++)
+			count++;
+	}
+	if (!count || count >= U16_MAX || n_ents > U16_MAX)
+		return NULL;
+	while (buckets < count)
+		buckets <<= 1;
+
+	index = malloc(sizeof(*index) + count * sizeof(*ent) +
+		       buckets * sizeof(u16));
+	if (!index)
+		return NULL;
+	index->mask = buckets - 1;
+	index->bucket = (u16 *)&index->entry[count];
+	memset(index->bucket, '\0', buckets * sizeof(u16));
+
+	/* add each entry at the head of its bucket, starting from the end */
+	ent = &index->entry[count];
+	for (i = n_ents - 1; i >= 0; i--) {
+		for (of_match = driver[i].of_match;
+		     of_match && of_match->compatible; of_match++) {
+			u16 *head;
+
+			ent--;
+			ent->hash = compat_hash(of_match->compatible);
+			ent->drv = i;
+			head = &index->bucket[ent->hash & index->mask];
+			ent->next = *head;
+			*head = ent - index->entry + 1;
+		}
+	}
+
+	return index;
+}
+
+/**
+ * compat_index_lookup() - Find the first driver for a compatible string
+ *
+ * @compat: The compatible string to search for
+ * @of_idp: Returns the match that was found
+ * Return: driver found, NULL if none, or an error pointer if the index is not
+ * available, in which case the driver list must be searched instead
+ */
+static struct driver *compat_index_lookup(const char *compat,
+					  const struct udevice_id **of_idp)
+{
+	struct driver *driver = ll_entry_start(struct driver, driver);
+	struct dm_compat_index *index = gd->dm_compat_index;
+	const struct dm_compat_entry *ent;
+	u32 hash;
+	uint i;
+
+	if (!index) {
+		index = compat_index_build();
+		/* do not retry on every bind if there is no memory for it */
+		if (!index)
+			index = ERR_PTR(-ENOMEM);
+		gd->dm_compat_index = index;
+	}
+	if (IS_ERR(index))
+		return ERR_CAST(index);
+
+	hash = compat_hash(compat);
+	for (i = index->bucket[hash & index->mask]; i; i = ent->next) {
+		ent = &index->entry[i - 1];
+		if (ent->hash == hash &&
+		    !driver_check_compatible(driver[ent->drv].of_match, of_idp,
+					     compat))
+			return &driver[ent->drv];
+	}
+
+	return NULL;
+}
+#else
+static struct driver *compat_index_lookup(const char *compat,
+					  const struct udevice_id **of_idp)
+{
+	return ERR_PTR(-ENOSYS);
+}
+#endif
+
 int lists_bind_fdt(struct udevice *parent, ofnode node, struct udevice **devp,
 		   struct driver *drv, bool pre_reloc_only)
 {
@@ -238,20 +377,28 @@ int lists_bind_fdt(struct udevice *parent, ofnode node, struct udevice **devp,
 			  compat);
 
 		id = NULL;
-		for (entry = driver; entry != driver + n_ents; entry++) {
-			if (drv) {
-				if (drv != entry)
-					continue;
-				if (!entry->of_match)
+		entry = ERR_PTR(-ENOSYS);
+		if (!drv)
+			entry = compat_index_lookup(compat, &id);
+		if (!entry)
+			continue;
+		if (IS_ERR(entry)) {
+			for (entry = driver; entry != driver + n_ents;
+			     entry++) {
+				if (drv) {
+					if (drv != entry)
+						continue;
+					if (!entry->of_match)
+						break;
+				}
+				ret = driver_check_compatible(entry->of_match,
+							      &id, compat);
+				if (!ret)
 					break;
 			}
-			ret = driver_check_compatible(entry->of_match, &id,
-						      compat);
-			if (!ret)
-				break;
+			if (entry == driver + n_ents)
+				continue;
 		}
-		if (entry == driver + n_ents)
-			continue;
 
 		if (pre_reloc_only) {
 			if (!ofnode_pre_reloc(node) &&
@@ -445,6 +445,133 @@ struct device_node *of_find_node_by_prop_value(struct device_node *from,
 	return np;
 }
 
+#if CONFIG_IS_ENABLED(OF_PHANDLE_CACHE)
+/* Number of trees with a phandle table, e.g. the control tree and one other */
+#define OF_PHANDLE_CACHE_TREES	2
+
+/**
+ * struct of_phandle_cache - table for looking up the nodes of a tree by phandle
+ *
+ * @root: Root of the tree covered, NULL if unused
+ * @mask: Number of slots minus one, where the number is a power of two
+ * @node: Nodes with a phandle, each in the first free slot from its phandle
+ *	masked with @mask
+ */
+struct of_phandle_cache {
+	struct device_node *root;
+	uint mask;
+	struct device_node **node;
+};
+
+static struct of_phandle_cache phandle_cache[OF_PHANDLE_CACHE_TREES];
+static uint phandle_cache_next;
+
+void of_phandle_cache_reset(const struct device_node *root)
+{
+	struct of_phandle_cache *cache;
+
+	for (cache = phandle_cache;
+	     cache != phandle_cache + OF_PHANDLE_CACHE_TREES; cache++) {
+		if (cache->root && (!root || cache->root == root)) {
+			free(cache->node);
+			cache->node = NULL;
+			cache->root = NULL;
+		}
+	}
+}
+
+/* Get the table for the tree at @root, building it if needed */
+static struct of_phandle_cache *of_phandle_cache_get(struct device_node *root)
+{
+	struct of_phandle_cache *cache;
+	struct device_node *np;
+	uint count = 0, slots = 1, i;
+
+	for (cache = phandle_cache;
+	     cache != phandle_cache + OF_PHANDLE_CACHE_TREES; cache++) {
+		if (cache->root == root)
+			return cache;
+	}
+
+	for (np = root; np; np = of_find_all_nodes(np)) {
+		if (np->phandle)
+			count++;
+	}
+	/* keep the table at most half full */
+	while (slots < count * 2)
+		slots <<= 1;
+
+	cache = &phandle_cache[phandle_cache_next++ % OF_PHANDLE_CACHE_TREES];
+	of_phandle_cache_reset(cache->root);
+	cache->node = calloc(slots, sizeof(*cache->node));
+	if (!cache->node)
+		return NULL;
+	cache->root = root;
+	cache->mask = slots - 1;
+
+	for (np = root; np; np = of_find_all_nodes(np)) {
+		if (!np->phandle)
+			continue;
+		for (i = np->phandle & cache->mask; cache->node[i];
+		     i = (i + 1) & cache->mask) {
+			/* the first node with a phandle wins, as in the tree */
+			if (cache->node[i]->phandle == np->phandle)
+				break;
+		}
+		if (!cache->node[i])
+			cache->node[i] = np;
+	}
+
+	return cache;
+}
+
+int of_phandle_cache_build(struct device_node *root)
+{
+	of_phandle_cache_reset(root);
+
+	return of_phandle_cache_get(root) ? 0 : -ENOMEM;
+}
+
+/**
+ * of_phandle_cache_find() - Look up a phandle in the table for a tree
+ *
+ * @root: Root of the tree, or NULL for the control tree
+ * @handle: Phandle to look up
+ * @npp: Returns the node found, or NULL if there is none
+ * Return: true if the table was used, false if it is not available
+ */
+static bool of_phandle_cache_find(struct device_node *root, phandle handle,
+				  struct device_node **npp)
+{
+	struct of_phandle_cache *cache;
+	struct device_node *np;
+	uint i;
+
+	if (!root)
+		root = gd_of_root();
+	if (!root)
+		return false;
+	cache = of_phandle_cache_get(root);
+	if (!cache)
+		return false;
+
+	for (i = handle & cache->mask; (np = cache->node[i]);
+	     i = (i + 1) & cache->mask) {
+		if (np->phandle == handle)
+			break;
+	}
+	*npp = np;
+
+	return true;
+}
+#else
+static bool of_phandle_cache_find(struct device_node *root, phandle handle,
+				  struct device_node **npp)
+{
+	return false;
+}
+#endif
+
 struct device_node *of_find_node_by_phandle(struct device_node *root,
 					    phandle handle)
 {
@@ -453,6 +580,9 @@ struct device_node *of_find_node_by_phandle(struct device_node *root,
 	if (!handle)
 		return NULL;
 
+	if (of_phandle_cache_find(root, handle, &np))
+		return np;
+
 	for_each_of_allnodes_from(root, np)
 		if (np->phandle == handle)
 			break;
@@ -1114,6 +1244,13 @@ int of_remove_node(struct device_node *to_remove)
 	if (!np)
 		return -EFAULT;
 
+	if (CONFIG_IS_ENABLED(OF_PHANDLE_CACHE)) {
+		for (np = parent; np->parent; np = np->parent)
+			;
+		of_phandle_cache_reset(np);
+		np = to_remove;
+	}
+
 	/* if there is a previous node, link it to this one's sibling */
 	if (prev)
 		prev->sibling = np->sibling;
@@ -12,6 +12,7 @@
 #include <fdtdec.h>
 #include <log.h>
 #include <malloc.h>
+#include <uthread.h>
 #include <asm-generic/sections.h>
 #include <asm/global_data.h>
 #include <linux/libfdt.h>
@@ -322,11 +323,145 @@ probe_children:
 	return 0;
 }
 
+#if CONFIG_IS_ENABLED(DM_PROBE_PARALLEL)
+/**
+ * struct dm_probe_entry - a device to be probed by the probe threads
+ *
+ * @dev: Device to probe
+ * @parent: Index of the entry of the closest ancestor which is also probed,
+ *	or -1 if none
+ * @ret: Result of probing @dev, or of its ancestor if that failed
+ * @done: true once @ret is set
+ */
+struct dm_probe_entry {
+	struct udevice *dev;
+	int parent;
+	int ret;
+	bool done;
+};
+
+/**
+ * struct dm_probe_queue - devices to be probed by probe threads
+ *
+ * @entry: Devices to probe, parents before children
+ * @count: Number of entries in @entry
+ * @next: Index of the next entry to probe
+ */
+struct dm_probe_queue {
+	struct dm_probe_entry *entry;
+	int count;
+	int next;
+};
+
+/*
+ * Add devices to be probed to @queue, or just count them if no @queue->entry.
+ * @parent is the index of the entry of the closest ancestor, or -1
+ */
+static void dm_probe_collect(struct udevice *dev, struct dm_probe_queue *queue,
+			     int parent)
+{
+	struct udevice *child;
+
+	if (dev_get_flags(dev) & DM_FLAG_PROBE_AFTER_BIND) {
+		if (queue->entry) {
+			queue->entry[queue->count].dev = dev;
+			queue->entry[queue->count].parent = parent;
+		}
+		parent = queue->count++;
+	}
+
+	list_for_each_entry(child, &dev->child_head, sibling_node)
+		dm_probe_collect(child, queue, parent);
+}
+
+static void dm_probe_thread(void *arg)
+{
+	struct dm_probe_queue *queue = arg;
+	struct dm_probe_entry *ent, *up;
+
+	/* threads only switch when they yield, so this needs no locking */
+	while (queue->next < queue->count) {
+		ent = &queue->entry[queue->next++];
+		/* as dm_probe_devices() does, skip the children of a failure */
+		if (ent->parent != -1) {
+			up = &queue->entry[ent->parent];
+			while (!up->done)
+				uthread_schedule();
+			if (up->ret) {
+				ent->ret = up->ret;
+				ent->done = true;
+				continue;
+			}
+		}
+		ent->ret = device_probe(ent->dev);
+		if (ent->ret)
+			dm_warn("Device '%s' failed to probe: %d\n",
+				ent->dev->name, ent->ret);
+		ent->done = true;
+	}
+}
+
+/**
+ * dm_probe_parallel() - Probe devices using several threads
+ *
+ * This probes all devices with DM_FLAG_PROBE_AFTER_BIND, as
+ * dm_probe_devices() does, but while one device waits for its hardware, others
+ * are probed. The parent and suppliers of each device are ready before it is
+ * probed, since device_probe() waits for any device which another thread is
+ * still probing. If there is no memory for the queue, the devices are probed
+ * one at a time instead.
+ *
+ * @root: Root device
+ * Return 0 if OK, -ve if @root itself failed to probe
+ */
+static int dm_probe_parallel(struct udevice *root)
+{
+	struct dm_probe_queue queue = {};
+	uint grp_id;
+	int i, ret;
+
+	dm_probe_collect(root, &queue, -1);
+	if (!queue.count)
+		return 0;
+	queue.entry = calloc(queue.count, sizeof(*queue.entry));
+	if (!queue.entry)
+		return dm_probe_devices(root, false);
+	queue.count = 0;
+	dm_probe_collect(root, &queue, -1);
+
+	grp_id = uthread_grp_new_id();
+	for (i = 0; i < CONFIG_DM_PROBE_PARALLEL_THREADS && i < queue.count;
+	     i++) {
+		if (uthread_create(NULL, dm_probe_thread, &queue,
+				   CONFIG_DM_PROBE_PARALLEL_STACK_SIZE, grp_id))
+			break;
+	}
+	/* this thread helps too, so all is well if none could be created */
+	dm_probe_thread(&queue);
+	while (!uthread_grp_done(grp_id))
+		uthread_schedule();
+	/* as with dm_probe_devices(), only a failure of the root is returned */
+	ret = queue.entry[0].dev == root ? queue.entry[0].ret : 0;
+	free(queue.entry);
+
+	return ret;
+}
+#else
+static int dm_probe_parallel(struct udevice *root)
+{
+	return -ENOSYS;
+}
+#endif
+
 int dm_autoprobe(void)
 {
 	int ret;
 
-	ret = dm_probe_devices(gd->dm_root, !(gd->flags & GD_FLG_RELOC));
+	if (CONFIG_IS_ENABLED(DM_PROBE_PARALLEL) && (gd->flags & GD_FLG_RELOC))
+		ret = dm_probe_parallel(gd->dm_root);
+	else
+		ret = dm_probe_devices(gd->dm_root,
+				       !(gd->flags & GD_FLG_RELOC));
 	if (ret)
 		return log_msg_ret("pro", ret);
 
@@ -44,7 +44,7 @@
 		 ADMA_BOUNDARY_ALGN)
 /* +1 descriptor for each crossing.
  */
-#define ADMA_TABLE_EXTRA_SZ (ADMA_POTENTIAL_CROSSINGS * ADMA_DESC_LEN)
+#define ADMA_TABLE_EXTRA_SZ (ADMA_POTENTIAL_CROSSINGS * ADMA_DESC_MAX_LEN)
 
 struct adi_sdhc_plat {
 	struct mmc_config cfg;
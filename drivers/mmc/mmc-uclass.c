@@ -222,6 +222,31 @@ int mmc_reinit(struct mmc *mmc)
 	return dm_mmc_reinit(mmc->dev);
 }
 
+#if CONFIG_IS_ENABLED(MMC_CQE)
+bool mmc_cqe_supported(struct mmc *mmc)
+{
+	struct dm_mmc_ops *ops = mmc_get_ops(mmc->dev);
+
+	return ops->cqe_request && mmc->cmdq_depth > 1;
+}
+
+static int dm_mmc_cqe_request(struct udevice *dev, struct mmc_cqe_task *tasks,
+			      int count)
+{
+	struct dm_mmc_ops *ops = mmc_get_ops(dev);
+
+	if (!ops->cqe_request)
+		return -ENOSYS;
+
+	return ops->cqe_request(dev, tasks, count);
+}
+
+int mmc_cqe_request(struct mmc *mmc, struct mmc_cqe_task *tasks, int count)
+{
+	return dm_mmc_cqe_request(mmc->dev, tasks, count);
+}
+#endif
+
 int mmc_of_parse(struct udevice *dev, struct mmc_config *cfg)
 {
 	int val;
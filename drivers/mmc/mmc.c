@@ -504,6 +504,51 @@ static int mmc_get_b_max(struct mmc *mmc, void *dst, lbaint_t blkcnt)
 }
 #endif
 
+#if CONFIG_IS_ENABLED(MMC_CQE)
+/*
+ * Read blocks as several tasks of up to @b_max blocks each, queueing as many
+ * as the card allows at once. Command queueing is only enabled while doing
+ * so, as the card does not accept plain read and write commands with it.
+ */
+static int mmc_cqe_read_blocks(struct mmc *mmc, void *dst, lbaint_t start,
+			       lbaint_t blkcnt, uint b_max)
+{
+	struct mmc_cqe_task tasks[MMC_CQE_MAX_TASKS];
+	int depth = min_t(int, mmc->cmdq_depth, MMC_CQE_MAX_TASKS);
+	int count, err, ret;
+
+	err = mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL, EXT_CSD_CMDQ_MODE_EN, 1);
+	if (err)
+		return err;
+
+	while (blkcnt) {
+		for (count = 0; count < depth && blkcnt; count++) {
+			struct mmc_cqe_task *task = &tasks[count];
+			lbaint_t cur = min_t(lbaint_t, blkcnt, b_max);
+
+			if (mmc->high_capacity)
+				task->addr = start;
+			else
+				task->addr = start * mmc->read_bl_len;
+			task->data.dest = dst;
+			task->data.blocks = cur;
+			task->data.blocksize = mmc->read_bl_len;
+			task->data.flags = MMC_DATA_READ;
+			blkcnt -= cur;
+			start += cur;
+			dst += cur * mmc->read_bl_len;
+		}
+		err = mmc_cqe_request(mmc, tasks, count);
+		if (err)
+			break;
+	}
+
+	ret = mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL, EXT_CSD_CMDQ_MODE_EN, 0);
+
+	return err ? err : ret;
+}
+#endif
+
 #if CONFIG_IS_ENABLED(BLK)
 ulong mmc_bread(struct udevice *dev, lbaint_t start, lbaint_t blkcnt, void *dst)
 #else
@@ -549,6 +594,16 @@ ulong mmc_bread(struct blk_desc *block_dev, lbaint_t start, lbaint_t blkcnt,
 
 	b_max = mmc_get_b_max(mmc, dst, blkcnt);
 
+#if CONFIG_IS_ENABLED(MMC_CQE)
+	if (blkcnt > b_max && mmc_cqe_supported(mmc)) {
+		if (mmc_cqe_read_blocks(mmc, dst, start, blkcnt, b_max)) {
+			pr_debug("%s: Failed to read queued blocks\n", __func__);
+			return 0;
+		}
+		return blkcnt;
+	}
+#endif
+
 	do {
 		cur = (blocks_todo > b_max) ? b_max : blocks_todo;
 		if (mmc_read_blocks(mmc, dst, start, cur) != cur) {
@@ -2404,6 +2459,14 @@ static int mmc_startup_v4(struct mmc *mmc)
 	if (mmc->part_switch_time < MMC_MIN_PART_SWITCH_TIME && mmc->part_switch_time)
 		mmc->part_switch_time = MMC_MIN_PART_SWITCH_TIME;
 
+#if CONFIG_IS_ENABLED(MMC_CQE)
+	if (mmc->version >= MMC_VERSION_5_1 &&
+	    (ext_csd[EXT_CSD_CMDQ_SUPPORT] & 0x1))
+		mmc->cmdq_depth = (ext_csd[EXT_CSD_CMDQ_DEPTH] & 0x1f) + 1;
+	else
+		mmc->cmdq_depth = 0;
+#endif
+
 	/* store the partition info of emmc */
 	mmc->part_support = ext_csd[EXT_CSD_PARTITIONING_SUPPORT];
 	if ((ext_csd[EXT_CSD_PARTITIONING_SUPPORT] & PART_SUPPORT) ||
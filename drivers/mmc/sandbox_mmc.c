@@ -26,12 +26,41 @@ struct sandbox_mmc_plat {
 /* Granularity of priv->csize - this is 1MB */
 #define SIZE_MULTIPLE		((1 << (MMC_CMULT + 2)) * MMC_BL_LEN)
 
+/**
+ * struct sandbox_mmc_priv - private data for the emulated card and host
+ *
+ * @buf: Card contents
+ * @csize: CSIZE value to report
+ * @size: Size of @buf in bytes
+ * @cmdq_en: true if command queueing is enabled in the card
+ * @transfers: Number of data transfers, by command or queued task
+ * @max_blocks: Most blocks moved by one transfer
+ * @max_queued: Most tasks queued at once
+ */
 struct sandbox_mmc_priv {
 	char *buf;
-	int csize;	/* CSIZE value to report */
+	int csize;
 	int size;
+	bool cmdq_en;
+	uint transfers;
+	uint max_blocks;
+	uint max_queued;
 };
 
+static void sandbox_mmc_xfer(struct sandbox_mmc_priv *priv, uint addr,
+			     struct mmc_data *data)
+{
+	ulong offset = (ulong)addr * data->blocksize;
+	ulong len = data->blocks * data->blocksize;
+
+	if (data->flags == MMC_DATA_READ)
+		memcpy(data->dest, &priv->buf[offset], len);
+	else
+		memcpy(&priv->buf[offset], data->src, len);
+	priv->transfers++;
+	priv->max_blocks = max(priv->max_blocks, data->blocks);
+}
+
 /**
  * sandbox_mmc_send_cmd() - Emulate SD commands
  *
@@ -56,7 +85,7 @@ static int sandbox_mmc_send_cmd(struct udevice *dev, struct mmc_cmd *cmd,
 		cmd->response[0] = 0xaa;
 		break;
 	case MMC_CMD_SEND_STATUS:
-		cmd->response[0] = MMC_STATUS_RDY_FOR_DATA;
+		cmd->response[0] = MMC_STATUS_RDY_FOR_DATA | MMC_STATE_TRANS;
 		break;
 	case MMC_CMD_SELECT_CARD:
 		break;
@@ -68,8 +97,12 @@ static int sandbox_mmc_send_cmd(struct udevice *dev, struct mmc_cmd *cmd,
 		cmd->response[3] = 0;
 		break;
 	case SD_CMD_SWITCH_FUNC: {
-		if (!data)
+		/* without data this is an eMMC SWITCH, setting an EXT_CSD byte */
+		if (!data) {
+			if (((cmd->cmdarg >> 16) & 0xff) == EXT_CSD_CMDQ_MODE_EN)
+				priv->cmdq_en = (cmd->cmdarg >> 8) & 1;
 			break;
+		}
 		u32 *resp = (u32 *)data->dest;
 		resp[3] = 0;
 		resp[7] = cpu_to_be32(SD_HIGHSPEED_BUSY);
@@ -79,13 +112,12 @@ static int sandbox_mmc_send_cmd(struct udevice *dev, struct mmc_cmd *cmd,
 	}
 	case MMC_CMD_READ_SINGLE_BLOCK:
 	case MMC_CMD_READ_MULTIPLE_BLOCK:
-		memcpy(data->dest, &priv->buf[cmd->cmdarg * data->blocksize],
-		       data->blocks * data->blocksize);
-		break;
 	case MMC_CMD_WRITE_SINGLE_BLOCK:
 	case MMC_CMD_WRITE_MULTIPLE_BLOCK:
-		memcpy(&priv->buf[cmd->cmdarg * data->blocksize], data->src,
-		       data->blocks * data->blocksize);
+		/* plain data commands are not allowed with command queueing */
+		if (priv->cmdq_en)
+			return -EIO;
+		sandbox_mmc_xfer(priv, cmd->cmdarg, data);
 		break;
 	case MMC_CMD_STOP_TRANSMISSION:
 		break;
@@ -138,10 +170,62 @@ static int sandbox_mmc_get_cd(struct udevice *dev)
 	return 1;
 }
 
+#if CONFIG_IS_ENABLED(MMC_CQE)
+/*
+ * Emulate a command queueing engine. The tasks are completed last to first,
+ * which a real engine is free to do too.
+ */
+static int sandbox_mmc_cqe_request(struct udevice *dev,
+				   struct mmc_cqe_task *tasks, int count)
+{
+	struct sandbox_mmc_priv *priv = dev_get_priv(dev);
+	struct mmc *mmc = mmc_get_mmc_dev(dev);
+	int i;
+
+	if (!priv->cmdq_en)
+		return -EIO;
+	if (count > mmc->cmdq_depth)
+		return -EINVAL;
+	for (i = count - 1; i >= 0; i--) {
+		if (tasks[i].data.blocks > mmc->cfg->b_max)
+			return -EINVAL;
+		sandbox_mmc_xfer(priv, tasks[i].addr, &tasks[i].data);
+	}
+	priv->max_queued = max_t(uint, priv->max_queued, count);
+
+	return 0;
+}
+#endif
+
+int sandbox_mmc_get_stats(struct udevice *dev, uint *transfersp,
+			  uint *max_blocksp, uint *max_queuedp)
+{
+	struct sandbox_mmc_priv *priv = dev_get_priv(dev);
+
+	*transfersp = priv->transfers;
+	*max_blocksp = priv->max_blocks;
+	*max_queuedp = priv->max_queued;
+	priv->transfers = 0;
+	priv->max_blocks = 0;
+	priv->max_queued = 0;
+
+	return 0;
+}
+
+void sandbox_mmc_set_b_max(struct udevice *dev, uint b_max)
+{
+	struct sandbox_mmc_plat *plat = dev_get_plat(dev);
+
+	plat->cfg.b_max = b_max;
+}
+
 static const struct dm_mmc_ops sandbox_mmc_ops = {
 	.send_cmd = sandbox_mmc_send_cmd,
 	.set_ios = sandbox_mmc_set_ios,
 	.get_cd = sandbox_mmc_get_cd,
+#if CONFIG_IS_ENABLED(MMC_CQE)
+	.cqe_request = sandbox_mmc_cqe_request,
+#endif
 };
 
 static int sandbox_mmc_of_to_plat(struct udevice *dev)
@@ -26,7 +26,13 @@ void sdhci_adma_write_desc(struct sdhci_host *host, void **next_desc,
 	desc->addr_hi = upper_32_bits(addr);
 #endif
 
-	*next_desc += ADMA_DESC_LEN;
+	if (host && (host->flags & USE_V4_MODE)) {
+		memset((void *)desc + ADMA_DESC_LEN, '\0',
+		       ADMA_DESC_V4_LEN - ADMA_DESC_LEN);
+		*next_desc += ADMA_DESC_V4_LEN;
+	} else {
+		*next_desc += ADMA_DESC_LEN;
+	}
 }
 
 static inline void __sdhci_adma_write_desc(struct sdhci_host *host,
@@ -49,8 +55,8 @@ static inline void __sdhci_adma_write_desc(struct sdhci_host *host,
  *
  * Fill the ADMA table according to the MMC data to read from or write to the
  * given DMA address.
- * Please note, that the table size depends on CONFIG_SYS_MMC_MAX_BLK_COUNT and
- * we don't have to check for overflow.
+ * Please note, that the table size depends on
+ * CONFIG_MMC_SDHCI_ADMA_MAX_BLK_COUNT and we don't have to check for overflow.
  */
 void sdhci_prepare_adma_table(struct sdhci_host *host,
 			      struct sdhci_adma_desc *table,
@@ -20,6 +20,7 @@
 #include <linux/delay.h>
 #include <linux/dma-mapping.h>
 #include <linux/printk.h>
+#include <linux/sizes.h>
 #include <phys2bus.h>
 #include <power/regulator.h>
 
@@ -85,9 +86,10 @@ static void sdhci_prepare_dma(struct sdhci_host *host, struct mmc_data *data,
 
 	ctrl = sdhci_readb(host, SDHCI_HOST_CONTROL);
 	ctrl &= ~SDHCI_CTRL_DMA_MASK;
-	if (host->flags & USE_ADMA64)
+	/* in version 4 mode, 64-bit addressing is set in HOST_CONTROL2 */
+	if ((host->flags & USE_ADMA64) && !(host->flags & USE_V4_MODE))
 		ctrl |= SDHCI_CTRL_ADMA64;
-	else if (host->flags & USE_ADMA)
+	else if (host->flags & (USE_ADMA | USE_ADMA64))
 		ctrl |= SDHCI_CTRL_ADMA32;
 	sdhci_writeb(host, ctrl, SDHCI_HOST_CONTROL);
 
@@ -132,7 +134,8 @@ static int sdhci_transfer_data(struct sdhci_host *host, struct mmc_data *data)
 	unsigned int stat, rdy, mask, timeout, block = 0;
 	bool transfer_done = false;
 
-	timeout = 1000000;
+	/* allow 10s for each 64K blocks, as larger transfers are possible */
+	timeout = 1000000 * (1 + data->blocks / SZ_64K);
 	rdy = SDHCI_INT_SPACE_AVAIL | SDHCI_INT_DATA_AVAIL;
 	mask = SDHCI_DATA_AVAILABLE | SDHCI_SPACE_AVAILABLE;
 	do {
@@ -292,7 +295,12 @@ static int sdhci_send_command(struct mmc *mmc, struct mmc_cmd *cmd,
 		sdhci_writew(host, SDHCI_MAKE_BLKSZ(SDHCI_DEFAULT_BOUNDARY_ARG,
 				data->blocksize),
 				SDHCI_BLOCK_SIZE);
-		sdhci_writew(host, data->blocks, SDHCI_BLOCK_COUNT);
+		if (host->flags & USE_V4_MODE) {
+			sdhci_writew(host, 0, SDHCI_BLOCK_COUNT);
+			sdhci_writel(host, data->blocks, SDHCI_32BIT_BLK_CNT);
+		} else {
+			sdhci_writew(host, data->blocks, SDHCI_BLOCK_COUNT);
+		}
 		sdhci_writew(host, mode, SDHCI_TRANSFER_MODE);
 	} else if (cmd->resp_type & MMC_RSP_BUSY) {
 		sdhci_writeb(host, 0xe, SDHCI_TIMEOUT_CONTROL);
@@ -725,6 +733,15 @@ static int sdhci_init(struct mmc *mmc)
 
 	sdhci_reset(host, SDHCI_RESET_ALL);
 
+	if (host->flags & USE_V4_MODE) {
+		u16 ctrl = sdhci_readw(host, SDHCI_HOST_CONTROL2);
+
+		ctrl |= SDHCI_CTRL_V4_MODE;
+		if (host->flags & USE_ADMA64)
+			ctrl |= SDHCI_CTRL_64BIT_ADDR;
+		sdhci_writew(host, ctrl, SDHCI_HOST_CONTROL2);
+	}
+
 #if defined(CONFIG_FIXED_SDHCI_ALIGNED_BUFFER)
 	host->align_buffer = (void *)CONFIG_FIXED_SDHCI_ALIGNED_BUFFER;
 	/*
@@ -908,6 +925,12 @@ int sdhci_setup_cfg(struct mmc_config *cfg, struct sdhci_host *host,
 	else
 		host->version = sdhci_readw(host, SDHCI_HOST_VERSION);
 
+	/* version 4 mode has a 32-bit block count, used with ADMA2 only */
+	if (IS_ENABLED(CONFIG_MMC_SDHCI_V4_MODE) &&
+	    SDHCI_GET_VERSION(host) >= SDHCI_SPEC_410 &&
+	    (host->flags & (USE_ADMA | USE_ADMA64)))
+		host->flags |= USE_V4_MODE;
+
 	cfg->name = host->name;
 #ifndef CONFIG_DM_MMC
 	cfg->ops = &sdhci_ops;
@@ -1021,6 +1044,10 @@ int sdhci_setup_cfg(struct mmc_config *cfg, struct sdhci_host *host,
 		cfg->host_caps |= host->host_caps;
 
 	cfg->b_max = CONFIG_SYS_MMC_MAX_BLK_COUNT;
+#ifdef CONFIG_MMC_SDHCI_ADMA_MAX_BLK_COUNT
+	if (host->flags & USE_V4_MODE)
+		cfg->b_max = CONFIG_MMC_SDHCI_ADMA_MAX_BLK_COUNT;
+#endif
 
 	return 0;
 }
@@ -61,7 +61,15 @@ MODULE_LICENSE("GPL");
  */
 u32  crc32_le(u32 crc, unsigned char const *p, size_t len);
 
-#if CRC_LE_BITS == 1
+#if defined(__UBOOT__) && CONFIG_IS_ENABLED(CRC32)
+#include <u-boot/crc.h>
+
+/* use the common implementation, which may be hardware accelerated */
+u32 crc32_le(u32 crc, unsigned char const *p, size_t len)
+{
+	return crc32_no_comp(crc, p, len);
+}
+#elif CRC_LE_BITS == 1
 /*
  * In fact, the table-based code will work in this case, but it can be
  * simplified by inlining the table in ?: form.
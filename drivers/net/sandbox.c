@@ -469,6 +469,20 @@ static void sb_eth_stop(struct udevice *dev)
 	debug("eth_sandbox: Stop\n");
 }
 
+static int sb_eth_mcast(struct udevice *dev, const u8 *enetaddr, int join)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+
+	debug("eth_sandbox %s: %s multicast %pM\n", dev->name,
+	      join ? "Join" : "Leave", enetaddr);
+	if (join)
+		memcpy(priv->mcast_hwaddr, enetaddr, ARP_HLEN);
+	else if (!memcmp(priv->mcast_hwaddr, enetaddr, ARP_HLEN))
+		memset(priv->mcast_hwaddr, 0, ARP_HLEN);
+
+	return 0;
+}
+
 static int sb_eth_write_hwaddr(struct udevice *dev)
 {
 	struct eth_pdata *pdata = dev_get_plat(dev);
@@ -486,6 +500,7 @@ static const struct eth_ops sb_eth_ops = {
 	.recv			= sb_eth_recv,
 	.free_pkt		= sb_eth_free_pkt,
 	.stop			= sb_eth_stop,
+	.mcast			= sb_eth_mcast,
 	.write_hwaddr		= sb_eth_write_hwaddr,
 };
 
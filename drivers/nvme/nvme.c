@@ -17,15 +17,14 @@
 #include <linux/compat.h>
 #include "nvme.h"
 
-#define NVME_Q_DEPTH		2
+#define NVME_Q_DEPTH		CONFIG_NVME_QUEUE_DEPTH
 #define NVME_AQ_DEPTH		2
 #define NVME_SQ_SIZE(depth)	(depth * sizeof(struct nvme_command))
 #define NVME_CQ_SIZE(depth)	(depth * sizeof(struct nvme_completion))
-#define NVME_CQ_ALLOCATION	ALIGN(NVME_CQ_SIZE(NVME_Q_DEPTH), \
-				      ARCH_DMA_MINALIGN)
+#define NVME_CQ_ALLOCATION(depth) ALIGN(NVME_CQ_SIZE(depth), \
+					ARCH_DMA_MINALIGN)
 #define ADMIN_TIMEOUT		60
 #define IO_TIMEOUT		30
-#define MAX_PRP_POOL		512
 
 static int nvme_wait_csts(struct nvme_dev *dev, u32 mask, u32 val)
 {
@@ -44,8 +43,8 @@ static int nvme_wait_csts(struct nvme_dev *dev, u32 mask, u32 val)
 	return -ETIME;
 }
 
-static int nvme_setup_prps(struct nvme_dev *dev, u64 *prp2,
-			   int total_len, u64 dma_addr)
+static int nvme_setup_prps(struct nvme_dev *dev, struct nvme_prp_list *prps,
+			   u64 *prp2, int total_len, u64 dma_addr)
 {
 	u32 page_size = dev->page_size;
 	int offset = dma_addr & (page_size - 1);
@@ -73,36 +72,37 @@ static int nvme_setup_prps(struct nvme_dev *dev, u64 *prp2,
 	nprps = DIV_ROUND_UP(length, page_size);
 	num_pages = DIV_ROUND_UP(nprps - 1, prps_per_page - 1);
 
-	if (nprps > dev->prp_entry_num) {
-		free(dev->prp_pool);
+	if (nprps > prps->entry_num) {
+		free(prps->pool);
 		/*
 		 * Always increase in increments of pages.  It doesn't waste
 		 * much memory and reduces the number of allocations.
 		 */
-		dev->prp_pool = memalign(page_size, num_pages * page_size);
-		if (!dev->prp_pool) {
+		prps->pool = memalign(page_size, num_pages * page_size);
+		if (!prps->pool) {
+			prps->entry_num = 0;
 			printf("Error: malloc prp_pool fail\n");
 			return -ENOMEM;
 		}
-		dev->prp_entry_num = num_pages * (prps_per_page - 1) + 1;
+		prps->entry_num = num_pages * (prps_per_page - 1) + 1;
 	}
 
-	prp_pool = dev->prp_pool;
+	prp_pool = prps->pool;
 	i = 0;
 	while (nprps) {
 		if ((i == (prps_per_page - 1)) && nprps > 1) {
 			*(prp_pool + i) = cpu_to_le64((ulong)prp_pool +
 					page_size);
 			i = 0;
-			prp_pool += page_size;
+			prp_pool += prps_per_page;
 		}
 		*(prp_pool + i++) = cpu_to_le64(dma_addr);
 		dma_addr += page_size;
 		nprps--;
 	}
-	*prp2 = (ulong)dev->prp_pool;
+	*prp2 = (ulong)prps->pool;
 
-	flush_dcache_range((ulong)dev->prp_pool, (ulong)dev->prp_pool +
+	flush_dcache_range((ulong)prps->pool, (ulong)prps->pool +
 			   num_pages * page_size);
 
 	return 0;
@@ -124,7 +124,7 @@ static u16 nvme_read_completion_status(struct nvme_queue *nvmeq, u16 index)
 	 * as the cache line should never become dirty.
 	 */
 	ulong start = (ulong)&nvmeq->cqes[0];
-	ulong stop = start + NVME_CQ_ALLOCATION;
+	ulong stop = start + NVME_CQ_ALLOCATION(nvmeq->q_depth);
 
 	invalidate_dcache_range(start, stop);
 
@@ -132,30 +132,61 @@ static u16 nvme_read_completion_status(struct nvme_queue *nvmeq, u16 index)
 }
 
 /**
- * nvme_submit_cmd() - copy a command into a queue and ring the doorbell
+ * nvme_custom_submit() - check for controller-specific command submission
+ *
+ * Such controllers are driven with a single command in flight.
+ *
+ * @dev:	The NVM Express device
+ * Return: true if the driver provides its own submit_cmd() operation
+ */
+static bool nvme_custom_submit(struct nvme_dev *dev)
+{
+	struct nvme_ops *ops = (struct nvme_ops *)dev->udev->driver->ops;
+
+	return ops && ops->submit_cmd;
+}
+
+/**
+ * nvme_queue_cmd() - copy a command into a queue without ringing the doorbell
  *
  * @nvmeq:	The queue to use
  * @cmd:	The command to send
  */
-static void nvme_submit_cmd(struct nvme_queue *nvmeq, struct nvme_command *cmd)
+static void nvme_queue_cmd(struct nvme_queue *nvmeq, struct nvme_command *cmd)
 {
-	struct nvme_ops *ops;
 	u16 tail = nvmeq->sq_tail;
 
 	memcpy(&nvmeq->sq_cmds[tail], cmd, sizeof(*cmd));
 	flush_dcache_range((ulong)&nvmeq->sq_cmds[tail],
 			   (ulong)&nvmeq->sq_cmds[tail] + sizeof(*cmd));
 
+	if (++tail == nvmeq->q_depth)
+		tail = 0;
+	nvmeq->sq_tail = tail;
+}
+
+/**
+ * nvme_submit_cmd() - copy a command into a queue and ring the doorbell
+ *
+ * @nvmeq:	The queue to use
+ * @cmd:	The command to send
+ */
+static void nvme_submit_cmd(struct nvme_queue *nvmeq, struct nvme_command *cmd)
+{
+	struct nvme_ops *ops;
+	u16 tail = nvmeq->sq_tail;
+
 	ops = (struct nvme_ops *)nvmeq->dev->udev->driver->ops;
 	if (ops && ops->submit_cmd) {
+		memcpy(&nvmeq->sq_cmds[tail], cmd, sizeof(*cmd));
+		flush_dcache_range((ulong)&nvmeq->sq_cmds[tail],
+				   (ulong)&nvmeq->sq_cmds[tail] + sizeof(*cmd));
 		ops->submit_cmd(nvmeq, cmd);
 		return;
 	}
 
-	if (++tail == nvmeq->q_depth)
-		tail = 0;
-	writel(tail, nvmeq->q_db);
-	nvmeq->sq_tail = tail;
+	nvme_queue_cmd(nvmeq, cmd);
+	writel(nvmeq->sq_tail, nvmeq->q_db);
 }
 
 static int nvme_submit_sync_cmd(struct nvme_queue *nvmeq,
@@ -228,14 +259,19 @@ static struct nvme_queue *nvme_alloc_queue(struct nvme_dev *dev,
 					   int qid, int depth)
 {
 	struct nvme_ops *ops;
-	struct nvme_queue *nvmeq = malloc(sizeof(*nvmeq));
+	struct nvme_queue *nvmeq;
+
+	nvmeq = calloc(1, sizeof(*nvmeq) + depth * sizeof(nvmeq->slots[0]));
 	if (!nvmeq)
 		return NULL;
-	memset(nvmeq, 0, sizeof(*nvmeq));
 
-	nvmeq->cqes = (void *)memalign(4096, NVME_CQ_ALLOCATION);
-	if (!nvmeq->cqes)
+	nvmeq->prps = calloc(depth, sizeof(*nvmeq->prps));
+	if (!nvmeq->prps)
 		goto free_nvmeq;
+
+	nvmeq->cqes = (void *)memalign(4096, NVME_CQ_ALLOCATION(depth));
+	if (!nvmeq->cqes)
+		goto free_prps;
 	memset((void *)nvmeq->cqes, 0, NVME_CQ_SIZE(depth));
 
 	nvmeq->sq_cmds = (void *)memalign(4096, NVME_SQ_SIZE(depth));
@@ -261,6 +297,8 @@ static struct nvme_queue *nvme_alloc_queue(struct nvme_dev *dev,
 
  free_queue:
 	free((void *)nvmeq->cqes);
+ free_prps:
+	free(nvmeq->prps);
  free_nvmeq:
 	free(nvmeq);
 
@@ -317,6 +355,13 @@ static int nvme_shutdown_ctrl(struct nvme_dev *dev)
 
 static void nvme_free_queue(struct nvme_queue *nvmeq)
 {
+	int i;
+
+	if (nvmeq->prps) {
+		for (i = 0; i < nvmeq->q_depth; i++)
+			free(nvmeq->prps[i].pool);
+		free(nvmeq->prps);
+	}
 	free((void *)nvmeq->cqes);
 	free(nvmeq->sq_cmds);
 	free(nvmeq);
@@ -344,7 +389,10 @@ static void nvme_init_queue(struct nvme_queue *nvmeq, u16 qid)
 	nvmeq->q_db = &dev->dbs[qid * 2 * dev->db_stride];
 	memset((void *)nvmeq->cqes, 0, NVME_CQ_SIZE(nvmeq->q_depth));
 	flush_dcache_range((ulong)nvmeq->cqes,
-			   (ulong)nvmeq->cqes + NVME_CQ_ALLOCATION);
+			   (ulong)nvmeq->cqes + NVME_CQ_ALLOCATION(nvmeq->q_depth));
+	/* commands given up before a reset will not complete now */
+	memset(nvmeq->slots, '\0', nvmeq->q_depth * sizeof(nvmeq->slots[0]));
+	nvmeq->inflight = 0;
 	dev->online_queues++;
 }
 
@@ -741,65 +789,270 @@ static int nvme_blk_probe(struct udevice *udev)
 	return 0;
 }
 
-static ulong nvme_blk_rw(struct udevice *udev, lbaint_t blknr,
-			 lbaint_t blkcnt, void *buffer, bool read)
+/**
+ * nvme_reap_io() - collect completions for outstanding I/O commands
+ *
+ * Consumes every completion that is already posted and updates the completion
+ * queue head doorbell once. Each completion is accounted to the transfer
+ * owning its command, which need not be @x since the queue is shared. If
+ * nothing has completed, either waits for a completion or returns at once.
+ *
+ * @nvmeq:	The I/O queue
+ * @x:		The transfer waiting for completions
+ * @wait:	true to wait for at least one completion
+ * Return: 0 if OK, -EAGAIN if nothing completed and @wait is false,
+ * -ETIMEDOUT if none of the commands of @x completed in time, in which case
+ * they are given up. Their command ids stay reserved until the controller
+ * completes them or the queue is reset, so that a late completion cannot be
+ * taken for that of a newer command.
+ */
+static int nvme_reap_io(struct nvme_queue *nvmeq, struct nvme_xfer *x,
+			bool wait)
+{
+	ulong timeout_us = IO_TIMEOUT * 100000;
+	u16 head = nvmeq->cq_head;
+	u16 phase = nvmeq->cq_phase;
+	struct nvme_cmd_slot *cs;
+	struct nvme_xfer *owner;
+	int reaped = 0;
+	u16 status;
+	u16 slot;
+
+	for (;;) {
+		status = nvme_read_completion_status(nvmeq, head);
+		if ((status & 0x01) == phase) {
+			slot = readw(&nvmeq->cqes[head].command_id);
+			cs = slot < nvmeq->q_depth ? &nvmeq->slots[slot] : NULL;
+			if (cs && cs->timed_out) {
+				/* a late completion just frees the slot */
+				cs->timed_out = false;
+				nvmeq->inflight--;
+			} else if (cs && cs->xfer) {
+				owner = cs->xfer;
+				cs->xfer = NULL;
+				owner->inflight--;
+				nvmeq->inflight--;
+				owner->last_us = timer_get_us();
+				if (status >> 1) {
+					printf("ERROR: status = %x, phase = %d, head = %d\n",
+					       status >> 1, phase, head);
+					owner->failed = min(owner->failed,
+							    cs->chunk);
+				}
+			}
+			reaped++;
+			if (++head == nvmeq->q_depth) {
+				head = 0;
+				phase = !phase;
+			}
+			continue;
+		}
+		if (reaped)
+			break;
+		if (timer_get_us() - x->last_us >= timeout_us)
+			break;
+		if (!wait)
+			return -EAGAIN;
+	}
+
+	if (reaped) {
+		writel(head, nvmeq->q_db + nvmeq->dev->db_stride);
+		nvmeq->cq_head = head;
+		nvmeq->cq_phase = phase;
+		return 0;
+	}
+
+	/*
+	 * Give up on the commands of this transfer still outstanding, or on
+	 * the transfer itself if it was waiting for a free slot
+	 */
+	if (!x->inflight)
+		x->failed = min(x->failed, x->next);
+	for (slot = 0; slot < nvmeq->q_depth; slot++) {
+		cs = &nvmeq->slots[slot];
+		if (cs->xfer != x)
+			continue;
+		x->failed = min(x->failed, cs->chunk);
+		cs->xfer = NULL;
+		cs->timed_out = true;
+	}
+	x->inflight = 0;
+
+	return -ETIMEDOUT;
+}
+
+static void nvme_xfer_start(struct udevice *udev, struct nvme_xfer *x,
+			    lbaint_t blknr, lbaint_t blkcnt, void *buffer,
+			    bool read)
+{
+	struct nvme_ns *ns = dev_get_priv(udev);
+	int chunk_shift = ns->dev->max_transfer_shift - ns->lba_shift;
+
+	x->blknr = blknr;
+	x->blkcnt = blkcnt;
+	x->buffer = buffer;
+	x->read = read;
+	x->nchunks = (blkcnt + (1 << chunk_shift) - 1) >> chunk_shift;
+	x->next = 0;
+	x->failed = x->nchunks;
+	x->inflight = 0;
+	x->last_us = timer_get_us();
+
+	flush_dcache_range((unsigned long)buffer,
+			   (unsigned long)buffer + (blkcnt << ns->lba_shift));
+}
+
+static bool nvme_xfer_busy(struct nvme_xfer *x)
+{
+	return (x->next < x->nchunks && x->failed == x->nchunks) ||
+		x->inflight;
+}
+
+/*
+ * Keep the queue filled with up to q_depth - 1 commands, counting those of
+ * other transfers, each transferring one chunk of at most max_transfer_shift
+ * bytes. New commands are added to the submission queue in batches with a
+ * single doorbell write. After an error no further commands are issued, but
+ * those in flight are drained so that the queue is left idle.
+ */
+static void nvme_xfer_queue(struct udevice *udev, struct nvme_xfer *x)
 {
 	struct nvme_ns *ns = dev_get_priv(udev);
 	struct nvme_dev *dev = ns->dev;
+	struct nvme_queue *nvmeq = dev->queues[NVME_IO_Q];
+	int chunk_shift = dev->max_transfer_shift - ns->lba_shift;
 	struct nvme_command c;
-	struct blk_desc *desc = dev_get_uclass_plat(udev);
-	int status;
+	int depth, queued = 0;
+	u16 slot = 0;
 	u64 prp2;
-	u64 total_len = blkcnt << desc->log2blksz;
-	u64 temp_len = total_len;
-	uintptr_t temp_buffer = (uintptr_t)buffer;
-
-	u64 slba = blknr;
-	u16 lbas = 1 << (dev->max_transfer_shift - ns->lba_shift);
-	u64 total_lbas = blkcnt;
 
-	flush_dcache_range((unsigned long)buffer,
-			   (unsigned long)buffer + total_len);
-
-	c.rw.opcode = read ? nvme_cmd_read : nvme_cmd_write;
-	c.rw.flags = 0;
+	memset(&c, 0, sizeof(c));
+	c.rw.opcode = x->read ? nvme_cmd_read : nvme_cmd_write;
 	c.rw.nsid = cpu_to_le32(ns->ns_id);
-	c.rw.control = 0;
-	c.rw.dsmgmt = 0;
-	c.rw.reftag = 0;
-	c.rw.apptag = 0;
-	c.rw.appmask = 0;
-	c.rw.metadata = 0;
-
-	while (total_lbas) {
-		if (total_lbas < lbas) {
-			lbas = (u16)total_lbas;
-			total_lbas = 0;
-		} else {
-			total_lbas -= lbas;
-		}
 
-		if (nvme_setup_prps(dev, &prp2,
-				    lbas << ns->lba_shift, temp_buffer))
-			return -EIO;
-		c.rw.slba = cpu_to_le64(slba);
-		slba += lbas;
+	depth = nvme_custom_submit(dev) ? 1 : nvmeq->q_depth - 1;
+	while (nvmeq->inflight < depth && x->next < x->nchunks &&
+	       x->failed == x->nchunks) {
+		lbaint_t slba = (lbaint_t)x->next << chunk_shift;
+		u16 lbas = min_t(lbaint_t, x->blkcnt - slba, 1 << chunk_shift);
+		uintptr_t addr = (uintptr_t)x->buffer +
+				 (slba << ns->lba_shift);
+
+		/* fewer than q_depth are in flight, so one is free */
+		while (nvmeq->slots[slot].xfer || nvmeq->slots[slot].timed_out)
+			slot = (slot + 1) % nvmeq->q_depth;
+
+		if (nvme_setup_prps(dev, &nvmeq->prps[slot], &prp2,
+				    lbas << ns->lba_shift, addr)) {
+			x->failed = x->next;
+			break;
+		}
+		c.rw.slba = cpu_to_le64(x->blknr + slba);
 		c.rw.length = cpu_to_le16(lbas - 1);
-		c.rw.prp1 = cpu_to_le64(temp_buffer);
+		c.rw.prp1 = cpu_to_le64(addr);
 		c.rw.prp2 = cpu_to_le64(prp2);
-		status = nvme_submit_sync_cmd(dev->queues[NVME_IO_Q],
-				&c, NULL, IO_TIMEOUT);
-		if (status)
-			break;
-		temp_len -= (u32)lbas << ns->lba_shift;
-		temp_buffer += lbas << ns->lba_shift;
+
+		if (nvme_custom_submit(dev)) {
+			/* the driver handles submission one at a time */
+			if (nvme_submit_sync_cmd(nvmeq, &c, NULL, IO_TIMEOUT))
+				x->failed = x->next;
+			x->next++;
+			continue;
+		}
+
+		c.rw.command_id = cpu_to_le16(slot);
+		nvme_queue_cmd(nvmeq, &c);
+		nvmeq->slots[slot].xfer = x;
+		nvmeq->slots[slot].chunk = x->next++;
+		nvmeq->inflight++;
+		x->inflight++;
+		queued++;
 	}
 
-	if (read)
-		invalidate_dcache_range((unsigned long)buffer,
-					(unsigned long)buffer + total_len);
+	if (queued) {
+		writel(nvmeq->sq_tail, nvmeq->q_db);
+		x->last_us = timer_get_us();
+	}
+}
 
-	return (total_len - temp_len) >> desc->log2blksz;
+/* Return the number of blocks transferred before the first failed chunk */
+static lbaint_t nvme_xfer_finish(struct udevice *udev, struct nvme_xfer *x)
+{
+	struct nvme_ns *ns = dev_get_priv(udev);
+	int chunk_shift = ns->dev->max_transfer_shift - ns->lba_shift;
+	lbaint_t done;
+
+	if (x->read)
+		invalidate_dcache_range((unsigned long)x->buffer,
+					(unsigned long)x->buffer +
+					(x->blkcnt << ns->lba_shift));
+
+	done = (lbaint_t)x->failed << chunk_shift;
+
+	return min(done, x->blkcnt);
+}
+
+static int nvme_blk_poll(struct udevice *udev, struct blk_request *req)
+{
+	struct nvme_ns *ns = dev_get_priv(udev);
+	struct nvme_queue *nvmeq = ns->dev->queues[NVME_IO_Q];
+	struct nvme_xfer *x = &ns->async;
+	int ret;
+
+	if (nvmeq->inflight) {
+		ret = nvme_reap_io(nvmeq, x, false);
+		if (ret == -EAGAIN)
+			return 0;
+		if (ret)
+			printf("Error: %s: I/O timed out\n", udev->name);
+	}
+	nvme_xfer_queue(udev, x);
+	if (nvme_xfer_busy(x))
+		return 0;
+
+	ns->async_req = NULL;
+	req->result = nvme_xfer_finish(udev, x);
+	req->done = true;
+
+	return 0;
+}
+
+static int nvme_blk_submit(struct udevice *udev, struct blk_request *req)
+{
+	struct nvme_ns *ns = dev_get_priv(udev);
+
+	/* one asynchronous transfer at a time, without custom submission */
+	if (ns->async_req || nvme_custom_submit(ns->dev))
+		return -EBUSY;
+
+	nvme_xfer_start(udev, &ns->async, req->start, req->blkcnt,
+			req->buffer, !req->write);
+	ns->async_req = req;
+	nvme_xfer_queue(udev, &ns->async);
+
+	return 0;
+}
+
+static ulong nvme_blk_rw(struct udevice *udev, lbaint_t blknr,
+			 lbaint_t blkcnt, void *buffer, bool read)
+{
+	struct nvme_ns *ns = dev_get_priv(udev);
+	struct nvme_queue *nvmeq = ns->dev->queues[NVME_IO_Q];
+	struct nvme_xfer x;
+
+	/*
+	 * Commands of asynchronous transfers may be sharing the I/O queue.
+	 * Their completions are accounted to them and picked up by the next
+	 * poll, so just reap whatever completes until this transfer is done.
+	 */
+	nvme_xfer_start(udev, &x, blknr, blkcnt, buffer, read);
+	while (nvme_xfer_busy(&x)) {
+		nvme_xfer_queue(udev, &x);
+		if (nvmeq->inflight && nvme_reap_io(nvmeq, &x, true))
+			printf("Error: %s: I/O timed out\n", udev->name);
+	}
+
+	return nvme_xfer_finish(udev, &x);
 }
 
 static ulong nvme_blk_read(struct udevice *udev, lbaint_t blknr,
@@ -817,6 +1070,8 @@ static ulong nvme_blk_write(struct udevice *udev, lbaint_t blknr,
 static const struct blk_ops nvme_blk_ops = {
 	.read	= nvme_blk_read,
 	.write	= nvme_blk_write,
+	.submit	= nvme_blk_submit,
+	.poll	= nvme_blk_poll,
 };
 
 U_BOOT_DRIVER(nvme_blk) = {
@@ -860,15 +1115,6 @@ int nvme_init(struct udevice *udev)
 		goto free_queue;
 	}
 
-	/* Allocate after the page size is known */
-	ndev->prp_pool = memalign(ndev->page_size, MAX_PRP_POOL);
-	if (!ndev->prp_pool) {
-		ret = -ENOMEM;
-		printf("Error: %s: Out of memory!\n", udev->name);
-		goto free_nvme;
-	}
-	ndev->prp_entry_num = MAX_PRP_POOL >> 3;
-
 	ret = nvme_setup_io_queues(ndev);
 	if (ret) {
 		log_debug("Unable to setup I/O queues(err=%dE)\n", ret);
@@ -7,6 +7,7 @@
 #ifndef __DRIVER_NVME_H__
 #define __DRIVER_NVME_H__
 
+#include <blk.h>
 #include <asm/io.h>
 
 struct nvme_id_power_state {
@@ -618,8 +619,6 @@ struct nvme_dev {
 	u32 stripe_size;
 	u32 page_size;
 	u8 vwc;
-	u64 *prp_pool;
-	u32 prp_entry_num;
 	u32 nn;
 };
 
@@ -630,6 +629,28 @@ enum nvme_queue_id {
 	NVME_Q_NUM,
 };
 
+/*
+ * A PRP list for one in-flight command. Each submission queue slot has its
+ * own list so that several commands can be outstanding at once.
+ */
+struct nvme_prp_list {
+	u64 *pool;
+	u32 entry_num;
+};
+
+struct nvme_xfer;
+
+/*
+ * A command id of an I/O queue. The queue is shared by every namespace and
+ * by synchronous and asynchronous transfers, so each command records the
+ * transfer it belongs to.
+ */
+struct nvme_cmd_slot {
+	struct nvme_xfer *xfer;	/* owning transfer, NULL if the slot is free */
+	ulong chunk;		/* chunk of the transfer sent by the command */
+	bool timed_out;		/* given up on, but may still complete */
+};
+
 /*
  * An NVM Express queue. Each device has at least two (one for admin
  * commands and one for I/O commands).
@@ -647,7 +668,26 @@ struct nvme_queue {
 	u16 qid;
 	u8 cq_phase;
 	u8 cqe_seen;
-	unsigned long cmdid_data[];
+	struct nvme_prp_list *prps;
+	u16 inflight;		/* I/O commands outstanding, of all transfers */
+	/* the transfer chunk owning each command id, indexed by command id */
+	struct nvme_cmd_slot slots[];
+};
+
+/*
+ * Progress of a read or write, which is split into chunks of at most the
+ * maximum transfer size, each sent as one command
+ */
+struct nvme_xfer {
+	lbaint_t blknr;
+	lbaint_t blkcnt;
+	void *buffer;
+	bool read;
+	ulong nchunks;
+	ulong next;		/* next chunk to send */
+	ulong failed;		/* lowest failed chunk, nchunks if none */
+	int inflight;		/* commands outstanding */
+	ulong last_us;		/* time of the last progress, for timeouts */
 };
 
 /*
@@ -662,6 +702,9 @@ struct nvme_ns {
 	int devnum;
 	int lba_shift;
 	u8 flbas;
+	/* asynchronous transfer in flight, if any, and its progress */
+	struct blk_request *async_req;
+	struct nvme_xfer async;
 };
 
 struct nvme_ops {
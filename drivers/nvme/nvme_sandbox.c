@@ -0,0 +1,442 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Emulated NVMe controller for sandbox
+ *
+ * This provides just enough of an NVMe controller to run the generic driver:
+ * the admin commands used during init and read/write on a single RAM-backed
+ * namespace. Commands are executed as soon as the submission queue doorbell is
+ * written, so completions are always ready by the time the driver polls.
+ */
+
+#include <dm.h>
+#include <log.h>
+#include <malloc.h>
+#include <asm/io.h>
+#include <asm/test.h>
+#include <linux/sizes.h>
+#include "nvme.h"
+
+#define SANDBOX_NVME_BLKSZ_SHIFT	9
+#define SANDBOX_NVME_BLOCKS		(SZ_8M >> SANDBOX_NVME_BLKSZ_SHIFT)
+#define SANDBOX_NVME_MQES		1023
+#define SANDBOX_NVME_MDTS		5	/* 128KB per command */
+#define SANDBOX_NVME_PAGE_SIZE		4096
+#define SANDBOX_NVME_DB_BASE		0x1000
+#define SANDBOX_NVME_REGS_SIZE		(SANDBOX_NVME_DB_BASE + \
+					 NVME_Q_NUM * 8)
+
+struct sandbox_nvme_sq {
+	struct nvme_command *cmds;
+	u16 size;
+	u16 head;
+	u16 tail;
+	u16 cqid;
+};
+
+struct sandbox_nvme_cq {
+	struct nvme_completion *cqes;
+	u16 size;
+	u16 head;
+	u16 tail;
+	u8 phase;
+};
+
+/**
+ * struct sandbox_nvme_priv - private data for the emulated controller
+ *
+ * @ndev: Generic NVMe device, must be first as the core uses dev_get_priv()
+ * @regs: Register window handed to the core as its BAR
+ * @data: Namespace contents
+ * @cc: Controller configuration register
+ * @csts: Controller status register
+ * @aqa: Admin queue attributes register
+ * @asq: Admin submission queue base
+ * @acq: Admin completion queue base
+ * @sq: Submission queues, indexed by queue ID
+ * @cq: Completion queues, indexed by queue ID
+ * @doorbells: Number of submission queue doorbell writes
+ * @commands: Number of commands executed
+ * @max_batch: Most commands made available by a single doorbell write
+ */
+struct sandbox_nvme_priv {
+	struct nvme_dev ndev;
+	void *regs;
+	u8 *data;
+	u32 cc;
+	u32 csts;
+	u32 aqa;
+	u64 asq;
+	u64 acq;
+	struct sandbox_nvme_sq sq[NVME_Q_NUM];
+	struct sandbox_nvme_cq cq[NVME_Q_NUM];
+	uint doorbells;
+	uint commands;
+	uint max_batch;
+};
+
+/* Copy between the namespace and a PRP-described host buffer */
+static int sandbox_nvme_xfer(struct nvme_rw_command *rw, u8 *data, bool read)
+{
+	ulong len = (le16_to_cpu(rw->length) + 1) << SANDBOX_NVME_BLKSZ_SHIFT;
+	u64 *list = NULL;
+	int idx = 0;
+	u64 prp;
+	ulong seg;
+
+	prp = le64_to_cpu(rw->prp1);
+	seg = SANDBOX_NVME_PAGE_SIZE - (prp & (SANDBOX_NVME_PAGE_SIZE - 1));
+	while (len) {
+		seg = min(seg, len);
+		if (read)
+			memcpy((void *)(uintptr_t)prp, data, seg);
+		else
+			memcpy(data, (void *)(uintptr_t)prp, seg);
+		data += seg;
+		len -= seg;
+		if (!len)
+			break;
+
+		seg = SANDBOX_NVME_PAGE_SIZE;
+		if (!list) {
+			prp = le64_to_cpu(rw->prp2);
+			if (len <= SANDBOX_NVME_PAGE_SIZE)
+				continue;
+			list = (u64 *)(uintptr_t)prp;
+		}
+		/* the last entry in a full list page points to the next one */
+		if (idx == SANDBOX_NVME_PAGE_SIZE / sizeof(u64) - 1) {
+			list = (u64 *)(uintptr_t)le64_to_cpu(list[idx]);
+			idx = 0;
+		}
+		prp = le64_to_cpu(list[idx++]);
+		if (!prp)
+			return NVME_SC_INVALID_FIELD;
+	}
+
+	return NVME_SC_SUCCESS;
+}
+
+static int sandbox_nvme_io(struct sandbox_nvme_priv *priv,
+			   struct nvme_command *cmd)
+{
+	struct nvme_rw_command *rw = &cmd->rw;
+	u64 slba = le64_to_cpu(rw->slba);
+	uint nlb = le16_to_cpu(rw->length) + 1;
+
+	switch (rw->opcode) {
+	case nvme_cmd_flush:
+		return NVME_SC_SUCCESS;
+	case nvme_cmd_read:
+	case nvme_cmd_write:
+		if (le32_to_cpu(rw->nsid) != 1)
+			return NVME_SC_INVALID_FIELD;
+		if (slba + nlb > SANDBOX_NVME_BLOCKS)
+			return NVME_SC_LBA_RANGE;
+		return sandbox_nvme_xfer(rw, priv->data +
+					 (slba << SANDBOX_NVME_BLKSZ_SHIFT),
+					 rw->opcode == nvme_cmd_read);
+	default:
+		return NVME_SC_INVALID_OPCODE;
+	}
+}
+
+static int sandbox_nvme_identify(struct sandbox_nvme_priv *priv,
+				 struct nvme_identify *cmd)
+{
+	void *buf = (void *)(uintptr_t)le64_to_cpu(cmd->prp1);
+	struct nvme_id_ctrl *ctrl = buf;
+	struct nvme_id_ns *ns = buf;
+
+	memset(buf, '\0', SANDBOX_NVME_PAGE_SIZE);
+	switch (le32_to_cpu(cmd->cns)) {
+	case 0:
+		if (le32_to_cpu(cmd->nsid) != 1)
+			break;
+		ns->nsze = cpu_to_le64(SANDBOX_NVME_BLOCKS);
+		ns->ncap = ns->nsze;
+		ns->nuse = ns->nsze;
+		ns->lbaf[0].ds = SANDBOX_NVME_BLKSZ_SHIFT;
+		break;
+	case 1:
+		ctrl->vid = cpu_to_le16(SANDBOX_PCI_VENDOR_ID);
+		memcpy(ctrl->sn, "SANDBOX0001", 11);
+		memcpy(ctrl->mn, "Sandbox NVMe", 12);
+		memcpy(ctrl->fr, "1.0", 3);
+		ctrl->mdts = SANDBOX_NVME_MDTS;
+		ctrl->nn = cpu_to_le32(1);
+		break;
+	default:
+		return NVME_SC_INVALID_FIELD;
+	}
+
+	return NVME_SC_SUCCESS;
+}
+
+static int sandbox_nvme_admin(struct sandbox_nvme_priv *priv,
+			      struct nvme_command *cmd, u32 *result)
+{
+	struct sandbox_nvme_sq *sq;
+	struct sandbox_nvme_cq *cq;
+	u16 qid;
+
+	switch (cmd->common.opcode) {
+	case nvme_admin_identify:
+		return sandbox_nvme_identify(priv, &cmd->identify);
+	case nvme_admin_set_features:
+		if (le32_to_cpu(cmd->features.fid) == NVME_FEAT_NUM_QUEUES)
+			*result = (NVME_Q_NUM - 2) | (NVME_Q_NUM - 2) << 16;
+		return NVME_SC_SUCCESS;
+	case nvme_admin_get_features:
+		return NVME_SC_SUCCESS;
+	case nvme_admin_create_cq:
+		qid = le16_to_cpu(cmd->create_cq.cqid);
+		if (!qid || qid >= NVME_Q_NUM)
+			return NVME_SC_INVALID_FIELD;
+		cq = &priv->cq[qid];
+		cq->cqes = (void *)(uintptr_t)le64_to_cpu(cmd->create_cq.prp1);
+		cq->size = le16_to_cpu(cmd->create_cq.qsize) + 1;
+		cq->head = 0;
+		cq->tail = 0;
+		cq->phase = 1;
+		return NVME_SC_SUCCESS;
+	case nvme_admin_create_sq:
+		qid = le16_to_cpu(cmd->create_sq.sqid);
+		if (!qid || qid >= NVME_Q_NUM ||
+		    !priv->cq[le16_to_cpu(cmd->create_sq.cqid)].cqes)
+			return NVME_SC_INVALID_FIELD;
+		sq = &priv->sq[qid];
+		sq->cmds = (void *)(uintptr_t)le64_to_cpu(cmd->create_sq.prp1);
+		sq->size = le16_to_cpu(cmd->create_sq.qsize) + 1;
+		sq->cqid = le16_to_cpu(cmd->create_sq.cqid);
+		sq->head = 0;
+		sq->tail = 0;
+		return NVME_SC_SUCCESS;
+	case nvme_admin_delete_sq:
+	case nvme_admin_delete_cq:
+		qid = le16_to_cpu(cmd->delete_queue.qid);
+		if (!qid || qid >= NVME_Q_NUM)
+			return NVME_SC_INVALID_FIELD;
+		if (cmd->common.opcode == nvme_admin_delete_sq)
+			memset(&priv->sq[qid], '\0', sizeof(priv->sq[qid]));
+		else
+			memset(&priv->cq[qid], '\0', sizeof(priv->cq[qid]));
+		return NVME_SC_SUCCESS;
+	default:
+		return NVME_SC_INVALID_OPCODE;
+	}
+}
+
+/* Execute commands on a submission queue while its completion queue has room */
+static void sandbox_nvme_run(struct sandbox_nvme_priv *priv, int qid)
+{
+	struct sandbox_nvme_sq *sq = &priv->sq[qid];
+	struct sandbox_nvme_cq *cq = &priv->cq[sq->cqid];
+
+	while (sq->cmds && sq->head != sq->tail &&
+	     (cq->tail + 1) % cq->size != cq->head) {
+		struct nvme_command *cmd = &sq->cmds[sq->head];
+		struct nvme_completion *cqe = &cq->cqes[cq->tail];
+		u32 result = 0;
+		int status;
+
+		if (qid)
+			status = sandbox_nvme_io(priv, cmd);
+		else
+			status = sandbox_nvme_admin(priv, cmd, &result);
+		priv->commands++;
+		sq->head = (sq->head + 1) % sq->size;
+
+		cqe->result = cpu_to_le32(result);
+		cqe->sq_head = cpu_to_le16(sq->head);
+		cqe->sq_id = cpu_to_le16(qid);
+		cqe->command_id = cmd->common.command_id;
+		cqe->status = cpu_to_le16(status << 1 | cq->phase);
+		if (++cq->tail == cq->size) {
+			cq->tail = 0;
+			cq->phase = !cq->phase;
+		}
+	}
+}
+
+static void sandbox_nvme_doorbell(struct sandbox_nvme_priv *priv, int db,
+				  uint val)
+{
+	int qid = db / 2;
+	struct sandbox_nvme_sq *sq = &priv->sq[qid];
+	uint pending;
+
+	if (qid >= NVME_Q_NUM)
+		return;
+
+	if (db & 1) {
+		/* completion queue head: may make room for more commands */
+		priv->cq[qid].head = val;
+		for (qid = 0; qid < NVME_Q_NUM; qid++)
+			sandbox_nvme_run(priv, qid);
+		return;
+	}
+
+	if (!sq->size)
+		return;
+	pending = (val + sq->size - sq->tail) % sq->size;
+	priv->doorbells++;
+	priv->max_batch = max(priv->max_batch, pending);
+	sq->tail = val;
+	sandbox_nvme_run(priv, qid);
+}
+
+static void sandbox_nvme_set_cc(struct sandbox_nvme_priv *priv, u32 val)
+{
+	struct sandbox_nvme_sq *asq = &priv->sq[NVME_ADMIN_Q];
+	struct sandbox_nvme_cq *acq = &priv->cq[NVME_ADMIN_Q];
+
+	if ((val & NVME_CC_SHN_MASK) != NVME_CC_SHN_NONE)
+		priv->csts |= NVME_CSTS_SHST_CMPLT;
+
+	if ((val & NVME_CC_ENABLE) && !(priv->cc & NVME_CC_ENABLE)) {
+		memset(priv->sq, '\0', sizeof(priv->sq));
+		memset(priv->cq, '\0', sizeof(priv->cq));
+		asq->cmds = (void *)(uintptr_t)priv->asq;
+		asq->size = (priv->aqa & 0xfff) + 1;
+		acq->cqes = (void *)(uintptr_t)priv->acq;
+		acq->size = ((priv->aqa >> 16) & 0xfff) + 1;
+		acq->phase = 1;
+		priv->csts = NVME_CSTS_RDY;
+	} else if (!(val & NVME_CC_ENABLE)) {
+		priv->csts &= ~NVME_CSTS_RDY;
+	}
+	priv->cc = val;
+}
+
+static ulong sandbox_nvme_read(void *ctx, ulong offset,
+			       enum sandboxio_size_t size)
+{
+	struct sandbox_nvme_priv *priv = ctx;
+	u64 cap;
+
+	cap = SANDBOX_NVME_MQES | (u64)1 << 24;
+	switch (offset) {
+	case offsetof(struct nvme_bar, cap):
+		return lower_32_bits(cap);
+	case offsetof(struct nvme_bar, cap) + 4:
+		return upper_32_bits(cap);
+	case offsetof(struct nvme_bar, vs):
+		return NVME_VS(1, 4);
+	case offsetof(struct nvme_bar, cc):
+		return priv->cc;
+	case offsetof(struct nvme_bar, csts):
+		return priv->csts;
+	case offsetof(struct nvme_bar, aqa):
+		return priv->aqa;
+	default:
+		return 0;
+	}
+}
+
+static void sandbox_nvme_write(void *ctx, ulong offset, uint val,
+			       enum sandboxio_size_t size)
+{
+	struct sandbox_nvme_priv *priv = ctx;
+
+	if (offset >= SANDBOX_NVME_DB_BASE) {
+		sandbox_nvme_doorbell(priv, (offset - SANDBOX_NVME_DB_BASE) / 4,
+				      val);
+		return;
+	}
+
+	switch (offset) {
+	case offsetof(struct nvme_bar, cc):
+		sandbox_nvme_set_cc(priv, val);
+		break;
+	case offsetof(struct nvme_bar, aqa):
+		priv->aqa = val;
+		break;
+	case offsetof(struct nvme_bar, asq):
+		priv->asq = (priv->asq & ~0xffffffffULL) | val;
+		break;
+	case offsetof(struct nvme_bar, asq) + 4:
+		priv->asq = lower_32_bits(priv->asq) | (u64)val << 32;
+		break;
+	case offsetof(struct nvme_bar, acq):
+		priv->acq = (priv->acq & ~0xffffffffULL) | val;
+		break;
+	case offsetof(struct nvme_bar, acq) + 4:
+		priv->acq = lower_32_bits(priv->acq) | (u64)val << 32;
+		break;
+	}
+}
+
+static const struct sandbox_mmio_ops sandbox_nvme_mmio_ops = {
+	.read	= sandbox_nvme_read,
+	.write	= sandbox_nvme_write,
+};
+
+int sandbox_nvme_get_stats(struct udevice *dev, uint *doorbellsp,
+			   uint *commandsp, uint *max_batchp)
+{
+	struct sandbox_nvme_priv *priv = dev_get_priv(dev);
+
+	*doorbellsp = priv->doorbells;
+	*commandsp = priv->commands;
+	*max_batchp = priv->max_batch;
+	priv->doorbells = 0;
+	priv->commands = 0;
+	priv->max_batch = 0;
+
+	return 0;
+}
+
+static int sandbox_nvme_probe(struct udevice *dev)
+{
+	struct sandbox_nvme_priv *priv = dev_get_priv(dev);
+	int ret;
+
+	priv->regs = calloc(1, SANDBOX_NVME_REGS_SIZE);
+	priv->data = calloc(SANDBOX_NVME_BLOCKS, 1 << SANDBOX_NVME_BLKSZ_SHIFT);
+	if (!priv->regs || !priv->data) {
+		ret = -ENOMEM;
+		goto err;
+	}
+
+	ret = sandbox_mmio_add(priv->regs, SANDBOX_NVME_REGS_SIZE,
+			       &sandbox_nvme_mmio_ops, priv);
+	if (ret)
+		goto err;
+
+	strcpy(priv->ndev.vendor, "sandbox");
+	priv->ndev.bar = priv->regs;
+
+	ret = nvme_init(dev);
+	if (ret) {
+		sandbox_mmio_remove(priv->regs);
+		goto err;
+	}
+
+	return 0;
+
+err:
+	free(priv->data);
+	free(priv->regs);
+
+	return log_msg_ret("nvme", ret);
+}
+
+static int sandbox_nvme_remove(struct udevice *dev)
+{
+	struct sandbox_nvme_priv *priv = dev_get_priv(dev);
+
+	nvme_shutdown(dev);
+	sandbox_mmio_remove(priv->regs);
+	free(priv->data);
+	free(priv->regs);
+
+	return 0;
+}
+
+U_BOOT_DRIVER(sandbox_nvme) = {
+	.name		= "sandbox_nvme",
+	.id		= UCLASS_NVME,
+	.probe		= sandbox_nvme_probe,
+	.remove		= sandbox_nvme_remove,
+	.priv_auto	= sizeof(struct sandbox_nvme_priv),
+};
@@ -8,17 +8,64 @@
 
 #include <blk.h>
 #include <dm.h>
+#include <malloc.h>
 #include <part.h>
 #include <virtio_types.h>
 #include <virtio.h>
 #include <virtio_ring.h>
+#include <linux/sizes.h>
 #include "virtio_blk.h"
 
+/* Largest transfer in one request, if the device sets no lower limit */
+#define VIRTIO_BLK_MAX_SECTORS	(SZ_1M / 512)
+
+/**
+ * struct virtio_blk_req - a request which may be on the virtqueue
+ *
+ * The header and status must stay put until the device has finished with the
+ * request, so each request in flight has one of these.
+ *
+ * @out_hdr: Request header, read by the device
+ * @wz: Range to zero, for VIRTIO_BLK_T_WRITE_ZEROES
+ * @status: Status, written by the device
+ * @owner: Transfer this request is part of, or NULL if not in use
+ */
+struct virtio_blk_req {
+	struct virtio_blk_outhdr out_hdr;
+	struct virtio_blk_discard_write_zeroes wz;
+	u8 status;
+	struct blk_request *owner;
+};
+
+/**
+ * struct virtio_blk_xfer - progress of a transfer
+ *
+ * Transfers are split into requests of up to max_sectors, which are queued
+ * together as far as the virtqueue allows.
+ *
+ * @type: Request type (VIRTIO_BLK_T_...)
+ * @queued: Number of blocks handed to the device so far
+ * @pending: Number of requests which the device has not completed yet
+ * @failed: true if a request failed
+ */
+struct virtio_blk_xfer {
+	u32 type;
+	lbaint_t queued;
+	uint pending;
+	bool failed;
+};
+
 struct virtio_blk_priv {
 	struct virtqueue *vq;
+	/* requests which can be on the virtqueue at once */
+	struct virtio_blk_req *reqs;
+	uint nreqs;
+	/* largest number of sectors in one request */
+	lbaint_t max_sectors;
 };
 
 static const u32 feature[] = {
+	VIRTIO_BLK_F_SIZE_MAX,
 	VIRTIO_BLK_F_WRITE_ZEROES
 };
 
@@ -59,57 +106,149 @@ static void virtio_blk_init_data_sg(void *buffer, lbaint_t blkcnt, struct virtio
 	sg->length = blkcnt * 512;
 }
 
-static ulong virtio_blk_do_req(struct udevice *dev, u64 sector,
-			       lbaint_t blkcnt, void *buffer, u32 type)
+static struct virtio_blk_req *virtio_blk_get_req(struct virtio_blk_priv *priv)
+{
+	uint i;
+
+	for (i = 0; i < priv->nreqs; i++) {
+		if (!priv->reqs[i].owner)
+			return &priv->reqs[i];
+	}
+
+	return NULL;
+}
+
+/*
+ * Queue as much of a transfer as there is room for, then notify the device
+ * once for the whole batch
+ */
+static void virtio_blk_queue(struct udevice *dev, struct blk_request *req)
 {
 	struct virtio_blk_priv *priv = dev_get_priv(dev);
-	struct virtio_blk_outhdr out_hdr;
-	struct virtio_blk_discard_write_zeroes wz_hdr;
-	unsigned int num_out = 0, num_in = 0;
-	struct virtio_sg hdr_sg, wz_sg, data_sg, status_sg;
-	struct virtio_sg *sgs[3];
-	u8 status;
+	struct virtio_blk_xfer *xfer = req->priv;
+	struct virtio_sg hdr_sg, data_sg, status_sg;
+	struct virtio_sg *sgs[] = { &hdr_sg, &data_sg, &status_sg };
+	struct virtio_blk_req *vbr;
+	uint queued = 0;
 	int ret;
 
-	virtio_blk_init_header_sg(dev, sector, type, &out_hdr, &hdr_sg);
-	sgs[num_out++] = &hdr_sg;
-
-	switch (type) {
-	case VIRTIO_BLK_T_IN:
-	case VIRTIO_BLK_T_OUT:
-		virtio_blk_init_data_sg(buffer, blkcnt, &data_sg);
-		if (type & VIRTIO_BLK_T_OUT)
-			sgs[num_out++] = &data_sg;
+	while (xfer->queued < req->blkcnt && !xfer->failed) {
+		u64 sector = req->start + xfer->queued;
+		lbaint_t blkcnt = req->blkcnt - xfer->queued;
+
+		vbr = virtio_blk_get_req(priv);
+		if (!vbr)
+			break;
+
+		virtio_blk_init_header_sg(dev, sector, xfer->type,
+					  &vbr->out_hdr, &hdr_sg);
+		if (xfer->type == VIRTIO_BLK_T_WRITE_ZEROES) {
+			virtio_blk_init_write_zeroes_sg(dev, sector, blkcnt,
+							&vbr->wz, &data_sg);
+		} else {
+			blkcnt = min(blkcnt, priv->max_sectors);
+			virtio_blk_init_data_sg(req->buffer + xfer->queued * 512,
+						blkcnt, &data_sg);
+		}
+		virtio_blk_init_status_sg(&vbr->status, &status_sg);
+
+		if (xfer->type == VIRTIO_BLK_T_IN)
+			ret = virtqueue_add(priv->vq, sgs, 1, 2);
 		else
-			sgs[num_out + num_in++] = &data_sg;
-		break;
+			ret = virtqueue_add(priv->vq, sgs, 2, 1);
+		if (ret == -ENOSPC)
+			break;
+		if (ret) {
+			xfer->failed = true;
+			break;
+		}
+		vbr->owner = req;
+		xfer->queued += blkcnt;
+		xfer->pending++;
+		queued++;
+	}
 
-	case VIRTIO_BLK_T_WRITE_ZEROES:
-		virtio_blk_init_write_zeroes_sg(dev, sector, blkcnt, &wz_hdr, &wz_sg);
-		sgs[num_out++] = &wz_sg;
-		break;
+	if (queued)
+		virtqueue_kick(priv->vq);
+}
 
-	default:
-		return -EINVAL;
+/* Collect completed requests, whichever transfer they belong to */
+static void virtio_blk_reap(struct virtio_blk_priv *priv)
+{
+	struct virtio_blk_outhdr *out_hdr;
+	struct virtio_blk_xfer *xfer;
+	struct virtio_blk_req *vbr;
+
+	while ((out_hdr = virtqueue_get_buf(priv->vq, NULL))) {
+		vbr = container_of(out_hdr, struct virtio_blk_req, out_hdr);
+		xfer = vbr->owner->priv;
+		if (vbr->status != VIRTIO_BLK_S_OK)
+			xfer->failed = true;
+		xfer->pending--;
+		vbr->owner = NULL;
 	}
+}
 
-	virtio_blk_init_status_sg(&status, &status_sg);
-	sgs[num_out + num_in++] = &status_sg;
-	log_debug("dev=%s, active=%d, priv=%p, priv->vq=%p\n", dev->name,
-		  device_active(dev), priv, priv->vq);
+/* Make progress on a transfer, returning true once it is complete */
+static bool virtio_blk_progress(struct udevice *dev, struct blk_request *req)
+{
+	struct virtio_blk_priv *priv = dev_get_priv(dev);
+	struct virtio_blk_xfer *xfer = req->priv;
 
-	ret = virtqueue_add(priv->vq, sgs, num_out, num_in);
-	if (ret)
-		return ret;
+	virtio_blk_reap(priv);
+	virtio_blk_queue(dev, req);
+
+	return !xfer->pending && (xfer->failed || xfer->queued == req->blkcnt);
+}
+
+static int virtio_blk_poll(struct udevice *dev, struct blk_request *req)
+{
+	struct virtio_blk_xfer *xfer = req->priv;
+
+	if (!virtio_blk_progress(dev, req))
+		return 0;
+
+	req->result = xfer->failed ? -EIO : req->blkcnt;
+	free(xfer);
+	req->priv = NULL;
+	req->done = true;
 
-	virtqueue_kick(priv->vq);
+	return 0;
+}
+
+static int virtio_blk_submit(struct udevice *dev, struct blk_request *req)
+{
+	struct virtio_blk_xfer *xfer;
+
+	xfer = calloc(1, sizeof(*xfer));
+	if (!xfer)
+		return -EBUSY;
+	xfer->type = req->write ? VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_IN;
+	req->priv = xfer;
+	virtio_blk_queue(dev, req);
+
+	return 0;
+}
 
-	log_debug("wait...");
-	while (!virtqueue_get_buf(priv->vq, NULL))
+static ulong virtio_blk_do_req(struct udevice *dev, u64 sector,
+			       lbaint_t blkcnt, void *buffer, u32 type)
+{
+	struct virtio_blk_xfer xfer = { .type = type };
+	struct blk_request req = {
+		.start	= sector,
+		.blkcnt	= blkcnt,
+		.buffer	= buffer,
+		.write	= type != VIRTIO_BLK_T_IN,
+		.priv	= &xfer,
+	};
+
+	log_debug("dev=%s, sector=%llx, blkcnt=%lx, type=%x\n", dev->name,
+		  sector, (ulong)blkcnt, type);
+	virtio_blk_queue(dev, &req);
+	while (!virtio_blk_progress(dev, &req))
 		;
-	log_debug("done\n");
 
-	return status == VIRTIO_BLK_S_OK ? blkcnt : -EIO;
+	return xfer.failed ? -EIO : blkcnt;
 }
 
 static ulong virtio_blk_read(struct udevice *dev, lbaint_t start,
@@ -175,6 +314,7 @@ static int virtio_blk_probe(struct udevice *dev)
 {
 	struct virtio_blk_priv *priv = dev_get_priv(dev);
 	struct blk_desc *desc = dev_get_uclass_plat(dev);
+	u32 size_max;
 	u64 cap;
 	int ret;
 
@@ -182,6 +322,24 @@ static int virtio_blk_probe(struct udevice *dev)
 	if (ret)
 		return ret;
 
+	/*
+	 * A request takes three descriptors, or one if they go in an indirect
+	 * table
+	 */
+	priv->nreqs = virtqueue_get_vring_size(priv->vq);
+	if (!virtio_has_feature(dev, VIRTIO_RING_F_INDIRECT_DESC))
+		priv->nreqs = max(priv->nreqs / 3, 1U);
+	priv->reqs = calloc(priv->nreqs, sizeof(*priv->reqs));
+	if (!priv->reqs)
+		return -ENOMEM;
+
+	priv->max_sectors = VIRTIO_BLK_MAX_SECTORS;
+	if (!virtio_cread_feature(dev, VIRTIO_BLK_F_SIZE_MAX,
+				  struct virtio_blk_config, size_max,
+				  &size_max) && size_max >= 512)
+		priv->max_sectors = min_t(lbaint_t, priv->max_sectors,
+					  size_max / 512);
+
 	desc->blksz = 512;
 	desc->log2blksz = 9;
 	virtio_cread(dev, struct virtio_blk_config, capacity, &cap);
@@ -190,10 +348,24 @@ static int virtio_blk_probe(struct udevice *dev)
 	return 0;
 }
 
+static int virtio_blk_remove(struct udevice *dev)
+{
+	struct virtio_blk_priv *priv = dev_get_priv(dev);
+	int ret;
+
+	ret = virtio_reset(dev);
+	free(priv->reqs);
+	priv->reqs = NULL;
+
+	return ret;
+}
+
 static const struct blk_ops virtio_blk_ops = {
 	.read	= virtio_blk_read,
 	.write	= virtio_blk_write,
 	.erase	= virtio_blk_erase,
+	.submit	= virtio_blk_submit,
+	.poll	= virtio_blk_poll,
 };
 
 U_BOOT_DRIVER(virtio_blk) = {
@@ -202,7 +374,7 @@ U_BOOT_DRIVER(virtio_blk) = {
 	.ops	= &virtio_blk_ops,
 	.bind	= virtio_blk_bind,
 	.probe	= virtio_blk_probe,
-	.remove	= virtio_reset,
+	.remove	= virtio_blk_remove,
 	.priv_auto	= sizeof(struct virtio_blk_priv),
 	.flags	= DM_FLAG_ACTIVE_DMA,
 };
@@ -5,15 +5,13 @@
  */
 
 #include <dm.h>
+#include <malloc.h>
 #include <net.h>
 #include <virtio_types.h>
 #include <virtio.h>
 #include <virtio_ring.h>
 #include "virtio_net.h"
 
-/* Amount of buffers to keep in the RX virtqueue */
-#define VIRTIO_NET_NUM_RX_BUFS	32
-
 /*
  * This value comes from the VirtIO spec: 1500 for maximum packet size,
  * 14 for the Ethernet header, 12 for virtio_net_hdr. In total 1526 bytes.
@@ -29,40 +27,59 @@ struct virtio_net_priv {
 		};
 	};
 
-	char rx_buff[VIRTIO_NET_NUM_RX_BUFS][VIRTIO_NET_RX_BUF_SIZE];
+	/* receive buffers, VIRTIO_NET_RX_BUF_SIZE bytes each */
+	char *rx_buff;
+	uint num_rx_bufs;
+	/* a packet spread over several buffers is put back together here */
+	char *rx_merge;
 	bool rx_running;
 	int net_hdr_len;
 };
 
 /*
- * For simplicity, the driver only negotiates the VIRTIO_NET_F_MAC feature.
+ * Checksums of received packets are checked by the device, where it can, and
+ * large packets may be spread over several receive buffers. Transmit
+ * checksums are left to the network stack, since U-Boot sends little. lwIP
+ * checks every received checksum itself, so would drop packets whose
+ * checksum the host left to be filled in; it gets full checksums instead.
+ *
  * For the VIRTIO_NET_F_STATUS feature, we don't negotiate it, hence per spec
  * we should assume the link is always active.
  */
 static const u32 feature[] = {
-	VIRTIO_NET_F_MAC
+#ifndef CONFIG_NET_LWIP
+	VIRTIO_NET_F_GUEST_CSUM,
+#endif
+	VIRTIO_NET_F_MAC,
+	VIRTIO_NET_F_MRG_RXBUF
 };
 
 static const u32 feature_legacy[] = {
-	VIRTIO_NET_F_MAC
+#ifndef CONFIG_NET_LWIP
+	VIRTIO_NET_F_GUEST_CSUM,
+#endif
+	VIRTIO_NET_F_MAC,
+	VIRTIO_NET_F_MRG_RXBUF
 };
 
+static void virtio_net_add_rx_buf(struct virtio_net_priv *priv, void *buf)
+{
+	struct virtio_sg sg = { buf, VIRTIO_NET_RX_BUF_SIZE };
+	struct virtio_sg *sgs[] = { &sg };
+
+	virtqueue_add(priv->rx_vq, sgs, 0, 1);
+}
+
 static int virtio_net_start(struct udevice *dev)
 {
 	struct virtio_net_priv *priv = dev_get_priv(dev);
-	struct virtio_sg sg;
-	struct virtio_sg *sgs[] = { &sg };
 	int i;
 
 	if (!priv->rx_running) {
-		/* receive buffer length is always 1526 */
-		sg.length = VIRTIO_NET_RX_BUF_SIZE;
-
-		/* setup the receive buffer address */
-		for (i = 0; i < VIRTIO_NET_NUM_RX_BUFS; i++) {
-			sg.addr = priv->rx_buff[i];
-			virtqueue_add(priv->rx_vq, sgs, 0, 1);
-		}
+		/* fill the receive queue, so the device can run ahead of us */
+		for (i = 0; i < priv->num_rx_bufs; i++)
+			virtio_net_add_rx_buf(priv, priv->rx_buff +
+					      i * VIRTIO_NET_RX_BUF_SIZE);
 
 		virtqueue_kick(priv->rx_vq);
 
@@ -105,16 +122,65 @@ static int virtio_net_send(struct udevice *dev, void *packet, int length)
 	return 0;
 }
 
+/*
+ * Copy a packet which the device spread over several buffers into one place,
+ * putting the buffers back in the rx ring. This returns the packet length or
+ * -ve on error.
+ */
+static int virtio_net_merge(struct virtio_net_priv *priv, void *buf,
+			    unsigned int size, uint num_buffers)
+{
+	int len = size - priv->net_hdr_len;
+	void *next;
+
+	memcpy(priv->rx_merge, buf + priv->net_hdr_len, len);
+	virtio_net_add_rx_buf(priv, buf);
+	while (--num_buffers) {
+		next = virtqueue_get_buf(priv->rx_vq, &size);
+		if (!next)
+			return -EIO;
+		if (len + size <= PKTSIZE_ALIGN)
+			memcpy(priv->rx_merge + len, next, size);
+		len += size;
+		virtio_net_add_rx_buf(priv, next);
+	}
+	virtqueue_kick(priv->rx_vq);
+
+	return len <= PKTSIZE_ALIGN ? len : -E2BIG;
+}
+
 static int virtio_net_recv(struct udevice *dev, int flags, uchar **packetp)
 {
 	struct virtio_net_priv *priv = dev_get_priv(dev);
+	struct virtio_net_hdr_v1 *hdr;
 	unsigned int len;
+	uint num_buffers;
 	void *buf;
+	int ret;
 
 	buf = virtqueue_get_buf(priv->rx_vq, &len);
 	if (!buf)
 		return -EAGAIN;
 
+	/*
+	 * A packet whose checksum is still to be filled in came from this
+	 * host, so need not be checked either
+	 */
+	hdr = buf;
+	net_rx_csum_valid = hdr->flags & (VIRTIO_NET_HDR_F_DATA_VALID |
+					  VIRTIO_NET_HDR_F_NEEDS_CSUM);
+
+	num_buffers = 1;
+	if (virtio_has_feature(dev, VIRTIO_NET_F_MRG_RXBUF))
+		num_buffers = virtio16_to_cpu(dev, hdr->num_buffers);
+	if (num_buffers > 1) {
+		ret = virtio_net_merge(priv, buf, len, num_buffers);
+		if (ret < 0)
+			return ret;
+		*packetp = priv->rx_merge;
+		return ret;
+	}
+
 	*packetp = buf + priv->net_hdr_len;
 	return len - priv->net_hdr_len;
 }
@@ -122,12 +188,17 @@ static int virtio_net_recv(struct udevice *dev, int flags, uchar **packetp)
 static int virtio_net_free_pkt(struct udevice *dev, uchar *packet, int length)
 {
 	struct virtio_net_priv *priv = dev_get_priv(dev);
-	void *buf = packet - priv->net_hdr_len;
-	struct virtio_sg sg = { buf, VIRTIO_NET_RX_BUF_SIZE };
-	struct virtio_sg *sgs[] = { &sg };
 
-	/* Put the buffer back to the rx ring */
-	virtqueue_add(priv->rx_vq, sgs, 0, 1);
+	/* a merged packet's buffers went back to the rx ring already */
+	if (packet == (uchar *)priv->rx_merge)
+		return 0;
+
+	/*
+	 * Put the buffer back to the rx ring; the device is only notified if
+	 * it has run out and asked to be
+	 */
+	virtio_net_add_rx_buf(priv, packet - priv->net_hdr_len);
+	virtqueue_kick(priv->rx_vq);
 
 	return 0;
 }
@@ -207,14 +278,37 @@ static int virtio_net_probe(struct udevice *dev)
 	 * VIRTIO_NET_F_MRG_RXBUF was negotiated. Without that feature
 	 * the structure was 2 bytes shorter.
 	 */
-	if (uc_priv->legacy)
+	if (uc_priv->legacy && !virtio_has_feature(dev, VIRTIO_NET_F_MRG_RXBUF))
 		priv->net_hdr_len = sizeof(struct virtio_net_hdr);
 	else
 		priv->net_hdr_len = sizeof(struct virtio_net_hdr_v1);
 
+	/* keep as many receive buffers posted as the queue holds */
+	priv->num_rx_bufs = min_t(uint, virtqueue_get_vring_size(priv->rx_vq),
+				  CONFIG_VIRTIO_NET_RX_BUFS);
+	priv->rx_buff = malloc(priv->num_rx_bufs * VIRTIO_NET_RX_BUF_SIZE);
+	priv->rx_merge = malloc(PKTSIZE_ALIGN);
+	if (!priv->rx_buff || !priv->rx_merge) {
+		free(priv->rx_buff);
+		free(priv->rx_merge);
+		return -ENOMEM;
+	}
+
 	return 0;
 }
 
+static int virtio_net_remove(struct udevice *dev)
+{
+	struct virtio_net_priv *priv = dev_get_priv(dev);
+	int ret;
+
+	ret = virtio_reset(dev);
+	free(priv->rx_buff);
+	free(priv->rx_merge);
+
+	return ret;
+}
+
 static const struct eth_ops virtio_net_ops = {
 	.start = virtio_net_start,
 	.send = virtio_net_send,
@@ -230,7 +324,7 @@ U_BOOT_DRIVER(virtio_net) = {
 	.id	= UCLASS_ETH,
 	.bind	= virtio_net_bind,
 	.probe	= virtio_net_probe,
-	.remove = virtio_reset,
+	.remove = virtio_net_remove,
 	.ops	= &virtio_net_ops,
 	.priv_auto	= sizeof(struct virtio_net_priv),
 	.plat_auto	= sizeof(struct eth_pdata),
@@ -6,13 +6,30 @@
  */
 
 #include <dm.h>
+#include <malloc.h>
 #include <virtio_types.h>
 #include <virtio.h>
 #include <virtio_ring.h>
+#include <asm/test.h>
 #include <linux/bug.h>
 #include <linux/compat.h>
 #include <linux/err.h>
 #include <linux/io.h>
+#include <linux/sizes.h>
+#include "virtio_blk.h"
+#include "virtio_net.h"
+
+/* The block device is backed by a RAM disk of this many sectors */
+#define SANDBOX_BLK_SECTORS	(SZ_4M / 512)
+#define SANDBOX_BLK_SIZE_MAX	SZ_64K
+#define SANDBOX_QUEUE_SIZE	16
+
+/* Queues of the network device */
+#define SANDBOX_NET_RX_QUEUE	0
+#define SANDBOX_NET_TX_QUEUE	1
+
+/* Most buffers in a request: header, data and status */
+#define SANDBOX_MAX_SGS		8
 
 struct virtio_sandbox_priv {
 	u8 id;
@@ -22,11 +39,44 @@ struct virtio_sandbox_priv {
 	ulong queue_desc;
 	ulong queue_available;
 	ulong queue_used;
+	u8 *disk;
+	u16 last_avail_idx;
+	u16 rx_avail_idx;
+	uint notifies;
+	uint requests;
+	uint max_batch;
+};
+
+struct sandbox_sg {
+	void *addr;
+	u32 len;
 };
 
 static int virtio_sandbox_get_config(struct udevice *udev, unsigned int offset,
 				     void *buf, unsigned int len)
 {
+	struct virtio_sandbox_priv *priv = dev_get_priv(udev);
+	struct virtio_dev_priv *uc_priv = dev_get_uclass_priv(udev);
+	struct virtio_blk_config config = {
+		.capacity = cpu_to_le64(SANDBOX_BLK_SECTORS),
+		.size_max = cpu_to_le32(SANDBOX_BLK_SIZE_MAX),
+	};
+	struct virtio_net_config net_config = {
+		.mac = { 0x52, 0x54, 0x00, 0x12, 0x34, 0x56 },
+	};
+	void *cfg = &config;
+	uint size = sizeof(config);
+
+	if (uc_priv->device == VIRTIO_ID_NET) {
+		cfg = &net_config;
+		size = sizeof(net_config);
+	} else if (!priv->disk) {
+		return 0;
+	}
+	if (offset + len > size)
+		return -EINVAL;
+	memcpy(buf, cfg + offset, len);
+
 	return 0;
 }
 
@@ -95,7 +145,7 @@ static struct virtqueue *virtio_sandbox_setup_vq(struct udevice *udev,
 	int err;
 
 	/* Create the vring */
-	vq = vring_create_virtqueue(index, 4, 4096, udev);
+	vq = vring_create_virtqueue(index, SANDBOX_QUEUE_SIZE, 4096, udev);
 	if (!vq) {
 		err = -ENOMEM;
 		goto error_new_virtqueue;
@@ -109,6 +159,8 @@ static struct virtqueue *virtio_sandbox_setup_vq(struct udevice *udev,
 
 	addr = virtqueue_get_used_addr(vq);
 	priv->queue_used = addr;
+	priv->last_avail_idx = 0;
+	priv->rx_avail_idx = 0;
 
 	return vq;
 
@@ -148,11 +200,240 @@ static int virtio_sandbox_find_vqs(struct udevice *udev, unsigned int nvqs,
 	return 0;
 }
 
+/* Get the buffers of a descriptor chain, following any indirect table */
+static int sandbox_get_chain(struct udevice *vdev, struct vring *vring,
+			     uint head, struct sandbox_sg sg[])
+{
+	struct vring_desc *desc = vring->desc;
+	uint i = head, n = 0;
+	u16 flags;
+
+	if (virtio16_to_cpu(vdev, desc[i].flags) & VRING_DESC_F_INDIRECT) {
+		desc = (void *)(uintptr_t)virtio64_to_cpu(vdev, desc[i].addr);
+		i = 0;
+	}
+	do {
+		if (n == SANDBOX_MAX_SGS)
+			return -E2BIG;
+		flags = virtio16_to_cpu(vdev, desc[i].flags);
+		sg[n].addr = (void *)(uintptr_t)virtio64_to_cpu(vdev,
+								desc[i].addr);
+		sg[n].len = virtio32_to_cpu(vdev, desc[i].len);
+		n++;
+		i = virtio16_to_cpu(vdev, desc[i].next);
+	} while (flags & VRING_DESC_F_NEXT);
+
+	return n;
+}
+
+/* Carry out a block request, returning the number of bytes written to it */
+static u32 sandbox_blk_request(struct virtio_sandbox_priv *priv,
+			       struct udevice *vdev, struct sandbox_sg sg[],
+			       int count)
+{
+	struct virtio_blk_outhdr *hdr = sg[0].addr;
+	struct virtio_blk_discard_write_zeroes *wz;
+	u8 *status = sg[count - 1].addr;
+	u64 pos = virtio64_to_cpu(vdev, hdr->sector) * 512;
+	u32 written = 0;
+	int i;
+
+	*status = VIRTIO_BLK_S_OK;
+	switch (virtio32_to_cpu(vdev, hdr->type)) {
+	case VIRTIO_BLK_T_IN:
+	case VIRTIO_BLK_T_OUT:
+		for (i = 1; i < count - 1; i++) {
+			if (pos + sg[i].len > SANDBOX_BLK_SECTORS * 512) {
+				*status = VIRTIO_BLK_S_IOERR;
+				break;
+			}
+			if (virtio32_to_cpu(vdev, hdr->type) == VIRTIO_BLK_T_IN) {
+				memcpy(sg[i].addr, priv->disk + pos, sg[i].len);
+				written += sg[i].len;
+			} else {
+				memcpy(priv->disk + pos, sg[i].addr, sg[i].len);
+			}
+			pos += sg[i].len;
+		}
+		break;
+	case VIRTIO_BLK_T_WRITE_ZEROES:
+		wz = sg[1].addr;
+		pos = virtio64_to_cpu(vdev, wz->sector) * 512;
+		if (pos + virtio32_to_cpu(vdev, wz->num_sectors) * 512ULL >
+		    SANDBOX_BLK_SECTORS * 512) {
+			*status = VIRTIO_BLK_S_IOERR;
+			break;
+		}
+		memset(priv->disk + pos, '\0',
+		       virtio32_to_cpu(vdev, wz->num_sectors) * 512);
+		break;
+	default:
+		*status = VIRTIO_BLK_S_UNSUPP;
+	}
+
+	return written + 1;
+}
+
+/* Act as the device: complete everything in the available ring */
+static void sandbox_blk_process(struct virtio_sandbox_priv *priv,
+				struct virtqueue *vq)
+{
+	struct udevice *vdev = vq->vdev;
+	struct vring *vring = &vq->vring;
+	struct sandbox_sg sg[SANDBOX_MAX_SGS];
+	u16 avail_idx, used_idx;
+	uint head, batch = 0;
+	u32 len;
+	int count;
+
+	avail_idx = virtio16_to_cpu(vdev, vring->avail->idx);
+	used_idx = virtio16_to_cpu(vdev, vring->used->idx);
+	while (priv->last_avail_idx != avail_idx) {
+		head = virtio16_to_cpu(vdev, vring->avail->ring[
+				priv->last_avail_idx & (vring->num - 1)]);
+		count = sandbox_get_chain(vdev, vring, head, sg);
+		len = count >= 2 ? sandbox_blk_request(priv, vdev, sg, count) :
+			0;
+		vring->used->ring[used_idx & (vring->num - 1)].id =
+			cpu_to_virtio32(vdev, head);
+		vring->used->ring[used_idx & (vring->num - 1)].len =
+			cpu_to_virtio32(vdev, len);
+		used_idx++;
+		priv->last_avail_idx++;
+		batch++;
+	}
+	vring->used->idx = cpu_to_virtio16(vdev, used_idx);
+
+	/* ask to be notified when the driver adds the next request */
+	if (priv->driver_features & BIT_ULL(VIRTIO_RING_F_EVENT_IDX))
+		vring_avail_event(vring) = cpu_to_virtio16(vdev,
+							   priv->last_avail_idx);
+
+	priv->requests += batch;
+	priv->max_batch = max(priv->max_batch, batch);
+}
+
+/* Act as the network device: send everything in the transmit queue */
+static void sandbox_net_tx(struct virtio_sandbox_priv *priv,
+			   struct virtqueue *vq)
+{
+	struct udevice *vdev = vq->vdev;
+	struct vring *vring = &vq->vring;
+	u16 avail_idx, used_idx;
+	uint head;
+
+	avail_idx = virtio16_to_cpu(vdev, vring->avail->idx);
+	used_idx = virtio16_to_cpu(vdev, vring->used->idx);
+	while (priv->last_avail_idx != avail_idx) {
+		head = virtio16_to_cpu(vdev, vring->avail->ring[
+				priv->last_avail_idx & (vring->num - 1)]);
+		vring->used->ring[used_idx & (vring->num - 1)].id =
+			cpu_to_virtio32(vdev, head);
+		vring->used->ring[used_idx & (vring->num - 1)].len = 0;
+		used_idx++;
+		priv->last_avail_idx++;
+	}
+	vring->used->idx = cpu_to_virtio16(vdev, used_idx);
+}
+
 static int virtio_sandbox_notify(struct udevice *udev, struct virtqueue *vq)
 {
+	struct virtio_sandbox_priv *priv = dev_get_priv(udev);
+	struct virtio_dev_priv *uc_priv = dev_get_uclass_priv(udev);
+
+	priv->notifies++;
+	if (priv->disk)
+		sandbox_blk_process(priv, vq);
+	else if (uc_priv->device == VIRTIO_ID_NET &&
+		 vq->index == SANDBOX_NET_TX_QUEUE)
+		sandbox_net_tx(priv, vq);
+
+	return 0;
+}
+
+int sandbox_virtio_net_rx(struct udevice *dev, const void *pkt, int len,
+			  u8 flags, uint nbufs)
+{
+	struct virtio_sandbox_priv *priv = dev_get_priv(dev);
+	struct virtio_dev_priv *uc_priv = dev_get_uclass_priv(dev);
+	struct sandbox_sg sg[SANDBOX_MAX_SGS];
+	struct virtio_net_hdr_v1 *hdr;
+	struct virtqueue *vq = NULL, *q;
+	struct udevice *vdev;
+	struct vring *vring;
+	u16 avail_idx, used_idx;
+	uint head, hdr_len, size, chunk, done = 0;
+	uint i;
+
+	list_for_each_entry(q, &uc_priv->vqs, list) {
+		if (q->index == SANDBOX_NET_RX_QUEUE)
+			vq = q;
+	}
+	if (!vq)
+		return -ENODEV;
+	vdev = vq->vdev;
+	vring = &vq->vring;
+
+	avail_idx = virtio16_to_cpu(vdev, vring->avail->idx);
+	if ((u16)(avail_idx - priv->rx_avail_idx) < nbufs)
+		return -ENOSPC;
+
+	/* spread the packet evenly, with the header in the first buffer */
+	chunk = DIV_ROUND_UP(len, nbufs);
+	used_idx = virtio16_to_cpu(vdev, vring->used->idx);
+	for (i = 0; i < nbufs; i++) {
+		head = virtio16_to_cpu(vdev, vring->avail->ring[
+				priv->rx_avail_idx & (vring->num - 1)]);
+		if (sandbox_get_chain(vdev, vring, head, sg) != 1)
+			return -EINVAL;
+		hdr_len = 0;
+		if (!i) {
+			hdr = sg[0].addr;
+			hdr_len = sizeof(*hdr);
+			memset(hdr, '\0', hdr_len);
+			hdr->flags = flags;
+			hdr->num_buffers = cpu_to_virtio16(vdev, nbufs);
+		}
+		size = min_t(uint, chunk, len - done);
+		if (hdr_len + size > sg[0].len)
+			return -E2BIG;
+		memcpy(sg[0].addr + hdr_len, pkt + done, size);
+		done += size;
+
+		vring->used->ring[used_idx & (vring->num - 1)].id =
+			cpu_to_virtio32(vdev, head);
+		vring->used->ring[used_idx & (vring->num - 1)].len =
+			cpu_to_virtio32(vdev, hdr_len + size);
+		used_idx++;
+		priv->rx_avail_idx++;
+	}
+	vring->used->idx = cpu_to_virtio16(vdev, used_idx);
+
+	return 0;
+}
+
+int sandbox_virtio_get_stats(struct udevice *dev, uint *notifiesp,
+			     uint *requestsp, uint *max_batchp)
+{
+	struct virtio_sandbox_priv *priv = dev_get_priv(dev);
+
+	*notifiesp = priv->notifies;
+	*requestsp = priv->requests;
+	*max_batchp = priv->max_batch;
+	priv->notifies = 0;
+	priv->requests = 0;
+	priv->max_batch = 0;
+
 	return 0;
 }
 
+void sandbox_virtio_set_features(struct udevice *dev, u64 features)
+{
+	struct virtio_sandbox_priv *priv = dev_get_priv(dev);
+
+	priv->device_features = features;
+}
+
 static int virtio_sandbox_probe(struct udevice *udev)
 {
 	struct virtio_sandbox_priv *priv = dev_get_priv(udev);
@@ -164,6 +445,33 @@ static int virtio_sandbox_probe(struct udevice *udev)
 					       VIRTIO_ID_RNG);
 	uc_priv->vendor = ('u' << 24) | ('b' << 16) | ('o' << 8) | 't';
 
+	/* a block device gets a RAM disk, so that requests can be tested */
+	if (uc_priv->device == VIRTIO_ID_BLOCK) {
+		priv->disk = calloc(SANDBOX_BLK_SECTORS, 512);
+		if (!priv->disk)
+			return -ENOMEM;
+		priv->device_features |= BIT_ULL(VIRTIO_BLK_F_SIZE_MAX) |
+			BIT_ULL(VIRTIO_BLK_F_WRITE_ZEROES) |
+			BIT_ULL(VIRTIO_RING_F_INDIRECT_DESC) |
+			BIT_ULL(VIRTIO_RING_F_EVENT_IDX);
+	}
+
+	/* a network device receives whatever the test gives it */
+	if (uc_priv->device == VIRTIO_ID_NET)
+		priv->device_features |= BIT_ULL(VIRTIO_NET_F_MAC) |
+			BIT_ULL(VIRTIO_NET_F_GUEST_CSUM) |
+			BIT_ULL(VIRTIO_NET_F_MRG_RXBUF);
+
+	return 0;
+}
+
+static int virtio_sandbox_remove(struct udevice *udev)
+{
+	struct virtio_sandbox_priv *priv = dev_get_priv(udev);
+
+	free(priv->disk);
+	priv->disk = NULL;
+
 	return 0;
 }
 
@@ -191,6 +499,7 @@ U_BOOT_DRIVER(virtio_sandbox1) = {
 	.of_match = virtio_sandbox1_ids,
 	.ops	= &virtio_sandbox1_ops,
 	.probe	= virtio_sandbox_probe,
+	.remove	= virtio_sandbox_remove,
 	.priv_auto	= sizeof(struct virtio_sandbox_priv),
 };
 
@@ -218,5 +527,6 @@ U_BOOT_DRIVER(virtio_sandbox2) = {
 	.of_match = virtio_sandbox2_ids,
 	.ops	= &virtio_sandbox2_ops,
 	.probe	= virtio_sandbox_probe,
+	.remove	= virtio_sandbox_remove,
 	.priv_auto	= sizeof(struct virtio_sandbox_priv),
 };
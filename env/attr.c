@@ -31,6 +31,7 @@ int env_attr_walk(const char *attr_list,
 {
 	const char *entry, *entry_end;
 	char *name, *attributes;
+	char buf[64];
 
 	if (!attr_list)
 		/* list not found */
@@ -39,42 +40,30 @@ int env_attr_walk(const char *attr_list,
 	entry = attr_list;
 	do {
 		char *entry_cpy = NULL;
+		int entry_len;
 
 		entry_end = strchr(entry, ENV_ATTR_LIST_DELIM);
 		/* check if this is the last entry in the list */
-		if (entry_end == NULL) {
-			int entry_len = strlen(entry);
-
-			if (entry_len) {
-				/*
-				 * allocate memory to copy the entry into since
-				 * we will need to inject '\0' chars and squash
-				 * white-space before calling the callback
-				 */
-				entry_cpy = malloc(entry_len + 1);
-				if (entry_cpy)
-					/* copy the rest of the list */
-					strcpy(entry_cpy, entry);
-				else
-					return -ENOMEM;
-			}
-		} else {
-			int entry_len = entry_end - entry;
-
-			if (entry_len) {
-				/*
-				 * allocate memory to copy the entry into since
-				 * we will need to inject '\0' chars and squash
-				 * white-space before calling the callback
-				 */
+		if (entry_end == NULL)
+			entry_len = strlen(entry);
+		else
+			entry_len = entry_end - entry;
+
+		if (entry_len) {
+			/*
+			 * copy the entry since we will need to inject '\0'
+			 * chars and squash white-space before calling the
+			 * callback; this is done for every variable, only
+			 * allocate memory for long entries
+			 */
+			if (entry_len < sizeof(buf))
+				entry_cpy = buf;
+			else
 				entry_cpy = malloc(entry_len + 1);
-				if (entry_cpy) {
-					/* copy just this entry and null term */
-					strncpy(entry_cpy, entry, entry_len);
-					entry_cpy[entry_len] = '\0';
-				} else
-					return -ENOMEM;
-			}
+			if (!entry_cpy)
+				return -ENOMEM;
+			memcpy(entry_cpy, entry, entry_len);
+			entry_cpy[entry_len] = '\0';
 		}
 
 		/* check if there is anything to process (e.g. not ",,,") */
@@ -96,13 +85,15 @@ int env_attr_walk(const char *attr_list,
 
 				retval = callback(name, attributes, priv);
 				if (retval) {
-					free(entry_cpy);
+					if (entry_cpy != buf)
+						free(entry_cpy);
 					return retval;
 				}
 			}
 		}
 
-		free(entry_cpy);
+		if (entry_cpy != buf)
+			free(entry_cpy);
 		entry = entry_end + 1;
 	} while (entry_end != NULL);
 
@@ -116,6 +107,30 @@ struct regex_callback_priv {
 	char *attributes;
 };
 
+/*
+ * Check whether @str may match the regex @name, from the plain characters
+ * the regex starts with. Compiling every regex of the list for every
+ * variable is what makes importing a large environment slow.
+ */
+static int regex_may_match(const char *name, const char *str)
+{
+	size_t len;
+
+	/* the prefix is only known without alternatives */
+	if (strchr(name, '|'))
+		return 1;
+
+	len = strcspn(name, "^$().[]*+?{}\\");
+	if (!name[len])
+		return !strcmp(name, str);
+
+	/* a quantifier makes the last plain character optional */
+	if (len && strchr("*?{", name[len]))
+		len--;
+
+	return !strncmp(name, str, len);
+}
+
 static int regex_callback(const char *name, const char *attributes, void *priv)
 {
 	int retval = 0;
@@ -123,6 +138,9 @@ static int regex_callback(const char *name, const char *attributes, void *priv)
 	struct slre slre;
 	char regex[strlen(name) + 3];
 
+	if (!regex_may_match(name, cbp->searched_for))
+		return 0;
+
 	/* Require the whole string to be described by the regex */
 	sprintf(regex, "^%s$", name);
 	if (slre_compile(&slre, regex)) {
@@ -1642,6 +1642,73 @@ int ext4fs_read_inode(struct ext2_data *data, int ino, struct ext2_inode *inode)
 	return 1;
 }
 
+long int read_allocated_extent(struct ext2_inode *inode, int fileblock,
+			       struct ext_block_cache *cache, uint32_t *countp)
+{
+	struct ext_block_cache *c, cd;
+	struct ext4_extent_header *ext_block;
+	struct ext4_extent *extent;
+	long int startblock, endblock;
+	unsigned long long start;
+	int log2_blksz;
+	long int ret = 0;
+	int i;
+
+	log2_blksz = LOG2_BLOCK_SIZE(ext4fs_root)
+		- get_fs()->dev_desc->log2blksz;
+
+	if (cache) {
+		c = cache;
+	} else {
+		c = &cd;
+		ext_cache_init(c);
+	}
+	ext_block =
+		ext4fs_get_extent_block(ext4fs_root, c,
+					(struct ext4_extent_header *)
+					inode->b.blocks.dir_blocks,
+					fileblock, log2_blksz);
+	if (!ext_block) {
+		printf("invalid extent block\n");
+		ret = -EINVAL;
+		goto out;
+	}
+
+	/*
+	 * A hole after the last extent in the inode itself runs to the end of
+	 * the file; one in a leaf block may end in the next leaf.
+	 */
+	if ((void *)ext_block == inode->b.blocks.dir_blocks)
+		*countp = INT_MAX - fileblock;
+	else
+		*countp = 1;
+
+	extent = (struct ext4_extent *)(ext_block + 1);
+
+	for (i = 0; i < le16_to_cpu(ext_block->eh_entries); i++) {
+		startblock = le32_to_cpu(extent[i].ee_block);
+		endblock = startblock + le16_to_cpu(extent[i].ee_len);
+
+		if (startblock > fileblock) {
+			/* Sparse file */
+			*countp = startblock - fileblock;
+			break;
+		} else if (fileblock < endblock) {
+			start = le16_to_cpu(extent[i].ee_start_hi);
+			start = (start << 32) +
+				le32_to_cpu(extent[i].ee_start_lo);
+			*countp = endblock - fileblock;
+			ret = (fileblock - startblock) + start;
+			break;
+		}
+	}
+
+out:
+	if (!cache)
+		ext_cache_fini(c);
+	return ret;
+}
+
 long int read_allocated_block(struct ext2_inode *inode, int fileblock,
 			      struct ext_block_cache *cache)
 {
@@ -1652,62 +1719,15 @@ long int read_allocated_block(struct ext2_inode *inode, int fileblock,
 	long int rblock;
 	long int perblock_parent;
 	long int perblock_child;
-	unsigned long long start;
 	/* get the blocksize of the filesystem */
 	blksz = EXT2_BLOCK_SIZE(ext4fs_root);
 	log2_blksz = LOG2_BLOCK_SIZE(ext4fs_root)
 		- get_fs()->dev_desc->log2blksz;
 
 	if (le32_to_cpu(inode->flags) & EXT4_EXTENTS_FL) {
-		long int startblock, endblock;
-		struct ext_block_cache *c, cd;
-		struct ext4_extent_header *ext_block;
-		struct ext4_extent *extent;
-		int i;
-
-		if (cache) {
-			c = cache;
-		} else {
-			c = &cd;
-			ext_cache_init(c);
-		}
-		ext_block =
-			ext4fs_get_extent_block(ext4fs_root, c,
-						(struct ext4_extent_header *)
-						inode->b.blocks.dir_blocks,
-						fileblock, log2_blksz);
-		if (!ext_block) {
-			printf("invalid extent block\n");
-			if (!cache)
-				ext_cache_fini(c);
-			return -EINVAL;
-		}
-
-		extent = (struct ext4_extent *)(ext_block + 1);
-
-		for (i = 0; i < le16_to_cpu(ext_block->eh_entries); i++) {
-			startblock = le32_to_cpu(extent[i].ee_block);
-			endblock = startblock + le16_to_cpu(extent[i].ee_len);
+		uint32_t count;
 
-			if (startblock > fileblock) {
-				/* Sparse file */
-				if (!cache)
-					ext_cache_fini(c);
-				return 0;
-
-			} else if (fileblock < endblock) {
-				start = le16_to_cpu(extent[i].ee_start_hi);
-				start = (start << 32) +
-					le32_to_cpu(extent[i].ee_start_lo);
-				if (!cache)
-					ext_cache_fini(c);
-				return (fileblock - startblock) + start;
-			}
-		}
-
-		if (!cache)
-			ext_cache_fini(c);
-		return 0;
+		return read_allocated_extent(inode, fileblock, cache, &count);
 	}
 
 	/* Direct blocks. */
@@ -2009,6 +2029,8 @@ long int read_allocated_block(struct ext2_inode *inode, int fileblock,
  */
 void ext4fs_reinit_global(void)
 {
+	ext_extent_cache_invalidate();
+
 	if (ext4fs_indir1_block != NULL) {
 		free(ext4fs_indir1_block);
 		ext4fs_indir1_block = NULL;
@@ -2042,24 +2064,16 @@ void ext4fs_close(void)
 	ext4fs_reinit_global();
 }
 
-int ext4fs_iterate_dir(struct ext2fs_node *dir, char *name,
-				struct ext2fs_node **fnode, int *ftype)
+/* Search the entries between byte offsets @fpos and @end of a directory */
+static int ext4fs_iterate_dir_range(struct ext2fs_node *dir, char *name,
+				    struct ext2fs_node **fnode, int *ftype,
+				    unsigned int fpos, unsigned int end)
 {
-	unsigned int fpos = 0;
 	int status;
 	loff_t actread;
 
-#ifdef DEBUG
-	if (name != NULL)
-		printf("Iterate dir %s\n", name);
-#endif /* of DEBUG */
-	if (!dir->inode_read) {
-		status = ext4fs_read_inode(dir->data, dir->ino, &dir->inode);
-		if (status == 0)
-			return 0;
-	}
 	/* Search the file.  */
-	while (fpos < le32_to_cpu(dir->inode.size)) {
+	while (fpos < end) {
 		struct ext2_dirent dirent;
 
 		status = ext4fs_read_file(dir, fpos,
@@ -2147,6 +2161,44 @@ int ext4fs_iterate_dir(struct ext2fs_node *dir, char *name,
 	return 0;
 }
 
+int ext4fs_iterate_dir(struct ext2fs_node *dir, char *name,
+				struct ext2fs_node **fnode, int *ftype)
+{
+	int status;
+
+#ifdef DEBUG
+	if (name != NULL)
+		printf("Iterate dir %s\n", name);
+#endif /* of DEBUG */
+	if (!dir->inode_read) {
+		status = ext4fs_read_inode(dir->data, dir->ino, &dir->inode);
+		if (status == 0)
+			return 0;
+	}
+
+	/* Only the leaf blocks for the name's hash need to be searched */
+	if (name && fnode && ftype) {
+		int log2_blksz = LOG2_BLOCK_SIZE(dir->data);
+		u32 leaves[4];
+		int i, count;
+
+		count = ext4fs_htree_lookup(dir, name, leaves,
+					    ARRAY_SIZE(leaves));
+		for (i = 0; i < count; i++) {
+			status = ext4fs_iterate_dir_range(dir, name, fnode,
+						ftype, leaves[i] << log2_blksz,
+						(leaves[i] + 1) << log2_blksz);
+			if (status)
+				return status;
+		}
+		if (count >= 0)
+			return 0;
+	}
+
+	return ext4fs_iterate_dir_range(dir, name, fnode, ftype, 0,
+					le32_to_cpu(dir->inode.size));
+}
+
 static char *ext4fs_read_symlink(struct ext2fs_node *node)
 {
 	char *symlink;
@@ -58,6 +58,24 @@ int ext4fs_find_file1(const char *currpath, struct ext2fs_node *currroot,
 int ext4fs_iterate_dir(struct ext2fs_node *dir, char *name,
 			struct ext2fs_node **fnode, int *ftype);
 
+/**
+ * ext4fs_htree_lookup() - find the leaf blocks which may hold a name
+ *
+ * Uses the hash tree index of a dir_index directory to find the blocks to
+ * search for @name. More than one block is returned only when names with the
+ * same hash continue from one leaf into the next.
+ *
+ * @dir:	directory to search
+ * @name:	name to look up
+ * @blocks:	returns the logical block numbers of the leaves
+ * @max:	size of @blocks
+ * Return: number of blocks found, -ENOENT if @dir is not indexed, or other
+ *	   -ve value if the index cannot be used, in which case the caller
+ *	   should scan the whole directory instead
+ */
+int ext4fs_htree_lookup(struct ext2fs_node *dir, const char *name,
+			u32 *blocks, int max);
+
 #if defined(CONFIG_EXT4_WRITE)
 uint32_t ext4fs_div_roundup(uint32_t size, uint32_t n);
 uint16_t ext4fs_checksum_update(unsigned int i);
@@ -0,0 +1,417 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Hashed (dir_index) directory lookup for ext4
+ *
+ * Directories with EXT4_INDEX_FL hold a tree of (hash, block) pairs in their
+ * first block, pointing at the leaf blocks which contain the entries for a
+ * range of name hashes. Looking a name up only needs the blocks along one
+ * path through the tree plus the matching leaf, rather than the whole
+ * directory.
+ *
+ * The hash functions follow the descriptions in the Linux kernel's
+ * Documentation/filesystems/ext4/directory.rst and fs/ext4/hash.c.
+ */
+
+#include <blk.h>
+#include <log.h>
+#include "ext4_common.h"
+
+/* Hash algorithms, as stored in dx_root_info.hash_version */
+enum {
+	DX_HASH_LEGACY,
+	DX_HASH_HALF_MD4,
+	DX_HASH_TEA,
+	DX_HASH_LEGACY_UNSIGNED,
+	DX_HASH_HALF_MD4_UNSIGNED,
+	DX_HASH_TEA_UNSIGNED,
+};
+
+/* Superblock flag: the hash was computed using unsigned chars */
+#define EXT2_FLAGS_UNSIGNED_HASH	0x0002
+
+#define EXT4_HTREE_EOF_32BIT		0x7fffffff
+
+/* Tree depth allowed without, and with, the largedir feature */
+#define DX_MAX_LEVELS			2
+#define DX_MAX_LEVELS_LARGEDIR		3
+
+struct dx_root_info {
+	__le32 reserved_zero;
+	u8 hash_version;
+	u8 info_length;
+	u8 indirect_levels;
+	u8 unused_flags;
+};
+
+struct dx_countlimit {
+	__le16 limit;
+	__le16 count;
+};
+
+struct dx_entry {
+	__le32 hash;
+	__le32 block;
+};
+
+/* Offset of dx_root_info in the first block: after the "." and ".." entries */
+#define DX_ROOT_INFO_OFFSET		24
+/* Offset of the entries in an interior block: after an empty dirent */
+#define DX_NODE_OFFSET			8
+
+#define DELTA				0x9e3779b9
+
+static void tea_transform(u32 buf[4], const u32 in[4])
+{
+	u32 sum = 0;
+	u32 b0 = buf[0], b1 = buf[1];
+	u32 a = in[0], b = in[1], c = in[2], d = in[3];
+	int n = 16;
+
+	do {
+		sum += DELTA;
+		b0 += ((b1 << 4) + a) ^ (b1 + sum) ^ ((b1 >> 5) + b);
+		b1 += ((b0 << 4) + c) ^ (b0 + sum) ^ ((b0 >> 5) + d);
+	} while (--n);
+
+	buf[0] += b0;
+	buf[1] += b1;
+}
+
+#define F(x, y, z)	((z) ^ ((x) & ((y) ^ (z))))
+#define G(x, y, z)	(((x) & (y)) + (((x) ^ (y)) & (z)))
+#define H(x, y, z)	((x) ^ (y) ^ (z))
+
+#define MD4_ROUND(f, a, b, c, d, x, s)	\
+	(a += f(b, c, d) + (x), a = (a << (s)) | (a >> (32 - (s))))
+#define K1	0
+#define K2	013240474631UL
+#define K3	015666365641UL
+
+/* The first three rounds of MD4, on 32 bytes of input */
+static void half_md4_transform(u32 buf[4], const u32 in[8])
+{
+	u32 a = buf[0], b = buf[1], c = buf[2], d = buf[3];
+
+	MD4_ROUND(F, a, b, c, d, in[0] + K1,  3);
+	MD4_ROUND(F, d, a, b, c, in[1] + K1,  7);
+	MD4_ROUND(F, c, d, a, b, in[2] + K1, 11);
+	MD4_ROUND(F, b, c, d, a, in[3] + K1, 19);
+	MD4_ROUND(F, a, b, c, d, in[4] + K1,  3);
+	MD4_ROUND(F, d, a, b, c, in[5] + K1,  7);
+	MD4_ROUND(F, c, d, a, b, in[6] + K1, 11);
+	MD4_ROUND(F, b, c, d, a, in[7] + K1, 19);
+
+	MD4_ROUND(G, a, b, c, d, in[1] + K2,  3);
+	MD4_ROUND(G, d, a, b, c, in[3] + K2,  5);
+	MD4_ROUND(G, c, d, a, b, in[5] + K2,  9);
+	MD4_ROUND(G, b, c, d, a, in[7] + K2, 13);
+	MD4_ROUND(G, a, b, c, d, in[0] + K2,  3);
+	MD4_ROUND(G, d, a, b, c, in[2] + K2,  5);
+	MD4_ROUND(G, c, d, a, b, in[4] + K2,  9);
+	MD4_ROUND(G, b, c, d, a, in[6] + K2, 13);
+
+	MD4_ROUND(H, a, b, c, d, in[3] + K3,  3);
+	MD4_ROUND(H, d, a, b, c, in[7] + K3,  9);
+	MD4_ROUND(H, c, d, a, b, in[2] + K3, 11);
+	MD4_ROUND(H, b, c, d, a, in[6] + K3, 15);
+	MD4_ROUND(H, a, b, c, d, in[1] + K3,  3);
+	MD4_ROUND(H, d, a, b, c, in[5] + K3,  9);
+	MD4_ROUND(H, c, d, a, b, in[0] + K3, 11);
+	MD4_ROUND(H, b, c, d, a, in[4] + K3, 15);
+
+	buf[0] += a;
+	buf[1] += b;
+	buf[2] += c;
+	buf[3] += d;
+}
+
+/* The original hash, from before the tree was made pluggable */
+static u32 dx_hack_hash(const char *name, int len, bool unsigned_char)
+{
+	u32 hash, hash0 = 0x12a3fe2d, hash1 = 0x37abe8f9;
+	int i, c;
+
+	for (i = 0; i < len; i++) {
+		c = unsigned_char ? (int)(unsigned char)name[i] :
+				    (int)(signed char)name[i];
+		hash = hash1 + (hash0 ^ (c * 7152373));
+		if (hash & 0x80000000)
+			hash -= 0x7fffffff;
+		hash1 = hash0;
+		hash0 = hash;
+	}
+
+	return hash0 << 1;
+}
+
+/* Pack up to @num words of the name into @buf, padding with the length */
+static void str2hashbuf(const char *msg, int len, u32 *buf, int num,
+			bool unsigned_char)
+{
+	u32 pad, val;
+	int i, c;
+
+	pad = (u32)len | ((u32)len << 8);
+	pad |= pad << 16;
+
+	val = pad;
+	if (len > num * 4)
+		len = num * 4;
+	for (i = 0; i < len; i++) {
+		c = unsigned_char ? (int)(unsigned char)msg[i] :
+				    (int)(signed char)msg[i];
+		val = c + (val << 8);
+		if ((i % 4) == 3) {
+			*buf++ = val;
+			val = pad;
+			num--;
+		}
+	}
+	if (--num >= 0)
+		*buf++ = val;
+	while (--num >= 0)
+		*buf++ = pad;
+}
+
+/**
+ * ext4fs_dirhash() - compute the major hash of a file name
+ *
+ * @name:	file name
+ * @len:	length of @name
+ * @version:	hash algorithm (DX_HASH_...)
+ * @seed:	hash seed from the superblock (little-endian words)
+ * @hashp:	returns the hash, with the lowest bit clear
+ * Return: 0 if OK, -EOPNOTSUPP if the algorithm is not supported
+ */
+static int ext4fs_dirhash(const char *name, int len, int version,
+			  const __le32 seed[4], u32 *hashp)
+{
+	bool unsigned_char = false;
+	u32 buf[4], in[8];
+	u32 hash;
+	int i;
+
+	buf[0] = 0x67452301;
+	buf[1] = 0xefcdab89;
+	buf[2] = 0x98badcfe;
+	buf[3] = 0x10325476;
+
+	/* an all-zero seed means the default one */
+	for (i = 0; i < 4; i++) {
+		if (seed[i]) {
+			for (i = 0; i < 4; i++)
+				buf[i] = le32_to_cpu(seed[i]);
+			break;
+		}
+	}
+
+	switch (version) {
+	case DX_HASH_LEGACY_UNSIGNED:
+		unsigned_char = true;
+		fallthrough;
+	case DX_HASH_LEGACY:
+		hash = dx_hack_hash(name, len, unsigned_char);
+		break;
+	case DX_HASH_HALF_MD4_UNSIGNED:
+		unsigned_char = true;
+		fallthrough;
+	case DX_HASH_HALF_MD4:
+		for (; len > 0; len -= 32, name += 32) {
+			str2hashbuf(name, len, in, 8, unsigned_char);
+			half_md4_transform(buf, in);
+		}
+		hash = buf[1];
+		break;
+	case DX_HASH_TEA_UNSIGNED:
+		unsigned_char = true;
+		fallthrough;
+	case DX_HASH_TEA:
+		for (; len > 0; len -= 16, name += 16) {
+			str2hashbuf(name, len, in, 4, unsigned_char);
+			tea_transform(buf, in);
+		}
+		hash = buf[0];
+		break;
+	default:
+		return -EOPNOTSUPP;
+	}
+
+	hash &= ~1;
+	if (hash == (EXT4_HTREE_EOF_32BIT << 1))
+		hash = (EXT4_HTREE_EOF_32BIT - 1) << 1;
+	*hashp = hash;
+
+	return 0;
+}
+
+/* A block of the tree being walked, and the entry chosen in it */
+struct dx_frame {
+	char *buf;
+	struct dx_entry *entries;
+	int count;
+	int at;
+};
+
+static int dx_read_block(struct ext2fs_node *dir, u32 block, char *buf)
+{
+	int blksz = EXT2_BLOCK_SIZE(dir->data);
+	loff_t actread;
+
+	if ((loff_t)(block + 1) * blksz > le32_to_cpu(dir->inode.size))
+		return -EINVAL;
+	if (ext4fs_read_file(dir, (loff_t)block * blksz, blksz, buf,
+			     &actread) || actread != blksz)
+		return -EIO;
+
+	return 0;
+}
+
+/* Set up a frame for the entries at @offset in its block and pick one */
+static int dx_frame_search(struct dx_frame *frame, int offset, int blksz,
+			   u32 hash)
+{
+	struct dx_countlimit *cl = (void *)frame->buf + offset;
+	int lo, hi, limit;
+
+	limit = le16_to_cpu(cl->limit);
+	frame->count = le16_to_cpu(cl->count);
+	if (!frame->count || frame->count > limit ||
+	    offset + limit * sizeof(struct dx_entry) > blksz)
+		return -EINVAL;
+	frame->entries = (struct dx_entry *)cl;
+
+	/*
+	 * Entry 0 holds the count and limit in place of a hash and covers
+	 * everything below entry 1. Find the last entry whose hash is not
+	 * above the one wanted.
+	 */
+	lo = 1;
+	hi = frame->count - 1;
+	while (lo <= hi) {
+		int mid = (lo + hi) / 2;
+
+		if (le32_to_cpu(frame->entries[mid].hash) > hash)
+			hi = mid - 1;
+		else
+			lo = mid + 1;
+	}
+	frame->at = lo - 1;
+
+	return 0;
+}
+
+static u32 dx_get_block(struct dx_frame *frame)
+{
+	return le32_to_cpu(frame->entries[frame->at].block) & 0x0fffffff;
+}
+
+int ext4fs_htree_lookup(struct ext2fs_node *dir, const char *name,
+			u32 *blocks, int max)
+{
+	struct ext2_sblock *sb = &dir->data->sblock;
+	int blksz = EXT2_BLOCK_SIZE(dir->data);
+	struct dx_frame frames[DX_MAX_LEVELS_LARGEDIR], *frame;
+	struct dx_root_info *info;
+	int levels, max_levels;
+	int version;
+	int count = 0;
+	u32 hash;
+	int i, ret;
+
+	if (!(le32_to_cpu(dir->inode.flags) & EXT4_INDEX_FL) ||
+	    !(le32_to_cpu(sb->feature_compatibility) &
+	      EXT4_FEATURE_COMPAT_DIR_INDEX))
+		return -ENOENT;
+
+	memset(frames, '\0', sizeof(frames));
+	frames[0].buf = malloc(blksz);
+	if (!frames[0].buf)
+		return -ENOMEM;
+	ret = dx_read_block(dir, 0, frames[0].buf);
+	if (ret)
+		goto out;
+
+	info = (void *)frames[0].buf + DX_ROOT_INFO_OFFSET;
+	version = info->hash_version;
+	if (version <= DX_HASH_TEA &&
+	    (le32_to_cpu(sb->flags) & EXT2_FLAGS_UNSIGNED_HASH))
+		version += DX_HASH_LEGACY_UNSIGNED;
+	max_levels = le32_to_cpu(sb->feature_incompat) &
+		     EXT4_FEATURE_INCOMPAT_LARGEDIR ?
+		     DX_MAX_LEVELS_LARGEDIR : DX_MAX_LEVELS;
+	levels = info->indirect_levels + 1;
+	if (info->reserved_zero || levels > max_levels) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	ret = ext4fs_dirhash(name, strlen(name), version, sb->hash_seed,
+			     &hash);
+	if (ret)
+		goto out;
+
+	/* Walk down to the leaf covering this hash */
+	ret = dx_frame_search(&frames[0],
+			      DX_ROOT_INFO_OFFSET + info->info_length, blksz,
+			      hash);
+	for (i = 1; !ret && i < levels; i++) {
+		frames[i].buf = malloc(blksz);
+		if (!frames[i].buf) {
+			ret = -ENOMEM;
+			break;
+		}
+		ret = dx_read_block(dir, dx_get_block(&frames[i - 1]),
+				    frames[i].buf);
+		if (!ret)
+			ret = dx_frame_search(&frames[i], DX_NODE_OFFSET,
+					      blksz, hash);
+	}
+	if (ret)
+		goto out;
+
+	/*
+	 * Names with the same hash may spill over into following leaves,
+	 * which is marked by setting the lowest bit of their starting hash.
+	 */
+	while (1) {
+		u32 next;
+
+		blocks[count++] = dx_get_block(&frames[levels - 1]);
+
+		/* find the next leaf, moving up the tree as needed */
+		for (frame = &frames[levels - 1];
+		     frame->at + 1 >= frame->count; frame--) {
+			if (frame == frames)
+				goto out;
+		}
+		frame->at++;
+		next = le32_to_cpu(frame->entries[frame->at].hash);
+		if (!(next & 1) || (next & ~1) != hash)
+			break;
+		if (count == max) {
+			ret = -E2BIG;
+			break;
+		}
+
+		/* and back down to the first leaf of that branch for the hash */
+		for (frame++; frame < frames + levels; frame++) {
+			ret = dx_read_block(dir, dx_get_block(frame - 1),
+					    frame->buf);
+			if (!ret)
+				ret = dx_frame_search(frame, DX_NODE_OFFSET,
+						      blksz, hash);
+			if (ret)
+				goto out;
+		}
+	}
+
+out:
+	for (i = 0; i < ARRAY_SIZE(frames); i++)
+		free(frames[i].buf);
+	if (ret) {
+		log_debug("htree lookup of '%s' failed (err=%d)\n", name, ret);
+		return ret;
+	}
+
+	return count;
+}
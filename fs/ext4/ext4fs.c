@@ -29,6 +29,7 @@
 #include <part.h>
 #include <rtc.h>
 #include <u-boot/uuid.h>
+#include <linux/sizes.h>
 #include "ext4_common.h"
 
 int ext4fs_symlinknest;
@@ -63,30 +64,93 @@ void ext4fs_free_node(struct ext2fs_node *node, struct ext2fs_node *currroot)
 		free(node);
 }
 
+/*
+ * Recently resolved runs of file blocks, so that repeated reads of the same
+ * file, such as a directory being scanned one entry at a time, do not walk
+ * the extent tree again. The cache is emptied whenever the filesystem is
+ * closed or about to be written.
+ */
+#define EXT_EXTENT_CACHE_SIZE	8
+
+static struct ext_extent_map {
+	int ino;		/* 0 if the entry is unused */
+	uint32_t block;		/* first file block */
+	uint32_t len;		/* number of file blocks */
+	long int start;		/* first disk block, 0 for a hole */
+} ext_extent_cache[EXT_EXTENT_CACHE_SIZE];
+static unsigned int ext_extent_next;
+
+void ext_extent_cache_invalidate(void)
+{
+	memset(ext_extent_cache, '\0', sizeof(ext_extent_cache));
+}
+
+/*
+ * Map a file block to a disk block, returning in *countp how many blocks
+ * from there on are consecutive on disk (or all holes)
+ */
+static long int ext4fs_map_blocks(struct ext2fs_node *node, int fileblock,
+				  struct ext_block_cache *cache,
+				  uint32_t *countp)
+{
+	struct ext_extent_map *map;
+	long int blknr;
+	int i;
+
+	if (!(le32_to_cpu(node->inode.flags) & EXT4_EXTENTS_FL)) {
+		*countp = 1;
+		return read_allocated_block(&node->inode, fileblock, cache);
+	}
+
+	for (i = 0; i < EXT_EXTENT_CACHE_SIZE; i++) {
+		map = &ext_extent_cache[i];
+		if (!node->ino || map->ino != node->ino ||
+		    fileblock < map->block || fileblock - map->block >= map->len)
+			continue;
+		*countp = map->len - (fileblock - map->block);
+		return map->start ? map->start + fileblock - map->block : 0;
+	}
+
+	blknr = read_allocated_extent(&node->inode, fileblock, cache, countp);
+	if (blknr < 0 || !node->ino)
+		return blknr;
+
+	map = &ext_extent_cache[ext_extent_next++ % EXT_EXTENT_CACHE_SIZE];
+	map->ino = node->ino;
+	map->block = fileblock;
+	map->len = *countp;
+	map->start = blknr;
+
+	return blknr;
+}
+
 /*
  * Taken from openmoko-kernel mailing list: By Andy green
  * Optimized read file API : collects and defers contiguous sector
  * reads into one potentially more efficient larger sequential read action
+ *
+ * Each lookup maps a whole run of blocks (an extent, or a hole), so large
+ * files are read with one device access per extent directly into @buf.
  */
 int ext4fs_read_file(struct ext2fs_node *node, loff_t pos,
 		loff_t len, char *buf, loff_t *actread)
 {
 	struct ext_filesystem *fs = get_fs();
-	int i;
+	lbaint_t i;
 	lbaint_t blockcnt;
 	int log2blksz = fs->dev_desc->log2blksz;
 	int log2_fs_blocksize = LOG2_BLOCK_SIZE(node->data) - log2blksz;
 	int blocksize = (1 << (log2_fs_blocksize + log2blksz));
+	/* keep each device read well below INT_MAX bytes */
+	uint32_t max_count = SZ_1G >> LOG2_BLOCK_SIZE(node->data);
 	unsigned int filesize = le32_to_cpu(node->inode.size);
-	lbaint_t previous_block_number = -1;
 	lbaint_t delayed_start = 0;
-	lbaint_t delayed_extent = 0;
-	lbaint_t delayed_skipfirst = 0;
+	int delayed_extent = 0;
+	int delayed_skipfirst = 0;
 	lbaint_t delayed_next = 0;
 	char *delayed_buf = NULL;
-	char *start_buf = buf;
-	short status;
 	struct ext_block_cache cache;
+	int ret = -1;
 
 	ext_cache_init(&cache);
 
@@ -101,109 +165,75 @@ int ext4fs_read_file(struct ext2fs_node *node, loff_t pos,
 
 	blockcnt = lldiv(((len + pos) + blocksize - 1), blocksize);
 
-	for (i = lldiv(pos, blocksize); i < blockcnt; i++) {
-		lbaint_t blknr;
+	for (i = lldiv(pos, blocksize); i < blockcnt; ) {
 		long blknr_and_status;
-		int blockoff = pos - (blocksize * i);
-		int blockend = blocksize;
-		int skipfirst = 0;
-		blknr_and_status = read_allocated_block(&node->inode, i, &cache);
-		if (blknr_and_status < 0) {
-			ext_cache_fini(&cache);
-			return -1;
-		}
-
-		/* Block number could becomes very large when CONFIG_SYS_64BIT_LBA is enabled
-		 * and wrap around at max long int
-		 */
-		blknr = (lbaint_t)blknr_and_status << log2_fs_blocksize;
-
-		/* Last block.  */
-		if (i == blockcnt - 1) {
-			blockend = (len + pos) - (blocksize * i);
-
-			/* The last portion is exactly blocksize. */
-			if (!blockend)
-				blockend = blocksize;
-		}
+		uint32_t count;
+		loff_t from, to;
+		int skipfirst;
+		char *dest;
 
-		/* First block. */
-		if (i == lldiv(pos, blocksize)) {
-			skipfirst = blockoff;
-			blockend -= skipfirst;
-		}
-		if (blknr) {
-			int status;
-
-			if (previous_block_number != -1) {
-				if (delayed_next == blknr) {
-					delayed_extent += blockend;
-					delayed_next += blockend >> log2blksz;
-				} else {	/* spill */
-					status = ext4fs_devread(delayed_start,
-							delayed_skipfirst,
-							delayed_extent,
-							delayed_buf);
-					if (status == 0) {
-						ext_cache_fini(&cache);
-						return -1;
-					}
-					previous_block_number = blknr;
-					delayed_start = blknr;
-					delayed_extent = blockend;
-					delayed_skipfirst = skipfirst;
-					delayed_buf = buf;
-					delayed_next = blknr +
-						(blockend >> log2blksz);
-				}
+		blknr_and_status = ext4fs_map_blocks(node, i, &cache, &count);
+		if (blknr_and_status < 0)
+			goto out;
+		count = min_t(lbaint_t, min(count, max_count), blockcnt - i);
+
+		/* The part of the requested range covered by this run */
+		from = max_t(loff_t, pos, (loff_t)i * blocksize);
+		to = min_t(loff_t, pos + len, (loff_t)(i + count) * blocksize);
+		skipfirst = from - (loff_t)i * blocksize;
+		dest = buf + (from - pos);
+
+		if (blknr_and_status) {
+			/* Block number could becomes very large when CONFIG_SYS_64BIT_LBA is enabled
+			 * and wrap around at max long int
+			 */
+			lbaint_t blknr = (lbaint_t)blknr_and_status <<
+					 log2_fs_blocksize;
+
+			if (delayed_extent && delayed_next == blknr &&
+			    delayed_extent + (to - from) <= SZ_1G) {
+				delayed_extent += to - from;
 			} else {
-				previous_block_number = blknr;
+				/* spill */
+				if (delayed_extent &&
+				    !ext4fs_devread(delayed_start,
+						    delayed_skipfirst,
+						    delayed_extent,
+						    delayed_buf))
+					goto out;
 				delayed_start = blknr;
-				delayed_extent = blockend;
+				delayed_extent = to - from;
 				delayed_skipfirst = skipfirst;
-				delayed_buf = buf;
-				delayed_next = blknr +
-					(blockend >> log2blksz);
+				delayed_buf = dest;
 			}
+			delayed_next = blknr +
+				((lbaint_t)count << log2_fs_blocksize);
 		} else {
-			int n;
-			int n_left;
-			if (previous_block_number != -1) {
+			if (delayed_extent) {
 				/* spill */
-				status = ext4fs_devread(delayed_start,
-							delayed_skipfirst,
-							delayed_extent,
-							delayed_buf);
-				if (status == 0) {
-					ext_cache_fini(&cache);
-					return -1;
-				}
-				previous_block_number = -1;
+				if (!ext4fs_devread(delayed_start,
+						    delayed_skipfirst,
+						    delayed_extent,
+						    delayed_buf))
+					goto out;
+				delayed_extent = 0;
 			}
-			/* Zero no more than `len' bytes. */
-			n = blocksize - skipfirst;
-			n_left = len - ( buf - start_buf );
-			if (n > n_left)
-				n = n_left;
-			memset(buf, 0, n);
+			memset(dest, 0, to - from);
 		}
-		buf += blocksize - skipfirst;
+		i += count;
 	}
-	if (previous_block_number != -1) {
+	if (delayed_extent) {
 		/* spill */
-		status = ext4fs_devread(delayed_start,
-					delayed_skipfirst, delayed_extent,
-					delayed_buf);
-		if (status == 0) {
-			ext_cache_fini(&cache);
-			return -1;
-		}
-		previous_block_number = -1;
+		if (!ext4fs_devread(delayed_start, delayed_skipfirst,
+				    delayed_extent, delayed_buf))
+			goto out;
 	}
 
 	*actread  = len;
+	ret = 0;
+out:
 	ext_cache_fini(&cache);
-	return 0;
+	return ret;
 }
 
 int ext4fs_opendir(const char *dirname, struct fs_dir_stream **dirsp)
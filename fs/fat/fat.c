@@ -12,6 +12,7 @@
 
 #include <blk.h>
 #include <config.h>
+#include <div64.h>
 #include <exports.h>
 #include <fat.h>
 #include <fs.h>
@@ -309,6 +310,136 @@ get_cluster(fsdata *mydata, __u32 clustnum, __u8 *buffer, unsigned long size)
 	return 0;
 }
 
+/*
+ * Run-length map of the cluster chain of the file read last. Runs are
+ * contiguous extents of clusters, so locating the cluster holding a given
+ * file offset is a binary search and each run is read with a single request.
+ * The map is extended lazily as far as a read needs it and kept across
+ * fat_read_file() calls for the same file, e.g. when a file is read in
+ * chunks. It is dropped when a different volume or file is read, and on any
+ * write to the device, whether through the filesystem or not.
+ */
+struct fat_run {
+	__u32 fclust;		/* first cluster of the run, within the file */
+	__u32 clust;		/* first cluster of the run, on the volume */
+	__u32 len;		/* number of clusters in the run */
+};
+
+static struct {
+	struct blk_desc *dev;	/* volume the map belongs to */
+	uint write_gen;		/* dev->write_gen when the map was started */
+	lbaint_t part_start;
+	u32 vol_id;
+	__u32 start;		/* first cluster of the file */
+	__u32 size;		/* file size in bytes */
+	__u32 mapped;		/* number of clusters mapped so far */
+	__u32 next;		/* cluster following the last mapped one */
+	struct fat_run *runs;
+	int count;
+	int alloc;
+} fat_runmap;
+
+static void fat_runmap_invalidate(void)
+{
+	free(fat_runmap.runs);
+	memset(&fat_runmap, '\0', sizeof(fat_runmap));
+}
+
+/*
+ * fat_runmap_get() - select the run map for a file, starting a new one if
+ * the cached map belongs to a different file or volume
+ */
+static void fat_runmap_get(fsdata *mydata, __u32 start, __u32 size)
+{
+	if (fat_runmap.dev == cur_dev &&
+	    fat_runmap.write_gen == cur_dev->write_gen &&
+	    fat_runmap.part_start == cur_part_info.start &&
+	    fat_runmap.vol_id == mydata->vol_id &&
+	    fat_runmap.start == start && fat_runmap.size == size)
+		return;
+
+	fat_runmap_invalidate();
+	fat_runmap.dev = cur_dev;
+	fat_runmap.write_gen = cur_dev->write_gen;
+	fat_runmap.part_start = cur_part_info.start;
+	fat_runmap.vol_id = mydata->vol_id;
+	fat_runmap.start = start;
+	fat_runmap.size = size;
+	fat_runmap.next = start;
+}
+
+/*
+ * fat_runmap_extend() - follow the cluster chain until the run map covers
+ * at least 'nclust' clusters of the file
+ *
+ * Return: 0 on success, -1 on error
+ */
+static int fat_runmap_extend(fsdata *mydata, __u32 nclust)
+{
+	struct fat_run *run;
+	__u32 clust;
+
+	while (fat_runmap.mapped < nclust) {
+		clust = fat_runmap.next;
+		if (CHECK_CLUST(clust, mydata->fatsize)) {
+			debug("curclust: 0x%x\n", clust);
+			printf("Invalid FAT entry\n");
+			return -1;
+		}
+
+		run = fat_runmap.count ? &fat_runmap.runs[fat_runmap.count - 1] :
+			NULL;
+		if (run && run->clust + run->len == clust) {
+			run->len++;
+		} else {
+			if (fat_runmap.count == fat_runmap.alloc) {
+				int alloc = max(fat_runmap.alloc * 2, 16);
+				struct fat_run *runs;
+
+				runs = realloc(fat_runmap.runs,
+					       alloc * sizeof(*runs));
+				if (!runs) {
+					debug("Error: allocating run map\n");
+					return -1;
+				}
+				fat_runmap.runs = runs;
+				fat_runmap.alloc = alloc;
+			}
+			run = &fat_runmap.runs[fat_runmap.count++];
+			run->fclust = fat_runmap.mapped;
+			run->clust = clust;
+			run->len = 1;
+		}
+		fat_runmap.mapped++;
+
+		/* the entry of the file's last cluster is not needed */
+		if (fat_runmap.mapped * (u64)mydata->clust_size *
+		    mydata->sect_size < fat_runmap.size)
+			fat_runmap.next = get_fatent(mydata, clust);
+		else
+			fat_runmap.next = 0;
+	}
+
+	return 0;
+}
+
+/* fat_runmap_find() - find the run holding cluster 'fclust' of the file */
+static int fat_runmap_find(__u32 fclust)
+{
+	int lo = 0, hi = fat_runmap.count - 1;
+
+	while (lo < hi) {
+		int mid = (lo + hi + 1) / 2;
+
+		if (fat_runmap.runs[mid].fclust <= fclust)
+			lo = mid;
+		else
+			hi = mid - 1;
+	}
+
+	return lo;
+}
+
 /**
  * get_contents() - read from file
  *
@@ -329,9 +460,10 @@ static int get_contents(fsdata *mydata, dir_entry *dentptr, loff_t pos,
 {
 	loff_t filesize = FAT2CPU32(dentptr->size);
 	unsigned int bytesperclust = mydata->clust_size * mydata->sect_size;
-	__u32 curclust = START(dentptr);
-	__u32 endclust, newclust;
+	__u32 fclust, nclust, off;
+	struct fat_run *run;
 	loff_t actsize;
+	int idx;
 
 	*gotsize = 0;
 	debug("Filesize: %llu bytes\n", filesize);
@@ -341,28 +473,26 @@ static int get_contents(fsdata *mydata, dir_entry *dentptr, loff_t pos,
 		return 0;
 	}
 
+	fat_runmap_get(mydata, START(dentptr), filesize);
+
 	if (maxsize > 0 && filesize > pos + maxsize)
 		filesize = pos + maxsize;
 
 	debug("%llu bytes\n", filesize);
 
-	actsize = bytesperclust;
+	/* map the clusters up to the end of the requested range */
+	nclust = DIV_ROUND_UP(filesize, bytesperclust);
+	if (fat_runmap_extend(mydata, nclust))
+		return -1;
 
 	/* go to cluster at pos */
-	while (actsize <= pos) {
-		curclust = get_fatent(mydata, curclust);
-		if (CHECK_CLUST(curclust, mydata->fatsize)) {
-			debug("curclust: 0x%x\n", curclust);
-			printf("Invalid FAT entry\n");
-			return -1;
-		}
-		actsize += bytesperclust;
-	}
+	fclust = div_u64(pos, bytesperclust);
+	idx = fat_runmap_find(fclust);
+	run = &fat_runmap.runs[idx];
+	off = fclust - run->fclust;
 
-	/* actsize > pos */
-	actsize -= bytesperclust;
-	filesize -= actsize;
-	pos -= actsize;
+	filesize -= (loff_t)fclust * bytesperclust;
+	pos -= (loff_t)fclust * bytesperclust;
 
 	/* align to beginning of next cluster if any */
 	if (pos) {
@@ -375,7 +505,8 @@ static int get_contents(fsdata *mydata, dir_entry *dentptr, loff_t pos,
 			return -1;
 		}
 
-		if (get_cluster(mydata, curclust, tmp_buffer, actsize) != 0) {
+		if (get_cluster(mydata, run->clust + off, tmp_buffer,
+				actsize) != 0) {
 			printf("Error reading cluster\n");
 			free(tmp_buffer);
 			return -1;
@@ -389,58 +520,29 @@ static int get_contents(fsdata *mydata, dir_entry *dentptr, loff_t pos,
 			return 0;
 		buffer += actsize;
 
-		curclust = get_fatent(mydata, curclust);
-		if (CHECK_CLUST(curclust, mydata->fatsize)) {
-			debug("curclust: 0x%x\n", curclust);
-			printf("Invalid FAT entry\n");
-			return -1;
+		if (++off == run->len) {
+			run++;
+			off = 0;
 		}
 	}
 
-	actsize = bytesperclust;
-	endclust = curclust;
-
-	do {
-		/* search for consecutive clusters */
-		while (actsize < filesize) {
-			newclust = get_fatent(mydata, endclust);
-			if ((newclust - 1) != endclust)
-				goto getit;
-			if (CHECK_CLUST(newclust, mydata->fatsize)) {
-				debug("curclust: 0x%x\n", newclust);
-				printf("Invalid FAT entry\n");
-				return -1;
-			}
-			endclust = newclust;
-			actsize += bytesperclust;
-		}
-
-		/* get remaining bytes */
-		actsize = filesize;
-		if (get_cluster(mydata, curclust, buffer, (int)actsize) != 0) {
+	/* read the rest one run at a time */
+	while (filesize) {
+		actsize = min(filesize,
+			      (loff_t)(run->len - off) * bytesperclust);
+		if (get_cluster(mydata, run->clust + off, buffer,
+				actsize) != 0) {
 			printf("Error reading cluster\n");
 			return -1;
 		}
 		*gotsize += actsize;
-		return 0;
-getit:
-		if (get_cluster(mydata, curclust, buffer, (int)actsize) != 0) {
-			printf("Error reading cluster\n");
-			return -1;
-		}
-		*gotsize += (int)actsize;
 		filesize -= actsize;
 		buffer += actsize;
+		run++;
+		off = 0;
+	}
 
-		curclust = get_fatent(mydata, endclust);
-		if (CHECK_CLUST(curclust, mydata->fatsize)) {
-			debug("curclust: 0x%x\n", curclust);
-			printf("Invalid FAT entry\n");
-			return -1;
-		}
-		actsize = bytesperclust;
-		endclust = curclust;
-	} while (1);
+	return 0;
 }
 
 /*
@@ -642,6 +744,7 @@ static int get_fs_info(fsdata *mydata)
 
 	mydata->fats = bs.fats;
 	mydata->fat_sect = bs.reserved;
+	mydata->vol_id = get_unaligned_le32(volinfo.volume_id);
 
 	mydata->rootdir_sect = mydata->fat_sect + mydata->fatlength * bs.fats;
 
@@ -18,10 +18,12 @@
 #include <ext4fs.h>
 #include <fat.h>
 #include <fs.h>
+#include <image.h>
 #include <sandboxfs.h>
 #include <semihostingfs.h>
 #include <time.h>
 #include <ubifs_uboot.h>
+#include <uthread.h>
 #include <btrfs.h>
 #include <asm/cache.h>
 #include <asm/global_data.h>
@@ -794,6 +796,233 @@ int do_size(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv[],
 	return 0;
 }
 
+#if CONFIG_IS_ENABLED(IMAGE_DECOMP_STREAM)
+/* Size of each read while decompressing; the first read must hold the header */
+#define FS_DECOMP_CHUNK		SZ_1M
+
+/**
+ * struct fs_decomp_chunk - a buffer of compressed data
+ *
+ * @buf: Buffer of FS_DECOMP_CHUNK bytes
+ * @len: Number of bytes read into @buf, 0 at the end of the file
+ * @ret: Result of the read
+ * @full: true if the chunk has been read and is waiting to be decompressed
+ */
+struct fs_decomp_chunk {
+	void *buf;
+	loff_t len;
+	int ret;
+	bool full;
+};
+
+/**
+ * struct fs_decomp_reader - state of the thread reading compressed data
+ *
+ * Chunks are filled in turn. With UTHREAD the reader runs in its own thread,
+ * one chunk ahead of the decompressor, so block-device waits and the
+ * schedule() calls in the decompressors let reading and decompression
+ * overlap. Otherwise each chunk is read just before it is decompressed.
+ */
+struct fs_decomp_reader {
+	const char *ifname;
+	const char *dev_part_str;
+	int fstype;
+	const char *fname;
+	loff_t size;
+	loff_t pos;
+	struct fs_decomp_chunk chunk[2];
+	bool stop;
+};
+
+static void fs_decomp_read_chunk(struct fs_decomp_reader *rd,
+				 struct fs_decomp_chunk *c)
+{
+	c->len = 0;
+	c->ret = 0;
+	if (rd->pos < rd->size) {
+		c->ret = fs_set_blk_dev(rd->ifname, rd->dev_part_str,
+					rd->fstype);
+		if (!c->ret)
+			c->ret = fs_read(rd->fname, map_to_sysmem(c->buf),
+					 rd->pos, min_t(loff_t, FS_DECOMP_CHUNK,
+							rd->size - rd->pos),
+					 &c->len);
+		else
+			c->ret = -ENOMEDIUM;
+		if (!c->ret && !c->len)
+			c->ret = -EIO;
+		rd->pos += c->len;
+	}
+	c->full = true;
+}
+
+static void fs_decomp_reader_thread(void *arg)
+{
+	struct fs_decomp_reader *rd = arg;
+	struct fs_decomp_chunk *c;
+	int i;
+
+	/* chunk 0 was read to find the compression type */
+	for (i = 1; !rd->stop; i ^= 1) {
+		c = &rd->chunk[i];
+		while (c->full && !rd->stop)
+			uthread_schedule();
+		if (rd->stop)
+			break;
+		fs_decomp_read_chunk(rd, c);
+		if (c->ret || !c->len)
+			break;
+	}
+}
+
+/* Read a file which is not compressed straight to @addr */
+static int fs_load_plain(struct fs_decomp_reader *rd, ulong addr,
+			 ulong max_size, ulong *sizep)
+{
+	loff_t len_read;
+	int ret;
+
+	if (rd->size > max_size)
+		return -ENOSPC;
+	if (fs_set_blk_dev(rd->ifname, rd->dev_part_str, rd->fstype))
+		return -ENOMEDIUM;
+	ret = _fs_read(rd->fname, addr, 0, 0, 1, &len_read);
+	if (ret)
+		return ret;
+	*sizep = len_read;
+
+	return 0;
+}
+
+/* Decompress a file whose format does not support streaming via a buffer */
+static int fs_load_decomp_buf(struct fs_decomp_reader *rd, int comp,
+			      ulong addr, ulong max_size, ulong *sizep)
+{
+	ulong load_end;
+	void *buf;
+	int ret;
+
+	if (fs_set_blk_dev(rd->ifname, rd->dev_part_str, rd->fstype))
+		return -ENOMEDIUM;
+	ret = fs_read_alloc(rd->fname, rd->size, 0, &buf);
+	if (ret)
+		return ret;
+	ret = image_decomp(comp, addr, map_to_sysmem(buf), IH_TYPE_KERNEL,
+			   map_sysmem(addr, max_size), buf, rd->size,
+			   min_t(ulong, max_size, UINT_MAX), &load_end);
+	unmap_sysmem(buf);
+	free(buf);
+	if (ret)
+		return -EINVAL;
+	*sizep = load_end - addr;
+
+	return 0;
+}
+
+int fs_load_decomp(const char *ifname, const char *dev_part_str, int fstype,
+		   const char *fname, ulong addr, ulong max_size, ulong *sizep)
+{
+	struct fs_decomp_reader rd = {
+		.ifname = ifname,
+		.dev_part_str = dev_part_str,
+		.fstype = fstype,
+		.fname = fname,
+	};
+	struct image_decomp_stream st;
+	struct fs_decomp_chunk *c;
+	unsigned int grp_id = 0;
+	int comp, ret, i;
+	ulong limit;
+
+	if (fs_set_blk_dev(ifname, dev_part_str, fstype))
+		return -ENOMEDIUM;
+	ret = fs_size(fname, &rd.size);
+	if (ret)
+		return -ENOENT;
+
+	limit = ~0UL - addr;
+#if CONFIG_IS_ENABLED(LMB)
+	limit = lmb_get_free_size(addr);
+#endif
+	if (max_size && max_size < limit)
+		limit = max_size;
+
+	for (i = 0; i < ARRAY_SIZE(rd.chunk); i++) {
+		rd.chunk[i].buf = malloc(FS_DECOMP_CHUNK);
+		if (!rd.chunk[i].buf) {
+			ret = -ENOMEM;
+			goto out;
+		}
+	}
+
+	/* the first chunk tells the compression type */
+	c = &rd.chunk[0];
+	fs_decomp_read_chunk(&rd, c);
+	ret = c->ret;
+	if (ret)
+		goto out;
+	comp = image_decomp_type(c->buf, c->len);
+	if (comp == IH_COMP_NONE || comp < 0) {
+		ret = fs_load_plain(&rd, addr, limit, sizep);
+		goto out;
+	}
+	if (!image_decomp_stream_supported(comp)) {
+		ret = fs_load_decomp_buf(&rd, comp, addr, limit, sizep);
+		goto out;
+	}
+
+	ret = image_decomp_stream_start(&st, comp, map_sysmem(addr, limit),
+					limit);
+	if (ret)
+		goto out;
+
+	if (IS_ENABLED(CONFIG_UTHREAD)) {
+		grp_id = uthread_grp_new_id();
+		if (uthread_create(NULL, fs_decomp_reader_thread, &rd, 0,
+				   grp_id))
+			grp_id = 0;
+	}
+
+	/*
+	 * A chunk may end just after a frame with more frames to come, so keep
+	 * going until the file or the compressed data ends. If the input runs
+	 * out part-way through a frame, image_decomp_stream_finish() fails.
+	 */
+	for (i = 0; !st.ended; i ^= 1) {
+		c = &rd.chunk[i];
+		if (grp_id) {
+			while (!c->full)
+				uthread_schedule();
+		} else if (!c->full) {
+			fs_decomp_read_chunk(&rd, c);
+		}
+		ret = c->ret;
+		if (ret || !c->len)
+			break;
+		ret = image_decomp_stream_write(&st, c->buf, c->len);
+		c->full = false;
+		if (ret)
+			break;
+	}
+
+	/* let the reader finish its current read before freeing the chunks */
+	rd.stop = true;
+	while (grp_id && !uthread_grp_done(grp_id))
+		uthread_schedule();
+
+	if (!ret)
+		ret = image_decomp_stream_finish(&st, sizep);
+	else
+		image_decomp_stream_finish(&st, NULL);
+	unmap_sysmem(st.out);
+out:
+	for (i = 0; i < ARRAY_SIZE(rd.chunk); i++)
+		free(rd.chunk[i].buf);
+
+	return ret;
+}
+#endif
+
 int do_load(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv[],
 	    int fstype)
 {
@@ -805,8 +1034,15 @@ int do_load(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv[],
 	loff_t len_read;
 	int ret;
 	unsigned long time;
+	bool decomp = false;
 	char *ep;
 
+	if (CONFIG_IS_ENABLED(IMAGE_DECOMP_STREAM) && argc > 1 &&
+	    !strcmp(argv[1], "-z")) {
+		decomp = true;
+		argc--;
+		argv++;
+	}
 	if (argc < 2)
 		return CMD_RET_USAGE;
 	if (argc > 7)
@@ -847,7 +1083,19 @@ int do_load(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv[],
 		pos = 0;
 
 	time = get_timer(0);
-	ret = _fs_read(filename, addr, pos, bytes, 1, &len_read);
+	if (decomp) {
+		ulong size = 0;
+
+		/* the file is opened again for each chunk */
+		fs_close();
+		if (pos)
+			return CMD_RET_USAGE;
+		ret = fs_load_decomp(argv[1], cmd_arg2(argc, argv), fstype,
+				     filename, addr, bytes, &size);
+		len_read = size;
+	} else {
+		ret = _fs_read(filename, addr, pos, bytes, 1, &len_read);
+	}
 	time = get_timer(time);
 	if (ret < 0) {
 		log_err("Failed to load '%s'\n", filename);
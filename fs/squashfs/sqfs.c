@@ -14,6 +14,7 @@
 #include <linux/types.h>
 #include <asm/byteorder.h>
 #include <linux/compat.h>
+#include <linux/sizes.h>
 #include <memalign.h>
 #include <stdlib.h>
 #include <string.h>
@@ -25,6 +26,8 @@
 #include "sqfs_utils.h"
 
 #define MAX_SYMLINK_NEST 8
+/* Largest run of consecutive data blocks read from disk at once */
+#define SQFS_DATA_BATCH_SIZE SZ_256K
 
 static struct squashfs_ctxt ctxt;
 static int symlinknest;
@@ -99,113 +102,206 @@ static int sqfs_calc_n_blks(__le64 start, __le64 end, u64 *offset)
 }
 
 /*
- * Retrieves fragment block entry and returns true if the fragment block is
- * compressed
+ * Reads 'size' bytes found at byte offset 'offset' of the filesystem. The data
+ * is returned in a newly allocated buffer, stored in 'bufp', which must be
+ * freed by the caller.
  */
-static int sqfs_frag_lookup(u32 inode_fragment_index,
-			    struct squashfs_fragment_block_entry *e)
+static void *sqfs_read_bytes(u64 offset, u64 size, void **bufp)
 {
-	u64 start, end, exp_tbl, n_blks, src_len, table_offset, start_block;
-	unsigned char *metadata_buffer, *metadata, *table;
-	struct squashfs_fragment_block_entry *entries;
-	struct squashfs_super_block *sblk = ctxt.sblk;
-	unsigned long dest_len;
-	int block, offset, ret;
-	u16 header;
+	u64 start, n_blks, skip;
+	size_t buf_size;
+	void *buf;
 
-	metadata_buffer = NULL;
-	entries = NULL;
-	table = NULL;
+	start = lldiv(offset, ctxt.cur_dev->blksz);
+	skip = offset - start * ctxt.cur_dev->blksz;
+	n_blks = DIV_ROUND_UP(skip + size, ctxt.cur_dev->blksz);
 
-	if (inode_fragment_index >= get_unaligned_le32(&sblk->fragments))
-		return -EINVAL;
+	if (__builtin_mul_overflow(n_blks, ctxt.cur_dev->blksz, &buf_size))
+		return NULL;
 
-	start = get_unaligned_le64(&sblk->fragment_table_start);
-	end = get_unaligned_le64(&sblk->id_table_start);
-	exp_tbl = get_unaligned_le64(&sblk->export_table_start);
+	buf = malloc_cache_aligned(buf_size);
+	if (!buf)
+		return NULL;
 
-	if (exp_tbl > start && exp_tbl < end)
-		end = exp_tbl;
+	if (sqfs_disk_read(start, n_blks, buf) < 0) {
+		free(buf);
+		return NULL;
+	}
 
-	n_blks = sqfs_calc_n_blks(sblk->fragment_table_start,
-				  cpu_to_le64(end), &table_offset);
+	*bufp = buf;
 
-	start /= ctxt.cur_dev->blksz;
+	return buf + skip;
+}
 
-	/* Allocate a proper sized buffer to store the fragment index table */
-	table = malloc_cache_aligned(n_blks * ctxt.cur_dev->blksz);
-	if (!table) {
-		ret = -ENOMEM;
-		goto out;
+static void sqfs_cache_free(struct squashfs_cache_entry *cache, int count)
+{
+	int i;
+
+	for (i = 0; i < count; i++) {
+		free(cache[i].data);
+		cache[i].data = NULL;
+		cache[i].size = 0;
 	}
+}
 
-	if (sqfs_disk_read(start, n_blks, table) < 0) {
-		ret = -EINVAL;
-		goto out;
+static struct squashfs_cache_entry *
+sqfs_cache_lookup(struct squashfs_cache_entry *cache, int count, u64 start)
+{
+	int i;
+
+	for (i = 0; i < count; i++) {
+		if (cache[i].size && cache[i].start == start) {
+			cache[i].stamp = ++ctxt.cache_stamp;
+			return &cache[i];
+		}
 	}
 
-	block = SQFS_FRAGMENT_INDEX(inode_fragment_index);
-	offset = SQFS_FRAGMENT_INDEX_OFFSET(inode_fragment_index);
+	return NULL;
+}
 
-	/*
-	 * Get the start offset of the metadata block that contains the right
-	 * fragment block entry
-	 */
-	start_block = get_unaligned_le64(table + table_offset + block *
-					 sizeof(u64));
+/*
+ * Recycles the least recently used entry of 'cache' to hold the block at
+ * 'start': 'src_len' bytes found at 'src' are read and, if 'comp' is set,
+ * decompressed into at most 'max' bytes.
+ */
+static int sqfs_cache_fill(struct squashfs_cache_entry *cache, int count,
+			   u64 start, u64 src, u32 src_len, bool comp, u32 max,
+			   struct squashfs_cache_entry **ep)
+{
+	struct squashfs_cache_entry *e = NULL;
+	unsigned long dest_len = max;
+	void *buf, *data;
+	int i, ret = 0;
 
-	start = start_block / ctxt.cur_dev->blksz;
-	n_blks = sqfs_calc_n_blks(cpu_to_le64(start_block),
-				  sblk->fragment_table_start, &table_offset);
+	if (!src_len || src_len > max)
+		return -EINVAL;
 
-	metadata_buffer = malloc_cache_aligned(n_blks * ctxt.cur_dev->blksz);
-	if (!metadata_buffer) {
-		ret = -ENOMEM;
-		goto out;
+	for (i = 0; i < count; i++) {
+		if (!e || (e->size && (!cache[i].size ||
+				       (s32)(cache[i].stamp - e->stamp) < 0)))
+			e = &cache[i];
 	}
 
-	if (sqfs_disk_read(start, n_blks, metadata_buffer) < 0) {
-		ret = -EINVAL;
-		goto out;
+	if (!e->data) {
+		e->data = malloc(max);
+		if (!e->data)
+			return -ENOMEM;
 	}
+	e->size = 0;
 
-	/* Every metadata block starts with a 16-bit header */
-	header = get_unaligned_le16(metadata_buffer + table_offset);
-	metadata = metadata_buffer + table_offset + SQFS_HEADER_SIZE;
+	data = sqfs_read_bytes(src, src_len, &buf);
+	if (!data)
+		return -EINVAL;
 
-	if (!metadata || !header) {
-		ret = -ENOMEM;
-		goto out;
+	if (comp) {
+		ret = sqfs_decompress(&ctxt, e->data, &dest_len, data, src_len);
+	} else {
+		memcpy(e->data, data, src_len);
+		dest_len = src_len;
 	}
+	free(buf);
 
-	entries = malloc(SQFS_METADATA_BLOCK_SIZE);
-	if (!entries) {
-		ret = -ENOMEM;
-		goto out;
-	}
+	if (ret || !dest_len)
+		return -EINVAL;
 
-	if (SQFS_COMPRESSED_METADATA(header)) {
-		src_len = SQFS_METADATA_SIZE(header);
-		dest_len = SQFS_METADATA_BLOCK_SIZE;
-		ret = sqfs_decompress(&ctxt, entries, &dest_len, metadata,
-				      src_len);
-		if (ret) {
-			ret = -EINVAL;
-			goto out;
-		}
-	} else {
-		memcpy(entries, metadata, SQFS_METADATA_SIZE(header));
+	e->start = start;
+	e->size = dest_len;
+	e->stamp = ++ctxt.cache_stamp;
+	*ep = e;
+
+	return 0;
+}
+
+/* Returns the decompressed metadata block found at byte offset 'start' */
+static int sqfs_read_metadata_block(u64 start, struct squashfs_cache_entry **ep)
+{
+	void *buf, *data;
+	u16 header;
+
+	*ep = sqfs_cache_lookup(ctxt.meta_cache, ARRAY_SIZE(ctxt.meta_cache),
+				start);
+	if (*ep)
+		return 0;
+
+	/* Every metadata block starts with a 16-bit header */
+	data = sqfs_read_bytes(start, SQFS_HEADER_SIZE, &buf);
+	if (!data)
+		return -EINVAL;
+	header = get_unaligned_le16(data);
+	free(buf);
+
+	return sqfs_cache_fill(ctxt.meta_cache, ARRAY_SIZE(ctxt.meta_cache),
+			       start, start + SQFS_HEADER_SIZE,
+			       SQFS_METADATA_SIZE(header),
+			       SQFS_COMPRESSED_METADATA(header),
+			       SQFS_METADATA_BLOCK_SIZE, ep);
+}
+
+/* Returns the decompressed fragment block described by 'e' */
+static int sqfs_read_fragment_block(struct squashfs_fragment_block_entry *e,
+				    struct squashfs_cache_entry **ep)
+{
+	u64 start = get_unaligned_le64(&e->start);
+	u32 size = get_unaligned_le32(&e->size);
+
+	*ep = sqfs_cache_lookup(ctxt.frag_cache, ARRAY_SIZE(ctxt.frag_cache),
+				start);
+	if (*ep)
+		return 0;
+
+	return sqfs_cache_fill(ctxt.frag_cache, ARRAY_SIZE(ctxt.frag_cache),
+			       start, start, SQFS_BLOCK_SIZE(size),
+			       SQFS_COMPRESSED_BLOCK(size),
+			       get_unaligned_le32(&ctxt.sblk->block_size), ep);
+}
+
+/*
+ * Retrieves fragment block entry and returns true if the fragment block is
+ * compressed
+ */
+static int sqfs_frag_lookup(u32 inode_fragment_index,
+			    struct squashfs_fragment_block_entry *e)
+{
+	struct squashfs_super_block *sblk = ctxt.sblk;
+	struct squashfs_cache_entry *entries;
+	u32 fragments, count, offset;
+	void *buf, *table;
+	int block, ret;
+
+	fragments = get_unaligned_le32(&sblk->fragments);
+	if (inode_fragment_index >= fragments)
+		return -EINVAL;
+
+	/* The fragment index table lists the metadata blocks of entries */
+	if (!ctxt.frag_index) {
+		count = DIV_ROUND_UP(fragments, SQFS_MAX_ENTRIES);
+		table = sqfs_read_bytes(get_unaligned_le64(&sblk->fragment_table_start),
+					count * sizeof(u64), &buf);
+		if (!table)
+			return -EINVAL;
+
+		ctxt.frag_index = malloc(count * sizeof(u64));
+		if (ctxt.frag_index)
+			memcpy(ctxt.frag_index, table, count * sizeof(u64));
+		free(buf);
+		if (!ctxt.frag_index)
+			return -ENOMEM;
 	}
 
-	*e = entries[offset];
-	ret = SQFS_COMPRESSED_BLOCK(e->size);
+	block = SQFS_FRAGMENT_INDEX(inode_fragment_index);
+	offset = SQFS_FRAGMENT_INDEX_OFFSET(inode_fragment_index) * sizeof(*e);
 
-out:
-	free(entries);
-	free(metadata_buffer);
-	free(table);
+	ret = sqfs_read_metadata_block(get_unaligned_le64(&ctxt.frag_index[block]),
+				       &entries);
+	if (ret)
+		return ret;
 
-	return ret;
+	if (offset + sizeof(*e) > entries->size)
+		return -EINVAL;
+
+	memcpy(e, entries->data + offset, sizeof(*e));
+
+	return SQFS_COMPRESSED_BLOCK(get_unaligned_le32(&e->size));
 }
 
 /*
@@ -905,13 +1001,73 @@ out:
 	return metablks_count;
 }
 
+static void sqfs_put_tables(struct squashfs_tables *tables)
+{
+	if (!tables || --tables->refs)
+		return;
+
+	free(tables->inode_table);
+	free(tables->dir_table);
+	free(tables->pos_list);
+	free(tables);
+}
+
+/*
+ * Returns a reference to the decompressed inode and directory tables of the
+ * current image, which are only read and decompressed on first use.
+ */
+static struct squashfs_tables *sqfs_get_tables(void)
+{
+	struct squashfs_tables *tables = ctxt.tables;
+
+	if (tables) {
+		tables->refs++;
+		return tables;
+	}
+
+	tables = calloc(1, sizeof(*tables));
+	if (!tables)
+		return NULL;
+
+	if (sqfs_read_inode_table(&tables->inode_table))
+		goto err;
+
+	tables->metablks_count = sqfs_read_directory_table(&tables->dir_table,
+							   &tables->pos_list);
+	if (tables->metablks_count < 1)
+		goto err;
+
+	/* One reference for the caller and one for the cache */
+	tables->refs = 2;
+	ctxt.tables = tables;
+
+	return tables;
+
+err:
+	free(tables->inode_table);
+	free(tables);
+
+	return NULL;
+}
+
+/* Drops everything cached from the previously probed image */
+static void sqfs_cache_drop(void)
+{
+	sqfs_put_tables(ctxt.tables);
+	ctxt.tables = NULL;
+	free(ctxt.frag_index);
+	ctxt.frag_index = NULL;
+	sqfs_cache_free(ctxt.meta_cache, ARRAY_SIZE(ctxt.meta_cache));
+	sqfs_cache_free(ctxt.frag_cache, ARRAY_SIZE(ctxt.frag_cache));
+	ctxt.cache_dev = NULL;
+}
+
 static int sqfs_opendir_nest(const char *filename, struct fs_dir_stream **dirsp)
 {
-	unsigned char *inode_table = NULL, *dir_table = NULL;
-	int j, token_count = 0, ret = 0, metablks_count;
+	int j, token_count = 0, ret = 0;
+	struct squashfs_tables *tables;
 	struct squashfs_dir_stream *dirs;
 	char **token_list = NULL, *path = NULL;
-	u32 *pos_list = NULL;
 
 	dirs = calloc(1, sizeof(*dirs));
 	if (!dirs)
@@ -924,17 +1080,12 @@ static int sqfs_opendir_nest(const char *filename, struct fs_dir_stream **dirsp)
 	dirs->inode_table = NULL;
 	dirs->dir_table = NULL;
 
-	ret = sqfs_read_inode_table(&inode_table);
-	if (ret) {
-		ret = -EINVAL;
-		goto out;
-	}
-
-	metablks_count = sqfs_read_directory_table(&dir_table, &pos_list);
-	if (metablks_count < 1) {
+	tables = sqfs_get_tables();
+	if (!tables) {
 		ret = -EINVAL;
 		goto out;
 	}
+	dirs->tables = tables;
 
 	/* Tokenize filename */
 	token_count = sqfs_count_tokens(filename);
@@ -963,10 +1114,10 @@ static int sqfs_opendir_nest(const char *filename, struct fs_dir_stream **dirsp)
 	 * ldir's (extended directory) size is greater than dir, so it works as
 	 * a general solution for the malloc size, since 'i' is a union.
 	 */
-	dirs->inode_table = inode_table;
-	dirs->dir_table = dir_table;
-	ret = sqfs_search_dir(dirs, token_list, token_count, pos_list,
-			      metablks_count);
+	dirs->inode_table = tables->inode_table;
+	dirs->dir_table = tables->dir_table;
+	ret = sqfs_search_dir(dirs, token_list, token_count, tables->pos_list,
+			      tables->metablks_count);
 	if (ret)
 		goto out;
 
@@ -992,10 +1143,10 @@ out:
 			free(token_list[j]);
 		free(token_list);
 	}
-	free(pos_list);
 	free(path);
 	if (ret) {
-		free(inode_table);
+		sqfs_put_tables(dirs->tables);
+		free(dirs->dir_header);
 		free(dirs);
 	}
 
@@ -1157,6 +1308,16 @@ int sqfs_probe(struct blk_desc *fs_dev_desc, struct disk_partition *fs_partition
 		goto error;
 	}
 
+	/* Keep the cached tables and blocks if this is the same image */
+	if (ctxt.cache_dev != fs_dev_desc ||
+	    ctxt.cache_part_start != fs_partition->start ||
+	    memcmp(&ctxt.cache_sblk, sblk, sizeof(*sblk))) {
+		sqfs_cache_drop();
+		ctxt.cache_dev = fs_dev_desc;
+		ctxt.cache_part_start = fs_partition->start;
+		ctxt.cache_sblk = *sblk;
+	}
+
 	return 0;
 error:
 	ctxt.cur_dev = NULL;
@@ -1360,15 +1521,111 @@ static int sqfs_get_lregfile_info(struct squashfs_lreg_inode *lreg,
 	return datablk_count;
 }
 
+/*
+ * Loads the data blocks of a file into 'buf'. Consecutive blocks are read from
+ * disk at once, and blocks which fit entirely are decompressed straight into
+ * 'buf' instead of going through a bounce buffer.
+ */
+static int sqfs_read_data_blocks(struct squashfs_file_info *finfo, int count,
+				 void *buf, loff_t len, loff_t *actread)
+{
+	u32 block_size = get_unaligned_le32(&ctxt.sblk->block_size);
+	void *data_buffer = NULL, *datablock = NULL;
+	u64 data_offset = finfo->start, run_size;
+	unsigned long dest_len;
+	int ret = 0, j = 0, k;
+	loff_t want;
+	char *data;
+	u32 size;
+
+	while (j < count && *actread < len) {
+		/* Don't load any data for sparse blocks */
+		if (!finfo->blk_sizes[j]) {
+			dest_len = min_t(loff_t, block_size, len - *actread);
+			memset(buf + *actread, 0, dest_len);
+			*actread += dest_len;
+			j++;
+			continue;
+		}
+
+		/* Gather the following blocks which are needed and stored */
+		run_size = 0;
+		want = *actread;
+		for (k = j; k < count && finfo->blk_sizes[k] && want < len; k++) {
+			size = SQFS_BLOCK_SIZE(finfo->blk_sizes[k]);
+			if (k > j && run_size + size > SQFS_DATA_BATCH_SIZE)
+				break;
+			run_size += size;
+			want += block_size;
+		}
+
+		data = sqfs_read_bytes(data_offset, run_size, &data_buffer);
+		if (!data) {
+			/*
+			 * Possible causes: too many data blocks or too large
+			 * SquashFS block size. Tip: re-compile the SquashFS
+			 * image with mksquashfs's -b <block_size> option.
+			 */
+			printf("Error: too many data blocks to be read.\n");
+			ret = -EINVAL;
+			goto out;
+		}
+		data_offset += run_size;
+
+		for (; j < k; j++) {
+			size = SQFS_BLOCK_SIZE(finfo->blk_sizes[j]);
+			if (!SQFS_COMPRESSED_BLOCK(finfo->blk_sizes[j])) {
+				dest_len = min_t(loff_t, size, len - *actread);
+				memcpy(buf + *actread, data, dest_len);
+			} else if (len - *actread >= block_size) {
+				dest_len = block_size;
+				ret = sqfs_decompress(&ctxt, buf + *actread,
+						      &dest_len, data, size);
+				if (ret)
+					goto out;
+			} else {
+				if (!datablock) {
+					datablock = malloc(block_size);
+					if (!datablock) {
+						ret = -ENOMEM;
+						goto out;
+					}
+				}
+
+				dest_len = block_size;
+				ret = sqfs_decompress(&ctxt, datablock,
+						      &dest_len, data, size);
+				if (ret)
+					goto out;
+
+				dest_len = min_t(loff_t, dest_len,
+						 len - *actread);
+				memcpy(buf + *actread, datablock, dest_len);
+			}
+
+			*actread += dest_len;
+			data += size;
+		}
+
+		free(data_buffer);
+		data_buffer = NULL;
+	}
+
+out:
+	free(data_buffer);
+	free(datablock);
+
+	return ret;
+}
+
 static int sqfs_read_nest(const char *filename, void *buf, loff_t offset,
 			  loff_t len, loff_t *actread)
 {
-	char *dir = NULL, *fragment_block, *datablock = NULL;
-	char *fragment = NULL, *file = NULL, *resolved, *data;
-	u64 start, n_blks, table_size, data_offset, table_offset, sparse_size;
-	int ret, j, i_number, datablk_count = 0;
+	char *dir = NULL, *file = NULL, *resolved;
+	int ret, i_number, datablk_count = 0;
 	struct squashfs_super_block *sblk = ctxt.sblk;
 	struct squashfs_fragment_block_entry frag_entry;
+	struct squashfs_cache_entry *fragment;
 	struct squashfs_file_info finfo = {0};
 	struct squashfs_symlink_inode *symlink;
 	struct fs_dir_stream *dirsp = NULL;
@@ -1376,10 +1633,8 @@ static int sqfs_read_nest(const char *filename, void *buf, loff_t offset,
 	struct squashfs_lreg_inode *lreg;
 	struct squashfs_base_inode *base;
 	struct squashfs_reg_inode *reg;
-	unsigned long dest_len;
 	struct fs_dirent *dent;
 	unsigned char *ipos;
-	size_t buf_size;
 
 	*actread = 0;
 
@@ -1493,143 +1748,31 @@ static int sqfs_read_nest(const char *filename, void *buf, loff_t offset,
 		len = finfo.size;
 	}
 
-	if (datablk_count) {
-		data_offset = finfo.start;
-		datablock = malloc(get_unaligned_le32(&sblk->block_size));
-		if (!datablock) {
-			ret = -ENOMEM;
-			goto out;
-		}
-	}
-
-	for (j = 0; j < datablk_count; j++) {
-		char *data_buffer;
-
-		start = lldiv(data_offset, ctxt.cur_dev->blksz);
-		table_size = SQFS_BLOCK_SIZE(finfo.blk_sizes[j]);
-		table_offset = data_offset - (start * ctxt.cur_dev->blksz);
-		n_blks = DIV_ROUND_UP(table_size + table_offset,
-				      ctxt.cur_dev->blksz);
-
-		/* Don't load any data for sparse blocks */
-		if (finfo.blk_sizes[j] == 0) {
-			n_blks = 0;
-			table_offset = 0;
-			data_buffer = NULL;
-			data = NULL;
-		} else {
-			data_buffer = malloc_cache_aligned(n_blks * ctxt.cur_dev->blksz);
-
-			if (!data_buffer) {
-				ret = -ENOMEM;
-				goto out;
-			}
-
-			ret = sqfs_disk_read(start, n_blks, data_buffer);
-			if (ret < 0) {
-				/*
-				 * Possible causes: too many data blocks or too large
-				 * SquashFS block size. Tip: re-compile the SquashFS
-				 * image with mksquashfs's -b <block_size> option.
-				 */
-				printf("Error: too many data blocks to be read.\n");
-				goto out;
-			}
-
-			data = data_buffer + table_offset;
-		}
-
-		/* Load the data */
-		if (finfo.blk_sizes[j] == 0) {
-			/* This is a sparse block */
-			sparse_size = get_unaligned_le32(&sblk->block_size);
-			if ((*actread + sparse_size) > len)
-				sparse_size = len - *actread;
-			memset(buf + *actread, 0, sparse_size);
-			*actread += sparse_size;
-		} else if (SQFS_COMPRESSED_BLOCK(finfo.blk_sizes[j])) {
-			dest_len = get_unaligned_le32(&sblk->block_size);
-			ret = sqfs_decompress(&ctxt, datablock, &dest_len,
-					      data, table_size);
-			if (ret)
-				goto out;
-
-			if ((*actread + dest_len) > len)
-				dest_len = len - *actread;
-			memcpy(buf + *actread, datablock, dest_len);
-			*actread += dest_len;
-		} else {
-			if ((*actread + table_size) > len)
-				table_size = len - *actread;
-			memcpy(buf + *actread, data, table_size);
-			*actread += table_size;
-		}
-
-		data_offset += table_size;
-		free(data_buffer);
-		if (*actread >= len)
-			break;
-	}
+	ret = sqfs_read_data_blocks(&finfo, datablk_count, buf, len, actread);
+	if (ret)
+		goto out;
 
 	/*
 	 * There is no need to continue if the file is not fragmented.
 	 */
-	if (!finfo.frag) {
+	if (!finfo.frag || *actread >= len) {
 		ret = 0;
 		goto out;
 	}
 
-	start = lldiv(frag_entry.start, ctxt.cur_dev->blksz);
-	table_size = SQFS_BLOCK_SIZE(frag_entry.size);
-	table_offset = frag_entry.start - (start * ctxt.cur_dev->blksz);
-	n_blks = DIV_ROUND_UP(table_size + table_offset, ctxt.cur_dev->blksz);
-
-	if (__builtin_mul_overflow(n_blks, ctxt.cur_dev->blksz, &buf_size))
-		return -EINVAL;
-
-	fragment = malloc_cache_aligned(buf_size);
-
-	if (!fragment) {
-		ret = -ENOMEM;
+	ret = sqfs_read_fragment_block(&frag_entry, &fragment);
+	if (ret)
 		goto out;
-	}
 
-	ret = sqfs_disk_read(start, n_blks, fragment);
-	if (ret < 0)
+	if (finfo.offset + len - *actread > fragment->size) {
+		ret = -EINVAL;
 		goto out;
-
-	/* File compressed and fragmented */
-	if (finfo.frag && finfo.comp) {
-		dest_len = get_unaligned_le32(&sblk->block_size);
-		fragment_block = malloc(dest_len);
-		if (!fragment_block) {
-			ret = -ENOMEM;
-			goto out;
-		}
-
-		ret = sqfs_decompress(&ctxt, fragment_block, &dest_len,
-				      (void *)fragment  + table_offset,
-				      frag_entry.size);
-		if (ret) {
-			free(fragment_block);
-			goto out;
-		}
-
-		memcpy(buf + *actread, &fragment_block[finfo.offset], finfo.size - *actread);
-		*actread = finfo.size;
-
-		free(fragment_block);
-
-	} else if (finfo.frag && !finfo.comp) {
-		fragment_block = (void *)fragment + table_offset;
-
-		memcpy(buf + *actread, &fragment_block[finfo.offset], finfo.size - *actread);
-		*actread = finfo.size;
 	}
 
+	memcpy(buf + *actread, fragment->data + finfo.offset, len - *actread);
+	*actread = len;
+
 out:
-	free(fragment);
-	free(datablock);
 	free(file);
 	free(dir);
 	free(finfo.blk_sizes);
@@ -1808,8 +1951,7 @@ void sqfs_closedir(struct fs_dir_stream *dirs)
 		return;
 
 	sqfs_dirs = (struct squashfs_dir_stream *)dirs;
-	free(sqfs_dirs->inode_table);
-	free(sqfs_dirs->dir_table);
+	sqfs_put_tables(sqfs_dirs->tables);
 	free(sqfs_dirs->dir_header);
 	free(sqfs_dirs);
 }
@@ -71,6 +71,28 @@ struct squashfs_super_block {
 	__le64 export_table_start;
 };
 
+/*
+ * Decompressed inode and directory tables of an image. They are shared by all
+ * directory streams opened on the image and by the mount cache, and freed when
+ * the last reference is dropped.
+ */
+struct squashfs_tables {
+	int refs;
+	unsigned char *inode_table;
+	unsigned char *dir_table;
+	/* Directory table metadata block positions, see sqfs_dir_offset() */
+	u32 *pos_list;
+	int metablks_count;
+};
+
+/* A decompressed metadata or fragment block, keyed by its position on disk */
+struct squashfs_cache_entry {
+	u64 start;
+	u32 size;
+	u32 stamp;
+	void *data;
+};
+
 struct squashfs_ctxt {
 	struct disk_partition cur_part_info;
 	struct blk_desc *cur_dev;
@@ -78,6 +100,19 @@ struct squashfs_ctxt {
 #if IS_ENABLED(CONFIG_ZSTD)
 	void *zstd_workspace;
 #endif
+	/*
+	 * Everything below survives sqfs_close() and is only dropped when
+	 * sqfs_probe() finds a different image, so that a series of commands
+	 * on the same filesystem does not re-read and re-decompress it.
+	 */
+	struct blk_desc *cache_dev;
+	lbaint_t cache_part_start;
+	struct squashfs_super_block cache_sblk;
+	struct squashfs_tables *tables;
+	__le64 *frag_index;
+	u32 cache_stamp;
+	struct squashfs_cache_entry meta_cache[CONFIG_SQUASHFS_METADATA_CACHE_SIZE];
+	struct squashfs_cache_entry frag_cache[CONFIG_SQUASHFS_FRAGMENT_CACHE_SIZE];
 };
 
 struct squashfs_directory_index {
@@ -272,10 +307,12 @@ struct squashfs_dir_stream {
 	struct squashfs_ldir_inode i_ldir;
 	/*
 	 * References to the tables' beginnings. They are assigned in
-	 * sqfs_opendir() and freed in sqfs_closedir().
+	 * sqfs_opendir() and belong to 'tables', which is released in
+	 * sqfs_closedir().
 	 */
 	unsigned char *inode_table;
 	unsigned char *dir_table;
+	struct squashfs_tables *tables;
 };
 
 struct squashfs_file_info {
@@ -256,6 +256,15 @@ struct global_data {
 	 */
 	void *dm_priv_base;
 # endif
+# if CONFIG_IS_ENABLED(DM_COMPAT_INDEX)
+	/**
+	 * @dm_compat_index: Hash index of the compatible strings of all
+	 * drivers, used by lists_bind_fdt(). This is NULL until it is first
+	 * needed. An error pointer, also stored if there is no memory to
+	 * build it, disables the index
+	 */
+	struct dm_compat_index *dm_compat_index;
+# endif
 #endif
 #ifdef CONFIG_TIMER
 	/**
@@ -269,6 +278,13 @@ struct global_data {
 	 */
 	struct device_node *of_root;
 #endif
+#if CONFIG_IS_ENABLED(OF_PHANDLE_CACHE)
+	/**
+	 * @fdt_phandle_cache: table for looking up nodes of @fdt_blob by
+	 * phandle, NULL until it is first needed
+	 */
+	struct fdtdec_phandle_cache *fdt_phandle_cache;
+#endif
 #if CONFIG_IS_ENABLED(MULTI_DTB_FIT)
 	/**
 	 * @multi_dtb_fit: pointer to uncompressed multi-dtb FIT image
@@ -80,6 +80,11 @@ struct blk_desc {
 		uint32_t mbr_sig;	/* MBR integer signature */
 		efi_guid_t guid_sig;	/* GPT GUID Signature */
 	};
+	/*
+	 * Bumped on each write or erase, so that data cached from the device,
+	 * e.g. by a filesystem, can tell whether it is still valid
+	 */
+	uint		write_gen;
 #if CONFIG_IS_ENABLED(BLK)
 	/*
 	 * For now we have a few functions which take struct blk_desc as a
@@ -124,6 +129,29 @@ int blkcache_read(int iftype, int dev,
 		  lbaint_t start, lbaint_t blkcnt,
 		  unsigned long blksz, void *buffer);
 
+/**
+ * blkcache_readahead() - work out which blocks to read on a cache miss
+ *
+ * The range is widened to whole cache lines and, if the device is being read
+ * sequentially, extended by a readahead window so that following requests
+ * can be served from the cache.
+ *
+ * @param iftype - uclass_id_x for type of device
+ * @param dev - device index of particular type
+ * @param start - starting block number of the request
+ * @param blkcnt - number of blocks requested
+ * @param blksz - size in bytes of each block
+ * @param lba - number of blocks on the device, or 0 if unknown
+ * @param rstart - returns the first block to read
+ *
+ * Return: number of blocks to read from @rstart, or 0 if the request should
+ * bypass the cache
+ */
+lbaint_t blkcache_readahead(int iftype, int dev,
+			    lbaint_t start, lbaint_t blkcnt,
+			    unsigned long blksz, lbaint_t lba,
+			    lbaint_t *rstart);
+
 /**
  * blkcache_fill() - make data read from a block device available
  * to the block cache
@@ -152,10 +180,11 @@ void blkcache_invalidate(int iftype, int dev);
 /**
  * blkcache_configure() - configure block cache
  *
- * @param blocks - maximum blocks per entry
- * @param entries - maximum entries in cache
+ * @param max_bytes - maximum number of bytes held in the cache
+ * @param max_readahead - maximum number of bytes read ahead of a sequential
+ * reader
  */
-void blkcache_configure(unsigned blocks, unsigned entries);
+void blkcache_configure(unsigned long max_bytes, unsigned long max_readahead);
 
 /*
  * statistics of the block cache
@@ -164,8 +193,20 @@ struct block_cache_stats {
 	unsigned hits;
 	unsigned misses;
 	unsigned entries; /* current entry count */
-	unsigned max_blocks_per_entry;
-	unsigned max_entries;
+	unsigned long bytes; /* bytes currently cached */
+	unsigned long max_bytes;
+	unsigned long max_readahead;
+};
+
+/*
+ * per-device statistics of the block cache
+ */
+struct block_cache_dev_stats {
+	int iftype;
+	int devnum;
+	unsigned hits;
+	unsigned misses;
+	unsigned long readahead; /* blocks read ahead of requests */
 };
 
 /**
@@ -175,6 +216,16 @@ struct block_cache_stats {
  */
 void blkcache_stats(struct block_cache_stats *stats);
 
+/**
+ * blkcache_dev_stats() - return statistics of one device and reset
+ *
+ * @param idx - index of the device, starting at 0
+ * @param stats - statistics are copied here
+ *
+ * Return: 0 if OK, -ENOENT if there are no statistics for @idx
+ */
+int blkcache_dev_stats(int idx, struct block_cache_dev_stats *stats);
+
 /** blkcache_free() - free all memory allocated to the block cache */
 void blkcache_free(void);
 
@@ -187,6 +238,14 @@ static inline int blkcache_read(int iftype, int dev,
 	return 0;
 }
 
+static inline lbaint_t blkcache_readahead(int iftype, int dev,
+					  lbaint_t start, lbaint_t blkcnt,
+					  unsigned long blksz, lbaint_t lba,
+					  lbaint_t *rstart)
+{
+	return 0;
+}
+
 static inline void blkcache_fill(int iftype, int dev,
 				 lbaint_t start, lbaint_t blkcnt,
 				 unsigned long blksz, void const *buffer) {}
@@ -199,6 +258,31 @@ static inline void blkcache_free(void) {}
 
 struct udevice;
 
+/**
+ * struct blk_request - an asynchronous read or write of a block device
+ *
+ * This is set up by blk_submit_read() or blk_submit_write() and then passed to
+ * blk_poll() until the transfer completes. The buffer must stay valid until
+ * then.
+ *
+ * @start:	First block to transfer
+ * @blkcnt:	Number of blocks to transfer
+ * @buffer:	Data buffer
+ * @write:	true to write to the device, false to read from it
+ * @done:	true once the transfer has completed
+ * @result:	Number of blocks transferred, or -ve error, once @done is set
+ * @priv:	Private data for the driver while the transfer is in flight
+ */
+struct blk_request {
+	lbaint_t start;
+	lbaint_t blkcnt;
+	void *buffer;
+	bool write;
+	bool done;
+	long result;
+	void *priv;
+};
+
 /* Operations on block devices */
 struct blk_ops {
 	/**
@@ -258,6 +342,32 @@ struct blk_ops {
 	 */
 	int (*select_hwpart)(struct udevice *dev, int hwpart);
 
+	/**
+	 * submit() - start an asynchronous read or write
+	 *
+	 * This starts the transfer described by @req and returns without
+	 * waiting for it to finish. Drivers which cannot take another request
+	 * at present return -EBUSY, in which case the transfer is carried
+	 * out synchronously with read() or write() instead.
+	 *
+	 * @dev:	Device to use
+	 * @req:	Transfer to start
+	 * @return 0 if OK, -ve on error
+	 */
+	int (*submit)(struct udevice *dev, struct blk_request *req);
+
+	/**
+	 * poll() - make progress on an asynchronous read or write
+	 *
+	 * This must not wait for the device. Once the transfer has finished it
+	 * sets @req->result and then @req->done.
+	 *
+	 * @dev:	Device to use
+	 * @req:	Transfer started with submit()
+	 * @return 0 if OK, -ve on error
+	 */
+	int (*poll)(struct udevice *dev, struct blk_request *req);
+
 #if IS_ENABLED(CONFIG_BOUNCE_BUFFER)
 	/**
 	 * buffer_aligned() - test memory alignment of block operation buffer
@@ -331,6 +441,61 @@ long blk_write(struct udevice *dev, lbaint_t start, lbaint_t blkcnt,
  */
 long blk_erase(struct udevice *dev, lbaint_t start, lbaint_t blkcnt);
 
+/**
+ * blk_submit_read() - Start reading from a block device
+ *
+ * This starts the read and returns without waiting for it, where the driver
+ * supports that, so that other work can be done meanwhile. Otherwise, or if
+ * the data is in the block cache, the read is done before returning. Use
+ * blk_poll() or blk_wait() to get the result.
+ *
+ * @dev: Device to read from
+ * @start: Start block for the read
+ * @blkcnt: Number of blocks to read
+ * @buffer: Place to put the data, which must stay valid until completion
+ * @req: Returns the request in flight
+ * @return 0 if OK, -ve on error
+ */
+int blk_submit_read(struct udevice *dev, lbaint_t start, lbaint_t blkcnt,
+		    void *buffer, struct blk_request *req);
+
+/**
+ * blk_submit_write() - Start writing to a block device
+ *
+ * This is the same as blk_submit_read() but for writing.
+ *
+ * @dev: Device to write to
+ * @start: Start block for the write
+ * @blkcnt: Number of blocks to write
+ * @buffer: Data to write, which must stay valid until completion
+ * @req: Returns the request in flight
+ * @return 0 if OK, -ve on error
+ */
+int blk_submit_write(struct udevice *dev, lbaint_t start, lbaint_t blkcnt,
+		     const void *buffer, struct blk_request *req);
+
+/**
+ * blk_poll() - Check whether an asynchronous read or write has completed
+ *
+ * This does not wait for the device.
+ *
+ * @dev: Device the request was submitted to
+ * @req: Request to check
+ * @return number of blocks transferred (which may be less than requested) once
+ * complete, -EAGAIN if still in progress, or other -ve on error
+ */
+long blk_poll(struct udevice *dev, struct blk_request *req);
+
+/**
+ * blk_wait() - Wait for an asynchronous read or write to complete
+ *
+ * @dev: Device the request was submitted to
+ * @req: Request to wait for
+ * @return number of blocks transferred (which may be less than requested), or
+ * -ve on error
+ */
+long blk_wait(struct udevice *dev, struct blk_request *req);
+
 /**
  * blk_find_device() - Find a block device
  *
@@ -549,6 +714,7 @@ static inline ulong blk_dwrite(struct blk_desc *block_dev, lbaint_t start,
 			       lbaint_t blkcnt, const void *buffer)
 {
 	blkcache_invalidate(block_dev->uclass_id, block_dev->devnum);
+	block_dev->write_gen++;
 	return block_dev->block_write(block_dev, start, blkcnt, buffer);
 }
 
@@ -556,6 +722,7 @@ static inline ulong blk_derase(struct blk_desc *block_dev, lbaint_t start,
 			       lbaint_t blkcnt)
 {
 	blkcache_invalidate(block_dev->uclass_id, block_dev->devnum);
+	block_dev->write_gen++;
 	return block_dev->block_erase(block_dev, start, blkcnt);
 }
 
@@ -266,6 +266,38 @@ struct device_node *of_find_node_by_prop_value(struct device_node *from,
 struct device_node *of_find_node_by_phandle(struct device_node *root,
 					    phandle handle);
 
+#if CONFIG_IS_ENABLED(OF_PHANDLE_CACHE)
+/**
+ * of_phandle_cache_build() - Build the table for looking up nodes by phandle
+ *
+ * This is done when first needed by of_find_node_by_phandle(), but can be
+ * done up front, e.g. when the tree is created.
+ *
+ * @root:	root node of the tree
+ * Return: 0 if OK, -ENOMEM if out of memory
+ */
+int of_phandle_cache_build(struct device_node *root);
+
+/**
+ * of_phandle_cache_reset() - Drop the table for looking up nodes by phandle
+ *
+ * This must be called when a node is removed from a tree, or the tree is
+ * freed or replaced, so that the table is rebuilt when next needed.
+ *
+ * @root:	root node of the tree, or NULL for all trees
+ */
+void of_phandle_cache_reset(const struct device_node *root);
+#else
+static inline int of_phandle_cache_build(struct device_node *root)
+{
+	return 0;
+}
+
+static inline void of_phandle_cache_reset(const struct device_node *root)
+{
+}
+#endif
+
 /**
  * of_read_u8() - Find and read a 8-bit integer from a property
  *
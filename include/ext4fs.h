@@ -36,6 +36,8 @@ struct disk_partition;
 #define EXT4_EXTENTS_FL		0x00080000 /* Inode uses extents */
 #define EXT4_EXT_MAGIC			0xf30a
 
+#define EXT4_FEATURE_COMPAT_DIR_INDEX        0x0020
+
 #define EXT4_FEATURE_RO_COMPAT_SPARSE_SUPER  0x0001
 #define EXT4_FEATURE_RO_COMPAT_LARGE_FILE    0x0002
 #define EXT4_FEATURE_RO_COMPAT_BTREE_DIR     0x0004
@@ -54,6 +56,7 @@ struct disk_partition;
 #define EXT4_FEATURE_INCOMPAT_MMP       0x0100
 #define EXT4_FEATURE_INCOMPAT_FLEX_BG   0x0200
 #define EXT4_FEATURE_INCOMPAT_CSUM_SEED 0x2000
+#define EXT4_FEATURE_INCOMPAT_LARGEDIR  0x4000
 #define EXT4_FEATURE_INCOMPAT_ENCRYPT   0x10000
 
 #define EXT4_INDIRECT_BLOCKS		12
@@ -210,6 +213,21 @@ int ext4fs_devread(lbaint_t sector, int byte_offset, int byte_len, char *buf);
 void ext4fs_set_blk_dev(struct blk_desc *rbdd, struct disk_partition *info);
 long int read_allocated_block(struct ext2_inode *inode, int fileblock,
 			      struct ext_block_cache *cache);
+
+/**
+ * read_allocated_extent() - map a file block through the extent tree
+ *
+ * @inode:	inode of a file using extents
+ * @fileblock:	file block to look up
+ * @cache:	cache for extent tree blocks, or NULL
+ * @countp:	returns the number of file blocks, starting at @fileblock,
+ *		which are consecutive on disk, or which are all holes when the
+ *		return value is 0
+ * Return: disk block of @fileblock, 0 for a hole, -EINVAL if the extent tree
+ *	   is corrupt
+ */
+long int read_allocated_extent(struct ext2_inode *inode, int fileblock,
+			       struct ext_block_cache *cache, uint32_t *countp);
 int ext4fs_probe(struct blk_desc *fs_dev_desc,
 		 struct disk_partition *fs_partition);
 int ext4_read_file(const char *filename, void *buf, loff_t offset, loff_t len,
@@ -219,6 +237,7 @@ int ext4fs_uuid(char *uuid_str);
 void ext_cache_init(struct ext_block_cache *cache);
 void ext_cache_fini(struct ext_block_cache *cache);
 int ext_cache_read(struct ext_block_cache *cache, lbaint_t block, int size);
+void ext_extent_cache_invalidate(void);
 int ext4fs_opendir(const char *dirname, struct fs_dir_stream **dirsp);
 int ext4fs_readdir(struct fs_dir_stream *dirs, struct fs_dirent **dentp);
 void ext4fs_closedir(struct fs_dir_stream *dirs);
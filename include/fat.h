@@ -24,7 +24,14 @@ struct disk_partition;
 #define DIRENTSPERCLUST	((mydata->clust_size * mydata->sect_size) / \
 			 sizeof(dir_entry))
 
+#if defined(CONFIG_XPL_BUILD)
 #define FATBUFBLOCKS	6
+#else
+#define FATBUFBLOCKS	CONFIG_FS_FAT_BUF_SECTORS
+#endif
+#if FATBUFBLOCKS % 3
+#error "FATBUFBLOCKS must be a multiple of 3"
+#endif
 #define FATBUFSIZE	(mydata->sect_size * FATBUFBLOCKS)
 #define FAT12BUFSIZE	((FATBUFSIZE*2)/3)
 #define FAT16BUFSIZE	(FATBUFSIZE/2)
@@ -175,6 +182,7 @@ typedef struct {
 	__u32	root_cluster;	/* First cluster of root dir for FAT32 */
 	u32	total_sect;	/* Number of sectors */
 	int	fats;		/* Number of FATs */
+	u32	vol_id;		/* Volume ID, identifies the mounted volume */
 } fsdata;
 
 struct fat_itr;
@@ -674,6 +674,21 @@ int fdtdec_get_chosen_node(const void *blob, const char *name);
  */
 const char *fdtdec_get_compatible(enum fdt_compat_id id);
 
+/**
+ * fdtdec_node_offset_by_phandle() - Find the node with a given phandle
+ *
+ * This is the same as fdt_node_offset_by_phandle() except that, with
+ * OF_PHANDLE_CACHE, lookups in U-Boot's own device tree use a table, built
+ * when first needed and rebuilt when the tree changes, instead of searching
+ * the whole tree.
+ *
+ * @blob: FDT blob
+ * @phandle: Phandle value
+ * Return: offset of the node, or -FDT_ERR_NOTFOUND if there is no node with
+ * that phandle, or other -ve FDT error
+ */
+int fdtdec_node_offset_by_phandle(const void *blob, uint phandle);
+
 /* Look up a phandle and follow it to its node. Then return the offset
  * of that node.
  *
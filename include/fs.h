@@ -283,6 +283,29 @@ int fs_mkdir(const char *filename);
  */
 int fs_rename(const char *old_path, const char *new_path);
 
+/**
+ * fs_load_decomp() - Load a file, decompressing it while it is read
+ *
+ * A gzip, lz4 or zstd compressed file is read in chunks which are
+ * decompressed straight to @addr, so that the compressed file needs no space
+ * of its own. With CONFIG_UTHREAD reading runs in a separate thread. Other
+ * compressed files are read into a temporary buffer first and files which are
+ * not compressed are read as they are.
+ *
+ * @ifname: Interface name to read from (e.g. "mmc")
+ * @dev_part_str: Device and partition string (e.g. "1:2")
+ * @fstype: Filesystem type to use (FS_TYPE_...)
+ * @fname: Filename to read
+ * @addr: Address to decompress to
+ * @max_size: Maximum decompressed size, 0 for all the memory available
+ * @sizep: Returns the decompressed size
+ * Return: 0 if OK, -ENOMEDIUM if the device does not exist, -ENOENT if the
+ * file does not exist, -ENOSPC if the decompressed file is too large, other
+ * -ve value on error
+ */
+int fs_load_decomp(const char *ifname, const char *dev_part_str, int fstype,
+		   const char *fname, ulong addr, ulong max_size, ulong *sizep);
+
 /*
  * Common implementation for various filesystem commands, optionally limited
  * to a specific filesystem type via the fstype parameter.
@@ -1013,6 +1013,82 @@ int image_decomp(int comp, ulong load, ulong image_start, int type,
 		 void *load_buf, void *image_buf, ulong image_len,
 		 uint unc_len, ulong *load_end);
 
+/**
+ * struct image_decomp_stream - state of a streaming decompression
+ *
+ * @comp:	Compression algorithm that is used (IH_COMP_...)
+ * @out:	Place to decompress to
+ * @out_size:	Available space at @out
+ * @out_len:	Number of bytes decompressed so far
+ * @done:	true if the data so far ends with a complete frame
+ * @ended:	true once data which is not a frame follows the last frame,
+ *		after which the rest is ignored
+ * @priv:	Decompressor state
+ */
+struct image_decomp_stream {
+	int comp;
+	void *out;
+	ulong out_size;
+	ulong out_len;
+	bool done;
+	bool ended;
+	void *priv;
+};
+
+/**
+ * image_decomp_stream_supported() - check for streaming decompression
+ *
+ * @comp:	Compression algorithm (IH_COMP_...)
+ * Return: true if @comp can be decompressed with image_decomp_stream_write()
+ */
+bool image_decomp_stream_supported(int comp);
+
+/**
+ * image_decomp_stream_start() - start a streaming decompression
+ *
+ * Only gzip, lz4 (with independent blocks) and zstd are supported. The
+ * decompressed data is written straight to @out, so no copy of the whole
+ * compressed image is needed.
+ *
+ * @st:		Stream state to set up
+ * @comp:	Compression algorithm (IH_COMP_...)
+ * @out:	Place to decompress to
+ * @out_size:	Available space at @out
+ * Return: 0 if OK, -EPROTONOSUPPORT if @comp is not supported
+ */
+int image_decomp_stream_start(struct image_decomp_stream *st, int comp,
+			      void *out, ulong out_size);
+
+/**
+ * image_decomp_stream_write() - decompress the next chunk of a stream
+ *
+ * The chunks may have any size, except that the first one must hold the
+ * whole gzip header. The zstd and lz4 data may hold several frames back to
+ * back, including skippable frames, as for zstd_decompress() and ulz4fn().
+ * Data after the last frame which does not start with a frame magic is
+ * ignored, as is anything after the gzip stream.
+ *
+ * @st:		Stream state
+ * @in:		Compressed data
+ * @len:	Number of bytes at @in
+ * Return: 0 if OK, -ENOSPC if the output does not fit, -ENOMEM if out of
+ *	memory, other -ve value on corrupt data
+ */
+int image_decomp_stream_write(struct image_decomp_stream *st, const void *in,
+			      ulong len);
+
+/**
+ * image_decomp_stream_finish() - finish a streaming decompression
+ *
+ * This frees the decompressor state and must be called once for each
+ * image_decomp_stream_start(), also after an error.
+ *
+ * @st:		Stream state
+ * @out_len:	Returns the number of bytes decompressed (may be NULL)
+ * Return: 0 if OK, -EINVAL if the compressed stream was truncated
+ */
+int image_decomp_stream_finish(struct image_decomp_stream *st, ulong *out_len);
+
 /**
  * Set up properties in the FDT
  *
@@ -1106,6 +1182,7 @@ int booti_setup(ulong image, ulong *relocated_addr, ulong *size,
 #define FIT_PHASE_PROP		"phase"
 
 #define FIT_MAX_HASH_LEN	HASH_MAX_DIGEST_SIZE
+#define FIT_MAX_HASH_NODES	4
 
 /* cmdline argument format parsing */
 int fit_parse_conf(const char *spec, ulong addr_curr,
@@ -1341,6 +1418,87 @@ int fit_image_verify_with_data(const void *fit, int image_noffset,
 			       const void *key_blob, const void *data,
 			       size_t size);
 
+struct hash_algo;
+
+/**
+ * struct fit_image_hash - digest of one hash node, calculated progressively
+ *
+ * @noffset:	Offset of the hash node
+ * @algo:	Hash algorithm
+ * @ctx:	Context of @algo, NULL once finished or on error
+ * @value:	Digest, valid once @value_len is non-zero
+ * @value_len:	Length of the digest
+ */
+struct fit_image_hash {
+	int noffset;
+	struct hash_algo *algo;
+	void *ctx;
+	uint8_t value[FIT_MAX_HASH_LEN];
+	int value_len;
+};
+
+/**
+ * struct fit_image_hashes - digests of an image, calculated progressively
+ *
+ * This allows hashing the data of an image while it is loaded, chunk by
+ * chunk, and calculates all the digests of an image in one pass over the
+ * data. Hash nodes which cannot be handled this way (e.g. with DM_HASH) are
+ * left out and hashed by fit_image_verify_hashed() as before.
+ *
+ * @count:	Number of entries in @hash
+ * @hash:	State of each hash node
+ */
+struct fit_image_hashes {
+	int count;
+	struct fit_image_hash hash[FIT_MAX_HASH_NODES];
+};
+
+/**
+ * fit_image_hash_start() - start hashing the data of an image
+ *
+ * @fit:	Pointer to the FIT format image header
+ * @image_noffset: Offset of the image node
+ * @hashes:	Returns the hashing state
+ */
+void fit_image_hash_start(const void *fit, int image_noffset,
+			  struct fit_image_hashes *hashes);
+
+/**
+ * fit_image_hash_update() - hash the next part of the data of an image
+ *
+ * @hashes:	Hashing state
+ * @data:	Next part of the image data
+ * @size:	Size of @data
+ * @last:	true if this is the last part
+ */
+void fit_image_hash_update(struct fit_image_hashes *hashes, const void *data,
+			   size_t size, bool last);
+
+/**
+ * fit_image_hash_finish() - finish hashing the data of an image
+ *
+ * @hashes:	Hashing state
+ */
+void fit_image_hash_finish(struct fit_image_hashes *hashes);
+
+/**
+ * fit_image_verify_hashed() - Verify an image with digests already calculated
+ *
+ * This is fit_image_verify_with_data() for data which has been hashed with
+ * fit_image_hash_update() already, e.g. while it was loaded.
+ *
+ * @fit:	Pointer to the FIT format image header
+ * @image_noffset: Offset in @fit of image to verify
+ * @key_blob:	FDT containing public keys
+ * @data:	Image data to verify
+ * @size:	Size of image data
+ * @hashes:	Digests from fit_image_hash_finish()
+ * Return: 1 if the image is valid, 0 otherwise
+ */
+int fit_image_verify_hashed(const void *fit, int image_noffset,
+			    const void *key_blob, const void *data,
+			    size_t size, const struct fit_image_hashes *hashes);
+
 int fit_image_verify(const void *fit, int noffset);
 #if CONFIG_IS_ENABLED(FIT_SIGNATURE)
 int fit_config_verify(const void *fit, int conf_noffset);
@@ -449,6 +449,11 @@ struct abuf;
 /**
  * zstd_decompress() - Decompress Zstandard data
  *
+ * The input may hold several frames back to back, which are decompressed one
+ * after the other. When all of them record their decompressed size and
+ * CONFIG_WORKERS is enabled, they are decompressed in parallel instead.
+ * Anything after the last frame is ignored.
+ *
  * @in: Input buffer to decompress
  * @out: Output buffer to hold the results (must be large enough)
  * Return: size of the decompressed data, or -ve on error
@@ -208,6 +208,7 @@ static inline bool mmc_is_tuning_cmd(uint cmdidx)
 /*
  * EXT_CSD fields
  */
+#define EXT_CSD_CMDQ_MODE_EN		15	/* R/W */
 #define EXT_CSD_BOOT_SIZE_MULT_MICRON	125	/* R/W, vendor specific field */
 #define EXT_CSD_ENH_START_ADDR		136	/* R/W */
 #define EXT_CSD_ENH_SIZE_MULT		140	/* R/W */
@@ -239,6 +240,8 @@ static inline bool mmc_is_tuning_cmd(uint cmdidx)
 #define EXT_CSD_BOOT_MULT		226	/* RO */
 #define EXT_CSD_SEC_FEATURE		231	/* RO */
 #define EXT_CSD_GENERIC_CMD6_TIME       248     /* RO */
+#define EXT_CSD_CMDQ_DEPTH		307	/* RO */
+#define EXT_CSD_CMDQ_SUPPORT		308	/* RO */
 #define EXT_CSD_BKOPS_SUPPORT		502	/* RO */
 
 /*
@@ -451,6 +454,20 @@ struct mmc_data {
 	uint blocksize;
 };
 
+/* Most tasks in a command queue, as for an eMMC 5.1 device */
+#define MMC_CQE_MAX_TASKS	32
+
+/**
+ * struct mmc_cqe_task - a data transfer queued with command queueing
+ *
+ * @addr:	Card address, as used as argument of a read or write command
+ * @data:	Data to transfer; @data.flags gives the direction
+ */
+struct mmc_cqe_task {
+	uint addr;
+	struct mmc_data data;
+};
+
 /* forward decl. */
 struct mmc;
 
@@ -572,6 +589,23 @@ struct dm_mmc_ops {
 	 * @return 0 if success, -ve on error
 	 */
 	int (*hs400_prepare_ddr)(struct udevice *dev);
+
+#if CONFIG_IS_ENABLED(MMC_CQE)
+	/**
+	 * cqe_request() - run data transfers through the command queue
+	 *
+	 * The tasks are all put in the queue of the host's command queueing
+	 * engine (CQE), which issues them to the card and may complete them
+	 * in any order. The card has command queueing enabled already.
+	 *
+	 * @dev:	Device to use
+	 * @tasks:	Tasks to run
+	 * @count:	Number of tasks, at most the card's queue depth
+	 * @return 0 when all tasks are done, -ve on error
+	 */
+	int (*cqe_request)(struct udevice *dev, struct mmc_cqe_task *tasks,
+			   int count);
+#endif
 };
 
 #define mmc_get_ops(dev)        ((struct dm_mmc_ops *)(dev)->driver->ops)
@@ -590,6 +624,8 @@ int mmc_reinit(struct mmc *mmc);
 int mmc_get_b_max(struct mmc *mmc, void *dst, lbaint_t blkcnt);
 int mmc_hs400_prepare_ddr(struct mmc *mmc);
 int mmc_send_stop_transmission(struct mmc *mmc, bool write);
+bool mmc_cqe_supported(struct mmc *mmc);
+int mmc_cqe_request(struct mmc *mmc, struct mmc_cqe_task *tasks, int count);
 
 #else
 struct mmc_ops {
@@ -720,6 +756,9 @@ struct mmc {
 	u8 part_config;
 	u8 gen_cmd6_time;	/* units: 10 ms */
 	u8 part_switch_time;	/* units: 10 ms */
+#if CONFIG_IS_ENABLED(MMC_CQE)
+	u8 cmdq_depth;		/* command queue depth, 0 if not supported */
+#endif
 	uint tran_speed;
 	uint legacy_speed; /* speed for the legacy mode provided by the card */
 	uint read_bl_len;
@@ -116,6 +116,8 @@ struct ip_udp_hdr {
 
 extern int		net_restart_wrap;	/* Tried all network devices */
 extern uchar               *net_rx_packets[PKTBUFSRX]; /* Receive packets */
+/* The device has checked the UDP/TCP checksum of the packet being received */
+extern bool		net_rx_csum_valid;
 extern const u8		net_bcast_ethaddr[ARP_HLEN];	/* Ethernet broadcast address */
 extern char	net_boot_file_name[1024];/* Boot File name */
 extern struct in_addr	net_ip;		/* Our    IP addr (0 = unknown) */
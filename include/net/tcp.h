@@ -86,7 +86,7 @@ struct ip_tcp_hdr {
 #define TCP_OPT_LEN_8	0x08
 #define TCP_OPT_LEN_A	0x0a		/* Timestamp Length		*/
 #define TCP_MSS		1460		/* Max segment size		*/
-#define TCP_SCALE	0x01		/* Scale			*/
+#define TCP_SCALE_MAX	14		/* Max window scale (RFC 7323)	*/
 
 /**
  * struct tcp_mss - TCP option structure for MSS (Max segment size)
@@ -306,7 +306,8 @@ enum tcp_status {
  * @rx_inactiv_timeout:	Maximum time from last rx till connection drop
  *			  (default 30 sec)
  *
- * @on_closed:		User callback, called just before destroying TCP stream
+ * @on_closed:		User callback, called when destroying TCP stream. It
+ *			  gets a copy of the stream and may open new streams
  * @on_established:	User callback, called when TCP stream enters
  *			  TCP_ESTABLISHED state
  * @on_rcv_nxt_update:	User callback, called when all data in the segment
@@ -358,6 +359,12 @@ enum tcp_status {
  * @rmt_timestamp:	Remote timestamp
  *
  * @rmt_win_scale:	Remote window scale factor
+ * @loc_win_scale:	Local window scale factor, 0 unless both sides sent
+ *			  the window scale option
+ *
+ * @ack_pending:	Number of received segments not acknowledged yet
+ * @ack_time:		Arrival time of the first unacknowledged segment (ticks)
+ * @sack_recent:	TCP sequence of the most recently received segment
  *
  * @lost:		Used for SACK
  *
@@ -420,8 +427,14 @@ struct tcp_stream {
 
 	/* TCP window scale */
 	u8		rmt_win_scale;
+	u8		loc_win_scale;
+
+	/* delayed acknowledge */
+	u32		ack_pending;
+	ulong		ack_time;
 
 	/* TCP sliding window control used to request re-TX */
+	u32		sack_recent;
 	struct tcp_sack_v lost;
 
 	/* used for data retransmission */
@@ -22,6 +22,14 @@ void tftp_start(enum proto_t protocol);	/* Begin TFTP get/put */
 void tftp_start_server(void);	/* Wait for incoming TFTP put */
 #endif
 
+#ifdef CONFIG_TFTP_MULTICAST
+void tftp_mcast_cleanup(void);	/* Leave the multicast group, if any */
+#else
+static inline void tftp_mcast_cleanup(void)
+{
+}
+#endif
+
 extern ulong tftp_timeout_ms;
 extern int tftp_timeout_count_max;
 
@@ -11,3 +11,4 @@ void wget_start(void);
 #define DEBUG_WGET		0	/* Set to 1 for debug messages */
 #define WGET_RETRY_COUNT	30
 #define WGET_TIMEOUT		2000UL
+#define WGET_RESUME_COUNT	3	/* reconnects after a lost connection */
@@ -58,6 +58,61 @@ off_t os_lseek(int fd, off_t offset, int whence);
 #define OS_SEEK_CUR	1
 #define OS_SEEK_END	2
 
+/**
+ * os_aio_start() - start reading or writing a file without waiting
+ *
+ * This uses the Linux asynchronous I/O system calls.
+ *
+ * @fd:		File descriptor as returned by os_open()
+ * @buf:	Buffer for the data
+ * @count:	Number of bytes to transfer
+ * @offset:	File offset to start at
+ * @write:	true to write @buf to the file, false to read into it
+ * @handlep:	Returns a handle to pass to os_aio_poll()
+ * Return:	0 if OK, -errno on error
+ */
+int os_aio_start(int fd, void *buf, size_t count, off_t offset, bool write,
+		 void **handlep);
+
+/**
+ * os_aio_poll() - check whether a transfer from os_aio_start() is done
+ *
+ * This does not wait. Once the transfer is done, the handle is freed.
+ *
+ * @handle:	Handle from os_aio_start()
+ * @resultp:	Returns the number of bytes transferred, or -errno on error
+ * Return:	0 if done, -EAGAIN if still in progress
+ */
+int os_aio_poll(void *handle, ssize_t *resultp);
+
+/**
+ * os_thread_create() - start a host thread
+ *
+ * The thread runs U-Boot code concurrently with the main thread, so it must
+ * only touch memory which is not used by anything else meanwhile.
+ *
+ * @func:	Function to run in the thread
+ * @arg:	Argument to pass to @func
+ * @threadp:	Returns a handle to pass to os_thread_join()
+ * Return:	0 if OK, -errno on error
+ */
+int os_thread_create(void *(*func)(void *arg), void *arg, void **threadp);
+
+/**
+ * os_thread_join() - wait for a thread from os_thread_create() to return
+ *
+ * @thread:	Handle from os_thread_create()
+ * Return:	0 if OK, -errno on error
+ */
+int os_thread_join(void *thread);
+
+/**
+ * os_get_nprocs() - get the number of CPUs available on the host
+ *
+ * Return:	number of online CPUs, at least 1
+ */
+int os_get_nprocs(void);
+
 /**
  * os_filesize() - Calculate the size of a file
  *
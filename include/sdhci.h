@@ -21,6 +21,7 @@
  */
 
 #define SDHCI_DMA_ADDRESS	0x00
+#define SDHCI_32BIT_BLK_CNT	SDHCI_DMA_ADDRESS
 
 #define SDHCI_BLOCK_SIZE	0x04
 #define  SDHCI_MAKE_BLKSZ(dma, blksz) (((dma & 0x7) << 12) | (blksz & 0xFFF))
@@ -166,6 +167,8 @@
 #define  SDHCI_CTRL_DRV_TYPE_D	0x0030
 #define  SDHCI_CTRL_EXEC_TUNING	0x0040
 #define  SDHCI_CTRL_TUNED_CLK	0x0080
+#define  SDHCI_CTRL_V4_MODE	0x1000
+#define  SDHCI_CTRL_64BIT_ADDR	0x2000
 #define  SDHCI_CTRL_PRESET_VAL_ENABLE	0x8000
 
 #define SDHCI_CAPABILITIES	0x40
@@ -223,6 +226,8 @@
 #define   SDHCI_SPEC_100	0
 #define   SDHCI_SPEC_200	1
 #define   SDHCI_SPEC_300	2
+#define   SDHCI_SPEC_400	3
+#define   SDHCI_SPEC_410	4
 
 #define SDHCI_GET_VERSION(x) (x->version & SDHCI_SPEC_VER_MASK)
 
@@ -302,13 +307,23 @@ struct sdhci_ops {
 #define ADMA_MAX_LEN	65532
 #ifdef CONFIG_MMC_SDHCI_ADMA_64BIT
 #define ADMA_DESC_LEN	12
+/* in version 4 mode 64-bit descriptors are padded to 128 bits */
+#define ADMA_DESC_V4_LEN	16
 #else
 #define ADMA_DESC_LEN	8
+#define ADMA_DESC_V4_LEN	8
 #endif
-#define ADMA_TABLE_NO_ENTRIES DIV_ROUND_UP(CONFIG_SYS_MMC_MAX_BLK_COUNT * \
+#define ADMA_TABLE_NO_ENTRIES DIV_ROUND_UP(CONFIG_MMC_SDHCI_ADMA_MAX_BLK_COUNT * \
 			      MMC_MAX_BLOCK_LEN, ADMA_MAX_LEN)
 
-#define ADMA_TABLE_SZ (ADMA_TABLE_NO_ENTRIES * ADMA_DESC_LEN)
+/* only version 4 mode pads the descriptors, see sdhci_adma_write_desc() */
+#ifdef CONFIG_MMC_SDHCI_V4_MODE
+#define ADMA_DESC_MAX_LEN	ADMA_DESC_V4_LEN
+#else
+#define ADMA_DESC_MAX_LEN	ADMA_DESC_LEN
+#endif
+
+#define ADMA_TABLE_SZ (ADMA_TABLE_NO_ENTRIES * ADMA_DESC_MAX_LEN)
 
 /* Decriptor table defines */
 #define ADMA_DESC_ATTR_VALID		BIT(0)
@@ -358,6 +373,7 @@ struct sdhci_host {
 #define USE_ADMA	(0x1 << 1)
 #define USE_ADMA64	(0x1 << 2)
 #define USE_DMA		(USE_SDMA | USE_ADMA | USE_ADMA64)
+#define USE_V4_MODE	(0x1 << 3)
 	dma_addr_t adma_addr;
 #if CONFIG_IS_ENABLED(MMC_SDHCI_ADMA)
 	struct sdhci_adma_desc *adma_desc_table;
@@ -44,9 +44,19 @@ struct env_entry {
 
 /* Data type for reentrant functions.  */
 struct hsearch_data {
-	struct env_entry_node *table;
+	/* open addressing table of the entries, NULL if not created */
+	struct env_entry_node **table;
+	/* number of slots in the table, a power of two */
 	unsigned int size;
+	/* number of entries */
 	unsigned int filled;
+	/* number of slots of deleted entries */
+	unsigned int deleted;
+	/* the entries sorted by key, and the room for them */
+	struct env_entry_node **sorted;
+	unsigned int sorted_size;
+	/* memory of the imported entries */
+	struct env_arena *arenas;
 /*
  * Callback function which will check whether the given change for variable
  * "item" to "newval" may be applied or not, and possibly apply such change.
@@ -58,7 +68,10 @@ struct hsearch_data {
 			 enum env_op, int flag);
 };
 
-/* Create a new hash table which will contain at most "nel" elements.  */
+/*
+ * Create a new hash table with room for "nel" elements. It grows when more
+ * are entered.
+ */
 int hcreate_r(size_t nel, struct hsearch_data *htab);
 
 /* Destroy current internal hash table.  */
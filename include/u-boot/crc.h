@@ -88,6 +88,22 @@ uint32_t crc32_wd(uint32_t crc, const unsigned char *buf, uint len,
  */
 uint32_t crc32_no_comp(uint32_t crc, const unsigned char *buf, uint len);
 
+/**
+ * crc32_no_comp_generic - Calculate the CRC32 in software (no one's compliment)
+ *
+ * This is the portable implementation behind crc32_no_comp(). Architecture
+ * code which provides an accelerated crc32_no_comp() calls it when the
+ * required instructions are not available, or for short buffers.
+ *
+ * @crc: Input crc to chain from a previous calculution (use 0 to start a new
+ *	calculation)
+ * @buf: Bytes to checksum
+ * @len: Number of bytes to checksum
+ * Return: checksum value
+ */
+uint32_t crc32_no_comp_generic(uint32_t crc, const unsigned char *buf,
+			       uint len);
+
 /**
  * crc32_wd_buf - Perform CRC32 on a buffer and return result in buffer
  *
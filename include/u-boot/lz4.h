@@ -9,6 +9,9 @@
 /**
  * ulz4fn() - Decompress LZ4 data
  *
+ * @src may hold several frames back to back, which are decompressed one after
+ * the other. Anything after the last frame is ignored.
+ *
  * @src: Source data to decompress
  * @srcn: Length of source data
  * @dst: Destination for uncompressed data
@@ -21,6 +24,31 @@
  */
 int ulz4fn(const void *src, size_t srcn, void *dst, size_t *dstn);
 
+/**
+ * ulz4fn_parallel() - Decompress LZ4 data, using all available CPUs
+ *
+ * This is the same as ulz4fn(), except that when @src holds several frames
+ * which all record their content size, the frames are decompressed in
+ * parallel by the worker pool (see workers.h). Otherwise, or without
+ * CONFIG_WORKERS, this just calls ulz4fn(). The data must not be decompressed
+ * in place.
+ *
+ * @src: Source data to decompress
+ * @srcn: Length of source data
+ * @dst: Destination for uncompressed data
+ * @dstn: Size of the destination buffer, returns length of uncompressed data
+ * Return: 0 if OK, -ve on error, see ulz4fn()
+ */
+#if CONFIG_IS_ENABLED(WORKERS)
+int ulz4fn_parallel(const void *src, size_t srcn, void *dst, size_t *dstn);
+#else
+static inline int ulz4fn_parallel(const void *src, size_t srcn, void *dst,
+				  size_t *dstn)
+{
+	return ulz4fn(src, srcn, dst, dstn);
+}
+#endif
+
 /**
  * LZ4_decompress_safe() - Decompression protected against buffer overflow
  * @source: source address of the compressed data
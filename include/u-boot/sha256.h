@@ -37,6 +37,31 @@ void sha256_finish(sha256_context * ctx, uint8_t digest[SHA256_SUM_LEN]);
 void sha256_csum_wd(const unsigned char *input, unsigned int ilen,
 		unsigned char *output, unsigned int chunk_sz);
 
+#if !CONFIG_IS_ENABLED(MBEDTLS_LIB_CRYPTO)
+/**
+ * sha256_process() - Hash whole 64-byte blocks into the state
+ *
+ * Architecture code may provide an accelerated version of this, which calls
+ * sha256_process_generic() when the instructions it needs are missing.
+ *
+ * @ctx: SHA-256 context
+ * @data: Blocks to hash
+ * @blocks: Number of blocks
+ */
+void sha256_process(sha256_context *ctx, const unsigned char *data,
+		    unsigned int blocks);
+
+/**
+ * sha256_process_generic() - Hash whole 64-byte blocks in software
+ *
+ * @ctx: SHA-256 context
+ * @data: Blocks to hash
+ * @blocks: Number of blocks
+ */
+void sha256_process_generic(sha256_context *ctx, const unsigned char *data,
+			    unsigned int blocks);
+#endif
+
 int sha256_hmac(const unsigned char *key, int keylen,
 		const unsigned char *input, unsigned int ilen,
 		unsigned char *output);
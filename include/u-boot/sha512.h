@@ -37,6 +37,32 @@ void sha512_finish(sha512_context * ctx, uint8_t digest[SHA512_SUM_LEN]);
 void sha512_csum_wd(const unsigned char *input, unsigned int ilen,
 		unsigned char *output, unsigned int chunk_sz);
 
+#if !CONFIG_IS_ENABLED(MBEDTLS_LIB_CRYPTO)
+/**
+ * sha512_process() - Hash whole 128-byte blocks into the state
+ *
+ * This is shared by SHA-384 and SHA-512. Architecture code may provide an
+ * accelerated version of it, which calls sha512_process_generic() when the
+ * instructions it needs are missing.
+ *
+ * @ctx: SHA-384 or SHA-512 context
+ * @data: Blocks to hash
+ * @blocks: Number of blocks
+ */
+void sha512_process(sha512_context *ctx, const unsigned char *data,
+		    unsigned int blocks);
+
+/**
+ * sha512_process_generic() - Hash whole 128-byte blocks in software
+ *
+ * @ctx: SHA-384 or SHA-512 context
+ * @data: Blocks to hash
+ * @blocks: Number of blocks
+ */
+void sha512_process_generic(sha512_context *ctx, const unsigned char *data,
+			    unsigned int blocks);
+#endif
+
 extern const uint8_t sha384_der_prefix[];
 
 void sha384_starts(sha512_context * ctx);
@@ -661,6 +661,16 @@ ZEXTERN int ZEXPORT inflateEnd OF((z_streamp strm));
 
 ZEXTERN int ZEXPORT inflateReset OF((z_streamp strm));
 
+ZEXTERN int ZEXPORT inflateChunk OF((z_streamp strm, int enable));
+/*
+     Selects whether the wide-copy fast path (ZLIB_INFLATE_CHUNK) is used,
+   which it is by default when it is built in. Disabling it falls back to the
+   stock inflate_fast(), so that both can be compared.
+
+     inflateChunk returns Z_OK if success, or Z_STREAM_ERROR if the stream
+   state was inconsistent or the fast path was requested but is not built in.
+*/
+
                         /* utility functions */
 
 /*
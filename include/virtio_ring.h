@@ -63,6 +63,8 @@ struct vring_desc_shadow {
 	u16 next;
 	/* Metadata about the descriptor. */
 	bool chain_head;
+	/* Indirect table this chain head points to, if any */
+	struct vring_desc *indir_desc;
 };
 
 struct vring_avail {
@@ -103,6 +105,7 @@ struct vring {
  * @vring: actual memory layout for this queue
  * @vring_desc_shadow: guest-only copy of descriptors
  * @event: host publishes avail event idx
+ * @indirect: host supports indirect descriptor tables
  * @free_head: head of free buffer list
  * @num_added: number we've added since last sync
  * @last_used_idx: last used index we've seen
@@ -117,6 +120,7 @@ struct virtqueue {
 	struct vring vring;
 	struct vring_desc_shadow *vring_desc_shadow;
 	bool event;
+	bool indirect;
 	unsigned int free_head;
 	unsigned int num_added;
 	u16 last_used_idx;
@@ -187,6 +191,9 @@ struct virtio_sg;
  * @in_sgs:	the number of scatterlists which are writable
  *		(after readable ones)
  *
+ * If the host supports indirect descriptors, a chain of several buffers takes
+ * up a single descriptor in the ring.
+ *
  * Caller must ensure we don't call this with other virtqueue operations
  * at the same time (except where noted).
  *
@@ -201,7 +208,9 @@ int virtqueue_add(struct virtqueue *vq, struct virtio_sg *sgs[],
  * @vq:		the struct virtqueue
  *
  * After one or more virtqueue_add() calls, invoke this to kick
- * the other side.
+ * the other side. Adding a batch of buffers before kicking saves
+ * notifications, and with VIRTIO_RING_F_EVENT_IDX the host is only
+ * notified if it asked to be.
  *
  * Caller must ensure we don't call this with other virtqueue
  * operations at the same time (except where noted).
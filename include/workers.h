@@ -0,0 +1,137 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Running independent jobs in parallel on secondary CPUs
+ */
+
+#ifndef _WORKERS_H_
+#define _WORKERS_H_
+
+#include <linux/types.h>
+
+/**
+ * DOC: Overview
+ *
+ * The worker pool runs a number of independent jobs on all the CPUs that are
+ * available to U-Boot: the boot CPU and, when the architecture provides a
+ * backend, secondary CPUs (or host threads on sandbox). The boot CPU takes
+ * part in the work, so workers_run() only returns once every job is done.
+ *
+ * Jobs run outside of the normal U-Boot environment. They may only compute on
+ * memory which the caller set up for them: they must not allocate memory,
+ * print, access devices or call anything else which relies on global state.
+ * Anything a job needs, such as a decompression workspace, must be allocated
+ * by the caller beforehand, one per worker.
+ *
+ * CONFIG_WORKERS in lib/Kconfig enables the worker pool. Without it, or when
+ * no secondary CPU is available, workers_run() runs all jobs in a loop on the
+ * boot CPU so callers do not need to care.
+ */
+
+/**
+ * typedef workers_fn - Job function run by workers_run()
+ *
+ * @priv: Private data passed to workers_run()
+ * @job: Index of the job to run, from 0 to the job count minus 1
+ * @worker: Index of the worker running the job, from 0 (the boot CPU) to
+ *	workers_count() minus 1
+ * Return: 0 if OK, -ve on error
+ */
+typedef int (*workers_fn)(void *priv, uint job, uint worker);
+
+#if CONFIG_IS_ENABLED(WORKERS)
+/**
+ * workers_count() - Get the number of workers, including the boot CPU
+ *
+ * Return: number of workers which may run jobs, at least 1
+ */
+uint workers_count(void);
+
+/**
+ * workers_set_limit() - Limit the number of workers used by workers_run()
+ *
+ * @limit: Maximum number of workers, including the boot CPU, or 0 to use all
+ *	of them
+ */
+void workers_set_limit(uint limit);
+
+/**
+ * workers_run() - Run jobs in parallel
+ *
+ * Each job is run exactly once, in no particular order. If a job is already
+ * running in the pool (i.e. a job calls this function), the jobs are run on
+ * the calling CPU only.
+ *
+ * @fn: Function to run for each job
+ * @priv: Private data to pass to @fn
+ * @count: Number of jobs
+ * Return: 0 if all jobs succeeded, else the error returned by one of the
+ *	failing jobs
+ */
+int workers_run(workers_fn fn, void *priv, uint count);
+
+/*
+ * Architecture backend, implemented by arch code (the weak default provides
+ * no secondary worker)
+ */
+
+/**
+ * workers_arch_max() - Get the number of secondary workers the backend has
+ *
+ * Return: number of workers which workers_arch_start() may start
+ */
+uint workers_arch_max(void);
+
+/**
+ * workers_arch_start() - Start secondary workers
+ *
+ * Each secondary worker calls workers_secondary() with its index and stops
+ * once that returns.
+ *
+ * @count: Number of workers to start, from 1 to workers_arch_max()
+ * Return: 0 if OK, -ve on error, in which case no worker was started
+ */
+int workers_arch_start(uint count);
+
+/**
+ * workers_arch_wait() - Wait for secondary workers to stop
+ *
+ * This waits until workers_secondary() has returned on all the workers
+ * started by workers_arch_start().
+ */
+void workers_arch_wait(void);
+
+/**
+ * workers_secondary() - Run jobs on a secondary worker
+ *
+ * This is called by the architecture backend on each secondary worker which
+ * it started and returns once no job is left to be started.
+ *
+ * @worker: Index of the worker, from 1 to the number of workers started
+ */
+void workers_secondary(uint worker);
+#else
+static inline uint workers_count(void)
+{
+	return 1;
+}
+
+static inline void workers_set_limit(uint limit)
+{
+}
+
+static inline int workers_run(workers_fn fn, void *priv, uint count)
+{
+	uint i;
+	int ret;
+
+	for (i = 0; i < count; i++) {
+		ret = fn(priv, i, 0);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+#endif
+
+#endif /* _WORKERS_H_ */
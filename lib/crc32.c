@@ -14,6 +14,7 @@
 #include <efi_loader.h>
 #endif
 #include <compiler.h>
+#include <linux/compiler_attributes.h>
 #include <u-boot/crc.h>
 
 #if defined(CONFIG_HW_WATCHDOG) || defined(CONFIG_WATCHDOG)
@@ -82,7 +83,7 @@ static void __efi_runtime make_crc_table(void)
   }
   crc_table_empty = 0;
 }
-#elif !defined(CONFIG_ARM64_CRC32)
+#else
 /* ========================================================================
  * Table of CRC-32's of all single-byte values (made by make_crc_table)
  */
@@ -177,17 +178,45 @@ const uint32_t * ZEXPORT get_crc_table()
 
 /* ========================================================================= */
 
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+#ifdef USE_HOSTCC
+#define CRC_SLICE_BY_8
+#elif CONFIG_IS_ENABLED(CRC32_SLICE8)
+#define CRC_SLICE_BY_8
+#endif
+#endif
+
+#ifdef CRC_SLICE_BY_8
+/*
+ * Tables for slice-by-8: crc_slice[k][n] is the CRC of byte n followed by
+ * k + 1 zero bytes, so that eight input bytes can be folded into the CRC
+ * with eight independent lookups instead of eight dependent ones.
+ */
+static int __efi_runtime_data crc_slice_empty = 1;
+static uint32_t __efi_runtime_data crc_slice[7][256];
+
+static void __efi_runtime make_crc_slice_table(const uint32_t *tab)
+{
+	uint32_t c;
+	int n, k;
+
+	for (n = 0; n < 256; n++) {
+		c = tab[n];
+		for (k = 0; k < 7; k++) {
+			c = tab[c & 255] ^ (c >> 8);
+			crc_slice[k][n] = c;
+		}
+	}
+	crc_slice_empty = 0;
+}
+#endif
+
 /* No ones complement version. JFFS2 (and other things ?)
  * don't use ones compliment in their CRC calculations.
  */
-uint32_t __efi_runtime crc32_no_comp(uint32_t crc, const Bytef *buf, uInt len)
+uint32_t __efi_runtime crc32_no_comp_generic(uint32_t crc, const Bytef *buf,
+					     uInt len)
 {
-#ifdef CONFIG_ARM64_CRC32
-    crc = cpu_to_le32(crc);
-    while (len--)
-        crc = __builtin_aarch64_crc32b(crc, *buf++);
-    return le32_to_cpu(crc);
-#else
     const uint32_t *tab = crc_table;
     const uint32_t *b =(const uint32_t *)buf;
     size_t rem_len;
@@ -205,6 +234,20 @@ uint32_t __efi_runtime crc32_no_comp(uint32_t crc, const Bytef *buf, uInt len)
 	 b = (uint32_t *)p;
     }
 
+#ifdef CRC_SLICE_BY_8
+    if (len >= 8 && crc_slice_empty)
+	 make_crc_slice_table(tab);
+    for (; len >= 8; len -= 8, b += 2) {
+	 uint32_t one = b[0] ^ crc;
+	 uint32_t two = b[1];
+
+	 crc = crc_slice[6][one & 255] ^ crc_slice[5][(one >> 8) & 255] ^
+	       crc_slice[4][(one >> 16) & 255] ^ crc_slice[3][one >> 24] ^
+	       crc_slice[2][two & 255] ^ crc_slice[1][(two >> 8) & 255] ^
+	       crc_slice[0][(two >> 16) & 255] ^ tab[two >> 24];
+    }
+#endif
+
     rem_len = len & 3;
     len = len >> 2;
     for (--b; len; --len) {
@@ -225,10 +268,20 @@ uint32_t __efi_runtime crc32_no_comp(uint32_t crc, const Bytef *buf, uInt len)
     }
 
     return le32_to_cpu(crc);
-#endif
 }
 #undef DO_CRC
 
+/*
+ * Architecture code may override this with an accelerated version, which
+ * falls back to crc32_no_comp_generic() where the hardware support is
+ * missing.
+ */
+__weak uint32_t __efi_runtime crc32_no_comp(uint32_t crc, const Bytef *buf,
+					    uInt len)
+{
+	return crc32_no_comp_generic(crc, buf, len);
+}
+
 uint32_t __efi_runtime crc32(uint32_t crc, const Bytef *p, uInt len)
 {
      return crc32_no_comp(crc ^ 0xffffffffL, p, len) ^ 0xffffffffL;
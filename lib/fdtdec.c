@@ -653,6 +653,112 @@ int fdtdec_check_fdt(void)
 	return 0;
 }
 
+#if CONFIG_IS_ENABLED(OF_PHANDLE_CACHE)
+/**
+ * struct fdtdec_phandle_cache - table for looking up nodes by phandle
+ *
+ * @blob: Device tree covered
+ * @size_dt_struct: Size of the structure block when the table was built, which
+ *	changes when nodes or properties are added or removed
+ * @mask: Number of slots minus one, where the number is a power of two
+ * @slot: Nodes with a phandle, each in the first free slot from its phandle
+ *	masked with @mask. Free slots have a phandle of 0
+ */
+struct fdtdec_phandle_cache {
+	const void *blob;
+	uint size_dt_struct;
+	uint mask;
+	struct {
+		u32 phandle;
+		int offset;
+	} slot[];
+};
+
+static struct fdtdec_phandle_cache *fdtdec_phandle_cache_build(const void *blob)
+{
+	struct fdtdec_phandle_cache *cache = gd->fdt_phandle_cache;
+	uint count = 0, slots = 1, i;
+	int offset;
+	u32 phandle;
+
+	for (offset = fdt_next_node(blob, -1, NULL); offset >= 0;
+	     offset = fdt_next_node(blob, offset, NULL)) {
+		if (fdt_get_phandle(blob, offset))
+			count++;
+	}
+	/* keep the table at most half full */
+	while (slots < count * 2)
+		slots <<= 1;
+
+	/* reuse the table if possible, since free() does nothing early on */
+	if (!cache || cache->mask + 1 < slots) {
+		free(cache);
+		cache = malloc(sizeof(*cache) + slots * sizeof(cache->slot[0]));
+		gd->fdt_phandle_cache = cache;
+		if (!cache)
+			return NULL;
+		cache->mask = slots - 1;
+	}
+	memset(cache->slot, '\0', (cache->mask + 1) * sizeof(cache->slot[0]));
+	cache->blob = blob;
+	cache->size_dt_struct = fdt_size_dt_struct(blob);
+
+	for (offset = fdt_next_node(blob, -1, NULL); offset >= 0;
+	     offset = fdt_next_node(blob, offset, NULL)) {
+		phandle = fdt_get_phandle(blob, offset);
+		if (!phandle)
+			continue;
+		for (i = phandle & cache->mask; cache->slot[i].phandle;
+		     i = (i + 1) & cache->mask) {
+			/* the first node with a phandle wins, as in libfdt */
+			if (cache->slot[i].phandle == phandle)
+				break;
+		}
+		if (!cache->slot[i].phandle) {
+			cache->slot[i].phandle = phandle;
+			cache->slot[i].offset = offset;
+		}
+	}
+
+	return cache;
+}
+
+int fdtdec_node_offset_by_phandle(const void *blob, uint phandle)
+{
+	struct fdtdec_phandle_cache *cache = gd->fdt_phandle_cache;
+	uint i;
+
+	if (blob != gd->fdt_blob || !phandle || phandle == (u32)-1)
+		return fdt_node_offset_by_phandle(blob, phandle);
+
+	if (!cache || cache->blob != blob ||
+	    cache->size_dt_struct != fdt_size_dt_struct(blob)) {
+		cache = fdtdec_phandle_cache_build(blob);
+		if (!cache)
+			return fdt_node_offset_by_phandle(blob, phandle);
+	}
+
+	for (i = phandle & cache->mask; cache->slot[i].phandle;
+	     i = (i + 1) & cache->mask) {
+		if (cache->slot[i].phandle != phandle)
+			continue;
+		/* nodes may have moved without the size changing */
+		if (fdt_get_phandle(blob, cache->slot[i].offset) == phandle)
+			return cache->slot[i].offset;
+		cache->blob = NULL;
+		break;
+	}
+
+	/* the table may be out of date, so make sure */
+	return fdt_node_offset_by_phandle(blob, phandle);
+}
+#else
+int fdtdec_node_offset_by_phandle(const void *blob, uint phandle)
+{
+	return fdt_node_offset_by_phandle(blob, phandle);
+}
+#endif
+
 int fdtdec_lookup_phandle(const void *blob, int node, const char *prop_name)
 {
 	const u32 *phandle;
@@ -663,7 +769,7 @@ int fdtdec_lookup_phandle(const void *blob, int node, const char *prop_name)
 	if (!phandle)
 		return -FDT_ERR_NOTFOUND;
 
-	lookup = fdt_node_offset_by_phandle(blob, fdt32_to_cpu(*phandle));
+	lookup = fdtdec_node_offset_by_phandle(blob, fdt32_to_cpu(*phandle));
 	return lookup;
 }
 
@@ -794,8 +900,8 @@ int fdtdec_parse_phandle_with_args(const void *blob, int src_node,
 			 * below.
 			 */
 			if (cells_name || cur_index == index) {
-				node = fdt_node_offset_by_phandle(blob,
-								  phandle);
+				node = fdtdec_node_offset_by_phandle(blob,
+								     phandle);
 				if (node < 0) {
 					debug("%s: could not find phandle\n",
 					      fdt_get_name(blob, src_node,
@@ -1516,7 +1622,7 @@ int fdtdec_get_carveout(const void *blob, const char *node,
 
 	phandle = fdt32_to_cpu(prop[index]);
 
-	offset = fdt_node_offset_by_phandle(blob, phandle);
+	offset = fdtdec_node_offset_by_phandle(blob, phandle);
 	if (offset < 0) {
 		debug("failed to find node for phandle %u\n", phandle);
 		return offset;
@@ -34,16 +34,12 @@
 # include <linux/ctype.h>
 #endif
 
-#define USED_FREE 0
-#define USED_DELETED -1
-
 #include <env_callback.h>
 #include <env_flags.h>
 #include <search.h>
 #include <slre.h>
 
 /*
- * [Aho,Sethi,Ullman] Compilers: Principles, Techniques and Tools, 1986
  * [Knuth]	      The Art of Computer Programming, part 3 (6.4)
  */
 
@@ -53,43 +49,206 @@
  * which describes the current status.
  */
 
+/*
+ * An entry of the hash table. Entries never move once created: the table
+ * itself only holds pointers to them, so it can grow while the callers keep
+ * the struct env_entry pointers they were given.
+ */
 struct env_entry_node {
-	int used;
+	unsigned int hval;
+	unsigned int flags;
 	struct env_entry entry;
 };
 
+/* The node and its key come from an import arena */
+#define ENV_NODE_ARENA	(1 << 0)
+/* The data come from an import arena */
+#define ENV_DATA_ARENA	(1 << 1)
+
+/* Marks a slot whose entry has been deleted */
+#define DELETED_NODE	((struct env_entry_node *)-1)
+
+/*
+ * Memory of an import: the entries of the imported environment and the
+ * text of their keys and data, allocated at once. It is freed when the last
+ * entry using it is deleted or overwritten.
+ */
+struct env_arena {
+	struct env_arena *next;
+	unsigned int refs;
+	unsigned int used;
+	unsigned int count;
+	struct env_entry_node *nodes;
+	char *text;
+	char *end;
+};
+
 static void _hdelete(const char *key, struct hsearch_data *htab,
-		     struct env_entry *ep, int idx);
+		     struct env_entry_node *node);
+
+static struct env_entry_node *hnode(struct env_entry *ep)
+{
+	return (struct env_entry_node *)((char *)ep -
+					 offsetof(struct env_entry_node, entry));
+}
+
+/* FNV-1a */
+static unsigned int hhash(const char *key)
+{
+	unsigned int hval = 2166136261U;
+
+	while (*key) {
+		hval ^= (unsigned char)*key++;
+		hval *= 16777619U;
+	}
+
+	return hval;
+}
+
+/* Number of slots for @nel entries, at most 3/4 of the slots being used */
+static unsigned int hslots(size_t nel)
+{
+	unsigned int size = 8;
+
+	while (size - size / 4 < nel)
+		size <<= 1;
+
+	return size;
+}
 
 /*
- * hcreate()
+ * Find the slot of @key, or if it is not in the table the slot where to
+ * insert it. Linear probing: the table size is a power of two and at least
+ * one slot in four is free, so the loop ends.
  */
+static unsigned int hfind(struct hsearch_data *htab, const char *key,
+			  unsigned int hval, struct env_entry_node **nodep)
+{
+	unsigned int mask = htab->size - 1;
+	unsigned int idx, first_deleted = htab->size;
+	struct env_entry_node *node;
+
+	for (idx = hval & mask; (node = htab->table[idx]);
+	     idx = (idx + 1) & mask) {
+		if (node == DELETED_NODE) {
+			if (first_deleted == htab->size)
+				first_deleted = idx;
+			continue;
+		}
+		if (node->hval == hval && strcmp(node->entry.key, key) == 0) {
+			*nodep = node;
+			return idx;
+		}
+	}
+
+	*nodep = NULL;
+	return first_deleted != htab->size ? first_deleted : idx;
+}
 
 /*
- * For the used double hash method the table size has to be a prime. To
- * correct the user given table size we need a prime test.  This trivial
- * algorithm is adequate because
- * a)  the code is (most probably) called a few times per program run and
- * b)  the number is small because the table must fit in the core
- * */
-static int isprime(unsigned int number)
+ * Position of @key in the sorted view, or where to insert it. Keys usually
+ * come in order, from an environment exported by hexport_r().
+ */
+static unsigned int hsorted_pos(struct hsearch_data *htab, const char *key)
+{
+	unsigned int lo = 0, hi = htab->filled, mid;
+
+	if (hi && strcmp(htab->sorted[hi - 1]->entry.key, key) < 0)
+		return hi;
+
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (strcmp(htab->sorted[mid]->entry.key, key) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+/* Rebuild the table with room for @nel entries, dropping deleted slots */
+static int hresize(struct hsearch_data *htab, size_t nel)
+{
+	struct env_entry_node **table, *node;
+	unsigned int size = hslots(nel);
+	unsigned int i, idx;
+
+	table = calloc(size, sizeof(*table));
+	if (!table)
+		return -ENOMEM;
+
+	for (i = 0; i < htab->size; i++) {
+		node = htab->table[i];
+		if (!node || node == DELETED_NODE)
+			continue;
+		for (idx = node->hval & (size - 1); table[idx];
+		     idx = (idx + 1) & (size - 1))
+			;
+		table[idx] = node;
+	}
+
+	free(htab->table);
+	htab->table = table;
+	htab->size = size;
+	htab->deleted = 0;
+
+	return 0;
+}
+
+/* Make room for @count more entries */
+static int hreserve(struct hsearch_data *htab, size_t count)
+{
+	size_t nel = htab->filled + count;
+	struct env_entry_node **sorted;
+	int ret;
+
+	if (nel > htab->sorted_size) {
+		nel = max_t(size_t, nel, htab->sorted_size * 2);
+		sorted = realloc(htab->sorted, nel * sizeof(*sorted));
+		if (!sorted)
+			return -ENOMEM;
+		htab->sorted = sorted;
+		htab->sorted_size = nel;
+		nel = htab->filled + count;
+	}
+
+	if (nel + htab->deleted > htab->size - htab->size / 4) {
+		/* double the size if needed, else only drop deleted slots */
+		ret = hresize(htab, max_t(size_t, nel, htab->filled * 2));
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+/* Drop a reference to the arena holding @ptr, freeing it when unused */
+static void harena_put(struct hsearch_data *htab, const void *ptr)
 {
-	/* no even number will be passed */
-	unsigned int div = 3;
+	struct env_arena **ap, *arena;
 
-	while (div * div < number && number % div != 0)
-		div += 2;
+	for (ap = &htab->arenas; (arena = *ap); ap = &arena->next) {
+		if ((char *)ptr >= (char *)arena->nodes &&
+		    (char *)ptr < arena->end)
+			break;
+	}
+	if (!arena || --arena->refs)
+		return;
 
-	return number % div != 0;
+	*ap = arena->next;
+	free(arena);
 }
 
+/*
+ * hcreate()
+ */
+
 /*
  * Before using the hash table we must allocate memory for it.
- * Test for an existing table are done. We allocate one element
- * more as the found prime number says. This is done for more effective
- * indexing as explained in the comment for the hsearch function.
- * The contents of the table is zeroed, especially the field used
- * becomes zero.
+ * Test for an existing table are done. The table starts with room for
+ * @nel entries and grows when more are entered.
+ * The contents of the table is zeroed.
  */
 
 int hcreate_r(size_t nel, struct hsearch_data *htab)
@@ -106,18 +265,20 @@ int hcreate_r(size_t nel, struct hsearch_data *htab)
 		return 0;
 	}
 
-	/* Change nel to the first prime number not smaller as nel. */
-	nel |= 1;		/* make odd */
-	while (!isprime(nel))
-		nel += 2;
-
-	htab->size = nel;
+	htab->size = hslots(nel);
 	htab->filled = 0;
+	htab->deleted = 0;
+	htab->arenas = NULL;
 
 	/* allocate memory and zero out */
-	htab->table = (struct env_entry_node *)calloc(htab->size + 1,
-						sizeof(struct env_entry_node));
-	if (htab->table == NULL) {
+	htab->table = calloc(htab->size, sizeof(struct env_entry_node *));
+	htab->sorted_size = max_t(size_t, nel, 1);
+	htab->sorted = malloc(htab->sorted_size *
+			      sizeof(struct env_entry_node *));
+	if (htab->table == NULL || htab->sorted == NULL) {
+		free(htab->table);
+		free(htab->sorted);
+		htab->table = NULL;
 		__set_errno(ENOMEM);
 		return 0;
 	}
@@ -137,7 +298,9 @@ int hcreate_r(size_t nel, struct hsearch_data *htab)
 
 void hdestroy_r(struct hsearch_data *htab)
 {
-	int i;
+	struct env_entry_node *node;
+	struct env_arena *arena;
+	unsigned int i;
 
 	/* Test for correct arguments.  */
 	if (htab == NULL) {
@@ -146,18 +309,27 @@ void hdestroy_r(struct hsearch_data *htab)
 	}
 
 	/* free used memory */
-	for (i = 1; i <= htab->size; ++i) {
-		if (htab->table[i].used > 0) {
-			struct env_entry *ep = &htab->table[i].entry;
-
-			free((void *)ep->key);
-			free(ep->data);
+	for (i = 0; i < htab->filled; ++i) {
+		node = htab->sorted[i];
+		if (!(node->flags & ENV_DATA_ARENA))
+			free(node->entry.data);
+		if (!(node->flags & ENV_NODE_ARENA)) {
+			free((void *)node->entry.key);
+			free(node);
 		}
 	}
+	while ((arena = htab->arenas)) {
+		htab->arenas = arena->next;
+		free(arena);
+	}
 	free(htab->table);
+	free(htab->sorted);
 
 	/* the sign for an existing table is an value != NULL in htable */
 	htab->table = NULL;
+	htab->sorted = NULL;
+	htab->filled = 0;
+	htab->deleted = 0;
 }
 
 /*
@@ -165,19 +337,16 @@ void hdestroy_r(struct hsearch_data *htab)
  */
 
 /*
- * This is the search function. It uses double hashing with open addressing.
+ * This is the search function. It uses linear probing with open addressing
+ * in a table whose size is a power of two, kept at most 3/4 used: it grows
+ * as entries are added, so that there is no fixed limit to their number.
  * The argument item.key has to be a pointer to an zero terminated, most
- * probably strings of chars. The function for generating a number of the
- * strings is simple but fast. It can be replaced by a more complex function
- * like ajw (see [Aho,Sethi,Ullman]) if the needs are shown.
+ * probably strings of chars. The table keeps the full hash of every key,
+ * which is compared before calling strcmp.
  *
- * We use an trick to speed up the lookup. The table is created by hcreate
- * with one more element available. This enables us to use the index zero
- * special. This index will never be used because we store the first hash
- * index in the field used where zero means not used. Every other value
- * means used. The used field can be used as a first fast comparison for
- * equality of the stored and the parameter value. This helps to prevent
- * unnecessary expensive calls of strcmp.
+ * Besides the hash table, the entries are kept sorted by key, so that
+ * exporting the table does not need to sort it. Entries entered in order,
+ * as when importing an exported environment, are simply appended.
  *
  * This implementation differs from the standard library version of
  * this function in a number of ways:
@@ -192,23 +361,24 @@ void hdestroy_r(struct hsearch_data *htab)
  *   existing entry.  This version will create a new entry or update an
  *   existing one when both "action == ENV_ENTER" and "item.data != NULL".
  * - Instead of returning 1 on success, we return the index into the
- *   internal hash table, which is also guaranteed to be positive.
- *   This allows us direct access to the found hash table slot for
- *   example for functions like hdelete().
+ *   internal hash table plus one, which is also guaranteed to be positive.
+ *   It can be passed to hmatch_r() to go on with the following entries.
  */
 
 int hmatch_r(const char *match, int last_idx, struct env_entry **retval,
 	     struct hsearch_data *htab)
 {
+	struct env_entry_node *node;
 	unsigned int idx;
 	size_t key_len = strlen(match);
 
-	for (idx = last_idx + 1; idx < htab->size; ++idx) {
-		if (htab->table[idx].used <= 0)
+	for (idx = last_idx; idx < htab->size; ++idx) {
+		node = htab->table[idx];
+		if (!node || node == DELETED_NODE)
 			continue;
-		if (!strncmp(match, htab->table[idx].entry.key, key_len)) {
-			*retval = &htab->table[idx].entry;
-			return idx;
+		if (!strncmp(match, node->entry.key, key_len)) {
+			*retval = &node->entry;
+			return idx + 1;
 		}
 	}
 
@@ -250,195 +420,188 @@ do_callback(const struct env_entry *e, const char *name, const char *value,
 }
 
 /*
- * Compare an existing entry with the desired key, and overwrite if the action
- * is ENV_ENTER.  This is simply a helper function for hsearch_r().
+ * Set the data of an entry, from @arena if not NULL, else from a copy.
+ * This is simply a helper function for hsearch_r() and himport_r().
  */
-static inline int _compare_and_overwrite_entry(struct env_entry item,
-		enum env_action action, struct env_entry **retval,
-		struct hsearch_data *htab, int flag, unsigned int hval,
-		unsigned int idx)
+static int hset_data(struct hsearch_data *htab, struct env_entry_node *node,
+		     char *data, struct env_arena *arena)
 {
-	if (htab->table[idx].used == hval
-	    && strcmp(item.key, htab->table[idx].entry.key) == 0) {
-		/* Overwrite existing value? */
-		if (action == ENV_ENTER && item.data) {
-			/* check for permission */
-			if (htab->change_ok != NULL && htab->change_ok(
-			    &htab->table[idx].entry, item.data,
-			    env_op_overwrite, flag)) {
-				debug("change_ok() rejected setting variable "
-					"%s, skipping it!\n", item.key);
-				__set_errno(EPERM);
-				*retval = NULL;
-				return 0;
-			}
+	char *old = node->entry.data;
 
-			/* If there is a callback, call it */
-			if (do_callback(&htab->table[idx].entry, item.key,
-					item.data, env_op_overwrite, flag)) {
-				debug("callback() rejected setting variable "
-					"%s, skipping it!\n", item.key);
-				__set_errno(EINVAL);
-				*retval = NULL;
-				return 0;
-			}
-
-			free(htab->table[idx].entry.data);
-			htab->table[idx].entry.data = strdup(item.data);
-			if (!htab->table[idx].entry.data) {
-				__set_errno(ENOMEM);
-				*retval = NULL;
-				return 0;
-			}
+	if (arena) {
+		node->entry.data = data;
+		arena->refs++;
+	} else {
+		node->entry.data = strdup(data);
+		if (!node->entry.data) {
+			node->entry.data = old;
+			return -ENOMEM;
 		}
-		/* return found entry */
-		*retval = &htab->table[idx].entry;
-		return idx;
 	}
-	/* keep searching */
-	return -1;
+
+	if (node->flags & ENV_DATA_ARENA)
+		harena_put(htab, old);
+	else
+		free(old);
+	if (arena)
+		node->flags |= ENV_DATA_ARENA;
+	else
+		node->flags &= ~ENV_DATA_ARENA;
+
+	return 0;
 }
 
-int hsearch_r(struct env_entry item, enum env_action action,
-	      struct env_entry **retval, struct hsearch_data *htab, int flag)
+/*
+ * Overwrite an existing entry with the desired data if the action is
+ * ENV_ENTER.  This is simply a helper function for hsearch_r().
+ */
+static int _overwrite_entry(struct env_entry item, enum env_action action,
+			    struct env_entry **retval,
+			    struct hsearch_data *htab, int flag,
+			    struct env_entry_node *node, struct env_arena *arena)
 {
-	unsigned int hval;
-	unsigned int count;
-	unsigned int len = strlen(item.key);
-	unsigned int idx;
-	unsigned int first_deleted = 0;
-	int ret;
+	struct env_entry_node *found;
 
-	/* Compute an value for the given string. Perhaps use a better method. */
-	hval = len;
-	count = len;
-	while (count-- > 0) {
-		hval <<= 4;
-		hval += item.key[count];
-	}
+	/* Overwrite existing value? */
+	if (action == ENV_ENTER && item.data) {
+		/* check for permission */
+		if (htab->change_ok != NULL && htab->change_ok(
+		    &node->entry, item.data, env_op_overwrite, flag)) {
+			debug("change_ok() rejected setting variable "
+				"%s, skipping it!\n", item.key);
+			__set_errno(EPERM);
+			*retval = NULL;
+			return 0;
+		}
 
-	/*
-	 * First hash function:
-	 * simply take the modul but prevent zero.
-	 */
-	hval %= htab->size;
-	if (hval == 0)
-		++hval;
+		/* If there is a callback, call it */
+		if (do_callback(&node->entry, item.key, item.data,
+				env_op_overwrite, flag)) {
+			debug("callback() rejected setting variable "
+				"%s, skipping it!\n", item.key);
+			__set_errno(EINVAL);
+			*retval = NULL;
+			return 0;
+		}
 
-	/* The first index tried. */
-	idx = hval;
+		if (hset_data(htab, node, item.data, arena)) {
+			__set_errno(ENOMEM);
+			*retval = NULL;
+			return 0;
+		}
+	}
 
-	if (htab->table[idx].used) {
-		/*
-		 * Further action might be required according to the
-		 * action value.
-		 */
-		unsigned hval2;
+	/* return found entry, the callback may have moved its slot */
+	*retval = &node->entry;
+	return hfind(htab, node->entry.key, node->hval, &found) + 1;
+}
 
-		if (htab->table[idx].used == USED_DELETED)
-			first_deleted = idx;
+/* Take a new entry from @arena if there is one left, else allocate it */
+static struct env_entry_node *hnew_node(struct env_entry item,
+					struct env_arena *arena)
+{
+	struct env_entry_node *node;
 
-		ret = _compare_and_overwrite_entry(item, action, retval, htab,
-			flag, hval, idx);
-		if (ret != -1)
-			return ret;
+	if (arena && arena->used < arena->count) {
+		node = &arena->nodes[arena->used++];
+		memset(node, '\0', sizeof(*node));
+		node->flags = ENV_NODE_ARENA | ENV_DATA_ARENA;
+		node->entry.key = item.key;
+		node->entry.data = item.data;
+		arena->refs += 2;
 
-		/*
-		 * Second hash function:
-		 * as suggested in [Knuth]
-		 */
-		hval2 = 1 + hval % (htab->size - 2);
-
-		do {
-			/*
-			 * Because SIZE is prime this guarantees to
-			 * step through all available indices.
-			 */
-			if (idx <= hval2)
-				idx = htab->size + idx - hval2;
-			else
-				idx -= hval2;
+		return node;
+	}
 
-			/*
-			 * If we visited all entries leave the loop
-			 * unsuccessfully.
-			 */
-			if (idx == hval)
-				break;
+	node = calloc(1, sizeof(*node));
+	if (!node)
+		return NULL;
+	node->entry.key = strdup(item.key);
+	node->entry.data = strdup(item.data);
+	if (!node->entry.key || !node->entry.data) {
+		free((void *)node->entry.key);
+		free(node->entry.data);
+		free(node);
+		return NULL;
+	}
 
-			if (htab->table[idx].used == USED_DELETED
-			    && !first_deleted)
-				first_deleted = idx;
+	return node;
+}
 
-			/* If entry is found use it. */
-			ret = _compare_and_overwrite_entry(item, action, retval,
-				htab, flag, hval, idx);
-			if (ret != -1)
-				return ret;
-		}
-		while (htab->table[idx].used != USED_FREE);
-	}
+static int _hsearch_r(struct env_entry item, enum env_action action,
+		      struct env_entry **retval, struct hsearch_data *htab,
+		      int flag, struct env_arena *arena)
+{
+	struct env_entry_node *node;
+	unsigned int hval = hhash(item.key);
+	unsigned int idx, pos;
+
+	idx = hfind(htab, item.key, hval, &node);
+	if (node)
+		return _overwrite_entry(item, action, retval, htab, flag, node,
+					arena);
 
 	/* An empty bucket has been found. */
 	if (action == ENV_ENTER) {
-		/*
-		 * If table is full and another entry should be
-		 * entered return with error.
-		 */
-		if (htab->filled == htab->size) {
+		/* Make room, the table may move */
+		if (hreserve(htab, 1)) {
 			__set_errno(ENOMEM);
 			*retval = NULL;
 			return 0;
 		}
+		idx = hfind(htab, item.key, hval, &node);
 
 		/*
 		 * Create new entry;
 		 * create copies of item.key and item.data
 		 */
-		if (first_deleted)
-			idx = first_deleted;
-
-		htab->table[idx].used = hval;
-		htab->table[idx].entry.key = strdup(item.key);
-		htab->table[idx].entry.data = strdup(item.data);
-		if (!htab->table[idx].entry.key ||
-		    !htab->table[idx].entry.data) {
+		node = hnew_node(item, arena);
+		if (!node) {
 			__set_errno(ENOMEM);
 			*retval = NULL;
 			return 0;
 		}
+		node->hval = hval;
+
+		if (htab->table[idx] == DELETED_NODE)
+			--htab->deleted;
+		htab->table[idx] = node;
 
+		pos = hsorted_pos(htab, item.key);
+		memmove(&htab->sorted[pos + 1], &htab->sorted[pos],
+			(htab->filled - pos) * sizeof(*htab->sorted));
+		htab->sorted[pos] = node;
 		++htab->filled;
 
 		/* This is a new entry, so look up a possible callback */
-		env_callback_init(&htab->table[idx].entry);
+		env_callback_init(&node->entry);
 		/* Also look for flags */
-		env_flags_init(&htab->table[idx].entry);
+		env_flags_init(&node->entry);
 
 		/* check for permission */
 		if (htab->change_ok != NULL && htab->change_ok(
-		    &htab->table[idx].entry, item.data, env_op_create, flag)) {
+		    &node->entry, item.data, env_op_create, flag)) {
 			debug("change_ok() rejected setting variable "
 				"%s, skipping it!\n", item.key);
-			_hdelete(item.key, htab, &htab->table[idx].entry, idx);
+			_hdelete(item.key, htab, node);
 			__set_errno(EPERM);
 			*retval = NULL;
 			return 0;
 		}
 
 		/* If there is a callback, call it */
-		if (do_callback(&htab->table[idx].entry, item.key, item.data,
+		if (do_callback(&node->entry, item.key, item.data,
 				env_op_create, flag)) {
 			debug("callback() rejected setting variable "
 				"%s, skipping it!\n", item.key);
-			_hdelete(item.key, htab, &htab->table[idx].entry, idx);
+			_hdelete(item.key, htab, node);
 			__set_errno(EINVAL);
 			*retval = NULL;
 			return 0;
 		}
 
 		/* return new entry */
-		*retval = &htab->table[idx].entry;
+		*retval = &node->entry;
 		return 1;
 	}
 
@@ -447,6 +610,12 @@ int hsearch_r(struct env_entry item, enum env_action action,
 	return 0;
 }
 
+int hsearch_r(struct env_entry item, enum env_action action,
+	      struct env_entry **retval, struct hsearch_data *htab, int flag)
+{
+	return _hsearch_r(item, action, retval, htab, flag, NULL);
+}
+
 /*
  * hdelete()
  */
@@ -458,16 +627,32 @@ int hsearch_r(struct env_entry item, enum env_action action,
  */
 
 static void _hdelete(const char *key, struct hsearch_data *htab,
-		     struct env_entry *ep, int idx)
+		     struct env_entry_node *node)
 {
+	struct env_entry_node *found;
+	unsigned int idx, pos;
+
 	/* free used entry */
 	debug("hdelete: DELETING key \"%s\"\n", key);
-	free((void *)ep->key);
-	free(ep->data);
-	ep->flags = 0;
-	htab->table[idx].used = USED_DELETED;
+	idx = hfind(htab, node->entry.key, node->hval, &found);
+	htab->table[idx] = DELETED_NODE;
+	++htab->deleted;
 
+	pos = hsorted_pos(htab, node->entry.key);
 	--htab->filled;
+	memmove(&htab->sorted[pos], &htab->sorted[pos + 1],
+		(htab->filled - pos) * sizeof(*htab->sorted));
+
+	if (node->flags & ENV_DATA_ARENA)
+		harena_put(htab, node->entry.data);
+	else
+		free(node->entry.data);
+	if (node->flags & ENV_NODE_ARENA) {
+		harena_put(htab, node);
+	} else {
+		free((void *)node->entry.key);
+		free(node);
+	}
 }
 
 int hdelete_r(const char *key, struct hsearch_data *htab, int flag)
@@ -495,15 +680,14 @@ int hdelete_r(const char *key, struct hsearch_data *htab, int flag)
 	}
 
 	/* If there is a callback, call it */
-	if (do_callback(&htab->table[idx].entry, key, NULL,
-			env_op_delete, flag)) {
+	if (do_callback(ep, key, NULL, env_op_delete, flag)) {
 		debug("callback() rejected deleting variable "
 			"%s, skipping it!\n", key);
 		__set_errno(EINVAL);
 		return -EINVAL;
 	}
 
-	_hdelete(key, htab, ep, idx);
+	_hdelete(key, htab, hnode(ep));
 
 	return 0;
 }
@@ -526,7 +710,7 @@ int hdelete_r(const char *key, struct hsearch_data *htab, int flag)
  * for later re-import.
  *
  * The entries in the result list will be sorted by ascending key
- * values.
+ * values. The table keeps them sorted, so this costs nothing.
  *
  * If the separator character is different from NUL, then any
  * separator characters and backslash characters in the values will
@@ -551,14 +735,6 @@ int hdelete_r(const char *key, struct hsearch_data *htab, int flag)
  *		bytes in the string will be '\0'-padded.
  */
 
-static int cmpkey(const void *p1, const void *p2)
-{
-	struct env_entry *e1 = *(struct env_entry **)p1;
-	struct env_entry *e2 = *(struct env_entry **)p2;
-
-	return (strcmp(e1->key, e2->key));
-}
-
 static int match_string(int flag, const char *str, const char *pat, void *priv)
 {
 	switch (flag & H_MATCH_METHOD) {
@@ -621,7 +797,7 @@ ssize_t hexport_r(struct hsearch_data *htab, const char sep, int flag,
 		 char **resp, size_t size,
 		 int argc, char *const argv[])
 {
-	struct env_entry *list[htab->size];
+	struct env_entry **list;
 	char *res, *p;
 	size_t totlen;
 	int i, n;
@@ -634,61 +810,63 @@ ssize_t hexport_r(struct hsearch_data *htab, const char sep, int flag,
 
 	debug("EXPORT  table = %p, htab.size = %d, htab.filled = %d, size = %lu\n",
 	      htab, htab->size, htab->filled, (ulong)size);
+
+	list = malloc(htab->filled * sizeof(*list) + 1);
+	if (!list) {
+		__set_errno(ENOMEM);
+		return (-1);
+	}
+
 	/*
 	 * Pass 1:
-	 * search used entries,
+	 * search used entries, in the order of their keys,
 	 * save addresses and compute total length
 	 */
-	for (i = 1, n = 0, totlen = 0; i <= htab->size; ++i) {
-
-		if (htab->table[i].used > 0) {
-			struct env_entry *ep = &htab->table[i].entry;
-			int found = match_entry(ep, flag, argc, argv);
+	for (i = 0, n = 0, totlen = 0; i < htab->filled; ++i) {
+		struct env_entry *ep = &htab->sorted[i]->entry;
+		int found = match_entry(ep, flag, argc, argv);
 
-			if ((argc > 0) && (found == 0))
-				continue;
+		if ((argc > 0) && (found == 0))
+			continue;
 
-			if ((flag & H_HIDE_DOT) && ep->key[0] == '.')
-				continue;
+		if ((flag & H_HIDE_DOT) && ep->key[0] == '.')
+			continue;
 
-			list[n++] = ep;
+		list[n++] = ep;
 
-			totlen += strlen(ep->key);
+		totlen += strlen(ep->key);
 
-			if (sep == '\0') {
-				totlen += strlen(ep->data);
-			} else {	/* check if escapes are needed */
-				char *s = ep->data;
+		if (sep == '\0') {
+			totlen += strlen(ep->data);
+		} else {	/* check if escapes are needed */
+			char *s = ep->data;
 
-				while (*s) {
+			while (*s) {
+				++totlen;
+				/* add room for needed escape chars */
+				if ((*s == sep) || (*s == '\\'))
 					++totlen;
-					/* add room for needed escape chars */
-					if ((*s == sep) || (*s == '\\'))
-						++totlen;
-					++s;
-				}
+				++s;
 			}
-			totlen += 2;	/* for '=' and 'sep' char */
 		}
+		totlen += 2;	/* for '=' and 'sep' char */
 	}
 
 #ifdef DEBUG
-	/* Pass 1a: print unsorted list */
-	printf("Unsorted: n=%d\n", n);
+	/* Pass 1a: print sorted list */
+	printf("Sorted: n=%d\n", n);
 	for (i = 0; i < n; ++i) {
 		printf("\t%3d: %p ==> %-10s => %s\n",
 		       i, list[i], list[i]->key, list[i]->data);
 	}
 #endif
 
-	/* Sort list by keys */
-	qsort(list, n, sizeof(struct env_entry *), cmpkey);
-
 	/* Check if the user supplied buffer size is sufficient */
 	if (size) {
 		if (size < totlen + 1) {	/* provided buffer too small */
 			printf("Env export buffer too small: %lu, but need %lu\n",
 			       (ulong)size, (ulong)totlen + 1);
+			free(list);
 			__set_errno(ENOMEM);
 			return (-1);
 		}
@@ -705,6 +883,7 @@ ssize_t hexport_r(struct hsearch_data *htab, const char sep, int flag,
 		/* no, allocate and clear one */
 		*resp = res = calloc(1, size);
 		if (res == NULL) {
+			free(list);
 			__set_errno(ENOMEM);
 			return (-1);
 		}
@@ -731,6 +910,7 @@ ssize_t hexport_r(struct hsearch_data *htab, const char sep, int flag,
 		*p++ = sep;
 	}
 	*p = '\0';		/* terminate result */
+	free(list);
 
 	return size;
 }
@@ -768,6 +948,59 @@ static int drop_var_from_set(const char *name, int nvars, char * vars[])
 	return res;
 }
 
+/*
+ * Set up the arena of an import: room for @count entries and a copy of the
+ * @len bytes of @env, with two NUL characters after them. The arena holds a reference to itself until the import
+ * is done.
+ */
+static struct env_arena *harena_new(struct hsearch_data *htab,
+				    const char *env, size_t len,
+				    unsigned int count)
+{
+	struct env_arena *arena;
+
+	arena = malloc(sizeof(*arena) + count * sizeof(*arena->nodes) +
+		       len + 2);
+	if (!arena)
+		return NULL;
+
+	arena->refs = 1;
+	arena->used = 0;
+	arena->count = count;
+	arena->nodes = (struct env_entry_node *)(arena + 1);
+	arena->text = (char *)(arena->nodes + count);
+	arena->end = arena->text + len + 2;
+	memcpy(arena->text, env, len);
+	arena->text[len] = '\0';
+	arena->text[len + 1] = '\0';
+
+	arena->next = htab->arenas;
+	htab->arenas = arena;
+
+	return arena;
+}
+
+/*
+ * Length of the data to import, which end at the first empty entry, and in
+ * @countp the number of entries they hold at most
+ */
+static size_t himport_len(const char *env, size_t size, const char sep,
+			  unsigned int *countp)
+{
+	unsigned int count = 1;
+	size_t len;
+
+	for (len = 0; len < size; len++) {
+		if (!env[len] && (!len || !env[len - 1]))
+			break;
+		if (env[len] == sep || !env[len])
+			count++;
+	}
+	*countp = count;
+
+	return len;
+}
+
 /*
  * Import linearized data into hash table.
  *
@@ -804,6 +1037,9 @@ static int drop_var_from_set(const char *name, int nvars, char * vars[])
  *
  * In theory, arbitrary separator characters can be used, but only
  * '\0' and '\n' have really been tested.
+ *
+ * The entries and their text are allocated at once, from an arena which is
+ * freed when none of its entries is left.
  */
 
 int himport_r(struct hsearch_data *htab,
@@ -812,6 +1048,9 @@ int himport_r(struct hsearch_data *htab,
 {
 	char *data, *sp, *dp, *name, *value;
 	char *localvars[nvars];
+	struct env_arena *arena;
+	unsigned int count;
+	size_t len;
 	int i;
 
 	/* Test for correct arguments.  */
@@ -820,15 +1059,7 @@ int himport_r(struct hsearch_data *htab,
 		return 0;
 	}
 
-	/* we allocate new space to make sure we can write to the array */
-	if ((data = malloc(size + 1)) == NULL) {
-		debug("himport_r: can't malloc %lu bytes\n", (ulong)size + 1);
-		__set_errno(ENOMEM);
-		return 0;
-	}
-	memcpy(data, env, size);
-	data[size] = '\0';
-	dp = data;
+	len = himport_len(env, size, sep, &count);
 
 	/* make a local copy of the list of variables */
 	if (nvars)
@@ -861,7 +1092,8 @@ int himport_r(struct hsearch_data *htab,
 	 * environment size), so we clip it to a reasonable value.
 	 * On the other hand we need to add some more entries for free
 	 * space when importing very small buffers. Both boundaries can
-	 * be overwritten in the board config file if needed.
+	 * be overwritten in the board config file if needed. The table
+	 * grows anyway if the data hold more entries.
 	 */
 
 	if (!htab->table) {
@@ -872,27 +1104,40 @@ int himport_r(struct hsearch_data *htab,
 
 		debug("Create Hash Table: N=%d\n", nent);
 
-		if (hcreate_r(nent, htab) == 0) {
-			free(data);
+		if (hcreate_r(nent, htab) == 0)
 			return 0;
-		}
 	}
 
-	if (!size) {
-		free(data);
+	if (!size)
 		return 1;		/* everything OK */
+
+	/*
+	 * Only some variables are taken, do not keep entries for the
+	 * others: allocate those which are taken one by one
+	 */
+	if (nvars)
+		count = 0;
+
+	/* we allocate new space to make sure we can write to the array */
+	if (hreserve(htab, count) ||
+	    !(arena = harena_new(htab, env, len, count))) {
+		debug("himport_r: can't malloc %lu bytes\n", (ulong)len + 2);
+		__set_errno(ENOMEM);
+		return 0;
 	}
+	data = arena->text;
+	dp = data;
 	if(crlf_is_lf) {
 		/* Remove Carriage Returns in front of Line Feeds */
 		unsigned ignored_crs = 0;
-		for(;dp < data + size && *dp; ++dp) {
+		for(;dp < data + len && *dp; ++dp) {
 			if(*dp == '\r' &&
-			   dp < data + size - 1 && *(dp+1) == '\n')
+			   dp < data + len - 1 && *(dp+1) == '\n')
 				++ignored_crs;
 			else
 				*(dp-ignored_crs) = *dp;
 		}
-		size -= ignored_crs;
+		len -= ignored_crs;
 		dp = data;
 	}
 	/* Parse environment; allow for '\0' and 'sep' as separators */
@@ -945,7 +1190,7 @@ int himport_r(struct hsearch_data *htab,
 		if (*name == 0) {
 			debug("INSERT: unable to use an empty key\n");
 			__set_errno(EINVAL);
-			free(data);
+			harena_put(htab, data);
 			return 0;
 		}
 
@@ -957,7 +1202,8 @@ int himport_r(struct hsearch_data *htab,
 		e.key = name;
 		e.data = value;
 
-		hsearch_r(e, ENV_ENTER, &rv, htab, flag);
+		_hsearch_r(e, ENV_ENTER, &rv, htab, flag,
+			   count ? arena : NULL);
 #if !IS_ENABLED(CONFIG_ENV_WRITEABLE_LIST)
 		if (rv == NULL) {
 			printf("himport_r: can't insert \"%s=%s\" into hash table\n",
@@ -968,10 +1214,10 @@ int himport_r(struct hsearch_data *htab,
 		debug("INSERT: table %p, filled %d/%d rv %p ==> name=\"%s\" value=\"%s\"\n",
 			htab, htab->filled, htab->size,
 			rv, name, value);
-	} while ((dp < data + size) && *dp);	/* size check needed for text */
+	} while ((dp < data + len) && *dp);	/* size check needed for text */
 						/* without '\0' termination */
-	debug("INSERT: free(data = %p)\n", data);
-	free(data);
+	debug("INSERT: release(data = %p)\n", data);
+	harena_put(htab, data);
 
 	if (flag & H_NOCLEAR)
 		goto end;
@@ -1009,12 +1255,14 @@ end:
  */
 int hwalk_r(struct hsearch_data *htab, int (*callback)(struct env_entry *entry))
 {
-	int i;
+	struct env_entry_node *node;
+	unsigned int i;
 	int retval;
 
-	for (i = 1; i <= htab->size; ++i) {
-		if (htab->table[i].used > 0) {
-			retval = callback(&htab->table[i].entry);
+	for (i = 0; i < htab->size; ++i) {
+		node = htab->table[i];
+		if (node && node != DELETED_NODE) {
+			retval = callback(&node->entry);
 			if (retval)
 				return retval;
 		}
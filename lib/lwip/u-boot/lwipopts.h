@@ -74,6 +74,8 @@
 #define IP_OPTIONS_ALLOWED              1
 #define IP_REASSEMBLY                   1
 #define IP_FRAG                         1
+/* received frames are passed to lwIP in place, see net_lwip_rx() */
+#define LWIP_SUPPORT_CUSTOM_PBUF        1
 #define IP_REASS_MAXAGE                 3
 #define IP_REASS_MAX_PBUFS              4
 #define IP_FRAG_USES_STATIC_BUF         0
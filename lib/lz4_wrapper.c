@@ -5,6 +5,9 @@
 
 #include <compiler.h>
 #include <image.h>
+#include <malloc.h>
+#include <workers.h>
+#include <linux/bitops.h>
 #include <linux/kernel.h>
 #include <linux/types.h>
 #include <asm/unaligned.h>
@@ -14,52 +17,85 @@
 #include "lz4.c"	/* #include for inlining, do not link! */
 
 #define LZ4F_BLOCKUNCOMPRESSED_FLAG 0x80000000U
+#define LZ4F_SKIPPABLE_MAGIC	0x184D2A50
+#define LZ4F_SKIPPABLE_MASK	0xFFFFFFF0
 
-__rcode int ulz4fn(const void *src, size_t srcn, void *dst, size_t *dstn)
+/* Frame descriptor flags */
+#define LZ4F_BLOCK_CHECKSUM	BIT(4)
+#define LZ4F_CONTENT_SIZE	BIT(3)
+#define LZ4F_CONTENT_CHECKSUM	BIT(2)
+
+/*
+ * Check the header of the frame at @src and return its length, or -ve on
+ * error. @flagsp returns the frame descriptor flags and @sizep the content
+ * size, or 0 if the frame does not record it.
+ */
+static __rcode int ulz4_frame_header(const void *src, size_t srcn, u8 *flagsp,
+				     u64 *sizep)
+{
+	const void *in = src;
+	u32 magic;
+	u8 flags, version, independent_blocks, has_content_size;
+	u8 block_desc;
+
+	if (srcn < sizeof(u32) + 3*sizeof(u8))
+		return -EINVAL;	/* input overrun */
+
+	magic = get_unaligned_le32(in);
+	in += sizeof(u32);
+	flags = *(u8 *)in;
+	in += sizeof(u8);
+	block_desc = *(u8 *)in;
+	in += sizeof(u8);
+
+	version = (flags >> 6) & 0x3;
+	independent_blocks = (flags >> 5) & 0x1;
+	has_content_size = (flags >> 3) & 0x1;
+
+	if (magic != LZ4F_MAGIC || version != 1)
+		return -EPROTONOSUPPORT;	/* unknown format */
+	if ((flags & 0x03) || (block_desc & 0x8f))
+		return -EINVAL;	/* reserved bits must be zero */
+	if (!independent_blocks)
+		return -EPROTONOSUPPORT; /* we can't support this yet */
+
+	*sizep = 0;
+	if (has_content_size) {
+		if (srcn < sizeof(u32) + 3*sizeof(u8) + sizeof(u64))
+			return -EINVAL;	/* input overrun */
+		*sizep = get_unaligned_le64(in);
+		in += sizeof(u64);
+	}
+	/* Header checksum byte */
+	in += sizeof(u8);
+	*flagsp = flags;
+
+	return in - src;
+}
+
+/*
+ * Decompress the frame at @src. @dstn is the space available at @dst and
+ * returns the length of the decompressed data, @srcused returns the length
+ * of the frame.
+ */
+static __rcode int ulz4_frame(const void *src, size_t srcn, void *dst,
+			      size_t *dstn, size_t *srcused)
 {
 	const void *end = dst + *dstn;
 	const void *in = src;
 	void *out = dst;
 	int has_block_checksum;
+	u64 content_size;
+	u8 flags;
 	int ret;
 	*dstn = 0;
 
-	{ /* With in-place decompression the header may become invalid later. */
-		u32 magic;
-		u8 flags, version, independent_blocks, has_content_size;
-		u8 block_desc;
-
-		if (srcn < sizeof(u32) + 3*sizeof(u8))
-			return -EINVAL;	/* input overrun */
-
-		magic = get_unaligned_le32(in);
-		in += sizeof(u32);
-		flags = *(u8 *)in;
-		in += sizeof(u8);
-		block_desc = *(u8 *)in;
-		in += sizeof(u8);
-
-		version = (flags >> 6) & 0x3;
-		independent_blocks = (flags >> 5) & 0x1;
-		has_block_checksum = (flags >> 4) & 0x1;
-		has_content_size = (flags >> 3) & 0x1;
-
-		/* We assume there's always only a single, standard frame. */
-		if (magic != LZ4F_MAGIC || version != 1)
-			return -EPROTONOSUPPORT;	/* unknown format */
-		if ((flags & 0x03) || (block_desc & 0x8f))
-			return -EINVAL;	/* reserved bits must be zero */
-		if (!independent_blocks)
-			return -EPROTONOSUPPORT; /* we can't support this yet */
-
-		if (has_content_size) {
-			if (srcn < sizeof(u32) + 3*sizeof(u8) + sizeof(u64))
-				return -EINVAL;	/* input overrun */
-			in += sizeof(u64);
-		}
-		/* Header checksum byte */
-		in += sizeof(u8);
-	}
+	/* With in-place decompression the header may become invalid later. */
+	ret = ulz4_frame_header(src, srcn, &flags, &content_size);
+	if (ret < 0)
+		return ret;
+	in += ret;
+	has_block_checksum = flags & LZ4F_BLOCK_CHECKSUM;
 
 	while (1) {
 		u32 block_header, block_size;
@@ -75,6 +111,10 @@ __rcode int ulz4fn(const void *src, size_t srcn, void *dst, size_t *dstn)
 
 		if (!block_size) {
 			ret = 0;	/* decompression successful */
+			if (flags & LZ4F_CONTENT_CHECKSUM)
+				in += sizeof(u32);
+			/* a truncated checksum ends the data like junk would */
+			in = min(in, src + srcn);
 			break;
 		}
 
@@ -104,5 +144,167 @@ __rcode int ulz4fn(const void *src, size_t srcn, void *dst, size_t *dstn)
 	}
 
 	*dstn = out - dst;
+	*srcused = in - src;
+	return ret;
+}
+
+/* Return the length of the skippable frame at @src, or 0 if there is none */
+static __rcode size_t ulz4_skippable_len(const void *src, size_t srcn)
+{
+	size_t len;
+
+	if (srcn < 2 * sizeof(u32) ||
+	    (get_unaligned_le32(src) & LZ4F_SKIPPABLE_MASK) !=
+	    LZ4F_SKIPPABLE_MAGIC)
+		return 0;
+	len = 2 * sizeof(u32) + get_unaligned_le32(src + sizeof(u32));
+
+	return len <= srcn ? len : 0;
+}
+
+__rcode int ulz4fn(const void *src, size_t srcn, void *dst, size_t *dstn)
+{
+	size_t out = 0, used, size, skip;
+	int ret;
+
+	do {
+		size = *dstn - out;
+		ret = ulz4_frame(src, srcn, dst + out, &size, &used);
+		out += size;
+		if (ret)
+			break;
+		src += used;
+		srcn -= used;
+
+		/* More frames may follow, e.g. from lz4 -B with --content-size */
+		while ((skip = ulz4_skippable_len(src, srcn))) {
+			src += skip;
+			srcn -= skip;
+		}
+	} while (srcn >= sizeof(u32) && get_unaligned_le32(src) == LZ4F_MAGIC);
+
+	*dstn = out;
+	return ret;
+}
+
+#if CONFIG_IS_ENABLED(WORKERS)
+/**
+ * struct ulz4_frame_job - A frame to decompress on a worker
+ *
+ * @src: Start of the frame
+ * @srcn: Length of the frame
+ * @dst: Where to put the decompressed data
+ * @dstn: Decompressed size of the frame
+ */
+struct ulz4_frame_job {
+	const void *src;
+	size_t srcn;
+	void *dst;
+	size_t dstn;
+};
+
+static int ulz4_job(void *priv, uint job, uint worker)
+{
+	struct ulz4_frame_job *frame = (struct ulz4_frame_job *)priv + job;
+	size_t size = frame->dstn, used;
+	int ret;
+
+	ret = ulz4_frame(frame->src, frame->srcn, frame->dst, &size, &used);
+	if (ret)
+		return ret;
+
+	return size == frame->dstn ? 0 : -EPROTO;
+}
+
+/*
+ * Find the frames in @src, without decompressing them. This fills in @jobs,
+ * if not NULL, and returns the number of frames, or 0 if they cannot be
+ * decompressed in parallel.
+ */
+static int ulz4_scan_frames(const void *src, size_t srcn, void *dst,
+			    size_t dstn, struct ulz4_frame_job *jobs)
+{
+	size_t out = 0, skip, len;
+	u64 content_size;
+	int count = 0;
+	const void *in;
+	u32 block_size;
+	u8 flags;
+	int ret;
+
+	while (srcn >= sizeof(u32) && get_unaligned_le32(src) == LZ4F_MAGIC) {
+		ret = ulz4_frame_header(src, srcn, &flags, &content_size);
+		if (ret < 0 || !content_size || content_size > dstn - out)
+			return 0;
+
+		/* Walk the blocks to find the end of the frame */
+		in = src + ret;
+		len = ret;
+		do {
+			if (srcn - len < sizeof(u32))
+				return 0;
+			block_size = get_unaligned_le32(in) &
+				~LZ4F_BLOCKUNCOMPRESSED_FLAG;
+			len += sizeof(u32);
+			if (block_size && (flags & LZ4F_BLOCK_CHECKSUM))
+				block_size += sizeof(u32);
+			if (block_size > srcn - len)
+				return 0;
+			len += block_size;
+			in = src + len;
+		} while (block_size);
+		if (flags & LZ4F_CONTENT_CHECKSUM)
+			len += sizeof(u32);
+		if (len > srcn)
+			return 0;
+		in = src + len;
+
+		if (jobs) {
+			jobs[count].src = src;
+			jobs[count].srcn = in - src;
+			jobs[count].dst = dst + out;
+			jobs[count].dstn = content_size;
+		}
+		count++;
+		out += content_size;
+		srcn -= in - src;
+		src = in;
+
+		while ((skip = ulz4_skippable_len(src, srcn))) {
+			src += skip;
+			srcn -= skip;
+		}
+	}
+
+	return count;
+}
+
+int ulz4fn_parallel(const void *src, size_t srcn, void *dst, size_t *dstn)
+{
+	struct ulz4_frame_job *jobs;
+	size_t total = 0;
+	int count, i, ret;
+
+	if (workers_count() < 2)
+		return ulz4fn(src, srcn, dst, dstn);
+
+	count = ulz4_scan_frames(src, srcn, dst, *dstn, NULL);
+	if (count < 2)
+		return ulz4fn(src, srcn, dst, dstn);
+
+	jobs = calloc(count, sizeof(*jobs));
+	if (!jobs)
+		return ulz4fn(src, srcn, dst, dstn);
+	ulz4_scan_frames(src, srcn, dst, *dstn, jobs);
+
+	ret = workers_run(ulz4_job, jobs, count);
+	if (!ret) {
+		for (i = 0; i < count; i++)
+			total += jobs[i].dstn;
+		*dstn = total;
+	}
+	free(jobs);
+
 	return ret;
 }
+#endif
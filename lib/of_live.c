@@ -313,6 +313,8 @@ int unflatten_device_tree(const void *blob, struct device_node **mynodes)
 		      be32_to_cpup(mem + size));
 		return -ENOSPC;
 	}
+	/* any phandle table for a tree previously at this address is stale */
+	of_phandle_cache_reset(*mynodes);
 
 	debug(" <- unflatten_device_tree()\n");
 
@@ -335,6 +337,9 @@ int of_live_build(const void *fdt_blob, struct device_node **rootp)
 		debug("Failed to scan live tree aliases: err=%d\n", ret);
 		return ret;
 	}
+	/* without the table, phandles are found by walking the tree */
+	if (of_phandle_cache_build(*rootp))
+		debug("Failed to build phandle table\n");
 	debug("%s: stop\n", __func__);
 
 	if (CONFIG_IS_ENABLED(EVENT)) {
@@ -351,6 +356,7 @@ int of_live_build(const void *fdt_blob, struct device_node **rootp)
 
 void of_live_free(struct device_node *root)
 {
+	of_phandle_cache_reset(root);
 	/* the tree is stored as a contiguous block of memory */
 	free(root);
 }
@@ -369,6 +375,7 @@ int of_live_create_empty(struct device_node **rootp)
 	}
 	root->type = "<NULL>";
 	root->full_name = "";
+	of_phandle_cache_reset(root);
 	*rootp = root;
 
 	return 0;
@@ -0,0 +1,142 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Running independent jobs in parallel on secondary CPUs
+ *
+ * Jobs are handed out through a shared counter: every worker, the boot CPU
+ * included, atomically claims the next job index until none is left. The
+ * atomic builtins are used rather than asm/atomic.h since the latter only
+ * protects against interrupts on the local CPU.
+ */
+
+#include <log.h>
+#include <workers.h>
+#include <linux/errno.h>
+#include <linux/kernel.h>
+
+/**
+ * struct workers_pool - State shared with the workers while jobs are running
+ *
+ * @fn: Job function
+ * @priv: Private data for @fn
+ * @count: Number of jobs
+ * @next: Index of the next job to claim
+ * @ret: First error returned by a job, 0 if none
+ * @limit: Maximum number of workers to use, 0 for all
+ * @busy: true while workers_run() is running
+ */
+struct workers_pool {
+	workers_fn fn;
+	void *priv;
+	uint count;
+	uint next;
+	int ret;
+	uint limit;
+	bool busy;
+};
+
+static struct workers_pool pool;
+
+__weak uint workers_arch_max(void)
+{
+	return 0;
+}
+
+__weak int workers_arch_start(uint count)
+{
+	return -ENOSYS;
+}
+
+__weak void workers_arch_wait(void)
+{
+}
+
+static void workers_loop(uint worker)
+{
+	int expected, ret;
+	uint job;
+
+	for (;;) {
+		job = __atomic_fetch_add(&pool.next, 1, __ATOMIC_ACQUIRE);
+		if (job >= pool.count)
+			break;
+		ret = pool.fn(pool.priv, job, worker);
+		if (ret) {
+			expected = 0;
+			__atomic_compare_exchange_n(&pool.ret, &expected, ret,
+						    false, __ATOMIC_RELAXED,
+						    __ATOMIC_RELAXED);
+		}
+	}
+}
+
+void workers_secondary(uint worker)
+{
+	workers_loop(worker);
+	/* make this worker's output visible before it is reported as done */
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+uint workers_count(void)
+{
+	uint count = min_t(uint, workers_arch_max() + 1, CONFIG_WORKERS_MAX);
+
+	if (pool.limit)
+		count = min(count, pool.limit);
+
+	return count;
+}
+
+void workers_set_limit(uint limit)
+{
+	pool.limit = limit;
+}
+
+static int workers_run_serial(workers_fn fn, void *priv, uint count)
+{
+	uint i;
+	int ret;
+
+	for (i = 0; i < count; i++) {
+		ret = fn(priv, i, 0);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+int workers_run(workers_fn fn, void *priv, uint count)
+{
+	uint secondaries;
+	int ret;
+
+	if (pool.busy || count < 2)
+		return workers_run_serial(fn, priv, count);
+
+	secondaries = min(workers_count(), count) - 1;
+	if (!secondaries)
+		return workers_run_serial(fn, priv, count);
+
+	pool.fn = fn;
+	pool.priv = priv;
+	pool.count = count;
+	pool.next = 0;
+	pool.ret = 0;
+	pool.busy = true;
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	ret = workers_arch_start(secondaries);
+	if (ret) {
+		log_debug("Cannot start %u workers (err=%d)\n", secondaries,
+			  ret);
+		pool.busy = false;
+		return workers_run_serial(fn, priv, count);
+	}
+
+	workers_loop(0);
+	workers_arch_wait();
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	pool.busy = false;
+
+	return pool.ret;
+}
@@ -9,3 +9,13 @@
  */
 
 void inflate_fast OF((z_streamp strm, unsigned start));
+
+#if CONFIG_IS_ENABLED(ZLIB_INFLATE_CHUNK)
+/* Bytes copied at once by inflate_fast_chunk(), which may overrun a match */
+#define INFLATE_CHUNK_SIZE 16
+/* inflate_fast_chunk() refills its bit buffer 8 bytes at a time */
+#define INFLATE_FAST_MIN_INPUT 8
+#define INFLATE_FAST_MIN_OUTPUT 258
+
+void inflate_fast_chunk OF((z_streamp strm, unsigned start));
+#endif
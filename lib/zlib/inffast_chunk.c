@@ -0,0 +1,304 @@
+/* inffast_chunk.c -- fast decoding with wide loads and chunked copies
+ * Copyright (C) 1995-2008, 2010, 2013 Mark Adler
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+
+/* U-Boot: we already included these
+#include "zutil.h"
+#include "inftrees.h"
+#include "inflate.h"
+#include "inffast.h"
+*/
+
+/*
+   This is inflate_fast() reworked for 64-bit CPUs which handle unaligned
+   accesses well, along the lines of Chromium's inflate_fast_chunk():
+
+    - The bit accumulator is refilled with a single unaligned 64-bit load
+      at the top of each loop iteration. This always leaves at least 56 bits
+      available, which is enough to decode a literal or a complete
+      length/distance pair (at most 48 bits) without any further refill.
+
+    - Matches are copied INFLATE_CHUNK_SIZE bytes at a time with unaligned
+      loads and stores, and may write up to INFLATE_CHUNK_SIZE - 1 bytes past
+      their end. Those bytes are overwritten by what is decoded next, and a
+      match is only copied this way when they fit in the output buffer.
+      Short distances are first expanded byte by byte until the pattern can
+      be copied with whole chunks.
+
+   Entry assumptions:
+
+        state->mode == LEN
+        strm->avail_in >= INFLATE_FAST_MIN_INPUT
+        strm->avail_out >= INFLATE_FAST_MIN_OUTPUT
+        start >= strm->avail_out
+        state->bits < 8
+
+   On return, state->mode is one of:
+
+        LEN -- ran out of enough output space or enough available input
+        TYPE -- reached end of block code, inflate() to interpret next block
+        BAD -- error in block data
+ */
+
+/* Copy one chunk, which may be unaligned at both ends */
+static inline void chunk_copy(unsigned char FAR *out,
+                              const unsigned char FAR *from)
+{
+    __builtin_memcpy(out, from, INFLATE_CHUNK_SIZE);
+}
+
+/*
+   Copy len bytes from from to out, which is dist bytes further. At least
+   INFLATE_CHUNK_SIZE - 1 bytes must be available past out + len.
+ */
+static inline unsigned char FAR *chunk_copy_lapped(unsigned char FAR *out,
+                                                   unsigned dist, unsigned len)
+{
+    const unsigned char FAR *from = out - dist;
+    unsigned char FAR *stop = out + len;
+    unsigned step;
+
+    if (dist == 1) {
+        u64 pat = *from * 0x0101010101010101ULL;
+
+        do {
+            put_unaligned(pat, (u64 *)out);
+            out += sizeof(pat);
+        } while (out < stop);
+        return stop;
+    }
+
+    if (dist < INFLATE_CHUNK_SIZE) {
+        /*
+         * Expand the pattern until a whole number of its periods spans at
+         * least a chunk, then copy chunks from that far back.
+         */
+        step = dist;
+        while (step < INFLATE_CHUNK_SIZE)
+            step += dist;
+        len = step - dist;
+        do {
+            *out++ = *from++;
+        } while (--len && out < stop);
+        if (out >= stop)
+            return stop;
+        from = out - step;
+    }
+
+    do {
+        chunk_copy(out, from);
+        out += INFLATE_CHUNK_SIZE;
+        from += INFLATE_CHUNK_SIZE;
+    } while (out < stop);
+
+    return stop;
+}
+
+void ZLIB_INTERNAL inflate_fast_chunk(strm, start)
+z_streamp strm;
+unsigned start;         /* inflate()'s starting value for strm->avail_out */
+{
+    struct inflate_state FAR *state;
+    z_const unsigned char FAR *in;      /* local strm->next_in */
+    z_const unsigned char FAR *last;    /* have enough input while in < last */
+    unsigned char FAR *out;     /* local strm->next_out */
+    unsigned char FAR *beg;     /* inflate()'s initial strm->next_out */
+    unsigned char FAR *end;     /* while out < end, enough space available */
+    unsigned char FAR *limit;   /* end of the output buffer */
+#ifdef INFLATE_STRICT
+    unsigned dmax;              /* maximum distance from zlib header */
+#endif
+    unsigned wsize;             /* window size or zero if not using window */
+    unsigned whave;             /* valid bytes in the window */
+    unsigned wnext;             /* window write index */
+    unsigned char FAR *window;  /* allocated sliding window, if wsize != 0 */
+    u64 hold;                   /* local strm->hold */
+    unsigned bits;              /* local strm->bits */
+    code const FAR *lcode;      /* local strm->lencode */
+    code const FAR *dcode;      /* local strm->distcode */
+    unsigned lmask;             /* mask for first level of length codes */
+    unsigned dmask;             /* mask for first level of distance codes */
+    code here;                  /* retrieved table entry */
+    unsigned op;                /* code bits, operation, extra bits, or */
+                                /*  window position, window bytes to copy */
+    unsigned len;               /* match length, unused bytes */
+    unsigned dist;              /* match distance */
+    unsigned char FAR *from;    /* where to copy match from */
+
+    /* copy state to local variables */
+    state = (struct inflate_state FAR *)strm->state;
+    in = strm->next_in;
+    last = in + (strm->avail_in - 7);
+    if (in > last) {
+        /*
+         * overflow detected, limit strm->avail_in to the
+         * max. possible size and recalculate last
+         */
+        strm->avail_in = 0xffffffff - (uintptr_t)in;
+        last = in + (strm->avail_in - 7);
+    }
+    out = strm->next_out;
+    beg = out - (start - strm->avail_out);
+    end = out + (strm->avail_out - 257);
+    limit = out + strm->avail_out;
+#ifdef INFLATE_STRICT
+    dmax = state->dmax;
+#endif
+    wsize = state->wsize;
+    whave = state->whave;
+    wnext = state->wnext;
+    window = state->window;
+    hold = state->hold;
+    bits = state->bits;
+    lcode = state->lencode;
+    dcode = state->distcode;
+    lmask = (1U << state->lenbits) - 1;
+    dmask = (1U << state->distbits) - 1;
+
+    /* decode literals and length/distances until end-of-block or not enough
+       input data or output space */
+    do {
+        /* at least 8 bytes of input are left, top up to 56 bits or more */
+        hold |= get_unaligned_le64(in) << bits;
+        in += (63 - bits) >> 3;
+        bits |= 56;
+
+        here = lcode[hold & lmask];
+      dolen:
+        op = (unsigned)(here.bits);
+        hold >>= op;
+        bits -= op;
+        op = (unsigned)(here.op);
+        if (op == 0) {                          /* literal */
+            Tracevv((stderr, here.val >= 0x20 && here.val < 0x7f ?
+                    "inflate:         literal '%c'\n" :
+                    "inflate:         literal 0x%02x\n", here.val));
+            *out++ = (unsigned char)(here.val);
+        }
+        else if (op & 16) {                     /* length base */
+            len = (unsigned)(here.val);
+            op &= 15;                           /* number of extra bits */
+            if (op) {
+                len += (unsigned)hold & ((1U << op) - 1);
+                hold >>= op;
+                bits -= op;
+            }
+            Tracevv((stderr, "inflate:         length %u\n", len));
+            here = dcode[hold & dmask];
+          dodist:
+            op = (unsigned)(here.bits);
+            hold >>= op;
+            bits -= op;
+            op = (unsigned)(here.op);
+            if (op & 16) {                      /* distance base */
+                dist = (unsigned)(here.val);
+                op &= 15;                       /* number of extra bits */
+                dist += (unsigned)hold & ((1U << op) - 1);
+#ifdef INFLATE_STRICT
+                if (dist > dmax) {
+                    strm->msg = (char *)"invalid distance too far back";
+                    state->mode = BAD;
+                    break;
+                }
+#endif
+                hold >>= op;
+                bits -= op;
+                Tracevv((stderr, "inflate:         distance %u\n", dist));
+                op = (unsigned)(out - beg);     /* max distance in output */
+                if (dist > op) {                /* see if copy from window */
+                    op = dist - op;             /* distance back in window */
+                    if (op > whave) {
+                        strm->msg =
+                            (char *)"invalid distance too far back";
+                        state->mode = BAD;
+                        break;
+                    }
+                    from = window;
+                    if (wnext == 0) {           /* very common case */
+                        from += wsize - op;
+                    }
+                    else if (wnext < op) {      /* wrap around window */
+                        from += wsize + wnext - op;
+                        op -= wnext;
+                        if (op < len) {         /* some from end of window */
+                            len -= op;
+                            memcpy(out, from, op);
+                            out += op;
+                            from = window;
+                            op = wnext;
+                        }
+                    }
+                    else {                      /* contiguous in window */
+                        from += wnext - op;
+                    }
+                    if (op < len) {             /* rest from output */
+                        memcpy(out, from, op);
+                        out += op;
+                        len -= op;
+                        if (out + len + INFLATE_CHUNK_SIZE - 1 <= limit) {
+                            out = chunk_copy_lapped(out, dist, len);
+                        }
+                        else {
+                            from = out - dist;
+                            do {
+                                *out++ = *from++;
+                            } while (--len);
+                        }
+                    }
+                    else {
+                        memcpy(out, from, len);
+                        out += len;
+                    }
+                }
+                else if (out + len + INFLATE_CHUNK_SIZE - 1 <= limit) {
+                    out = chunk_copy_lapped(out, dist, len);
+                }
+                else {
+                    from = out - dist;          /* copy direct from output */
+                    do {                        /* minimum length is three */
+                        *out++ = *from++;
+                    } while (--len);
+                }
+            }
+            else if ((op & 64) == 0) {          /* 2nd level distance code */
+                here = dcode[here.val + (hold & ((1U << op) - 1))];
+                goto dodist;
+            }
+            else {
+                strm->msg = (char *)"invalid distance code";
+                state->mode = BAD;
+                break;
+            }
+        }
+        else if ((op & 64) == 0) {              /* 2nd level length code */
+            here = lcode[here.val + (hold & ((1U << op) - 1))];
+            goto dolen;
+        }
+        else if (op & 32) {                     /* end-of-block */
+            Tracevv((stderr, "inflate:         end of block\n"));
+            state->mode = TYPE;
+            break;
+        }
+        else {
+            strm->msg = (char *)"invalid literal/length code";
+            state->mode = BAD;
+            break;
+        }
+    } while (in < last && out < end);
+
+    /* return unused bytes, the refill may have read up to seven ahead */
+    len = bits >> 3;
+    in -= len;
+    bits -= len << 3;
+    hold &= (1ULL << bits) - 1;
+
+    /* update state and return */
+    strm->next_in = in;
+    strm->next_out = out;
+    strm->avail_in = (unsigned)(in < last ? 7 + (last - in) : 7 - (in - last));
+    strm->avail_out = (unsigned)(limit - out);
+    state->hold = hold;
+    state->bits = bits;
+    return;
+}
@@ -66,9 +66,21 @@ __rcode int ZEXPORT inflateInit2_(z_streamp strm, int windowBits,
     }
     state->wbits = (unsigned)windowBits;
     state->window = Z_NULL;
+    state->nochunk = 0;
     return inflateReset(strm);
 }
 
+int ZEXPORT inflateChunk(z_streamp strm, int enable)
+{
+    struct inflate_state FAR *state;
+
+    if (strm == Z_NULL || strm->state == Z_NULL) return Z_STREAM_ERROR;
+    state = (struct inflate_state FAR *)strm->state;
+    state->nochunk = !enable;
+    return CONFIG_IS_ENABLED(ZLIB_INFLATE_CHUNK) || !enable ? Z_OK :
+           Z_STREAM_ERROR;
+}
+
 __rcode int ZEXPORT inflateInit_(z_streamp strm, int stream_size)
 {
     return inflateInit2_(strm, DEF_WBITS, stream_size);
@@ -736,6 +748,15 @@ __rcode int ZEXPORT inflate(z_streamp strm, int flush)
             fallthrough;
         case LEN:
 	    schedule();
+#if CONFIG_IS_ENABLED(ZLIB_INFLATE_CHUNK)
+            if (have >= INFLATE_FAST_MIN_INPUT &&
+                left >= INFLATE_FAST_MIN_OUTPUT && !state->nochunk) {
+                RESTORE();
+                inflate_fast_chunk(strm, out);
+                LOAD();
+                break;
+            }
+#endif
             if (have >= 6 && left >= 258) {
                 RESTORE();
                 inflate_fast(strm, out);
@@ -93,6 +93,7 @@ struct inflate_state {
         /* bit accumulator */
     unsigned long hold;         /* input bit accumulator */
     unsigned bits;              /* number of bits in "in" */
+    int nochunk;                /* true to not use inflate_fast_chunk() */
         /* for string and stored block copying */
     unsigned length;            /* literal or length of data to copy */
     unsigned offset;            /* distance back to copy string from */
@@ -8,22 +8,196 @@
 #include <abuf.h>
 #include <log.h>
 #include <malloc.h>
+#include <memalign.h>
+#include <workers.h>
+#include <asm/unaligned.h>
 #include <linux/errno.h>
 #include <linux/zstd.h>
 
-int zstd_decompress(struct abuf *in, struct abuf *out)
+/**
+ * struct zstd_frame - A zstd frame within the input
+ *
+ * @src: Start of the frame
+ * @src_len: Compressed size of the frame
+ * @dst_off: Offset of the frame's data in the output, if known
+ * @dst_len: Decompressed size of the frame, or ZSTD_CONTENTSIZE_UNKNOWN
+ */
+struct zstd_frame {
+	const void *src;
+	size_t src_len;
+	size_t dst_off;
+	u64 dst_len;
+};
+
+/**
+ * struct zstd_frame_jobs - Decompressing frames in parallel
+ *
+ * @frames: Frames to decompress, one per job
+ * @dst: Output buffer
+ * @workspace: Workspace for each worker, @wsize bytes apart
+ * @wsize: Size of the workspace for one worker
+ */
+struct zstd_frame_jobs {
+	struct zstd_frame *frames;
+	void *dst;
+	void *workspace;
+	size_t wsize;
+};
+
+/**
+ * zstd_scan_frames() - Find the zstd frames in the input
+ *
+ * Images may hold several frames back to back, e.g. to allow decompressing
+ * them in parallel. Skippable frames are ignored and anything which does not
+ * start with a frame magic is taken as the end of the data, since there may
+ * be junk after the last frame that zstd_decompress_dctx() can't handle.
+ *
+ * @in: Input data
+ * @frames: Returns the frames found, or NULL to just count them
+ * Return: number of frames, or -ve on error
+ */
+static int zstd_scan_frames(struct abuf *in, struct zstd_frame *frames)
 {
+	const u8 *src = abuf_data(in);
+	size_t left = abuf_size(in);
+	zstd_frame_header hdr;
+	int count = 0;
+	size_t len;
+	u32 magic;
+
+	while (left >= sizeof(magic)) {
+		magic = get_unaligned_le32(src);
+		if (magic != ZSTD_MAGICNUMBER &&
+		    (magic & ZSTD_MAGIC_SKIPPABLE_MASK) !=
+		     ZSTD_MAGIC_SKIPPABLE_START)
+			break;
+
+		len = zstd_find_frame_compressed_size(src, left);
+		if (zstd_is_error(len)) {
+			log_err("%s: failed to detect compressed size: %d\n",
+				__func__, zstd_get_error_code(len));
+			return -EINVAL;
+		}
+
+		if (magic == ZSTD_MAGICNUMBER) {
+			if (frames) {
+				frames[count].src = src;
+				frames[count].src_len = len;
+				frames[count].dst_len = ZSTD_CONTENTSIZE_UNKNOWN;
+				if (!zstd_get_frame_header(&hdr, src, len))
+					frames[count].dst_len =
+						hdr.frameContentSize;
+			}
+			count++;
+		}
+		src += len;
+		left -= len;
+	}
+	if (!count) {
+		log_err("%s: no zstd frame found\n", __func__);
+		return -EINVAL;
+	}
+
+	return count;
+}
+
+static int zstd_frame_job(void *priv, uint job, uint worker)
+{
+	struct zstd_frame_jobs *jobs = priv;
+	struct zstd_frame *frame = &jobs->frames[job];
 	zstd_dctx *ctx;
-	size_t wsize, len;
+	size_t len;
+
+	ctx = zstd_init_dctx(jobs->workspace + worker * jobs->wsize,
+			     jobs->wsize);
+	if (!ctx)
+		return -EPERM;
+
+	len = zstd_decompress_dctx(ctx, jobs->dst + frame->dst_off,
+				   frame->dst_len, frame->src, frame->src_len);
+	if (zstd_is_error(len) || len != frame->dst_len)
+		return -EINVAL;
+
+	return 0;
+}
+
+/**
+ * zstd_decompress_parallel() - Decompress frames on all the workers
+ *
+ * This needs the decompressed size of every frame, so that each one can go
+ * straight to its place in the output.
+ *
+ * Return: size of the decompressed data, -EAGAIN if the frames cannot be
+ *	decompressed in parallel, or other -ve value on error
+ */
+static int zstd_decompress_parallel(struct zstd_frame *frames, int count,
+				    struct abuf *out, size_t wsize)
+{
+	struct zstd_frame_jobs jobs;
+	size_t total = 0;
+	uint workers;
+	int i, ret;
+
+	workers = min_t(uint, workers_count(), count);
+	if (workers < 2)
+		return -EAGAIN;
+
+	for (i = 0; i < count; i++) {
+		if (frames[i].dst_len == ZSTD_CONTENTSIZE_UNKNOWN ||
+		    frames[i].dst_len > abuf_size(out) - total)
+			return -EAGAIN;
+		frames[i].dst_off = total;
+		total += frames[i].dst_len;
+	}
+
+	jobs.frames = frames;
+	jobs.dst = abuf_data(out);
+	jobs.wsize = ALIGN(wsize, ARCH_DMA_MINALIGN);
+	jobs.workspace = malloc_cache_aligned(jobs.wsize * workers);
+	if (!jobs.workspace)
+		return -EAGAIN;
+
+	ret = workers_run(zstd_frame_job, &jobs, count);
+	free(jobs.workspace);
+	if (ret) {
+		log_err("%s: failed to decompress frames: %d\n", __func__,
+			ret);
+		return -EINVAL;
+	}
+
+	return total;
+}
+
+int zstd_decompress(struct abuf *in, struct abuf *out)
+{
+	struct zstd_frame *frames;
+	size_t wsize, len, off;
 	void *workspace;
-	int ret;
+	zstd_dctx *ctx;
+	int count, i, ret;
+
+	count = zstd_scan_frames(in, NULL);
+	if (count < 0)
+		return count;
+
+	frames = calloc(count, sizeof(*frames));
+	if (!frames)
+		return -ENOMEM;
+	zstd_scan_frames(in, frames);
 
 	wsize = zstd_dctx_workspace_bound();
+	if (count > 1) {
+		ret = zstd_decompress_parallel(frames, count, out, wsize);
+		if (ret != -EAGAIN)
+			goto do_free_frames;
+	}
+
 	workspace = malloc(wsize);
 	if (!workspace) {
 		debug("%s: cannot allocate workspace of size %zu\n", __func__,
 			wsize);
-		return -ENOMEM;
+		ret = -ENOMEM;
+		goto do_free_frames;
 	}
 
 	ctx = zstd_init_dctx(workspace, wsize);
@@ -33,29 +207,23 @@ int zstd_decompress(struct abuf *in, struct abuf *out)
 		goto do_free;
 	}
 
-	/*
-	 * Find out how large the frame actually is, there may be junk at
-	 * the end of the frame that zstd_decompress_dctx() can't handle.
-	 */
-	len = zstd_find_frame_compressed_size(abuf_data(in), abuf_size(in));
-	if (zstd_is_error(len)) {
-		log_err("%s: failed to detect compressed size: %d\n", __func__,
-			zstd_get_error_code(len));
-		ret = -EINVAL;
-		goto do_free;
-	}
-
-	len = zstd_decompress_dctx(ctx, abuf_data(out), abuf_size(out),
-				   abuf_data(in), len);
-	if (zstd_is_error(len)) {
-		log_err("%s: failed to decompress: %d\n", __func__,
-			zstd_get_error_code(len));
-		ret = -EINVAL;
-		goto do_free;
+	for (i = 0, off = 0; i < count; i++) {
+		len = zstd_decompress_dctx(ctx, abuf_data(out) + off,
+					   abuf_size(out) - off, frames[i].src,
+					   frames[i].src_len);
+		if (zstd_is_error(len)) {
+			log_err("%s: failed to decompress: %d\n", __func__,
+				zstd_get_error_code(len));
+			ret = -EINVAL;
+			goto do_free;
+		}
+		off += len;
 	}
 
-	ret = len;
+	ret = off;
 do_free:
 	free(workspace);
+do_free_frames:
+	free(frames);
 	return ret;
 }
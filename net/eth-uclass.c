@@ -435,6 +435,32 @@ int eth_send(void *packet, int length)
 	return ret;
 }
 
+#ifdef CONFIG_TFTP_MULTICAST
+int eth_mcast_join(struct in_addr mcast_ip, int join)
+{
+	struct udevice *current;
+	u32 addr = ntohl(mcast_ip.s_addr);
+	u8 mcast_mac[ARP_HLEN];
+
+	current = eth_get_dev();
+	if (!current)
+		return -ENODEV;
+
+	if (!eth_get_ops(current)->mcast)
+		return -ENOSYS;
+
+	/* RFC 1112: 01:00:5e followed by the low 23 bits of the group */
+	mcast_mac[0] = 0x01;
+	mcast_mac[1] = 0x00;
+	mcast_mac[2] = 0x5e;
+	mcast_mac[3] = (addr >> 16) & 0x7f;
+	mcast_mac[4] = (addr >> 8) & 0xff;
+	mcast_mac[5] = addr & 0xff;
+
+	return eth_get_ops(current)->mcast(current, mcast_mac, join);
+}
+#endif
+
 int eth_rx(void)
 {
 	struct udevice *current;
@@ -453,6 +479,8 @@ int eth_rx(void)
 	/* Process up to 32 packets at one time */
 	flags = ETH_RECV_CHECK_DEVICE;
 	for (i = 0; i < ETH_PACKETS_BATCH_RECV; i++) {
+		/* the driver sets this if the device checked the packet */
+		net_rx_csum_valid = false;
 		ret = eth_get_ops(current)->recv(current, flags, &packet);
 		flags = 0;
 		if (ret > 0)
@@ -19,6 +19,9 @@ static char txbuf[sizeof(u64) + FASTBOOT_RESPONSE_LEN + 1];
 static u32 data_read;
 static u32 tx_last_offs, tx_last_len;
 
+/* the state above belongs to a single session at a time */
+static bool session_active;
+
 static void tcp_stream_on_rcv_nxt_update(struct tcp_stream *tcp, u32 rx_bytes)
 {
 	u64	cmd_size;
@@ -92,15 +95,26 @@ static int tcp_stream_tx(struct tcp_stream *tcp, u32 tx_offs, void *buf, int max
 	return maxlen;
 }
 
+static void tcp_stream_on_closed(struct tcp_stream *tcp)
+{
+	session_active = false;
+}
+
 static int tcp_stream_on_create(struct tcp_stream *tcp)
 {
 	if (tcp->lport != FASTBOOT_TCP_PORT)
 		return 0;
 
+	/* refuse further connections, e.g. a host retry, until it is over */
+	if (session_active)
+		return 0;
+	session_active = true;
+
 	data_read = 0;
 	tx_last_offs = 0;
 	tx_last_len = 0;
 
+	tcp->on_closed = tcp_stream_on_closed;
 	tcp->on_rcv_nxt_update = tcp_stream_on_rcv_nxt_update;
 	tcp->rx = tcp_stream_rx;
 	tcp->tx = tcp_stream_tx;
@@ -111,6 +125,7 @@ static int tcp_stream_on_create(struct tcp_stream *tcp)
 void fastboot_tcp_start_server(void)
 {
 	memset(net_server_ethaddr, 0, 6);
+	session_active = false;
 	tcp_stream_set_on_create_handler(tcp_stream_on_create);
 
 	printf("Using %s device\n", eth_get_name());
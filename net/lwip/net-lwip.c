@@ -16,7 +16,9 @@
 #include <lwip/etharp.h>
 #include <lwip/init.h>
 #include <lwip/prot/etharp.h>
+#include <lwip/priv/tcp_priv.h>
 #include <lwip/timeouts.h>
+#include <malloc.h>
 #include <net.h>
 #include <timer.h>
 #include <u-boot/schedule.h>
@@ -32,6 +34,7 @@ static int net_restarted;
 int net_restart_wrap;
 static uchar net_pkt_buf[(PKTBUFSRX) * PKTSIZE_ALIGN + PKTALIGN];
 uchar *net_rx_packets[PKTBUFSRX];
+bool net_rx_csum_valid;
 uchar *net_rx_packet;
 const u8 net_bcast_ethaddr[6] = { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff };
 char *pxelinux_configfile;
@@ -293,28 +296,89 @@ int net_init(void)
 	return 0;
 }
 
-static struct pbuf *alloc_pbuf_and_copy(uchar *data, int len)
+/**
+ * struct net_lwip_rx_pbuf - pbuf referencing a frame in a driver buffer
+ *
+ * @pc: custom pbuf handed to lwIP
+ * @copy: room for a private copy of the frame, used when lwIP keeps the
+ *	  pbuf after the driver buffer is given back
+ */
+struct net_lwip_rx_pbuf {
+	struct pbuf_custom pc;
+	uchar copy[];
+};
+
+static void net_lwip_rx_pbuf_free(struct pbuf *p)
 {
-	struct pbuf *p, *q;
+	free(container_of(p, struct net_lwip_rx_pbuf, pc.pbuf));
+}
 
-	/* We allocate a pbuf chain of pbufs from the pool. */
-	p = pbuf_alloc(PBUF_RAW, len, PBUF_POOL);
-	if (!p) {
+/*
+ * Frames are passed to lwIP in place, so in-order TCP payload goes straight
+ * from the driver buffer to its destination. An extra reference is taken so
+ * that release_pbuf_ref() can tell whether lwIP is still holding the pbuf.
+ */
+static struct pbuf *alloc_pbuf_ref(uchar *data, int len)
+{
+	struct net_lwip_rx_pbuf *rp;
+	struct pbuf *p;
+
+	rp = malloc(sizeof(*rp) + len);
+	if (!rp) {
 		LINK_STATS_INC(link.memerr);
 		LINK_STATS_INC(link.drop);
 		return NULL;
 	}
 
-	for (q = p; q != NULL; q = q->next) {
-		memcpy(q->payload, data, q->len);
-		data += q->len;
-	}
+	rp->pc.custom_free_function = net_lwip_rx_pbuf_free;
+	p = pbuf_alloced_custom(PBUF_RAW, len, PBUF_REF, &rp->pc, data, len);
+	pbuf_ref(p);
 
 	LINK_STATS_INC(link.recv);
 
 	return p;
 }
 
+/*
+ * Out-of-order TCP segments keep a pointer to their header besides the pbuf,
+ * so point those found in a moved frame at its new location too
+ */
+static void move_ooseq_hdrs(uchar *from, uchar *to, int len)
+{
+#if LWIP_TCP && TCP_QUEUE_OOSEQ
+	struct tcp_pcb *pcb;
+	struct tcp_seg *seg;
+	uchar *hdr;
+
+	for (pcb = tcp_active_pcbs; pcb; pcb = pcb->next) {
+		for (seg = pcb->ooseq; seg; seg = seg->next) {
+			hdr = (uchar *)seg->tcphdr;
+			if (hdr >= from && hdr < from + len)
+				seg->tcphdr = (struct tcp_hdr *)(to +
+								 (hdr - from));
+		}
+	}
+#endif
+}
+
+/*
+ * Drop our reference before the driver reuses its buffer. Out-of-order TCP
+ * segments, IP fragments and refused data stay queued in lwIP, so move
+ * those to the private copy first.
+ */
+static void release_pbuf_ref(struct pbuf *p, uchar *data, int len)
+{
+	struct net_lwip_rx_pbuf *rp;
+
+	if (p->ref > 1) {
+		rp = container_of(p, struct net_lwip_rx_pbuf, pc.pbuf);
+		memcpy(rp->copy, data, len);
+		p->payload = rp->copy + ((uchar *)p->payload - data);
+		move_ooseq_hdrs(data, rp->copy, len);
+	}
+	pbuf_free(p);
+}
+
 int net_lwip_rx(struct udevice *udev, struct netif *netif)
 {
 	struct pbuf *pbuf;
@@ -344,9 +408,11 @@ int net_lwip_rx(struct udevice *udev, struct netif *netif)
 					       packet, len, true);
 			}
 
-			pbuf = alloc_pbuf_and_copy(packet, len);
-			if (pbuf)
+			pbuf = alloc_pbuf_ref(packet, len);
+			if (pbuf) {
 				netif->input(pbuf, netif);
+				release_pbuf_ref(pbuf, packet, len);
+			}
 		}
 		if (len >= 0 && eth_get_ops(udev)->free_pkt)
 			eth_get_ops(udev)->free_pkt(udev, packet, len);
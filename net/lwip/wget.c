@@ -21,6 +21,8 @@
 #define HTTP_PORT_DEFAULT 80
 #define HTTPS_PORT_DEFAULT 443
 #define PROGRESS_PRINT_STEP_BYTES (100 * 1024)
+/* Content length reported by the HTTP client when there is none */
+#define CONTENT_LEN_UNKNOWN 0xFFFFFFFF
 
 enum done_state {
 	NOT_DONE = 0,
@@ -34,6 +36,7 @@ struct wget_ctx {
 	char *path;
 	ulong daddr;
 	ulong saved_daddr;
+	ulong checked_end;
 	ulong size;
 	ulong prevsize;
 	ulong start_time;
@@ -157,7 +160,8 @@ static int store_block(struct wget_ctx *ctx, void *src, u16_t len)
 	if (wget_info->buffer_size && wget_info->buffer_size < ctx->size + len)
 		return -1;
 
-	if (CONFIG_IS_ENABLED(LMB) && wget_info->set_bootdev) {
+	if (CONFIG_IS_ENABLED(LMB) && wget_info->set_bootdev &&
+	    store_addr + len > ctx->checked_end) {
 		if (store_addr + len < store_addr ||
 		    lmb_read_check(store_addr, len)) {
 			if (!wget_info->silent) {
@@ -263,11 +267,30 @@ static void httpc_result_cb(void *arg, httpc_result_t httpc_result,
 static err_t httpc_headers_done_cb(httpc_state_t *connection, void *arg, struct pbuf *hdr,
 				   u16_t hdr_len, u32_t content_len)
 {
+	struct wget_ctx *ctx = arg;
+
 	wget_lwip_fill_info(hdr, hdr_len, content_len);
 
 	if (wget_info->check_buffer_size && (ulong)content_len > wget_info->buffer_size)
 		return ERR_BUF;
 
+	/*
+	 * Check the whole destination against LMB at once, so store_block()
+	 * does not need to do it for every received segment
+	 */
+	if (CONFIG_IS_ENABLED(LMB) && wget_info->set_bootdev &&
+	    content_len != CONTENT_LEN_UNKNOWN && content_len) {
+		if (ctx->daddr + content_len < ctx->daddr ||
+		    lmb_read_check(ctx->daddr, content_len)) {
+			if (!wget_info->silent) {
+				printf("\nwget error: ");
+				printf("trying to overwrite reserved memory\n");
+			}
+			return ERR_BUF;
+		}
+		ctx->checked_end = ctx->daddr + content_len;
+	}
+
 	return ERR_OK;
 }
 
@@ -290,6 +313,7 @@ int wget_do_request(ulong dst_addr, char *uri)
 
 	ctx.daddr = dst_addr;
 	ctx.saved_daddr = dst_addr;
+	ctx.checked_end = 0;
 	ctx.done = NOT_DONE;
 	ctx.size = 0;
 	ctx.prevsize = 0;
@@ -152,6 +152,8 @@ u8 net_server_ethaddr[6];
 struct in_addr	net_ip;
 /* Server IP addr (0 = unknown) */
 struct in_addr	net_server_ip;
+/* Multicast group joined (0 = none) */
+struct in_addr	net_mcast_addr;
 /* Current receive packet */
 uchar *net_rx_packet;
 /* Current rx packet length */
@@ -191,6 +193,7 @@ u32 net_boot_file_expected_size_in_blocks;
 static uchar net_pkt_buf[(PKTBUFSRX+1) * PKTSIZE_ALIGN + PKTALIGN];
 /* Receive packets */
 uchar *net_rx_packets[PKTBUFSRX];
+bool net_rx_csum_valid;
 /* Current UDP RX packet handler */
 static rxhand_f *udp_packet_handler;
 /* Current ARP RX packet handler */
@@ -397,6 +400,7 @@ static void net_clear_handlers(void)
 static void net_cleanup_loop(void)
 {
 	net_clear_handlers();
+	tftp_mcast_cleanup();
 }
 
 int net_init(void)
@@ -1365,11 +1369,16 @@ void net_process_received_packet(uchar *in_packet, int len)
 		/* If it is not for us, ignore it */
 		dst_ip = net_read_ip(&ip->ip_dst);
 		if (net_ip.s_addr && dst_ip.s_addr != net_ip.s_addr &&
-		    dst_ip.s_addr != 0xFFFFFFFF) {
+		    dst_ip.s_addr != 0xFFFFFFFF &&
+		    (!net_mcast_addr.s_addr ||
+		     dst_ip.s_addr != net_mcast_addr.s_addr)) {
 				return;
 		}
 		/* Read source IP address for later use */
 		src_ip = net_read_ip(&ip->ip_src);
+		/* A device only checks whole packets, not fragments */
+		if (ntohs(ip->ip_off) & (IP_OFFS | IP_FLAGS_MFRAG))
+			net_rx_csum_valid = false;
 		/*
 		 * The function returns the unchanged packet if it's not
 		 * a fragment, and either the complete packet or NULL if
@@ -1422,7 +1431,8 @@ void net_process_received_packet(uchar *in_packet, int len)
 			   "received UDP (to=%pI4, from=%pI4, len=%d)\n",
 			   &dst_ip, &src_ip, len);
 
-		if (IS_ENABLED(CONFIG_UDP_CHECKSUM) && ip->udp_xsum != 0) {
+		if (IS_ENABLED(CONFIG_UDP_CHECKSUM) && ip->udp_xsum != 0 &&
+		    !net_rx_csum_valid) {
 			ulong   xsum;
 			u8 *sumptr;
 			ushort  sumlen;
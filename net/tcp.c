@@ -36,16 +36,22 @@
 #define TCP_SEND_RETRY		3
 #define TCP_SEND_TIMEOUT	2000UL
 #define TCP_RX_INACTIVE_TIMEOUT	30000UL
-#if PKTBUFSRX != 0
+#define TCP_DELAYED_ACK_TIMEOUT	20UL
+#if CONFIG_PROT_TCP_RCV_WND
+  #define TCP_RCV_WND_SIZE	CONFIG_PROT_TCP_RCV_WND
+#elif PKTBUFSRX != 0
   #define TCP_RCV_WND_SIZE	(PKTBUFSRX * TCP_MSS)
 #else
   #define TCP_RCV_WND_SIZE	(4 * TCP_MSS)
 #endif
 
+/* Maximum number of SACK blocks fitting next to the timestamp option */
+#define TCP_SACK_BLOCKS		3
+
 #define TCP_PACKET_OK		0
 #define TCP_PACKET_DROP		1
 
-static struct tcp_stream tcp_stream;
+static struct tcp_stream tcp_streams[CONFIG_PROT_TCP_STREAMS];
 
 static int (*tcp_stream_on_create)(struct tcp_stream *tcp);
 
@@ -76,6 +82,30 @@ static uint random_port(void)
 	return RANDOM_PORT_START + (get_timer(0) % RANDOM_PORT_RANGE);
 }
 
+/**
+ * tcp_free_port() - pick a local port not used by another stream
+ *
+ * Return: port number from 1024 to 17407
+ */
+static uint tcp_free_port(void)
+{
+	uint port = random_port();
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(tcp_streams); i++) {
+		if (tcp_streams[i].lport != port)
+			continue;
+
+		/* streams created within the same tick, try the next one */
+		port++;
+		if (port >= RANDOM_PORT_START + RANDOM_PORT_RANGE)
+			port = RANDOM_PORT_START;
+		i = -1;
+	}
+
+	return port;
+}
+
 static inline s32 tcp_seq_cmp(u32 a, u32 b)
 {
 	return (s32)(a - b);
@@ -97,6 +127,24 @@ static inline ulong msec_to_ticks(ulong msec)
 	return msec * CONFIG_SYS_HZ / 1000;
 }
 
+/**
+ * tcp_rcv_wnd_scale() - get the window scale advertised in our SYN
+ *
+ * The window field is 16 bits wide, so larger receive windows must be
+ * announced using the RFC 7323 window scale option.
+ *
+ * Return: smallest shift that makes the receive window fit the window field
+ */
+static u8 tcp_rcv_wnd_scale(void)
+{
+	u8 scale = 0;
+
+	while (scale < TCP_SCALE_MAX && (TCP_RCV_WND_SIZE >> scale) > 0xffff)
+		scale++;
+
+	return scale;
+}
+
 /**
  * tcp_stream_get_state() - get TCP stream state
  * @tcp: tcp stream
@@ -164,25 +212,31 @@ static void tcp_stream_init(struct tcp_stream *tcp,
 
 static void tcp_stream_destroy(struct tcp_stream *tcp)
 {
-	if (tcp->on_closed)
-		tcp->on_closed(tcp);
+	struct tcp_stream closed = *tcp;
+
+	/* release the stream first, so on_closed() may open a new one */
 	memset(tcp, 0, sizeof(struct tcp_stream));
+	if (closed.on_closed)
+		closed.on_closed(&closed);
 }
 
 void tcp_init(void)
 {
 	static int initialized;
-	struct tcp_stream *tcp = &tcp_stream;
+	struct tcp_stream *tcp;
 
 	tcp_stream_on_create = NULL;
 	if (!initialized) {
 		initialized = 1;
-		memset(tcp, 0, sizeof(struct tcp_stream));
+		memset(tcp_streams, 0, sizeof(tcp_streams));
 	}
 
-	tcp_stream_set_state(tcp, TCP_CLOSED);
-	tcp_stream_set_status(tcp, TCP_ERR_RST);
-	tcp_stream_destroy(tcp);
+	for (tcp = tcp_streams; tcp < tcp_streams + ARRAY_SIZE(tcp_streams);
+	     tcp++) {
+		tcp_stream_set_state(tcp, TCP_CLOSED);
+		tcp_stream_set_status(tcp, TCP_ERR_RST);
+		tcp_stream_destroy(tcp);
+	}
 }
 
 void tcp_stream_set_on_create_handler(int (*on_create)(struct tcp_stream *))
@@ -193,15 +247,25 @@ void tcp_stream_set_on_create_handler(int (*on_create)(struct tcp_stream *))
 static struct tcp_stream *tcp_stream_add(struct in_addr rhost,
 					 u16 rport, u16 lport)
 {
-	struct tcp_stream *tcp = &tcp_stream;
+	struct tcp_stream *tcp;
 
-	if (!tcp_stream_on_create ||
-	    tcp->state != TCP_CLOSED)
+	if (!tcp_stream_on_create)
+		return NULL;
+
+	/* a closed stream keeps its endpoint until it is destroyed */
+	for (tcp = tcp_streams; tcp < tcp_streams + ARRAY_SIZE(tcp_streams);
+	     tcp++) {
+		if (tcp->state == TCP_CLOSED && !tcp->lport)
+			break;
+	}
+	if (tcp == tcp_streams + ARRAY_SIZE(tcp_streams))
 		return NULL;
 
 	tcp_stream_init(tcp, rhost, rport, lport);
-	if (!tcp_stream_on_create(tcp))
+	if (!tcp_stream_on_create(tcp)) {
+		memset(tcp, 0, sizeof(struct tcp_stream));
 		return NULL;
+	}
 
 	return tcp;
 }
@@ -209,12 +273,16 @@ static struct tcp_stream *tcp_stream_add(struct in_addr rhost,
 struct tcp_stream *tcp_stream_get(int is_new, struct in_addr rhost,
 				  u16 rport, u16 lport)
 {
-	struct tcp_stream *tcp = &tcp_stream;
+	struct tcp_stream *tcp;
 
-	if (tcp->rhost.s_addr == rhost.s_addr &&
-	    tcp->rport == rport &&
-	    tcp->lport == lport)
-		return tcp;
+	for (tcp = tcp_streams; tcp < tcp_streams + ARRAY_SIZE(tcp_streams);
+	     tcp++) {
+		if (tcp->lport &&
+		    tcp->rhost.s_addr == rhost.s_addr &&
+		    tcp->rport == rport &&
+		    tcp->lport == lport)
+			return tcp;
+	}
 
 	return is_new ? tcp_stream_add(rhost, rport, lport) : NULL;
 }
@@ -281,6 +349,9 @@ static void tcp_stream_set_time_handler(struct tcp_stream *tcp, ulong msec,
 static void tcp_send_packet(struct tcp_stream *tcp, u8 action,
 			    u32 tcp_seq_num, u32 tcp_ack_num, u32 tx_len)
 {
+	/* every segment carrying an ACK covers the delayed ones */
+	if (action & TCP_ACK)
+		tcp->ack_pending = 0;
 	tcp->tx_packets++;
 	net_send_tcp_packet(tx_len, tcp->rhost, tcp->rport,
 			    tcp->lport, action, tcp_seq_num,
@@ -417,6 +488,12 @@ static void tcp_stream_poll(struct tcp_stream *tcp, ulong time)
 		return;
 	}
 
+	/* handle delayed acknowledge timeout */
+	if (tcp->ack_pending &&
+	    time - tcp->ack_time >= msec_to_ticks(TCP_DELAYED_ACK_TIMEOUT))
+		tcp_send_packet(tcp, tcp_stream_fin_needed(tcp, tcp->snd_una) |
+				TCP_ACK, tcp->snd_una, tcp->rcv_nxt, 0);
+
 	/* handle retransmit timeout */
 	if (tcp->time_handler &&
 	    time - tcp->time_start >= tcp->time_delta) {
@@ -434,8 +511,9 @@ void tcp_streams_poll(void)
 	struct tcp_stream	*tcp;
 
 	time = get_timer(0);
-	tcp = &tcp_stream;
-	tcp_stream_poll(tcp, time);
+	for (tcp = tcp_streams; tcp < tcp_streams + ARRAY_SIZE(tcp_streams);
+	     tcp++)
+		tcp_stream_poll(tcp, time);
 }
 
 /**
@@ -476,6 +554,26 @@ u16 tcp_set_pseudo_header(uchar *pkt, struct in_addr src, struct in_addr dest,
 	return compute_ip_checksum(pkt + PSEUDO_PAD_SIZE, checksum_len);
 }
 
+/**
+ * tcp_sack_recent_hill() - find the hill holding the latest received segment
+ * @tcp: tcp stream
+ *
+ * Return: index of the hill to report first, 0 if it is no longer tracked
+ */
+static int tcp_sack_recent_hill(struct tcp_stream *tcp)
+{
+	int i, cnt;
+
+	cnt = (tcp->lost.len - TCP_OPT_LEN_2) / TCP_OPT_LEN_8;
+	for (i = 0; i < cnt; i++) {
+		if (tcp_seq_cmp(tcp->lost.hill[i].l, tcp->sack_recent) <= 0 &&
+		    tcp_seq_cmp(tcp->sack_recent, tcp->lost.hill[i].r) < 0)
+			return i;
+	}
+
+	return 0;
+}
+
 /**
  * net_set_ack_options() - set TCP options in acknowledge packets
  * @tcp: tcp stream
@@ -485,6 +583,9 @@ u16 tcp_set_pseudo_header(uchar *pkt, struct in_addr src, struct in_addr dest,
  */
 int net_set_ack_options(struct tcp_stream *tcp, union tcp_build_pkt *b)
 {
+	int i, j, cnt, first;
+	u8 sack_len;
+
 	b->sack.hdr.tcp_hlen = SHIFT_TO_TCPHDRLEN_FIELD(LEN_B_TO_DW(TCP_HDR_SIZE));
 
 	b->sack.t_opt.kind = TCP_O_TS;
@@ -495,13 +596,33 @@ int net_set_ack_options(struct tcp_stream *tcp, union tcp_build_pkt *b)
 	b->sack.sack_v.len = 0;
 
 	if (IS_ENABLED(CONFIG_PROT_TCP_SACK)) {
-		if (tcp->lost.len > TCP_OPT_LEN_2) {
+		sack_len = tcp->lost.len;
+		if (sack_len > TCP_OPT_LEN_2) {
 			debug_cond(DEBUG_DEV_PKT, "TCP ack opt lost.len %x\n",
 				   tcp->lost.len);
-			b->sack.sack_v.len = tcp->lost.len;
+			cnt = (sack_len - TCP_OPT_LEN_2) / TCP_OPT_LEN_8;
+			if (cnt > TCP_SACK_BLOCKS) {
+				cnt = TCP_SACK_BLOCKS;
+				sack_len = TCP_OPT_LEN_2 + cnt * TCP_OPT_LEN_8;
+			}
+			b->sack.sack_v.len = sack_len;
 			b->sack.sack_v.kind = TCP_V_SACK;
-			b->sack.sack_v.hill[0].l = htonl(tcp->lost.hill[0].l);
-			b->sack.sack_v.hill[0].r = htonl(tcp->lost.hill[0].r);
+
+			/*
+			 * RFC 2018: the first block must report the most
+			 * recently received segment, the others follow in
+			 * sequence order.
+			 */
+			first = tcp_sack_recent_hill(tcp);
+			b->sack.sack_v.hill[0].l = htonl(tcp->lost.hill[first].l);
+			b->sack.sack_v.hill[0].r = htonl(tcp->lost.hill[first].r);
+			for (i = 0, j = 1; j < cnt; i++) {
+				if (i == first)
+					continue;
+				b->sack.sack_v.hill[j].l = htonl(tcp->lost.hill[i].l);
+				b->sack.sack_v.hill[j].r = htonl(tcp->lost.hill[i].r);
+				j++;
+			}
 
 			/*
 			 * These SACK structures are initialized with NOPs to
@@ -509,17 +630,15 @@ int net_set_ack_options(struct tcp_stream *tcp, union tcp_build_pkt *b)
 			 * SACK structures used for both header padding and
 			 * internally.
 			 */
-			b->sack.sack_v.hill[1].l = htonl(tcp->lost.hill[1].l);
-			b->sack.sack_v.hill[1].r = htonl(tcp->lost.hill[1].r);
-			b->sack.sack_v.hill[2].l = htonl(tcp->lost.hill[2].l);
-			b->sack.sack_v.hill[2].r = htonl(tcp->lost.hill[2].r);
-			b->sack.sack_v.hill[3].l = TCP_O_NOP;
-			b->sack.sack_v.hill[3].r = TCP_O_NOP;
+			for (; j < TCP_SACK_HILLS; j++) {
+				b->sack.sack_v.hill[j].l = TCP_O_NOP;
+				b->sack.sack_v.hill[j].r = TCP_O_NOP;
+			}
 		}
 
 		b->sack.hdr.tcp_hlen = SHIFT_TO_TCPHDRLEN_FIELD(ROUND_TCPHDR_LEN(TCP_HDR_SIZE +
 										 TCP_TSOPT_SIZE +
-										 tcp->lost.len));
+										 sack_len));
 	} else {
 		b->sack.sack_v.kind = 0;
 		b->sack.hdr.tcp_hlen = SHIFT_TO_TCPHDRLEN_FIELD(ROUND_TCPHDR_LEN(TCP_HDR_SIZE +
@@ -549,7 +668,7 @@ void net_set_syn_options(struct tcp_stream *tcp, union tcp_build_pkt *b)
 	b->ip.mss.len = TCP_OPT_LEN_4;
 	b->ip.mss.mss = htons(TCP_MSS);
 	b->ip.scale.kind = TCP_O_SCL;
-	b->ip.scale.scale = TCP_SCALE;
+	b->ip.scale.scale = tcp_rcv_wnd_scale();
 	b->ip.scale.len = TCP_OPT_LEN_3;
 	if (IS_ENABLED(CONFIG_PROT_TCP_SACK)) {
 		b->ip.sack_p.kind = TCP_P_SACK;
@@ -655,8 +774,15 @@ int tcp_set_tcp_header(struct tcp_stream *tcp, uchar *pkt, int payload_len,
 	 * SOCs is may not be considered a constraint to buffer space, if
 	 * it is, then the u-boot tftp or nfs kernel netboot should be
 	 * considered.
+	 *
+	 * The window in a SYN is never scaled (RFC 7323), later ones are only
+	 * scaled when both sides have sent the window scale option.
 	 */
-	b->ip.hdr.tcp_win = htons(tcp->rcv_wnd >> TCP_SCALE);
+	if (action & TCP_SYN)
+		b->ip.hdr.tcp_win = htons(min_t(u32, tcp->rcv_wnd, 0xffff));
+	else
+		b->ip.hdr.tcp_win = htons(min_t(u32, tcp->rcv_wnd >>
+						tcp->loc_win_scale, 0xffff));
 
 	b->ip.hdr.tcp_xsum = 0;
 	b->ip.hdr.tcp_ugr = 0;
@@ -783,6 +909,12 @@ void tcp_parse_options(struct tcp_stream *tcp, uchar *o, int o_len)
 	 * All other options have length fields.
 	 */
 	for (p = o; p < (o + o_len); ) {
+		/* Process optional NOPs */
+		if (p[0] == TCP_1_NOP) {
+			p++;
+			continue;
+		}
+
 		if (!p[1])
 			return; /* Finished processing options */
 
@@ -794,8 +926,16 @@ void tcp_parse_options(struct tcp_stream *tcp, uchar *o, int o_len)
 		case TCP_V_SACK:
 			break;
 		case TCP_O_SCL:
+			/*
+			 * Only valid in a SYN, and only honoured in reply to
+			 * our SYN, which is the one advertising our scale.
+			 */
+			if (tcp->state != TCP_SYN_SENT)
+				break;
 			wsopt = (struct tcp_scale *)p;
-			tcp->rmt_win_scale = wsopt->scale;
+			tcp->rmt_win_scale = min_t(u8, wsopt->scale,
+						   TCP_SCALE_MAX);
+			tcp->loc_win_scale = tcp_rcv_wnd_scale();
 			break;
 		case TCP_O_TS:
 			tsopt = (struct tcp_t_opt *)p;
@@ -803,11 +943,7 @@ void tcp_parse_options(struct tcp_stream *tcp, uchar *o, int o_len)
 			break;
 		}
 
-		/* Process optional NOPs */
-		if (p[0] == TCP_O_NOP)
-			p++;
-		else
-			p += p[1];
+		p += p[1];
 	}
 }
 
@@ -922,6 +1058,7 @@ static int tcp_rx_user_data(struct tcp_stream *tcp, u32 tcp_seq_num,
 {
 	int tmp_len;
 	u32 buf_offs, old_offs, new_offs;
+	bool in_order;
 	u8 action;
 
 	if (!len)
@@ -951,13 +1088,29 @@ static int tcp_rx_user_data(struct tcp_stream *tcp, u32 tcp_seq_num,
 			return TCP_PACKET_DROP;
 		}
 	}
-	if (tmp_len)
+	in_order = tcp_seq_num == tcp->rcv_nxt &&
+		   tcp->lost.len <= TCP_OPT_LEN_2;
+	if (tmp_len) {
+		tcp->sack_recent = tcp_seq_num;
 		tcp_hole(tcp, tcp_seq_num, tmp_len);
+	}
 
 	new_offs = tcp_stream_rx_offs(tcp);
 	if (tcp->on_rcv_nxt_update && old_offs != new_offs)
 		tcp->on_rcv_nxt_update(tcp, new_offs);
 
+	/*
+	 * Delay the acknowledge of in-order data (RFC 1122), but report
+	 * out-of-order segments and filled holes at once, so the sender can
+	 * retransmit the missing data without waiting for its timer.
+	 */
+	if (tcp->state != TCP_CLOSED && in_order &&
+	    ++tcp->ack_pending < CONFIG_PROT_TCP_ACK_SEGS) {
+		if (tcp->ack_pending == 1)
+			tcp->ack_time = get_timer(0);
+		return TCP_PACKET_OK;
+	}
+
 	action = tcp_stream_fin_needed(tcp, tcp->snd_una) | TCP_ACK;
 	tcp_send_packet(tcp, action, tcp->snd_una, tcp->rcv_nxt, 0);
 
@@ -984,10 +1137,12 @@ void tcp_rx_state_machine(struct tcp_stream *tcp,
 	 */
 	tcp_seq_num = ntohl(b->ip.hdr.tcp_seq);
 	tcp_ack_num = ntohl(b->ip.hdr.tcp_ack);
-	tcp_win_size = ntohs(b->ip.hdr.tcp_win) << tcp->rmt_win_scale;
-
 	tcp_flags = b->ip.hdr.tcp_flags;
 
+	tcp_win_size = ntohs(b->ip.hdr.tcp_win);
+	if (!(tcp_flags & TCP_SYN))
+		tcp_win_size <<= tcp->rmt_win_scale;
+
 //	printf("pkt: seq=%d, ack=%d, flags=%x, len=%d\n",
 //		tcp_seq_num - tcp->irs, tcp_ack_num - tcp->iss, tcp_flags, pkt_len);
 //	printf("tcp: rcv_nxt=%d, snd_una=%d, snd_nxt=%d\n\n",
@@ -1184,10 +1339,14 @@ void rxhand_tcp_f(union tcp_build_pkt *b, unsigned int pkt_len)
 		return;
 	}
 
-	/* Build pseudo header and verify TCP header */
+	/*
+	 * Build pseudo header and verify TCP header, unless the device has
+	 * already done so
+	 */
 	tcp_rx_xsum = b->ip.hdr.tcp_xsum;
 	b->ip.hdr.tcp_xsum = 0;
-	if (tcp_rx_xsum != tcp_set_pseudo_header((uchar *)b, b->ip.hdr.ip_src,
+	if (!net_rx_csum_valid &&
+	    tcp_rx_xsum != tcp_set_pseudo_header((uchar *)b, b->ip.hdr.ip_src,
 						 b->ip.hdr.ip_dst, tcp_len,
 						 pkt_len)) {
 		debug_cond(DEBUG_DEV_PKT,
@@ -1212,7 +1371,7 @@ struct tcp_stream *tcp_stream_connect(struct in_addr rhost, u16 rport)
 {
 	struct tcp_stream *tcp;
 
-	tcp = tcp_stream_add(rhost, rport, random_port());
+	tcp = tcp_stream_add(rhost, rport, tcp_free_port());
 	if (!tcp)
 		return NULL;
 
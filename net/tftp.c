@@ -13,11 +13,13 @@
 #include <led.h>
 #include <lmb.h>
 #include <log.h>
+#include <malloc.h>
 #include <mapmem.h>
 #include <net.h>
 #include <net6.h>
 #include <asm/global_data.h>
 #include <net/tftp.h>
+#include <linux/bitops.h>
 #include "bootp.h"
 
 DECLARE_GLOBAL_DATA_PTR;
@@ -26,6 +28,10 @@ DECLARE_GLOBAL_DATA_PTR;
 #define WELL_KNOWN_PORT	69
 /* Millisecs to timeout for lost pkt */
 #define TIMEOUT		5000UL
+/* Lower bound of the timeout derived from the round trip time */
+#define TFTP_RTO_MIN	200UL
+/* Number of blocks kept when they arrive ahead of a missing one */
+#define TFTP_AHEAD_BLOCKS	64
 /* Number of "loading" hashes per line (for checking the image size) */
 #define HASHES_PER_LINE	65
 
@@ -95,6 +101,36 @@ static ushort	tftp_windowsize;
 static ushort	tftp_next_ack;
 /* Last nack block we send */
 static ushort	tftp_last_nack;
+/* Blocks received ahead of tftp_cur_block, bit (block % tftp_ahead_bits) */
+static ulong	tftp_ahead_buf[BITS_TO_LONGS(TFTP_AHEAD_BLOCKS)];
+static ulong	*tftp_ahead_map = tftp_ahead_buf;
+static ulong	tftp_ahead_bits = TFTP_AHEAD_BLOCKS;
+/* 1 once the last (short) block has been received */
+static int	tftp_final_known;
+/* Block number of the last block */
+static ushort	tftp_final_block;
+/* Smoothed round trip time (x8) and its mean deviation (x4), in ms */
+static long	tftp_srtt;
+static long	tftp_rttvar;
+/* Timeout derived from the round trip time */
+static ulong	tftp_rto;
+/* 1 while waiting for the answer to the packet sent at tftp_rtt_sent */
+static int	tftp_rtt_timing;
+static ulong	tftp_rtt_sent;
+#ifdef CONFIG_TFTP_MULTICAST
+/* 1 if the data are received from a multicast group (RFC 2090) */
+static int	tftp_mcast_active;
+/* 1 if we are the client acknowledging the multicast data */
+static int	tftp_mcast_master;
+/* 1 to not ask for multicast, after it failed */
+static int	tftp_mcast_disabled;
+/* The UDP port the multicast data are sent to */
+static int	tftp_mcast_port;
+#else
+#define tftp_mcast_active	0
+#define tftp_mcast_master	0
+#define tftp_mcast_port		0
+#endif
 #ifdef CONFIG_CMD_TFTPPUT
 /* 1 if writing, else 0 */
 static int	tftp_put_active;
@@ -183,6 +219,9 @@ static void new_transfer(void)
 	tftp_prev_block = 0;
 	tftp_block_wrap = 0;
 	tftp_block_wrap_offset = 0;
+	tftp_final_known = 0;
+	memset(tftp_ahead_map, 0,
+	       BITS_TO_LONGS(tftp_ahead_bits) * sizeof(ulong));
 #ifdef CONFIG_CMD_TFTPPUT
 	tftp_put_final_block_sent = 0;
 #endif
@@ -277,6 +316,101 @@ static void update_block_number(void)
 	show_block_marker();
 }
 
+/*
+ * Update the timeout with the time the answer to our last packet took, the
+ * same way TCP does (RFC 6298). The answer to a packet sent again is not
+ * used, as it is not known which one it answers.
+ */
+static void tftp_rtt_sample(void)
+{
+	long rtt, err;
+
+	if (!tftp_rtt_timing)
+		return;
+	tftp_rtt_timing = 0;
+
+	rtt = get_timer(tftp_rtt_sent);
+	if (!tftp_srtt && !tftp_rttvar) {
+		tftp_srtt = rtt << 3;
+		tftp_rttvar = rtt << 1;
+	} else {
+		err = rtt - (tftp_srtt >> 3);
+		tftp_srtt += err;
+		if (err < 0)
+			err = -err;
+		tftp_rttvar += err - (tftp_rttvar >> 2);
+	}
+
+	tftp_rto = (tftp_srtt >> 3) + tftp_rttvar;
+	tftp_rto = clamp(tftp_rto, TFTP_RTO_MIN, timeout_ms);
+}
+
+/* Time to wait for the next packet before sending ours again */
+static ulong tftp_timeout(void)
+{
+	/* a multicast client which is not the master only listens */
+	if (tftp_mcast_active && !tftp_mcast_master)
+		return timeout_ms;
+
+	return tftp_rto;
+}
+
+#ifdef CONFIG_TFTP_MULTICAST
+/* Join the multicast group the server announced */
+static int tftp_mcast_start(struct in_addr addr, int port)
+{
+	ulong *map;
+	int ret;
+
+	/* keep track of every block of the file, they come in any order */
+	map = calloc(BITS_TO_LONGS(TFTP_SEQUENCE_SIZE), sizeof(ulong));
+	if (!map)
+		return -ENOMEM;
+
+	ret = eth_mcast_join(addr, 1);
+	if (ret) {
+		free(map);
+		return ret;
+	}
+
+	tftp_ahead_map = map;
+	tftp_ahead_bits = TFTP_SEQUENCE_SIZE;
+	net_mcast_addr = addr;
+	tftp_mcast_port = port;
+	tftp_mcast_active = 1;
+
+	return 0;
+}
+
+/*
+ * Leave the multicast group, if any. This is called from net_loop() whenever
+ * it stops, so that a failed or aborted transfer does not leave the group
+ * joined and net_mcast_addr set for the next protocol.
+ */
+void tftp_mcast_cleanup(void)
+{
+	if (!tftp_mcast_active)
+		return;
+
+	eth_mcast_join(net_mcast_addr, 0);
+	net_mcast_addr.s_addr = 0;
+	free(tftp_ahead_map);
+	tftp_ahead_map = tftp_ahead_buf;
+	tftp_ahead_bits = TFTP_AHEAD_BLOCKS;
+	tftp_mcast_active = 0;
+	tftp_mcast_master = 0;
+}
+
+/* Start the transfer again without multicast */
+static void tftp_mcast_revert(const char *msg)
+{
+	printf("\n%s, revert to TFTP\n", msg);
+	tftp_mcast_cleanup();
+	tftp_mcast_disabled = 1;
+	net_start_again();
+}
+#endif
+
 /* The TFTP get or put is complete */
 static void tftp_complete(void)
 {
@@ -298,6 +432,10 @@ static void tftp_complete(void)
 	puts("\ndone\n");
 
 	led_activity_off();
+	tftp_mcast_cleanup();
+#ifdef CONFIG_TFTP_MULTICAST
+	tftp_mcast_disabled = 0;
+#endif
 
 	if (!tftp_put_active)
 		efi_set_bootdev("Net", "", tftp_filename,
@@ -360,6 +498,12 @@ static void tftp_send(void)
 		if (tftp_state == STATE_SEND_RRQ && tftp_window_size_option > 1)
 			pkt += sprintf((char *)pkt, "windowsize%c%d%c",
 					0, tftp_window_size_option, 0);
+#ifdef CONFIG_TFTP_MULTICAST
+		/* join the other clients loading the same file, if any */
+		if (tftp_state == STATE_SEND_RRQ && !tftp_mcast_disabled &&
+		    !(IS_ENABLED(CONFIG_IPV6) && use_ip6))
+			pkt += sprintf((char *)pkt, "multicast%c%c", 0, 0);
+#endif
 		len = pkt - xp;
 		break;
 
@@ -433,10 +577,196 @@ static void tftp_send(void)
 		net_send_udp_packet(net_server_ethaddr, tftp_remote_ip,
 				    tftp_remote_port, tftp_our_port, len);
 
-	if (err_pkt)
+	if (err_pkt) {
 		net_set_state(NETLOOP_FAIL);
+		return;
+	}
+
+	/* time the answer */
+	tftp_rtt_timing = 1;
+	tftp_rtt_sent = get_timer(0);
+}
+
+/* Ask the server to send again from the first missing block */
+static void tftp_nack(void)
+{
+	/*
+	 * If one packet is dropped most likely
+	 * all other buffers in the window
+	 * that will arrive will cause a sending NACK.
+	 * This just overwellms the server, let's just send one.
+	 */
+	if (tftp_last_nack == tftp_cur_block)
+		return;
+
+	tftp_send();
+	tftp_last_nack = tftp_cur_block;
+	tftp_next_ack = (ushort)(tftp_cur_block + tftp_windowsize);
+}
+
+/**
+ * tftp_data_block() - handle a data block
+ *
+ * @block:	block number
+ * @data:	block data
+ * @len:	length of @data
+ *
+ * A block arriving ahead of a missing one is stored at once and remembered,
+ * so a reordered block does not cause the window to be sent again, and after
+ * a loss the window is acknowledged as far as the blocks received allow.
+ */
+static void tftp_data_block(ushort block, uchar *data, unsigned int len)
+{
+	ulong ahead, bit;
+
+#ifdef CONFIG_TFTP_MULTICAST
+	if (tftp_mcast_active && !block) {
+		tftp_mcast_revert("File too large for multicast");
+		return;
+	}
+#endif
+
+	/* multicast blocks do not wrap */
+	if (tftp_mcast_active)
+		ahead = block > tftp_cur_block ? block - tftp_cur_block : 0;
+	else if ((ushort)(block - tftp_cur_block) < TFTP_SEQUENCE_SIZE / 2)
+		ahead = (ushort)(block - tftp_cur_block);
+	else
+		ahead = 0;
+
+	/*
+	 * Blocks up to the expected one were received already, do not ACK
+	 * them (required to properly handle the server retransmitting the
+	 * window)
+	 */
+	if (!ahead)
+		return;
+
+	if (ahead > tftp_ahead_bits) {
+		debug("Received unexpected block: %d, expected: %d\n",
+		      block, (ushort)(tftp_cur_block + 1));
+		if (!tftp_mcast_active || tftp_mcast_master)
+			tftp_nack();
+		return;
+	}
+
+	bit = (tftp_cur_block + ahead) % tftp_ahead_bits;
+	if (test_bit(bit, tftp_ahead_map))
+		return;
+
+	if (ahead == 1)
+		tftp_rtt_sample();
+
+	if (store_block(tftp_cur_block + ahead, data, len)) {
+		eth_halt_state_only();
+		net_set_state(NETLOOP_FAIL);
+		return;
+	}
+	generic_set_bit(bit, tftp_ahead_map);
+	if (len < tftp_block_size) {
+		tftp_final_known = 1;
+		tftp_final_block = block;
+	}
+
+	timeout_count = 0;
+	timeout_count_max = tftp_timeout_count_max;
+	net_set_timeout_handler(tftp_timeout(), tftp_timeout_handler);
+
+	/* move over the blocks which are now in order */
+	bit = (tftp_cur_block + 1) % tftp_ahead_bits;
+	while (test_bit(bit, tftp_ahead_map)) {
+		generic_clear_bit(bit, tftp_ahead_map);
+		tftp_prev_block = tftp_cur_block;
+		tftp_cur_block = (tftp_cur_block + 1) % TFTP_SEQUENCE_SIZE;
+		update_block_number();
+		if (tftp_final_known && tftp_cur_block == tftp_final_block) {
+			if (!tftp_mcast_active || tftp_mcast_master)
+				tftp_send();
+			tftp_complete();
+			return;
+		}
+		bit = (tftp_cur_block + 1) % tftp_ahead_bits;
+	}
+
+	if (tftp_mcast_active && !tftp_mcast_master)
+		return;
+
+	/*
+	 *	Acknowledge the window once its last block is in, which will
+	 *	prompt the remote for the next one. If the last block overtook
+	 *	a missing one, the remote waits for us: ask for the hole. Blocks
+	 *	multicast ahead were sent for another client.
+	 */
+	if ((short)((ushort)tftp_cur_block - tftp_next_ack) >= 0) {
+		tftp_send();
+		tftp_next_ack = (ushort)(tftp_cur_block + tftp_windowsize);
+	} else if (!tftp_mcast_active && ahead > 1 &&
+		   (short)(block - tftp_next_ack) >= 0) {
+		tftp_nack();
+	}
 }
 
+#ifdef CONFIG_TFTP_MULTICAST
+/**
+ * tftp_mcast_oack() - handle the multicast option of an OACK
+ *
+ * @pkt:	options
+ * @len:	length of @pkt
+ *
+ * The option value is "<address>,<port>,<master>". Address and port are only
+ * given in the first OACK, later ones only hand the master role over.
+ *
+ * Return: 0 if OK, -1 if the transfer is started again
+ */
+static int tftp_mcast_oack(uchar *pkt, unsigned int len)
+{
+	char *val = NULL, *port, *master;
+	struct in_addr addr;
+	int i;
+
+	for (i = 0; i + 10 < len; i++) {
+		if (strcasecmp((char *)pkt + i, "multicast") == 0) {
+			val = (char *)pkt + i + 10;
+			break;
+		}
+	}
+	if (!val)
+		return 0;
+
+	port = strchr(val, ',');
+	master = port ? strchr(port + 1, ',') : NULL;
+	if (!master)
+		return 0;
+	*port++ = '\0';
+	*master++ = '\0';
+	debug("multicast = %s:%s, master %s\n", val, port, master);
+
+	if (!tftp_mcast_active) {
+		addr = string_to_ip(val);
+		if (!addr.s_addr || !dectoul(port, NULL))
+			return 0;
+		if (tftp_mcast_start(addr, dectoul(port, NULL))) {
+			tftp_mcast_revert("Fail to set mcast");
+			return -1;
+		}
+		tftp_mcast_master = *master == '1';
+		return 0;
+	}
+
+	if (*master == '1' && !tftp_mcast_master) {
+		/* ask for the first block we miss */
+		tftp_mcast_master = 1;
+		tftp_next_ack = (ushort)(tftp_cur_block + tftp_windowsize);
+		net_set_timeout_handler(tftp_timeout(), tftp_timeout_handler);
+		tftp_send();
+	} else {
+		tftp_mcast_master = *master == '1';
+	}
+
+	return 0;
+}
+#endif
+
 #ifdef CONFIG_CMD_TFTPPUT
 static void icmp_handler(unsigned type, unsigned code, unsigned dest,
 			 struct in_addr sip, unsigned src, uchar *pkt,
@@ -457,9 +787,9 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 	int i;
 	u16 timeout_val_rcvd;
 
-	if (dest != tftp_our_port) {
-			return;
-	}
+	if (dest != tftp_our_port &&
+	    !(tftp_mcast_active && dest == tftp_mcast_port))
+		return;
 	if (tftp_state != STATE_SEND_RRQ && src != tftp_remote_port &&
 	    tftp_state != STATE_RECV_WRQ && tftp_state != STATE_SEND_WRQ)
 		return;
@@ -493,6 +823,9 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 				tftp_cur_block = (unsigned short)(block + 1);
 				update_block_number();
 				if (ack_ok) {
+					tftp_rtt_sample();
+					net_set_timeout_handler(tftp_rto,
+								tftp_timeout_handler);
 					if (block == 0 &&
 					    tftp_state == STATE_SEND_WRQ){
 						/* connection's first ACK */
@@ -530,6 +863,14 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 				debug("%c", pkt[i]);
 		}
 		debug("\n");
+#ifdef CONFIG_TFTP_MULTICAST
+		/* later OACKs only hand the master role over */
+		if (tftp_mcast_active) {
+			tftp_mcast_oack(pkt, len);
+			break;
+		}
+#endif
+		tftp_rtt_sample();
 		tftp_state = STATE_OACK;
 		tftp_remote_port = src;
 		/*
@@ -578,6 +919,10 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 
 		tftp_next_ack = tftp_windowsize;
 
+#ifdef CONFIG_TFTP_MULTICAST
+		if (tftp_mcast_oack(pkt, len))
+			break;
+#endif
 #ifdef CONFIG_CMD_TFTPPUT
 		if (tftp_put_active && tftp_state == STATE_OACK) {
 			/* Get ready to send the first block */
@@ -585,43 +930,18 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 			tftp_cur_block++;
 		}
 #endif
-		tftp_send(); /* Send ACK or first data block */
+		/* only the master client asks for data */
+		if (!tftp_mcast_active || tftp_mcast_master)
+			tftp_send(); /* Send ACK or first data block */
+		else
+			net_set_timeout_handler(tftp_timeout(),
+						tftp_timeout_handler);
 		break;
 	case TFTP_DATA:
 		if (len < 2)
 			return;
 		len -= 2;
 
-		if (ntohs(*(__be16 *)pkt) != (ushort)(tftp_cur_block + 1)) {
-			debug("Received unexpected block: %d, expected: %d\n",
-			      ntohs(*(__be16 *)pkt),
-			      (ushort)(tftp_cur_block + 1));
-			/*
-			 * Only ACK if the block count received is greater than
-			 * the expected block count, otherwise skip ACK.
-			 * (required to properly handle the server retransmitting
-			 *  the window)
-			 */
-			if ((ushort)(tftp_cur_block + 1) - (short)(ntohs(*(__be16 *)pkt)) > 0)
-				break;
-			/*
-			 * If one packet is dropped most likely
-			 * all other buffers in the window
-			 * that will arrive will cause a sending NACK.
-			 * This just overwellms the server, let's just send one.
-			 */
-			if (tftp_last_nack != tftp_cur_block) {
-				tftp_send();
-				tftp_last_nack = tftp_cur_block;
-				tftp_next_ack = (ushort)(tftp_cur_block +
-							 tftp_windowsize);
-			}
-			break;
-		}
-
-		tftp_cur_block++;
-		tftp_cur_block %= TFTP_SEQUENCE_SIZE;
-
 		if (tftp_state == STATE_SEND_RRQ) {
 			debug("Server did not acknowledge any options!\n");
 			tftp_next_ack = tftp_windowsize;
@@ -631,50 +951,12 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 		    tftp_state == STATE_RECV_WRQ) {
 			/* first block received */
 			tftp_state = STATE_DATA;
-			tftp_remote_port = src;
+			if (!tftp_mcast_active)
+				tftp_remote_port = src;
 			new_transfer();
-
-			if (tftp_cur_block != 1) {	/* Assertion */
-				puts("\nTFTP error: ");
-				printf("First block is not block 1 (%ld)\n",
-				       tftp_cur_block);
-				puts("Starting again\n\n");
-				net_start_again();
-				break;
-			}
-		}
-
-		if (tftp_cur_block == tftp_prev_block) {
-			/* Same block again; ignore it. */
-			break;
 		}
 
-		update_block_number();
-		tftp_prev_block = tftp_cur_block;
-		timeout_count_max = tftp_timeout_count_max;
-		net_set_timeout_handler(timeout_ms, tftp_timeout_handler);
-
-		if (store_block(tftp_cur_block, pkt + 2, len)) {
-			eth_halt_state_only();
-			net_set_state(NETLOOP_FAIL);
-			break;
-		}
-		timeout_count = 0;
-
-		if (len < tftp_block_size) {
-			tftp_send();
-			tftp_complete();
-			break;
-		}
-
-		/*
-		 *	Acknowledge the block just received, which will prompt
-		 *	the remote for the next one.
-		 */
-		if (tftp_cur_block == tftp_next_ack) {
-			tftp_send();
-			tftp_next_ack += tftp_windowsize;
-		}
+		tftp_data_block(ntohs(*(__be16 *)pkt), pkt + 2, len);
 		break;
 
 	case TFTP_ERROR:
@@ -708,9 +990,18 @@ static void tftp_timeout_handler(void)
 		restart("Retry count exceeded");
 	} else {
 		puts("T ");
-		net_set_timeout_handler(timeout_ms, tftp_timeout_handler);
-		if (tftp_state != STATE_RECV_WRQ)
+		/* back off until an answer comes */
+		tftp_rto = min(tftp_rto * 2, timeout_ms);
+		net_set_timeout_handler(tftp_timeout(), tftp_timeout_handler);
+		if (tftp_state != STATE_RECV_WRQ &&
+		    (!tftp_mcast_active || tftp_mcast_master))
 			tftp_send();
+		/* the remote sends a whole window from our ACK */
+		if (tftp_state == STATE_DATA && !tftp_put_active)
+			tftp_next_ack = (ushort)(tftp_cur_block +
+						 tftp_windowsize);
+		/* do not time the answer to a packet sent again */
+		tftp_rtt_timing = 0;
 	}
 }
 
@@ -916,7 +1207,14 @@ void tftp_start(enum proto_t protocol)
 	time_start = get_timer(0);
 	timeout_count_max = tftp_timeout_count_max;
 
-	net_set_timeout_handler(timeout_ms, tftp_timeout_handler);
+	/* start from the configured timeout until the RTT is measured */
+	tftp_rto = timeout_ms;
+	tftp_srtt = 0;
+	tftp_rttvar = 0;
+	tftp_rtt_timing = 0;
+	tftp_mcast_cleanup();
+
+	net_set_timeout_handler(tftp_rto, tftp_timeout_handler);
 	net_set_udp_handler(tftp_handler);
 #ifdef CONFIG_CMD_TFTPPUT
 	net_set_icmp_handler(icmp_handler);
@@ -969,6 +1267,7 @@ void tftp_start_server(void)
 	timeout_count_max = tftp_timeout_count_max;
 	timeout_count = 0;
 	timeout_ms = TIMEOUT;
+	tftp_rto = timeout_ms;
 	net_set_timeout_handler(timeout_ms, tftp_timeout_handler);
 
 	/* Revert tftp_block_size to dflt */
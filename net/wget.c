@@ -28,20 +28,54 @@ DECLARE_GLOBAL_DATA_PTR;
 
 #define HTTP_STATUS_BAD		0
 #define HTTP_STATUS_OK		200
+#define HTTP_STATUS_PARTIAL	206
 
 static const char http_proto[] = "HTTP/1.0";
 static const char http_eom[] = "\r\n\r\n";
 static const char content_len[] = "Content-Length:";
+static const char content_range[] = "Content-Range:";
 static const char linefeed[] = "\r\n";
 static struct in_addr web_server_ip;
 static unsigned int server_port;
 static unsigned long content_length;
-static u32 http_hdr_size, max_rx_pos;
+static ulong store_checked;
 static int wget_tsize_num_hash;
 
 static char *image_url;
 static enum net_loop_state wget_loop_state;
 
+/**
+ * struct wget_conn - HTTP connection fetching a part of the file
+ *
+ * @tcp:	TCP stream, NULL if the connection is not in use
+ * @start:	file offset of the first byte requested
+ * @end:	file offset after the last byte requested, 0 for end of file
+ * @rcvd:	number of body bytes received in order
+ * @hdr_size:	size of the HTTP header, 0 until it has been parsed
+ * @hdr_len:	number of bytes stored in @hdr
+ * @retries:	number of times the connection may still be resumed
+ * @hdr:	start of the reply, kept until the header has been parsed
+ */
+struct wget_conn {
+	struct tcp_stream	*tcp;
+	ulong			start;
+	ulong			end;
+	ulong			rcvd;
+	u32			hdr_size;
+	u32			hdr_len;
+	int			retries;
+	char			hdr[HTTP_MAX_HDR_LEN + 1];
+};
+
+static struct wget_conn wget_conns[CONFIG_PROT_TCP_STREAMS];
+static struct wget_conn *wget_new_conn;
+static int wget_active, wget_max_conns;
+static u32 wget_rx_packets;
+static enum tcp_status wget_status;
+/* offset of the first byte not assigned to a connection yet */
+static ulong wget_next;
+static bool wget_ranges, wget_running;
+
 /**
  * store_block() - store block in memory
  * @src: source of data
@@ -56,7 +90,8 @@ static inline int store_block(uchar *src, unsigned int offset, unsigned int len)
 	// Avoid overflow
 	if (wget_info->buffer_size && wget_info->buffer_size < offset + len)
 		return -1;
-	if (CONFIG_IS_ENABLED(LMB) && wget_info->set_bootdev) {
+	if (CONFIG_IS_ENABLED(LMB) && wget_info->set_bootdev &&
+	    offset + len > store_checked) {
 		if (store_addr < image_load_addr ||
 		    lmb_read_check(store_addr, len)) {
 			if (!wget_info->silent) {
@@ -74,6 +109,33 @@ static inline int store_block(uchar *src, unsigned int offset, unsigned int len)
 	return 0;
 }
 
+/**
+ * check_blocks() - check the whole destination of the file
+ * @len: file size announced by the server
+ *
+ * Once the size is known the destination is checked against LMB in one go,
+ * so store_block() does not need to do it again for every segment.
+ *
+ * Return: 0 if OK, -1 if the file would overwrite reserved memory
+ */
+static int check_blocks(ulong len)
+{
+	if (!CONFIG_IS_ENABLED(LMB) || !wget_info->set_bootdev || !len)
+		return 0;
+
+	if (image_load_addr + len < image_load_addr ||
+	    lmb_read_check(image_load_addr, len)) {
+		if (!wget_info->silent) {
+			printf("\nwget error: ");
+			printf("trying to overwrite reserved memory\n");
+		}
+		return -1;
+	}
+	store_checked = len;
+
+	return 0;
+}
+
 static void show_block_marker(u32 packets)
 {
 	int cnt;
@@ -98,23 +160,21 @@ static void show_block_marker(u32 packets)
 	}
 }
 
-static void tcp_stream_on_closed(struct tcp_stream *tcp)
+static void wget_finish(void)
 {
-	if (tcp->status != TCP_ERR_OK)
-		wget_loop_state = NETLOOP_FAIL;
-
+	wget_running = false;
 	net_set_state(wget_loop_state);
 	if (wget_loop_state != NETLOOP_SUCCESS) {
 		net_boot_file_size = 0;
 		if (!wget_info->silent)
 			printf("\nwget: Transfer Fail, TCP status - %d\n",
-			       tcp->status);
+			       wget_status);
 		return;
 	}
 
 	if (!wget_info->silent)
 		printf("\nPackets received %d, Transfer Successful\n",
-		       tcp->rx_packets);
+		       wget_rx_packets);
 	wget_info->file_size = net_boot_file_size;
 	if (wget_info->method == WGET_HTTP_METHOD_GET && wget_info->set_bootdev) {
 		efi_set_bootdev("Http", NULL, image_url,
@@ -124,123 +184,341 @@ static void tcp_stream_on_closed(struct tcp_stream *tcp)
 	}
 }
 
-static void tcp_stream_on_rcv_nxt_update(struct tcp_stream *tcp, u32 rx_bytes)
+/**
+ * wget_conn_size() - get the number of bytes a connection has to fetch
+ * @conn: connection
+ *
+ * Return: size of the requested range, or -1 if not known yet
+ */
+static ulong wget_conn_size(struct wget_conn *conn)
 {
-	char	*pos, *tail;
-	uchar	saved, *ptr;
-	int	reply_len;
+	if (wget_info->method == WGET_HTTP_METHOD_HEAD)
+		return 0;
+	if (conn->end)
+		return conn->end - conn->start;
+	if (content_length != -1)
+		return content_length - conn->start;
 
-	if (http_hdr_size) {
-		net_boot_file_size = rx_bytes - http_hdr_size;
-		show_block_marker(tcp->rx_packets);
+	return -1;
+}
+
+/**
+ * wget_connect() - open a connection fetching part of the file
+ * @start: offset of the first byte to fetch
+ * @end: offset after the last byte to fetch, 0 to fetch up to the end
+ * @retries: number of times the connection may be resumed
+ *
+ * Return: 0 if OK, -1 if no connection could be opened
+ */
+static int wget_connect(ulong start, ulong end, int retries)
+{
+	struct tcp_stream *tcp;
+	struct wget_conn *conn;
+
+	for (conn = wget_conns; conn < wget_conns + ARRAY_SIZE(wget_conns);
+	     conn++) {
+		if (!conn->tcp)
+			break;
+	}
+	if (conn == wget_conns + ARRAY_SIZE(wget_conns))
+		return -1;
+
+	conn->start = start;
+	conn->end = end;
+	conn->rcvd = 0;
+	conn->hdr_size = 0;
+	conn->hdr_len = 0;
+	conn->retries = retries;
+
+	wget_new_conn = conn;
+	tcp = tcp_stream_connect(web_server_ip, server_port);
+	wget_new_conn = NULL;
+	if (!tcp)
+		return -1;
+
+	wget_active++;
+	tcp_stream_put(tcp);
+
+	return 0;
+}
+
+/* Open connections for the parts of the file nobody is fetching yet */
+static void wget_connect_ranges(void)
+{
+	ulong end;
+
+	while (wget_active < wget_max_conns && wget_next < content_length) {
+		end = min(wget_next + CONFIG_WGET_RANGE_SIZE, content_length);
+		if (wget_connect(wget_next, end, WGET_RESUME_COUNT))
+			break;
+		wget_next = end;
+	}
+}
+
+static void tcp_stream_on_closed(struct tcp_stream *tcp)
+{
+	struct wget_conn *conn = tcp->priv;
+	ulong size, resume;
+
+	/* the stream is already released, conn->tcp tells if it was ours */
+	if (!wget_running || !conn || !conn->tcp)
 		return;
+
+	conn->tcp = NULL;
+	wget_active--;
+	wget_rx_packets += tcp->rx_packets;
+	if (tcp->status != TCP_ERR_OK)
+		wget_status = tcp->status;
+
+	size = wget_conn_size(conn);
+	if (wget_loop_state != NETLOOP_FAIL &&
+	    (!conn->hdr_size ||
+	     (size == -1 ? tcp->status != TCP_ERR_OK : conn->rcvd < size))) {
+		/* connection lost, ask for the missing part */
+		resume = conn->start + conn->rcvd;
+		if (conn->retries &&
+		    !wget_connect(resume, conn->end, conn->retries - 1)) {
+			if (!wget_info->silent)
+				printf("\nwget: resuming at 0x%lx\n", resume);
+			return;
+		}
+		wget_loop_state = NETLOOP_FAIL;
+	}
+
+	if (wget_loop_state != NETLOOP_FAIL && wget_ranges) {
+		wget_connect_ranges();
+		if (!wget_active && wget_next < content_length)
+			wget_loop_state = NETLOOP_FAIL;
+	}
+
+	if (!wget_active || wget_loop_state == NETLOOP_FAIL) {
+		if (wget_loop_state != NETLOOP_FAIL)
+			wget_loop_state = NETLOOP_SUCCESS;
+		wget_finish();
 	}
+}
+
+/**
+ * wget_parse_range() - parse the Content-Range of a partial response
+ * @hdr: HTTP header
+ * @conn: connection which received it
+ *
+ * Return: 0 if OK, -1 if the range is not the one requested
+ */
+static int wget_parse_range(char *hdr, struct wget_conn *conn)
+{
+	ulong first, last, total;
+	char *pos, *tail;
+
+	pos = strstr(hdr, content_range);
+	if (!pos)
+		return -1;
 
-	ptr = map_sysmem(image_load_addr, rx_bytes + 1);
+	pos += strlen(content_range);
+	while (*pos == ' ')
+		pos++;
+	if (strncmp(pos, "bytes ", 6))
+		return -1;
 
-	saved = ptr[rx_bytes];
-	ptr[rx_bytes] = '\0';
-	pos = strstr((char *)ptr, http_eom);
-	ptr[rx_bytes] = saved;
+	first = simple_strtoul(pos + 6, &tail, 10);
+	if (*tail != '-')
+		return -1;
+	last = simple_strtoul(tail + 1, &tail, 10);
+	if (*tail != '/')
+		return -1;
+	total = simple_strtoul(tail + 1, &tail, 10);
+
+	if (first != conn->start || last < first || last >= total)
+		return -1;
+	if (content_length != -1 && content_length != total)
+		return -1;
+
+	content_length = total;
+	conn->end = last + 1;
+	wget_ranges = true;
+
+	return 0;
+}
+
+static void tcp_stream_on_rcv_nxt_update(struct tcp_stream *tcp, u32 rx_bytes)
+{
+	struct wget_conn *conn = tcp->priv;
+	char	*pos, *tail, *ptr;
+	int	reply_len, len;
+	ulong	size;
+
+	if (conn->hdr_size) {
+		net_boot_file_size += rx_bytes - conn->hdr_size - conn->rcvd;
+		conn->rcvd = rx_bytes - conn->hdr_size;
+		show_block_marker(tcp->rx_packets);
+		return;
+	}
+
+	ptr = conn->hdr;
+	len = min_t(u32, rx_bytes, HTTP_MAX_HDR_LEN);
+	ptr[len] = '\0';
+	pos = strstr(ptr, http_eom);
 
 	if (!pos) {
 		if (rx_bytes < HTTP_MAX_HDR_LEN &&
 		    tcp->state == TCP_ESTABLISHED)
-			goto end;
+			return;
 
 		if (!wget_info->silent)
 			printf("ERROR: misssed HTTP header\n");
-		tcp_stream_close(tcp);
-		goto end;
+		goto fail;
 	}
 
-	http_hdr_size = pos - (char *)ptr + strlen(http_eom);
+	conn->hdr_size = pos - ptr + strlen(http_eom);
 	*pos = '\0';
 
-	if (wget_info->headers && http_hdr_size < MAX_HTTP_HEADERS_SIZE)
+	if (wget_info->headers && conn->hdr_size < MAX_HTTP_HEADERS_SIZE &&
+	    !wget_info->headers[0])
 		strcpy(wget_info->headers, ptr);
 
 	/* check for HTTP proto */
-	if (strncasecmp((char *)ptr, "HTTP/", 5)) {
+	if (strncasecmp(ptr, "HTTP/", 5)) {
 		debug_cond(DEBUG_WGET, "wget: Connected Bad Xfer "
 				       "(no HTTP Status Line found)\n");
-		tcp_stream_close(tcp);
-		goto end;
+		goto fail;
 	}
 
 	/* get HTTP reply len */
-	pos = strstr((char *)ptr, linefeed);
+	pos = strstr(ptr, linefeed);
 	if (pos)
-		reply_len = pos - (char *)ptr;
+		reply_len = pos - ptr;
 	else
-		reply_len = http_hdr_size - strlen(http_eom);
+		reply_len = conn->hdr_size - strlen(http_eom);
 
-	pos = strchr((char *)ptr, ' ');
-	if (!pos || pos - (char *)ptr > reply_len) {
+	pos = strchr(ptr, ' ');
+	if (!pos || pos - ptr > reply_len) {
 		debug_cond(DEBUG_WGET, "wget: Connected Bad Xfer "
 				       "(no HTTP Status Code found)\n");
-		tcp_stream_close(tcp);
-		goto end;
+		goto fail;
 	}
 
 	wget_info->status_code = (u32)simple_strtoul(pos + 1, &tail, 10);
 	if (tail == pos + 1 || *tail != ' ') {
 		debug_cond(DEBUG_WGET, "wget: Connected Bad Xfer "
 				       "(bad HTTP Status Code)\n");
-		tcp_stream_close(tcp);
-		goto end;
+		goto fail;
 	}
 
 	debug_cond(DEBUG_WGET,
 		   "wget: HTTP Status Code %d\n", wget_info->status_code);
 
-	if (wget_info->status_code != HTTP_STATUS_OK) {
+	if (wget_info->status_code == HTTP_STATUS_PARTIAL &&
+	    (conn->start || conn->end)) {
+		if (wget_parse_range(ptr, conn)) {
+			debug_cond(DEBUG_WGET, "wget: Bad Content-Range\n");
+			goto fail;
+		}
+		wget_info->status_code = HTTP_STATUS_OK;
+	} else if (wget_info->status_code == HTTP_STATUS_OK) {
+		/* the server ignored the range, take the whole file */
+		if (conn->start || conn->end) {
+			if (wget_active > 1 || wget_ranges) {
+				debug_cond(DEBUG_WGET,
+					   "wget: range request ignored\n");
+				goto fail;
+			}
+			conn->start = 0;
+			conn->end = 0;
+			net_boot_file_size = 0;
+		}
+		wget_next = ULONG_MAX;
+	} else {
 		debug_cond(DEBUG_WGET, "wget: Connected Bad Xfer\n");
-		tcp_stream_close(tcp);
-		goto end;
+		goto fail;
 	}
 
 	debug_cond(DEBUG_WGET, "wget: Connctd pkt %p  hlen %x\n",
-		   ptr, http_hdr_size);
-
-	content_length = -1;
-	pos = strstr((char *)ptr, content_len);
-	if (pos) {
-		pos += strlen(content_len) + 1;
-		while (*pos == ' ')
-			pos++;
-		content_length = simple_strtoul(pos, &tail, 10);
-		if (*tail != '\r' && *tail != '\n' && *tail != '\0')
-			content_length = -1;
+		   ptr, conn->hdr_size);
+
+	if (content_length == -1 && !conn->end) {
+		pos = strstr(ptr, content_len);
+		if (pos) {
+			pos += strlen(content_len) + 1;
+			while (*pos == ' ')
+				pos++;
+			content_length = simple_strtoul(pos, &tail, 10);
+			if (*tail != '\r' && *tail != '\n' && *tail != '\0')
+				content_length = -1;
+		}
 	}
 
-	if (content_length >= 0) {
+	if (content_length != -1) {
 		debug_cond(DEBUG_WGET,
 			   "wget: Connected Len %lu\n",
 			   content_length);
 		wget_info->hdr_cont_len = content_length;
 		if (wget_info->buffer_size && wget_info->buffer_size < wget_info->hdr_cont_len){
 			tcp_stream_reset(tcp);
-			goto end;
+			wget_loop_state = NETLOOP_FAIL;
+			return;
+		}
+		if (!store_checked && check_blocks(content_length)) {
+			tcp_stream_reset(tcp);
+			wget_loop_state = NETLOOP_FAIL;
+			return;
 		}
+	}
 
+	/*
+	 * Body bytes received along with the header. Holes left by segments
+	 * which have not arrived yet are overwritten when they do.
+	 */
+	size = wget_conn_size(conn);
+	len = conn->hdr_len - conn->hdr_size;
+	if (size != -1 && len > size)
+		len = size;
+	if (len > 0 &&
+	    store_block((uchar *)conn->hdr + conn->hdr_size, conn->start, len)) {
+		tcp_stream_reset(tcp);
+		wget_loop_state = NETLOOP_FAIL;
+		return;
 	}
 
-	net_boot_file_size = rx_bytes - http_hdr_size;
-	memmove(ptr, ptr + http_hdr_size, max_rx_pos + 1 - http_hdr_size);
-	wget_loop_state = NETLOOP_SUCCESS;
+	conn->rcvd = rx_bytes - conn->hdr_size;
+	net_boot_file_size += conn->rcvd;
 
-end:
-	unmap_sysmem(ptr);
+	if (wget_ranges)
+		wget_connect_ranges();
+	return;
+
+fail:
+	wget_loop_state = NETLOOP_FAIL;
+	tcp_stream_close(tcp);
 }
 
 static int tcp_stream_rx(struct tcp_stream *tcp, u32 rx_offs, void *buf, int len)
 {
-	if ((max_rx_pos == (u32)(-1)) || (max_rx_pos < rx_offs + len - 1))
-		max_rx_pos = rx_offs + len - 1;
+	struct wget_conn *conn = tcp->priv;
+	int skip;
+
+	/* keep the header apart until it is complete */
+	if (!conn->hdr_size) {
+		if (rx_offs >= HTTP_MAX_HDR_LEN)
+			return 0;
+
+		len = min_t(int, len, HTTP_MAX_HDR_LEN - rx_offs);
+		memcpy(conn->hdr + rx_offs, buf, len);
+		if (conn->hdr_len < rx_offs + len)
+			conn->hdr_len = rx_offs + len;
+		return len;
+	}
+
+	skip = 0;
+	if (rx_offs < conn->hdr_size) {
+		skip = conn->hdr_size - rx_offs;
+		if (skip >= len)
+			return len;
+	}
 
 	// Avoid overflow
-	if (store_block(buf, rx_offs - http_hdr_size, len) < 0)
+	if (store_block(buf + skip,
+			conn->start + rx_offs + skip - conn->hdr_size,
+			len - skip) < 0)
 		return -1;
 
 	return len;
@@ -248,6 +526,7 @@ static int tcp_stream_rx(struct tcp_stream *tcp, u32 rx_offs, void *buf, int len
 
 static int tcp_stream_tx(struct tcp_stream *tcp, u32 tx_offs, void *buf, int maxlen)
 {
+	struct wget_conn *conn = tcp->priv;
 	int ret;
 	const char *method;
 
@@ -264,8 +543,18 @@ static int tcp_stream_tx(struct tcp_stream *tcp, u32 tx_offs, void *buf, int max
 		break;
 	}
 
-	ret = snprintf(buf, maxlen, "%s %s %s\r\n\r\n",
-		       method, image_url, http_proto);
+	if (conn->end)
+		ret = snprintf(buf, maxlen,
+			       "%s %s %s\r\nRange: bytes=%lu-%lu\r\n\r\n",
+			       method, image_url, http_proto, conn->start,
+			       conn->end - 1);
+	else if (conn->start)
+		ret = snprintf(buf, maxlen,
+			       "%s %s %s\r\nRange: bytes=%lu-\r\n\r\n",
+			       method, image_url, http_proto, conn->start);
+	else
+		ret = snprintf(buf, maxlen, "%s %s %s\r\n\r\n",
+			       method, image_url, http_proto);
 
 	return ret;
 }
@@ -273,7 +562,7 @@ static int tcp_stream_tx(struct tcp_stream *tcp, u32 tx_offs, void *buf, int max
 static int tcp_stream_on_create(struct tcp_stream *tcp)
 {
 	if (tcp->rhost.s_addr != web_server_ip.s_addr ||
-	    tcp->rport != server_port)
+	    tcp->rport != server_port || !wget_new_conn)
 		return 0;
 
 	tcp->max_retry_count = WGET_RETRY_COUNT;
@@ -282,6 +571,8 @@ static int tcp_stream_on_create(struct tcp_stream *tcp)
 	tcp->on_rcv_nxt_update = tcp_stream_on_rcv_nxt_update;
 	tcp->rx = tcp_stream_rx;
 	tcp->tx = tcp_stream_tx;
+	tcp->priv = wget_new_conn;
+	wget_new_conn->tcp = tcp;
 
 	return 1;
 }
@@ -290,7 +581,7 @@ static int tcp_stream_on_create(struct tcp_stream *tcp)
 
 void wget_start(void)
 {
-	struct tcp_stream *tcp;
+	int ret;
 
 	if (!wget_info)
 		wget_info = &default_wget_info;
@@ -340,11 +631,16 @@ void wget_start(void)
 
 	memset(net_server_ethaddr, 0, 6);
 
-	max_rx_pos = (u32)(-1);
 	net_boot_file_size = 0;
-	http_hdr_size = 0;
+	content_length = -1;
+	store_checked = 0;
 	wget_tsize_num_hash = 0;
-	wget_loop_state = NETLOOP_FAIL;
+	wget_loop_state = NETLOOP_CONTINUE;
+	wget_status = TCP_ERR_OK;
+	wget_rx_packets = 0;
+	wget_active = 0;
+	wget_ranges = false;
+	memset(wget_conns, 0, sizeof(wget_conns));
 
 	wget_info->status_code = HTTP_STATUS_BAD;
 	wget_info->file_size = 0;
@@ -353,15 +649,35 @@ void wget_start(void)
 		wget_info->headers[0] = 0;
 
 	server_port = env_get_ulong("httpdstp", 10, SERVER_PORT) & 0xffff;
+	wget_max_conns = env_get_ulong("wgetconns", 10,
+				       CONFIG_WGET_CONNECTIONS);
+	if (wget_max_conns < 1 ||
+	    wget_info->method == WGET_HTTP_METHOD_HEAD)
+		wget_max_conns = 1;
+	if (wget_max_conns > ARRAY_SIZE(wget_conns))
+		wget_max_conns = ARRAY_SIZE(wget_conns);
+
 	tcp_stream_set_on_create_handler(tcp_stream_on_create);
-	tcp = tcp_stream_connect(web_server_ip, server_port);
-	if (!tcp) {
+	wget_running = true;
+	/*
+	 * With several connections the first one asks for the first range
+	 * only, the others are opened once the server has confirmed it
+	 * supports range requests and told the size of the file.
+	 */
+	if (wget_max_conns > 1) {
+		wget_next = CONFIG_WGET_RANGE_SIZE;
+		ret = wget_connect(0, wget_next, WGET_RESUME_COUNT);
+	} else {
+		wget_next = ULONG_MAX;
+		ret = wget_connect(0, 0, WGET_RESUME_COUNT);
+	}
+	if (ret) {
+		wget_running = false;
 		if (!wget_info->silent)
 			printf("No free tcp streams\n");
 		net_set_state(NETLOOP_FAIL);
 		return;
 	}
-	tcp_stream_put(tcp);
 }
 
 int wget_do_request(ulong dst_addr, char *uri)
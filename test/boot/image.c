@@ -7,6 +7,9 @@
  */
 
 #include <image.h>
+#include <hash.h>
+#include <malloc.h>
+#include <linux/libfdt.h>
 #include <test/ut.h>
 #include "bootstd_common.h"
 
@@ -32,3 +35,78 @@ static int test_image_phase(struct unit_test_state *uts)
 	return 0;
 }
 BOOTSTD_TEST(test_image_phase, 0);
+
+/* Test that hashing an image progressively matches calculate_hash() */
+static int test_image_fit_hash(struct unit_test_state *uts)
+{
+	static const char *const algos[] = { "crc32", "sha1", "sha256" };
+	const int size = 300000, fit_size = size + 0x1000;
+	struct fit_image_hashes hashes;
+	uint8_t value[FIT_MAX_HASH_LEN];
+	int images, node, hnode, value_len;
+	int i, pos, len;
+	char name[20];
+	u8 *data;
+	void *fit;
+
+	data = malloc(size);
+	ut_assertnonnull(data);
+	for (i = 0; i < size; i++)
+		data[i] = i * 7 + (i >> 9);
+
+	fit = malloc(fit_size);
+	ut_assertnonnull(fit);
+	ut_assertok(fdt_create_empty_tree(fit, fit_size));
+	images = fdt_add_subnode(fit, 0, FIT_IMAGES_PATH + 1);
+	ut_assert(images >= 0);
+	node = fdt_add_subnode(fit, images, "kernel");
+	ut_assert(node >= 0);
+	ut_assertok(fdt_setprop(fit, node, FIT_DATA_PROP, data, size));
+	for (i = 0; i < ARRAY_SIZE(algos); i++) {
+		snprintf(name, sizeof(name), "%s-%d", FIT_HASH_NODENAME, i + 1);
+		hnode = fdt_add_subnode(fit, node, name);
+		ut_assert(hnode >= 0);
+		ut_assertok(fdt_setprop_string(fit, hnode, FIT_ALGO_PROP,
+					       algos[i]));
+		ut_assertok(calculate_hash(data, size, algos[i], value,
+					   &value_len));
+		ut_assertok(fdt_setprop(fit, hnode, FIT_VALUE_PROP, value,
+					value_len));
+	}
+	node = fdt_path_offset(fit, FIT_IMAGES_PATH "/kernel");
+	ut_assert(node >= 0);
+	ut_asserteq(1, fit_image_verify(fit, node));
+
+	/* hash the data in uneven parts, as when loading it in chunks */
+	fit_image_hash_start(fit, node, &hashes);
+	ut_asserteq(ARRAY_SIZE(algos), hashes.count);
+	for (pos = 0; pos < size; pos += len) {
+		len = min(size - pos, 1000 + pos / 3);
+		fit_image_hash_update(&hashes, data + pos, len,
+				      pos + len == size);
+	}
+	fit_image_hash_finish(&hashes);
+	for (i = 0; i < hashes.count; i++) {
+		ut_assertok(calculate_hash(data, size, hashes.hash[i].algo->name,
+					   value, &value_len));
+		ut_asserteq(value_len, hashes.hash[i].value_len);
+		ut_asserteq_mem(value, hashes.hash[i].value, value_len);
+	}
+	ut_asserteq(1, fit_image_verify_hashed(fit, node, fit, data, size,
+					       &hashes));
+
+	/* a digest which does not match must be rejected */
+	hashes.hash[1].value[0] ^= 1;
+	ut_asserteq(0, fit_image_verify_hashed(fit, node, fit, data, size,
+					       &hashes));
+
+	/* as must corrupt data */
+	data[size / 2] ^= 1;
+	ut_asserteq(0, fit_image_verify_with_data(fit, node, fit, data, size));
+
+	free(fit);
+	free(data);
+
+	return 0;
+}
+BOOTSTD_TEST(test_image_fit_hash, 0);
@@ -0,0 +1,460 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for the tftpboot command, against a fake server which drops and
+ * reorders packets
+ */
+
+#include <command.h>
+#include <console.h>
+#include <dm.h>
+#include <env.h>
+#include <mapmem.h>
+#include <net.h>
+#include <asm/eth.h>
+#include <asm/unaligned.h>
+#include <dm/test.h>
+#include <test/cmd.h>
+#include <test/test.h>
+#include <test/ut.h>
+#include <linux/sizes.h>
+
+/* TFTP opcodes */
+#define SB_TFTP_RRQ	1
+#define SB_TFTP_DATA	3
+#define SB_TFTP_ACK	4
+#define SB_TFTP_ERROR	5
+#define SB_TFTP_OACK	6
+
+#define SB_TFTP_PORT	4321
+#define SB_TFTP_BLKSIZE	512
+#define SB_TFTP_WINDOW	3
+#define SB_TFTP_BLOCKS	256
+#define SB_MCAST_PORT	1758
+#define SB_MCAST_ADDR	"239.1.1.1"
+/* Blocks multicast to the group for another client */
+#define SB_MCAST_EARLY	5
+#define SB_MCAST_LATE	100
+
+/**
+ * struct sb_tftp - state of the fake TFTP server
+ *
+ * @size: size of the file served
+ * @reorder: true to swap the first two blocks of every other window
+ * @loss: true to drop the first transmission of some blocks
+ * @mcast: true to answer the multicast option
+ * @fail: true to answer the ACK of block 2 with a file not found error
+ * @port: client port
+ * @window: window size negotiated
+ * @highest: highest block sent
+ * @sent: number of times each block has been delivered
+ * @lost: true for each block which has been dropped
+ * @drops: number of blocks dropped
+ * @dups: number of blocks delivered more than once
+ * @nacks: number of ACKs not for the highest block sent
+ * @zero_acks: number of ACKs for block 0
+ * @joined: true if the client was in the group when it was sent data
+ * @done: true once the last block has been acknowledged
+ */
+struct sb_tftp {
+	u32 size;
+	bool reorder;
+	bool loss;
+	bool mcast;
+	bool fail;
+	u16 port;
+	int window;
+	int highest;
+	u8 sent[SB_TFTP_BLOCKS];
+	bool lost[SB_TFTP_BLOCKS];
+	int drops;
+	int dups;
+	int nacks;
+	int zero_acks;
+	bool joined;
+	bool done;
+};
+
+static struct sb_tftp sb_tftp;
+
+static int sb_arp_handler(struct udevice *dev, void *packet,
+			  unsigned int len)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	struct arp_hdr *arp = packet + ETHER_HDR_SIZE;
+	int ret = 0;
+
+	if (ntohs(arp->ar_op) == ARPOP_REQUEST) {
+		priv->fake_host_ipaddr = net_read_ip(&arp->ar_spa);
+
+		ret = sandbox_eth_recv_arp_req(dev);
+		if (ret)
+			return ret;
+		ret = sandbox_eth_arp_req_to_reply(dev, packet, len);
+		return ret;
+	}
+
+	return -EPROTONOSUPPORT;
+}
+
+/* Content of the file served */
+static uchar sb_tftp_byte(u32 offs)
+{
+	return offs * 7 + (offs >> 9);
+}
+
+/* Number of the last block of the file */
+static int sb_tftp_last(void)
+{
+	return sb_tftp.size / SB_TFTP_BLKSIZE + 1;
+}
+
+/* Queue a TFTP packet to the client, or to the multicast group */
+static void sb_tftp_queue(struct udevice *dev, struct ethernet_hdr *eth,
+			  struct ip_udp_hdr *ip, uchar *data, int len,
+			  bool mcast)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	struct ip_udp_hdr *ip_send;
+	struct ethernet_hdr *eth_send;
+	struct in_addr dest;
+
+	eth_send = (void *)priv->recv_packet_buffer[priv->recv_packets];
+	memcpy(eth_send->et_dest, eth->et_src, ARP_HLEN);
+	memcpy(eth_send->et_src, priv->fake_host_hwaddr, ARP_HLEN);
+	eth_send->et_protlen = htons(PROT_IP);
+	ip_send = (void *)eth_send + ETHER_HDR_SIZE;
+	dest = net_read_ip(&ip->ip_src);
+	ip_send->udp_dst = htons(sb_tftp.port);
+	if (mcast) {
+		dest = string_to_ip(SB_MCAST_ADDR);
+		eth_send->et_dest[0] = 0x01;
+		eth_send->et_dest[1] = 0x00;
+		eth_send->et_dest[2] = 0x5e;
+		memcpy(&eth_send->et_dest[3], (uchar *)&dest.s_addr + 1, 3);
+		eth_send->et_dest[3] &= 0x7f;
+		ip_send->udp_dst = htons(SB_MCAST_PORT);
+		sb_tftp.joined = !memcmp(priv->mcast_hwaddr,
+					 eth_send->et_dest, ARP_HLEN);
+	}
+
+	memcpy((uchar *)ip_send + IP_UDP_HDR_SIZE, data, len);
+	net_set_ip_header((uchar *)ip_send, dest, net_read_ip(&ip->ip_dst),
+			  IP_UDP_HDR_SIZE + len, IPPROTO_UDP);
+	ip_send->udp_src = htons(SB_TFTP_PORT);
+	ip_send->udp_len = htons(UDP_HDR_SIZE + len);
+	ip_send->udp_xsum = 0;
+
+	priv->recv_packet_length[priv->recv_packets] = ETHER_HDR_SIZE +
+		IP_UDP_HDR_SIZE + len;
+	++priv->recv_packets;
+}
+
+/* Send a data block, unless it is to be lost */
+static void sb_tftp_block(struct udevice *dev, struct ethernet_hdr *eth,
+			  struct ip_udp_hdr *ip, int block)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	uchar data[4 + SB_TFTP_BLKSIZE];
+	u32 offs = (block - 1) * SB_TFTP_BLKSIZE;
+	int len, i;
+
+	if (block > sb_tftp_last())
+		return;
+
+	/* blocks which do not fit in the receive queue are lost as well */
+	sb_tftp.highest = max(sb_tftp.highest, block);
+	if (priv->recv_packets >= PKTBUFSRX ||
+	    (sb_tftp.loss && !(block % 23) && !sb_tftp.lost[block])) {
+		sb_tftp.lost[block] = true;
+		sb_tftp.drops++;
+		return;
+	}
+	if (sb_tftp.sent[block]++)
+		sb_tftp.dups++;
+
+	len = min_t(u32, SB_TFTP_BLKSIZE, sb_tftp.size - offs);
+	put_unaligned_be16(SB_TFTP_DATA, data);
+	put_unaligned_be16(block, data + 2);
+	for (i = 0; i < len; i++)
+		data[4 + i] = sb_tftp_byte(offs + i);
+
+	sb_tftp_queue(dev, eth, ip, data, 4 + len, sb_tftp.mcast);
+}
+
+/*
+ * The window is sent again from @block: what is still queued of the previous
+ * one is replaced, the receive queue being too short to hold both
+ */
+static void sb_tftp_flush(struct udevice *dev)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	uchar *data;
+
+	/* the first packet is the one the client is processing */
+	while (priv->recv_packets > 1) {
+		data = priv->recv_packet_buffer[--priv->recv_packets] +
+		       ETHER_HDR_SIZE + IP_UDP_HDR_SIZE;
+		if (get_unaligned_be16(data) == SB_TFTP_DATA)
+			sb_tftp.sent[get_unaligned_be16(data + 2)]--;
+	}
+}
+
+/* Send an OACK, @mcast is the value of the multicast option, if any */
+static void sb_tftp_oack(struct udevice *dev, struct ethernet_hdr *eth,
+			 struct ip_udp_hdr *ip, bool tsize, const char *mcast)
+{
+	uchar data[128];
+	int len = 2;
+
+	put_unaligned_be16(SB_TFTP_OACK, data);
+	len += sprintf((char *)data + len, "blksize%c%d%c", 0,
+		       SB_TFTP_BLKSIZE, 0);
+	if (tsize)
+		len += sprintf((char *)data + len, "tsize%c%u%c", 0,
+			       sb_tftp.size, 0);
+	if (mcast)
+		len += sprintf((char *)data + len, "multicast%c%s%c", 0,
+			       mcast, 0);
+	else if (sb_tftp.window > 1)
+		len += sprintf((char *)data + len, "windowsize%c%d%c", 0,
+			       sb_tftp.window, 0);
+
+	sb_tftp_queue(dev, eth, ip, data, len, false);
+}
+
+static void sb_tftp_rrq(struct udevice *dev, struct ethernet_hdr *eth,
+			struct ip_udp_hdr *ip, char *req, int len)
+{
+	char *end = req + len, *name, *val;
+	bool tsize = false, mcast = false;
+
+	sb_tftp.port = ntohs(ip->udp_src);
+	sb_tftp.window = 1;
+
+	/* file name and mode, then options */
+	req += strlen(req) + 1;
+	req += strlen(req) + 1;
+	while (req < end) {
+		name = req;
+		val = name + strlen(name) + 1;
+		req = val + strlen(val) + 1;
+		if (!strcmp(name, "windowsize"))
+			sb_tftp.window = min_t(int, SB_TFTP_WINDOW,
+					       dectoul(val, NULL));
+		else if (!strcmp(name, "tsize"))
+			tsize = true;
+		else if (!strcmp(name, "multicast"))
+			mcast = true;
+	}
+
+	if (!sb_tftp.mcast || !mcast) {
+		sb_tftp.mcast = false;
+		sb_tftp_oack(dev, eth, ip, tsize, NULL);
+		return;
+	}
+
+	/*
+	 * Another client is the master and is loading the file: the client
+	 * joins the group and gets some blocks, then becomes the master
+	 */
+	sb_tftp.window = 1;
+	sb_tftp_oack(dev, eth, ip, tsize, SB_MCAST_ADDR ","
+		     __stringify(SB_MCAST_PORT) ",0");
+	sb_tftp_block(dev, eth, ip, SB_MCAST_EARLY);
+	sb_tftp_oack(dev, eth, ip, false, ",,1");
+}
+
+static int sb_tftp_handler(struct udevice *dev, void *packet,
+			   unsigned int len)
+{
+	struct ethernet_hdr *eth = packet;
+	struct ip_udp_hdr *ip = packet + ETHER_HDR_SIZE;
+	uchar *data = (uchar *)ip + IP_UDP_HDR_SIZE;
+	int block, i;
+
+	if (ntohs(eth->et_protlen) == PROT_ARP)
+		return sb_arp_handler(dev, packet, len);
+	if (ntohs(eth->et_protlen) != PROT_IP || ip->ip_p != IPPROTO_UDP)
+		return -EPROTONOSUPPORT;
+
+	len = ntohs(ip->udp_len) - UDP_HDR_SIZE;
+	switch (get_unaligned_be16(data)) {
+	case SB_TFTP_RRQ:
+		sb_tftp_rrq(dev, eth, ip, (char *)data + 2, len - 2);
+		break;
+	case SB_TFTP_ACK:
+		block = get_unaligned_be16(data + 2);
+		if (!block)
+			sb_tftp.zero_acks++;
+		if (block == sb_tftp_last()) {
+			sb_tftp.done = true;
+			break;
+		}
+		if (block != sb_tftp.highest) {
+			sb_tftp.nacks++;
+			sb_tftp_flush(dev);
+		}
+
+		/* send the next window */
+		if (sb_tftp.reorder && sb_tftp.window > 1 &&
+		    !(block / sb_tftp.window % 2)) {
+			sb_tftp_block(dev, eth, ip, block + 2);
+			sb_tftp_block(dev, eth, ip, block + 1);
+			i = 3;
+		} else {
+			i = 1;
+		}
+		for (; i <= sb_tftp.window; i++)
+			sb_tftp_block(dev, eth, ip, block + i);
+
+		/* some late block for the other client */
+		if (sb_tftp.mcast && block == 2)
+			sb_tftp_block(dev, eth, ip, SB_MCAST_LATE);
+		if (sb_tftp.fail && block == 2) {
+			uchar err[] = { 0, SB_TFTP_ERROR, 0, 1, 'x', 0 };
+
+			sb_tftp_queue(dev, eth, ip, err, sizeof(err), false);
+		}
+		break;
+	}
+
+	return 0;
+}
+
+/*
+ * Load the file with the tftpboot command and check what has been received,
+ * return the number of timeouts, each shown as 'T' in the progress, in
+ * @timeoutsp
+ */
+static int sb_tftp_load(struct unit_test_state *uts, u32 size, int *timeoutsp)
+{
+	ulong addr = SZ_2M;
+	uchar *buf;
+	char *p;
+	u32 i;
+
+	sb_tftp.size = size;
+	sb_tftp.done = false;
+	ut_assertok(run_commandf("tftpboot %lx 1.1.2.2:file.bin", addr));
+	*timeoutsp = 0;
+	do {
+		ut_assert(console_record_readline(uts->actual_str,
+						  sizeof(uts->actual_str)) >= 0);
+		for (p = strstr(uts->actual_str, "T "); p;
+		     p = strstr(p + 2, "T "))
+			(*timeoutsp)++;
+	} while (strncmp(uts->actual_str, "Bytes transferred", 17));
+	snprintf(uts->expect_str, sizeof(uts->expect_str),
+		 "Bytes transferred = %u (%x hex)", size, size);
+	ut_asserteq_str(uts->expect_str, uts->actual_str);
+	ut_assert_console_end();
+	ut_assert(sb_tftp.done);
+
+	buf = map_sysmem(addr, size);
+	for (i = 0; i < size; i++) {
+		if (buf[i] != sb_tftp_byte(i))
+			break;
+	}
+	unmap_sysmem(buf);
+	ut_asserteq(size, i);
+
+	return 0;
+}
+
+static int net_test_tftp_window(struct unit_test_state *uts)
+{
+	char *prev_ethact = env_get("ethact");
+	char *prev_ethrotate = env_get("ethrotate");
+	char *prev_window = env_get("tftpwindowsize");
+	u32 size = SZ_64K + 123;
+	int timeouts;
+
+	sandbox_eth_set_tx_handler(0, sb_tftp_handler);
+	sandbox_eth_set_priv(0, uts);
+
+	env_set("ethact", "eth@10002000");
+	env_set("ethrotate", "no");
+	env_set("tftpwindowsize", __stringify(SB_TFTP_WINDOW));
+
+	/* a block ahead of the expected one does not cause a resend */
+	memset(&sb_tftp, '\0', sizeof(sb_tftp));
+	sb_tftp.reorder = true;
+	ut_assertok(sb_tftp_load(uts, size, &timeouts));
+	ut_asserteq(SB_TFTP_WINDOW, sb_tftp.window);
+	ut_asserteq(0, sb_tftp.drops);
+	ut_asserteq(0, sb_tftp.dups);
+	ut_asserteq(0, sb_tftp.nacks);
+
+	/* lost blocks followed by another are asked again without a timeout */
+	memset(&sb_tftp, '\0', sizeof(sb_tftp));
+	sb_tftp.reorder = true;
+	sb_tftp.loss = true;
+	ut_assertok(sb_tftp_load(uts, size, &timeouts));
+	ut_assert(sb_tftp.drops > 0);
+	ut_asserteq(sb_tftp.drops, sb_tftp.nacks);
+	ut_assert(sb_tftp.dups <= sb_tftp.drops);
+	ut_assert(timeouts < sb_tftp.drops);
+
+	sandbox_eth_set_tx_handler(0, NULL);
+	env_set("ethact", prev_ethact);
+	env_set("ethrotate", prev_ethrotate);
+	env_set("tftpwindowsize", prev_window);
+
+	return 0;
+}
+CMD_TEST(net_test_tftp_window, UTF_CONSOLE);
+
+static int net_test_tftp_mcast(struct unit_test_state *uts)
+{
+	char *prev_ethact = env_get("ethact");
+	char *prev_ethrotate = env_get("ethrotate");
+	struct eth_sandbox_priv *priv;
+	struct udevice *dev;
+	u8 zero[ARP_HLEN] = {};
+	int timeouts;
+
+	if (!IS_ENABLED(CONFIG_TFTP_MULTICAST))
+		return -EAGAIN;
+
+	sandbox_eth_set_tx_handler(0, sb_tftp_handler);
+	sandbox_eth_set_priv(0, uts);
+
+	env_set("ethact", "eth@10002000");
+	env_set("ethrotate", "no");
+
+	/* blocks multicast for the other client are not asked again */
+	memset(&sb_tftp, '\0', sizeof(sb_tftp));
+	sb_tftp.mcast = true;
+	ut_assertok(sb_tftp_load(uts, 120 * SB_TFTP_BLKSIZE + 77, &timeouts));
+	ut_assert(sb_tftp.mcast);
+	ut_assert(sb_tftp.joined);
+	ut_asserteq(1, sb_tftp.zero_acks);
+	ut_asserteq(0, sb_tftp.dups);
+	ut_asserteq(1, sb_tftp.sent[SB_MCAST_EARLY]);
+	ut_asserteq(1, sb_tftp.sent[SB_MCAST_LATE]);
+
+	/* the group has been left */
+	ut_assertok(uclass_get_device_by_name(UCLASS_ETH, "eth@10002000",
+					      &dev));
+	priv = dev_get_priv(dev);
+	ut_asserteq_mem(zero, priv->mcast_hwaddr, ARP_HLEN);
+
+	/* the group is also left when the transfer fails */
+	memset(&sb_tftp, '\0', sizeof(sb_tftp));
+	sb_tftp.mcast = true;
+	sb_tftp.fail = true;
+	sb_tftp.size = 120 * SB_TFTP_BLKSIZE;
+	ut_asserteq(1, run_commandf("tftpboot %x 1.1.2.2:file.bin", SZ_2M));
+	ut_assert_skip_to_line("Not retrying...");
+	ut_assertok(console_record_reset_enable());
+	ut_assert(sb_tftp.joined);
+	ut_asserteq_mem(zero, priv->mcast_hwaddr, ARP_HLEN);
+	ut_asserteq(0, net_mcast_addr.s_addr);
+
+	sandbox_eth_set_tx_handler(0, NULL);
+	env_set("ethact", prev_ethact);
+	env_set("ethrotate", prev_ethrotate);
+
+	return 0;
+}
+CMD_TEST(net_test_tftp_mcast, UTF_CONSOLE);
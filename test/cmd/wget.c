@@ -12,9 +12,11 @@
 #include <fdtdec.h>
 #include <log.h>
 #include <malloc.h>
+#include <mapmem.h>
 #include <net.h>
 #include <net/tcp.h>
 #include <net/wget.h>
+#include <asm/unaligned.h>
 #include <asm/eth.h>
 #include <dm/test.h>
 #include <dm/device-internal.h>
@@ -22,6 +24,8 @@
 #include <test/cmd.h>
 #include <test/test.h>
 #include <test/ut.h>
+#include <linux/sizes.h>
+#include <time.h>
 
 #define SHIFT_TO_TCPHDRLEN_FIELD(x) ((x) << 4)
 #define LEN_B_TO_DW(x) ((x) >> 2)
@@ -73,7 +77,7 @@ static int sb_syn_handler(struct udevice *dev, void *packet,
 	tcp_send->tcp_ack = htonl(priv->irs + 1);
 	tcp_send->tcp_hlen = SHIFT_TO_TCPHDRLEN_FIELD(LEN_B_TO_DW(TCP_HDR_SIZE));
 	tcp_send->tcp_flags = TCP_SYN | TCP_ACK;
-	tcp_send->tcp_win = htons(PKTBUFSRX * TCP_MSS >> TCP_SCALE);
+	tcp_send->tcp_win = htons(PKTBUFSRX * TCP_MSS);
 	tcp_send->tcp_xsum = 0;
 	tcp_send->tcp_ugr = 0;
 	tcp_send->tcp_xsum = tcp_set_pseudo_header((uchar *)tcp_send,
@@ -166,7 +170,7 @@ static int sb_ack_handler(struct udevice *dev, void *packet,
 	}
 
 	tcp_send->tcp_hlen = SHIFT_TO_TCPHDRLEN_FIELD(LEN_B_TO_DW(TCP_HDR_SIZE));
-	tcp_send->tcp_win = htons(PKTBUFSRX * TCP_MSS >> TCP_SCALE);
+	tcp_send->tcp_win = htons(PKTBUFSRX * TCP_MSS);
 	tcp_send->tcp_xsum = 0;
 	tcp_send->tcp_ugr = 0;
 	pkt_len = IP_TCP_HDR_SIZE + payload_len;
@@ -242,6 +246,776 @@ static int net_test_wget(struct unit_test_state *uts)
 }
 CMD_TEST(net_test_wget, UTF_CONSOLE);
 
+/* Size of the file served by the stream test */
+#define STREAM_FILE_SIZE	SZ_128K
+/* Payload of a full sized segment, as sent by a server using timestamps */
+#define STREAM_SEG_SIZE		1448
+/* Simulated one way link delay for every flight of segments */
+#define STREAM_DELAY_MS		5
+/* Every STREAM_DROP_EVERY-th segment is lost on its first transmission */
+#define STREAM_DROP_EVERY	23
+/* Every STREAM_REORDER_EVERY-th segment is overtaken by its successor */
+#define STREAM_REORDER_EVERY	17
+/* Window scale the server announces */
+#define STREAM_SRV_SCALE	7
+
+/**
+ * struct sb_stream - state of the fake HTTP server used by the stream test
+ *
+ * @data: HTTP reply (header followed by the file)
+ * @len: length of @data
+ * @una: first byte of @data not acknowledged by the client
+ * @nxt: next byte of @data to send
+ * @rtx: last position retransmitted
+ * @ack: last acknowledge received
+ * @rcv_nxt: next sequence expected from the client
+ * @scale: window scale announced by the client
+ * @fin_sent: true if the server has closed its side
+ * @segs: number of data segments sent, including retransmits
+ * @drops: number of segments lost on purpose
+ * @retransmits: number of segments sent again
+ * @acks: number of acknowledgements received while sending data
+ * @sacks: number of acknowledgements carrying SACK blocks
+ * @bad_wnd: number of client segments with an unexpected window
+ */
+struct sb_stream {
+	uchar *data;
+	u32 len;
+	u32 una;
+	u32 nxt;
+	u32 rtx;
+	u32 ack;
+	u32 rcv_nxt;
+	u8 scale;
+	bool fin_sent;
+	int segs;
+	int drops;
+	int retransmits;
+	int acks;
+	int sacks;
+	int bad_wnd;
+};
+
+static struct sb_stream sb_stream;
+
+static u8 sb_stream_rcv_wnd_scale(void)
+{
+	u8 scale = 0;
+
+	while ((CONFIG_PROT_TCP_RCV_WND >> scale) > 0xffff)
+		scale++;
+
+	return scale;
+}
+
+static void sb_stream_queue(struct udevice *dev, struct ethernet_hdr *eth,
+			    struct ip_tcp_hdr *tcp, u8 flags, u32 offs,
+			    int len)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	struct ip_tcp_hdr *tcp_send;
+	struct ethernet_hdr *eth_send;
+	int hdr_len = TCP_HDR_SIZE;
+	uchar *opt;
+	int pkt_len;
+
+	if (priv->recv_packets >= PKTBUFSRX)
+		return;
+
+	eth_send = (void *)priv->recv_packet_buffer[priv->recv_packets];
+	memcpy(eth_send->et_dest, eth->et_src, ARP_HLEN);
+	memcpy(eth_send->et_src, priv->fake_host_hwaddr, ARP_HLEN);
+	eth_send->et_protlen = htons(PROT_IP);
+	tcp_send = (void *)eth_send + ETHER_HDR_SIZE;
+	tcp_send->tcp_src = tcp->tcp_dst;
+	tcp_send->tcp_dst = tcp->tcp_src;
+	tcp_send->tcp_seq = htonl(priv->iss + 1 + offs);
+	tcp_send->tcp_ack = htonl(sb_stream.rcv_nxt);
+	tcp_send->tcp_flags = flags;
+	tcp_send->tcp_win = htons(0xffff);
+
+	if (flags & TCP_SYN) {
+		/* MSS, window scale and SACK permitted */
+		tcp_send->tcp_seq = htonl(priv->iss);
+		opt = (uchar *)tcp_send + IP_TCP_HDR_SIZE;
+		opt[0] = TCP_O_MSS;
+		opt[1] = TCP_OPT_LEN_4;
+		put_unaligned_be16(TCP_MSS, &opt[2]);
+		opt[4] = TCP_1_NOP;
+		opt[5] = TCP_O_SCL;
+		opt[6] = TCP_OPT_LEN_3;
+		opt[7] = STREAM_SRV_SCALE;
+		opt[8] = TCP_P_SACK;
+		opt[9] = TCP_OPT_LEN_2;
+		opt[10] = TCP_1_NOP;
+		opt[11] = TCP_1_NOP;
+		hdr_len += 12;
+	} else if (len) {
+		memcpy((uchar *)tcp_send + IP_TCP_HDR_SIZE,
+		       sb_stream.data + offs, len);
+		sb_stream.segs++;
+	}
+
+	tcp_send->tcp_hlen = SHIFT_TO_TCPHDRLEN_FIELD(LEN_B_TO_DW(hdr_len));
+	tcp_send->tcp_xsum = 0;
+	tcp_send->tcp_ugr = 0;
+	pkt_len = IP_HDR_SIZE + hdr_len + len;
+	tcp_send->tcp_xsum = tcp_set_pseudo_header((uchar *)tcp_send,
+						   tcp->ip_src,
+						   tcp->ip_dst,
+						   pkt_len - IP_HDR_SIZE,
+						   pkt_len);
+	net_set_ip_header((uchar *)tcp_send, tcp->ip_src, tcp->ip_dst,
+			  pkt_len, IPPROTO_TCP);
+
+	priv->recv_packet_length[priv->recv_packets] = ETHER_HDR_SIZE + pkt_len;
+	++priv->recv_packets;
+}
+
+static u32 sb_stream_seg_len(u32 offs)
+{
+	return min_t(u32, STREAM_SEG_SIZE, sb_stream.len - offs);
+}
+
+/* Check whether the segment at @offs is still on its way to the client */
+static bool sb_stream_in_flight(struct udevice *dev, u32 offs)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	struct ip_tcp_hdr *tcp;
+	int i;
+
+	for (i = 0; i < priv->recv_packets; i++) {
+		tcp = (void *)priv->recv_packet_buffer[i] + ETHER_HDR_SIZE;
+		if (ntohl(tcp->tcp_seq) == priv->iss + 1 + offs)
+			return true;
+	}
+
+	return false;
+}
+
+static void sb_stream_send(struct udevice *dev, struct ethernet_hdr *eth,
+			   struct ip_tcp_hdr *tcp, u32 wnd)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	u32 seg, len, next_len;
+
+	while (priv->recv_packets < PKTBUFSRX && sb_stream.nxt < sb_stream.len) {
+		len = sb_stream_seg_len(sb_stream.nxt);
+		if (sb_stream.nxt + len - sb_stream.una > wnd)
+			break;
+
+		seg = sb_stream.nxt / STREAM_SEG_SIZE;
+		if (seg % STREAM_DROP_EVERY == STREAM_DROP_EVERY - 1 &&
+		    sb_stream.nxt + 8 * STREAM_SEG_SIZE < sb_stream.len) {
+			/* lost on the link */
+			sb_stream.drops++;
+			sb_stream.segs++;
+			sb_stream.nxt += len;
+			continue;
+		}
+
+		if (seg % STREAM_REORDER_EVERY == STREAM_REORDER_EVERY - 1 &&
+		    priv->recv_packets + 1 < PKTBUFSRX &&
+		    sb_stream.nxt + len < sb_stream.len) {
+			/* the next segment overtakes this one */
+			next_len = sb_stream_seg_len(sb_stream.nxt + len);
+			sb_stream_queue(dev, eth, tcp, TCP_ACK,
+					sb_stream.nxt + len, next_len);
+			sb_stream_queue(dev, eth, tcp, TCP_ACK,
+					sb_stream.nxt, len);
+			sb_stream.nxt += len + next_len;
+			continue;
+		}
+
+		sb_stream_queue(dev, eth, tcp, TCP_ACK, sb_stream.nxt, len);
+		sb_stream.nxt += len;
+	}
+}
+
+static int sb_stream_handler(struct udevice *dev, void *packet,
+			     unsigned int len)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	struct ethernet_hdr *eth = packet;
+	struct ip_tcp_hdr *tcp = packet + ETHER_HDR_SIZE;
+	int hdr_len, data_len, i;
+	u32 ack, wnd;
+	bool sack = false, dup;
+	uchar *opt;
+
+	if (ntohs(eth->et_protlen) == PROT_ARP)
+		return sb_arp_handler(dev, packet, len);
+	if (ntohs(eth->et_protlen) != PROT_IP ||
+	    tcp->ip_p != IPPROTO_TCP)
+		return -EPROTONOSUPPORT;
+
+	hdr_len = GET_TCP_HDR_LEN_IN_BYTES(tcp->tcp_hlen);
+	data_len = len - ETHER_HDR_SIZE - IP_HDR_SIZE - hdr_len;
+	opt = (uchar *)tcp + IP_TCP_HDR_SIZE;
+	for (i = 0; i < hdr_len - TCP_HDR_SIZE; ) {
+		if (opt[i] == TCP_O_END)
+			break;
+		if (opt[i] == TCP_1_NOP) {
+			i++;
+			continue;
+		}
+		if (opt[i] == TCP_O_SCL)
+			sb_stream.scale = opt[i + 2];
+		if (opt[i] == TCP_V_SACK)
+			sack = true;
+		i += opt[i + 1];
+	}
+
+	if (tcp->tcp_flags == TCP_SYN) {
+		/* the window in a SYN is never scaled */
+		if (ntohs(tcp->tcp_win) != min_t(int, CONFIG_PROT_TCP_RCV_WND,
+						 0xffff))
+			sb_stream.bad_wnd++;
+		priv->irs = ntohl(tcp->tcp_seq);
+		priv->iss = ~priv->irs;
+		sb_stream.rcv_nxt = priv->irs + 1;
+		sb_stream_queue(dev, eth, tcp, TCP_SYN | TCP_ACK, 0, 0);
+		return 0;
+	}
+
+	if (!(tcp->tcp_flags & TCP_ACK))
+		return 0;
+
+	wnd = ntohs(tcp->tcp_win) << sb_stream.scale;
+	if (wnd != CONFIG_PROT_TCP_RCV_WND)
+		sb_stream.bad_wnd++;
+
+	if (data_len > 0 || tcp->tcp_flags & TCP_FIN) {
+		if (ntohl(tcp->tcp_seq) != sb_stream.rcv_nxt)
+			return 0;
+		sb_stream.rcv_nxt += data_len;
+		if (tcp->tcp_flags & TCP_FIN) {
+			/* client closed its side, acknowledge its FIN */
+			sb_stream.rcv_nxt++;
+			sb_stream_queue(dev, eth, tcp, TCP_ACK,
+					sb_stream.len + 1, 0);
+			return 0;
+		}
+	} else if (sb_stream.nxt) {
+		sb_stream.acks++;
+	}
+
+	ack = ntohl(tcp->tcp_ack) - priv->iss - 1;
+	dup = data_len <= 0 && ack == sb_stream.ack;
+	sb_stream.ack = ack;
+	if ((s32)(ack - sb_stream.una) > 0 && ack <= sb_stream.len)
+		sb_stream.una = ack;
+
+	/* the client reports a hole: send it again unless it is in flight */
+	if (sack)
+		sb_stream.sacks++;
+	if ((sack || dup) && sb_stream.una < sb_stream.nxt &&
+	    sb_stream.una != sb_stream.rtx &&
+	    !sb_stream_in_flight(dev, sb_stream.una)) {
+		sb_stream.rtx = sb_stream.una;
+		sb_stream.retransmits++;
+		sb_stream_queue(dev, eth, tcp, TCP_ACK, sb_stream.una,
+				sb_stream_seg_len(sb_stream.una));
+	}
+
+	if (sb_stream.una == sb_stream.len) {
+		if (!sb_stream.fin_sent) {
+			sb_stream.fin_sent = true;
+			sb_stream_queue(dev, eth, tcp, TCP_ACK | TCP_FIN,
+					sb_stream.len, 0);
+		}
+		return 0;
+	}
+
+	sb_stream_send(dev, eth, tcp, wnd);
+	timer_test_add_offset(STREAM_DELAY_MS);
+
+	return 0;
+}
+
+static int net_test_wget_stream(struct unit_test_state *uts)
+{
+	char *prev_ethact = env_get("ethact");
+	char *prev_ethrotate = env_get("ethrotate");
+	ulong addr = 0x20000;
+	uchar *buf;
+	int hdr_len, i;
+
+	memset(&sb_stream, '\0', sizeof(sb_stream));
+	sb_stream.rtx = -1;
+	sb_stream.data = malloc(STREAM_FILE_SIZE + 128);
+	ut_assertnonnull(sb_stream.data);
+	hdr_len = sprintf((char *)sb_stream.data,
+			  "HTTP/1.1 200 OK\r\nContent-Length: %d\r\n\r\n",
+			  STREAM_FILE_SIZE);
+	for (i = 0; i < STREAM_FILE_SIZE; i++)
+		sb_stream.data[hdr_len + i] = i * 7 + (i >> 9);
+	sb_stream.len = hdr_len + STREAM_FILE_SIZE;
+
+	sandbox_eth_set_tx_handler(0, sb_stream_handler);
+	sandbox_eth_set_priv(0, uts);
+
+	env_set("ethact", "eth@10002000");
+	env_set("ethrotate", "no");
+	env_set_hex("wgetaddr", addr);
+	ut_assertok(run_command("wget ${wgetaddr} 1.1.2.2:/file.bin", 0));
+	ut_assert_skip_to_line("Bytes transferred = %d (%x hex)",
+			       STREAM_FILE_SIZE, STREAM_FILE_SIZE);
+	ut_assert_console_end();
+
+	sandbox_eth_set_tx_handler(0, NULL);
+	env_set("ethact", prev_ethact);
+	env_set("ethrotate", prev_ethrotate);
+
+	buf = map_sysmem(addr, STREAM_FILE_SIZE);
+	ut_asserteq_mem(sb_stream.data + hdr_len, buf, STREAM_FILE_SIZE);
+	unmap_sysmem(buf);
+	free(sb_stream.data);
+
+	/* the client advertised the configured (scaled) window */
+	ut_asserteq(sb_stream_rcv_wnd_scale(), sb_stream.scale);
+	ut_asserteq(0, sb_stream.bad_wnd);
+
+	/* every loss was repaired from the SACK blocks, not by a timeout */
+	ut_assert(sb_stream.drops > 0);
+	if (IS_ENABLED(CONFIG_PROT_TCP_SACK))
+		ut_asserteq(sb_stream.drops, sb_stream.retransmits);
+
+	/* delayed acknowledge: at most one ACK per two segments plus holes */
+	if (CONFIG_PROT_TCP_ACK_SEGS > 1)
+		ut_assert(sb_stream.acks <= sb_stream.segs / 2 +
+			  2 * (sb_stream.sacks + 1));
+
+	return 0;
+}
+CMD_TEST(net_test_wget_stream, UTF_CONSOLE);
+
+/* Number of connections the range server can handle at the same time */
+#define RANGE_CONNS		CONFIG_PROT_TCP_STREAMS
+
+/**
+ * struct sb_range_conn - connection of the fake HTTP range server
+ *
+ * @port: client port, 0 if the entry is free
+ * @irs: initial sequence number of the client
+ * @iss: initial sequence number of the server
+ * @rcv_nxt: next sequence expected from the client
+ * @scale: window scale announced by the client
+ * @wnd: last window announced by the client
+ * @hdr: header of the HTTP reply
+ * @hdr_len: length of @hdr, 0 until the request has been received
+ * @start: file offset of the first byte of the reply body
+ * @len: length of the reply, header included
+ * @una: first byte of the reply not acknowledged by the client
+ * @nxt: next byte of the reply to send
+ * @cut: reply offset at which the connection is reset, 0 for never
+ * @syn_ack: true if the SYN-ACK still has to be sent
+ * @fin_sent: true if the server has closed its side
+ */
+struct sb_range_conn {
+	u16 port;
+	u32 irs;
+	u32 iss;
+	u32 rcv_nxt;
+	u8 scale;
+	u32 wnd;
+	char hdr[128];
+	u32 hdr_len;
+	u32 start;
+	u32 len;
+	u32 una;
+	u32 nxt;
+	u32 cut;
+	bool syn_ack;
+	bool fin_sent;
+};
+
+/**
+ * struct sb_range - state of the fake HTTP server supporting range requests
+ *
+ * @conns: connections
+ * @size: size of the file served
+ * @no_ranges: true to ignore the Range header, like an old server
+ * @cut: body bytes after which the first connection is reset, 0 for never
+ * @active: number of connections open
+ * @max_active: highest number of connections open at the same time
+ * @requests: number of requests received
+ * @partial: number of 206 (Partial Content) replies
+ * @reset_at: file offset where a connection has been reset
+ */
+struct sb_range {
+	struct sb_range_conn conns[RANGE_CONNS];
+	u32 size;
+	bool no_ranges;
+	u32 cut;
+	int active;
+	int max_active;
+	int requests;
+	int partial;
+	u32 reset_at;
+};
+
+static struct sb_range sb_range;
+
+/* Content of the file served by the range server */
+static uchar sb_range_byte(u32 offs)
+{
+	return offs * 13 + (offs >> 11);
+}
+
+static void sb_range_queue(struct udevice *dev, struct ethernet_hdr *eth,
+			   struct ip_tcp_hdr *tcp, struct sb_range_conn *conn,
+			   u8 flags, u32 offs, int len)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	struct ip_tcp_hdr *tcp_send;
+	struct ethernet_hdr *eth_send;
+	int hdr_len = TCP_HDR_SIZE;
+	uchar *opt, *data;
+	int pkt_len, i;
+
+	eth_send = (void *)priv->recv_packet_buffer[priv->recv_packets];
+	memcpy(eth_send->et_dest, eth->et_src, ARP_HLEN);
+	memcpy(eth_send->et_src, priv->fake_host_hwaddr, ARP_HLEN);
+	eth_send->et_protlen = htons(PROT_IP);
+	tcp_send = (void *)eth_send + ETHER_HDR_SIZE;
+	tcp_send->tcp_src = tcp->tcp_dst;
+	tcp_send->tcp_dst = conn->port;
+	tcp_send->tcp_seq = htonl(conn->iss + 1 + offs);
+	tcp_send->tcp_ack = htonl(conn->rcv_nxt);
+	tcp_send->tcp_flags = flags;
+	tcp_send->tcp_win = htons(0xffff);
+
+	if (flags & TCP_SYN) {
+		/* MSS and window scale */
+		tcp_send->tcp_seq = htonl(conn->iss);
+		opt = (uchar *)tcp_send + IP_TCP_HDR_SIZE;
+		opt[0] = TCP_O_MSS;
+		opt[1] = TCP_OPT_LEN_4;
+		put_unaligned_be16(TCP_MSS, &opt[2]);
+		opt[4] = TCP_1_NOP;
+		opt[5] = TCP_O_SCL;
+		opt[6] = TCP_OPT_LEN_3;
+		opt[7] = STREAM_SRV_SCALE;
+		hdr_len += 8;
+	}
+
+	data = (uchar *)tcp_send + IP_TCP_HDR_SIZE;
+	for (i = 0; i < len; i++, offs++) {
+		if (offs < conn->hdr_len)
+			data[i] = conn->hdr[offs];
+		else
+			data[i] = sb_range_byte(conn->start + offs -
+						conn->hdr_len);
+	}
+
+	tcp_send->tcp_hlen = SHIFT_TO_TCPHDRLEN_FIELD(LEN_B_TO_DW(hdr_len));
+	tcp_send->tcp_xsum = 0;
+	tcp_send->tcp_ugr = 0;
+	pkt_len = IP_HDR_SIZE + hdr_len + len;
+	tcp_send->tcp_xsum = tcp_set_pseudo_header((uchar *)tcp_send,
+						   tcp->ip_src,
+						   tcp->ip_dst,
+						   pkt_len - IP_HDR_SIZE,
+						   pkt_len);
+	net_set_ip_header((uchar *)tcp_send, tcp->ip_src, tcp->ip_dst,
+			  pkt_len, IPPROTO_TCP);
+
+	priv->recv_packet_length[priv->recv_packets] = ETHER_HDR_SIZE + pkt_len;
+	++priv->recv_packets;
+}
+
+static void sb_range_close(struct sb_range_conn *conn)
+{
+	conn->port = 0;
+	sb_range.active--;
+}
+
+/* Parse the HTTP request of @conn and prepare the reply */
+static void sb_range_request(struct sb_range_conn *conn, char *req, int len)
+{
+	ulong first = 0, last = sb_range.size - 1;
+	bool partial = false;
+	char *pos, *tail;
+
+	req[len] = '\0';
+	sb_range.requests++;
+
+	pos = strstr(req, "Range: bytes=");
+	if (pos && !sb_range.no_ranges) {
+		first = simple_strtoul(pos + 13, &tail, 10);
+		if (*tail == '-' && tail[1] >= '0' && tail[1] <= '9')
+			last = min_t(ulong, simple_strtoul(tail + 1, NULL, 10),
+				     sb_range.size - 1);
+		partial = true;
+	}
+
+	if (partial) {
+		sb_range.partial++;
+		conn->hdr_len = sprintf(conn->hdr,
+					"HTTP/1.1 206 Partial Content\r\n"
+					"Content-Range: bytes %lu-%lu/%u\r\n"
+					"Content-Length: %lu\r\n\r\n",
+					first, last, sb_range.size,
+					last - first + 1);
+	} else {
+		conn->hdr_len = sprintf(conn->hdr,
+					"HTTP/1.1 200 OK\r\n"
+					"Content-Length: %u\r\n\r\n",
+					sb_range.size);
+	}
+	conn->start = first;
+	conn->len = conn->hdr_len + last - first + 1;
+
+	/* the first connection is lost in the middle of the transfer */
+	if (sb_range.cut && sb_range.requests == 1)
+		conn->cut = conn->hdr_len + sb_range.cut;
+}
+
+/* Send whatever the connections may send, one segment each in turn */
+static void sb_range_pump(struct udevice *dev, struct ethernet_hdr *eth,
+			  struct ip_tcp_hdr *tcp)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	struct sb_range_conn *conn;
+	bool sent = true;
+	u32 len;
+
+	while (sent) {
+		sent = false;
+		for (conn = sb_range.conns;
+		     conn < sb_range.conns + RANGE_CONNS; conn++) {
+			if (priv->recv_packets >= PKTBUFSRX)
+				return;
+			if (!conn->port)
+				continue;
+
+			if (conn->syn_ack) {
+				sb_range_queue(dev, eth, tcp, conn,
+					       TCP_SYN | TCP_ACK, 0, 0);
+				conn->syn_ack = false;
+				sent = true;
+				continue;
+			}
+			if (!conn->hdr_len)
+				continue;
+
+			if (conn->cut && conn->nxt >= conn->cut) {
+				sb_range.reset_at = conn->start + conn->nxt -
+						    conn->hdr_len;
+				sb_range_queue(dev, eth, tcp, conn, TCP_RST,
+					       conn->nxt, 0);
+				sb_range_close(conn);
+				sent = true;
+				continue;
+			}
+
+			if (conn->una == conn->len && !conn->fin_sent) {
+				sb_range_queue(dev, eth, tcp, conn,
+					       TCP_ACK | TCP_FIN, conn->len, 0);
+				conn->fin_sent = true;
+				sent = true;
+				continue;
+			}
+
+			len = min_t(u32, STREAM_SEG_SIZE,
+				    conn->len - conn->nxt);
+			if (conn->cut)
+				len = min_t(u32, len, conn->cut - conn->nxt);
+			if (!len || conn->nxt + len - conn->una > conn->wnd)
+				continue;
+
+			sb_range_queue(dev, eth, tcp, conn, TCP_ACK,
+				       conn->nxt, len);
+			conn->nxt += len;
+			sent = true;
+		}
+	}
+}
+
+static int sb_range_handler(struct udevice *dev, void *packet,
+			    unsigned int len)
+{
+	struct ethernet_hdr *eth = packet;
+	struct ip_tcp_hdr *tcp = packet + ETHER_HDR_SIZE;
+	struct sb_range_conn *conn, *free = NULL;
+	int hdr_len, data_len, i;
+	uchar *opt;
+	u32 ack;
+
+	if (ntohs(eth->et_protlen) == PROT_ARP)
+		return sb_arp_handler(dev, packet, len);
+	if (ntohs(eth->et_protlen) != PROT_IP ||
+	    tcp->ip_p != IPPROTO_TCP)
+		return -EPROTONOSUPPORT;
+
+	hdr_len = GET_TCP_HDR_LEN_IN_BYTES(tcp->tcp_hlen);
+	data_len = len - ETHER_HDR_SIZE - IP_HDR_SIZE - hdr_len;
+
+	for (conn = sb_range.conns; conn < sb_range.conns + RANGE_CONNS;
+	     conn++) {
+		if (conn->port == tcp->tcp_src)
+			break;
+		if (!conn->port && !free)
+			free = conn;
+	}
+	if (conn == sb_range.conns + RANGE_CONNS)
+		conn = NULL;
+
+	if (tcp->tcp_flags == TCP_SYN) {
+		if (!conn) {
+			if (!free)
+				return 0;
+			conn = free;
+			sb_range.active++;
+			if (sb_range.active > sb_range.max_active)
+				sb_range.max_active = sb_range.active;
+		}
+		memset(conn, '\0', sizeof(*conn));
+		conn->port = tcp->tcp_src;
+		conn->irs = ntohl(tcp->tcp_seq);
+		conn->iss = ~conn->irs;
+		conn->rcv_nxt = conn->irs + 1;
+		conn->syn_ack = true;
+
+		opt = (uchar *)tcp + IP_TCP_HDR_SIZE;
+		for (i = 0; i < hdr_len - TCP_HDR_SIZE; ) {
+			if (opt[i] == TCP_O_END)
+				break;
+			if (opt[i] == TCP_1_NOP) {
+				i++;
+				continue;
+			}
+			if (opt[i] == TCP_O_SCL)
+				conn->scale = opt[i + 2];
+			i += opt[i + 1];
+		}
+	} else if (conn && tcp->tcp_flags & TCP_ACK) {
+		conn->wnd = ntohs(tcp->tcp_win) << conn->scale;
+		ack = ntohl(tcp->tcp_ack) - conn->iss - 1;
+		if ((s32)(ack - conn->una) > 0 && ack <= conn->len)
+			conn->una = ack;
+
+		if ((data_len > 0 || tcp->tcp_flags & TCP_FIN) &&
+		    ntohl(tcp->tcp_seq) == conn->rcv_nxt) {
+			conn->rcv_nxt += data_len;
+			if (data_len > 0 && !conn->hdr_len)
+				sb_range_request(conn, (char *)tcp +
+						 IP_TCP_HDR_SIZE +
+						 hdr_len - TCP_HDR_SIZE,
+						 data_len);
+			if (tcp->tcp_flags & TCP_FIN) {
+				/* client closed its side, acknowledge its FIN */
+				conn->rcv_nxt++;
+				sb_range_queue(dev, eth, tcp, conn, TCP_ACK,
+					       conn->len + 1, 0);
+				sb_range_close(conn);
+			}
+		}
+	}
+
+	sb_range_pump(dev, eth, tcp);
+
+	return 0;
+}
+
+/*
+ * Fetch the file with the wget command and check what has been received,
+ * @resume is the offset where the transfer is expected to resume, if any
+ */
+static int sb_range_wget(struct unit_test_state *uts, u32 size, u32 resume)
+{
+	ulong addr = SZ_2M;
+	uchar *buf;
+	u32 i;
+
+	sb_range.size = size;
+	env_set_hex("wgetaddr", addr);
+	ut_assertok(run_command("wget ${wgetaddr} 1.1.2.2:/file.bin", 0));
+	if (resume)
+		ut_assert_skip_to_line("wget: resuming at 0x%x", resume);
+	ut_assert_skip_to_line("Bytes transferred = %u (%x hex)", size, size);
+	ut_assert_console_end();
+
+	buf = map_sysmem(addr, size);
+	for (i = 0; i < size; i++) {
+		if (buf[i] != sb_range_byte(i))
+			break;
+	}
+	unmap_sysmem(buf);
+	ut_asserteq(size, i);
+
+	return 0;
+}
+
+static int net_test_wget_ranges(struct unit_test_state *uts)
+{
+	char *prev_ethact = env_get("ethact");
+	char *prev_ethrotate = env_get("ethrotate");
+	char *prev_conns = env_get("wgetconns");
+	u32 size = 2 * CONFIG_WGET_RANGE_SIZE + 12345;
+
+	sandbox_eth_set_tx_handler(0, sb_range_handler);
+	sandbox_eth_set_priv(0, uts);
+
+	env_set("ethact", "eth@10002000");
+	env_set("ethrotate", "no");
+	env_set("wgetconns", "2");
+
+	/* three ranges fetched over two connections */
+	memset(&sb_range, '\0', sizeof(sb_range));
+	ut_assertok(sb_range_wget(uts, size, 0));
+	ut_asserteq(3, sb_range.requests);
+	ut_asserteq(3, sb_range.partial);
+	ut_asserteq(2, sb_range.max_active);
+
+	/* a server without range support sends the whole file at once */
+	memset(&sb_range, '\0', sizeof(sb_range));
+	sb_range.no_ranges = true;
+	ut_assertok(sb_range_wget(uts, size, 0));
+	ut_asserteq(1, sb_range.requests);
+	ut_asserteq(0, sb_range.partial);
+
+	sandbox_eth_set_tx_handler(0, NULL);
+	env_set("ethact", prev_ethact);
+	env_set("ethrotate", prev_ethrotate);
+	env_set("wgetconns", prev_conns);
+
+	return 0;
+}
+CMD_TEST(net_test_wget_ranges, UTF_CONSOLE);
+
+static int net_test_wget_resume(struct unit_test_state *uts)
+{
+	char *prev_ethact = env_get("ethact");
+	char *prev_ethrotate = env_get("ethrotate");
+	char *prev_conns = env_get("wgetconns");
+	u32 size = SZ_64K;
+
+	sandbox_eth_set_tx_handler(0, sb_range_handler);
+	sandbox_eth_set_priv(0, uts);
+
+	env_set("ethact", "eth@10002000");
+	env_set("ethrotate", "no");
+	env_set("wgetconns", "1");
+
+	/* the connection is reset, the rest of the file is asked again */
+	memset(&sb_range, '\0', sizeof(sb_range));
+	sb_range.cut = 10 * STREAM_SEG_SIZE;
+	ut_assertok(sb_range_wget(uts, size, sb_range.cut));
+	ut_asserteq(2, sb_range.requests);
+	ut_asserteq(1, sb_range.partial);
+	ut_asserteq(sb_range.cut, sb_range.reset_at);
+
+	sandbox_eth_set_tx_handler(0, NULL);
+	env_set("ethact", prev_ethact);
+	env_set("ethrotate", prev_ethrotate);
+	env_set("wgetconns", prev_conns);
+
+	return 0;
+}
+CMD_TEST(net_test_wget_resume, UTF_CONSOLE);
+
 static int net_test_wget_uri_validate(struct unit_test_state *uts)
 {
 	ut_asserteq(true, wget_validate_uri("http://foo.com/bar.html"));
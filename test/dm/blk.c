@@ -4,6 +4,7 @@
  */
 
 #include <blk.h>
+#include <blkmap.h>
 #include <dm.h>
 #include <part.h>
 #include <sandbox_host.h>
@@ -334,3 +335,81 @@ static int dm_test_blk_foreach(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_blk_foreach, UTF_SCAN_PDATA | UTF_SCAN_FDT);
+
+#if CONFIG_IS_ENABLED(BLOCK_CACHE) && CONFIG_IS_ENABLED(BLKMAP)
+/* Test the block cache, including readahead of sequential reads */
+static int dm_test_blk_cache(struct unit_test_state *uts)
+{
+	struct block_cache_dev_stats dstats;
+	struct block_cache_stats stats;
+	static char disk[64 * DEFAULT_BLKSZ];
+	char buf[8 * DEFAULT_BLKSZ];
+	struct udevice *dev, *blk;
+	struct blk_desc *desc;
+	int i;
+
+	for (i = 0; i < 64; i++)
+		memset(disk + i * DEFAULT_BLKSZ, i, DEFAULT_BLKSZ);
+
+	blkcache_configure(0x20000, 0x4000);
+	ut_assertok(blkmap_create("cachetest", &dev));
+	ut_assertok(blk_get_from_parent(dev, &blk));
+	ut_assertok(blkmap_map_mem(dev, 0, 64, disk));
+	desc = dev_get_uclass_plat(blk);
+
+	/* Start from an empty cache, with no statistics */
+	blkcache_free();
+	blkcache_stats(&stats);
+
+	/* A single-block miss fills the whole 4KiB line around it */
+	ut_asserteq(1, blk_read(blk, 1, 1, buf));
+	ut_asserteq(1, buf[0]);
+	memset(disk + 3 * DEFAULT_BLKSZ, 0xff, DEFAULT_BLKSZ);
+	ut_asserteq(2, blk_read(blk, 3, 2, buf));
+	ut_asserteq(3, buf[0]);
+	ut_asserteq(4, buf[DEFAULT_BLKSZ]);
+	blkcache_stats(&stats);
+	ut_asserteq(1, stats.hits);
+	ut_asserteq(1, stats.misses);
+	ut_asserteq(1, stats.entries);
+	ut_asserteq(0x1000, stats.bytes);
+
+	/* A write drops the cached data for the device */
+	ut_asserteq(1, blk_write(blk, 40, 1, disk + 40 * DEFAULT_BLKSZ));
+	ut_asserteq(1, blk_read(blk, 3, 1, buf));
+	ut_asserteq(0xff, (u8)buf[0]);
+
+	/* The second of two sequential misses reads ahead four lines */
+	ut_asserteq(8, blk_read(blk, 8, 8, buf));
+	ut_asserteq(8, blk_read(blk, 16, 8, buf));
+	for (i = 24; i < 56; i += 8) {
+		ut_asserteq(8, blk_read(blk, i, 8, buf));
+		ut_asserteq(i + 7, buf[7 * DEFAULT_BLKSZ]);
+	}
+	blkcache_stats(&stats);
+	ut_asserteq(4, stats.hits);
+	ut_asserteq(3, stats.misses);
+
+	ut_assertok(blkcache_dev_stats(0, &dstats));
+	ut_asserteq(desc->uclass_id, dstats.iftype);
+	ut_asserteq(desc->devnum, dstats.devnum);
+	ut_asserteq(5, dstats.hits);
+	ut_asserteq(4, dstats.misses);
+	ut_asserteq(32, dstats.readahead);
+	ut_asserteq(-ENOENT, blkcache_dev_stats(1, &dstats));
+
+	/* Reads larger than a quarter of the cache bypass it */
+	blkcache_configure(0x2000, 0x4000);
+	ut_asserteq(8, blk_read(blk, 0, 8, buf));
+	blkcache_stats(&stats);
+	ut_asserteq(0, stats.entries);
+
+	ut_assertok(blkmap_destroy(dev));
+	blkcache_configure(CONFIG_BLOCK_CACHE_SIZE,
+			   CONFIG_BLOCK_CACHE_READAHEAD);
+	blkcache_free();
+
+	return 0;
+}
+DM_TEST(dm_test_blk_cache, 0);
+#endif
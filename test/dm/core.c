@@ -16,6 +16,7 @@
 #include <dm/util.h>
 #include <dm/test.h>
 #include <dm/uclass-internal.h>
+#include <linux/err.h>
 #include <linux/list.h>
 #include <test/test.h>
 #include <test/ut.h>
@@ -1443,3 +1444,59 @@ static int dm_test_try_first_device(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_try_first_device, 0);
+
+#if CONFIG_IS_ENABLED(DM_COMPAT_INDEX)
+/* Record the driver of each device below @parent, depth first */
+static int list_drivers(struct udevice *parent, const struct driver **drvs,
+			int count, int max)
+{
+	struct udevice *dev;
+
+	device_foreach_child(dev, parent) {
+		if (count < max)
+			drvs[count] = dev->driver;
+		count = list_drivers(dev, drvs, count + 1, max);
+	}
+
+	return count;
+}
+
+/* Check that binding with the compatible index matches the driver list */
+static int dm_test_compat_index(struct unit_test_state *uts)
+{
+	struct dm_compat_index *index;
+	const struct driver **drvs, **drvs2;
+	const int max = 1000;
+	int count, ret;
+
+	drvs = calloc(max, sizeof(*drvs));
+	drvs2 = calloc(max, sizeof(*drvs2));
+	ut_assertnonnull(drvs);
+	ut_assertnonnull(drvs2);
+
+	ut_assertok(dm_scan_fdt(false));
+	index = gd->dm_compat_index;
+	ut_assert(!IS_ERR_OR_NULL(index));
+	count = list_drivers(dm_root(), drvs, 0, max);
+	ut_assert(count > 100);
+	ut_assert(count <= max);
+
+	/* start again and bind using the driver list */
+	ut_assertok(dm_uninit());
+	ut_assertok(dm_init(uts->of_live));
+	uts->root = dm_root();
+	gd->dm_compat_index = ERR_PTR(-ENOSYS);
+	ret = dm_scan_fdt(false);
+	gd->dm_compat_index = index;
+	ut_assertok(ret);
+
+	ut_asserteq(count, list_drivers(dm_root(), drvs2, 0, max));
+	ut_asserteq_mem(drvs, drvs2, count * sizeof(*drvs));
+
+	free(drvs2);
+	free(drvs);
+
+	return 0;
+}
+DM_TEST(dm_test_compat_index, 0);
+#endif
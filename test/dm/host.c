@@ -7,6 +7,7 @@
 #include <blk.h>
 #include <dm.h>
 #include <fs.h>
+#include <malloc.h>
 #include <os.h>
 #include <sandbox_host.h>
 #include <asm/test.h>
@@ -108,6 +109,62 @@ static int dm_test_host_dup(struct unit_test_state *uts)
 }
 DM_TEST(dm_test_host_dup, UTF_SCAN_FDT);
 
+/* asynchronous reads and writes of a host device */
+static int dm_test_host_async(struct unit_test_state *uts)
+{
+	static char label[] = "test";
+	struct blk_request req, req2;
+	struct udevice *dev, *blk;
+	char fname[256];
+	u8 *orig, *buf;
+
+	ut_assertok(host_create_device(label, true, DEFAULT_BLKSZ, &dev));
+	ut_assertok(os_persistent_file(fname, sizeof(fname), "2MB.ext2.img"));
+	ut_assertok(host_attach_file(dev, fname));
+	ut_assertok(blk_get_from_parent(dev, &blk));
+	ut_assertok(device_probe(blk));
+
+	orig = malloc(0x10000);
+	ut_assertnonnull(orig);
+	buf = malloc(0x10000);
+	ut_assertnonnull(buf);
+	ut_asserteq(0x40, blk_read(blk, 0x100, 0x40, orig));
+
+	/* two reads in flight at once */
+	memset(buf, '\0', 0x10000);
+	ut_assertok(blk_submit_read(blk, 0x100, 0x20, buf, &req));
+	ut_assertok(blk_submit_read(blk, 0x120, 0x20, buf + 0x4000, &req2));
+	ut_asserteq(0x20, blk_wait(blk, &req2));
+	ut_asserteq(0x20, blk_wait(blk, &req));
+	ut_asserteq_mem(orig, buf, 0x8000);
+
+	/* the result stays available once complete */
+	ut_asserteq(0x20, blk_poll(blk, &req));
+
+	/* write something different, read it back, then put it back */
+	memset(buf, 0xaa, 0x1000);
+	ut_assertok(blk_submit_write(blk, 0x100, 8, buf, &req));
+	ut_asserteq(8, blk_wait(blk, &req));
+	memset(buf, '\0', 0x1000);
+	ut_asserteq(8, blk_read(blk, 0x100, 8, buf));
+	ut_asserteq(0xaa, buf[0]);
+	ut_asserteq(0xaa, buf[0xfff]);
+
+	ut_assertok(blk_submit_write(blk, 0x100, 8, orig, &req));
+	ut_asserteq(8, blk_wait(blk, &req));
+	ut_assertok(blk_submit_read(blk, 0x100, 0x40, buf, &req));
+	ut_asserteq(0x40, blk_wait(blk, &req));
+	ut_asserteq_mem(orig, buf, 0x8000);
+
+	free(buf);
+	free(orig);
+	ut_assertok(host_detach_file(dev));
+	ut_assertok(device_unbind(dev));
+
+	return 0;
+}
+DM_TEST(dm_test_host_async, UTF_SCAN_FDT);
+
 /* Basic test of 'host' command */
 static int dm_test_cmd_host(struct unit_test_state *uts)
 {
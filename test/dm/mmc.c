@@ -4,8 +4,10 @@
  */
 
 #include <dm.h>
+#include <malloc.h>
 #include <mmc.h>
 #include <part.h>
+#include <asm/test.h>
 #include <dm/test.h>
 #include <test/test.h>
 #include <test/ut.h>
@@ -51,3 +53,71 @@ static int dm_test_mmc_blk(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_mmc_blk, UTF_SCAN_PDATA | UTF_SCAN_FDT);
+
+/* Check how large reads are split into transfers, with and without queueing */
+static int dm_test_mmc_transfers(struct unit_test_state *uts)
+{
+	uint transfers, max_blocks, max_queued;
+	const int blocks = 1024;
+	struct blk_desc *dev_desc;
+	char *write, *read;
+	struct udevice *dev;
+	int i;
+
+	ut_assertok(blk_get_device_by_str("mmc", "0", &dev_desc));
+	dev = dev_get_parent(dev_desc->bdev);
+
+	/* reads of this size bypass the block cache */
+	write = malloc(blocks * 512);
+	read = malloc(blocks * 512);
+	ut_assertnonnull(write);
+	ut_assertnonnull(read);
+	for (i = 0; i < blocks * 512; i++)
+		write[i] = i / 512 + i;
+	ut_asserteq(blocks, blk_dwrite(dev_desc, 0, blocks, write));
+
+	/* without a limit the whole read is one transfer */
+	ut_assertok(sandbox_mmc_get_stats(dev, &transfers, &max_blocks,
+					  &max_queued));
+	ut_asserteq(blocks, blk_dread(dev_desc, 0, blocks, read));
+	ut_asserteq_mem(write, read, blocks * 512);
+	ut_assertok(sandbox_mmc_get_stats(dev, &transfers, &max_blocks,
+					  &max_queued));
+	ut_asserteq(1, transfers);
+	ut_asserteq(blocks, max_blocks);
+
+	/* otherwise it is split into one command per 128 blocks */
+	sandbox_mmc_set_b_max(dev, 128);
+	memset(read, '\0', blocks * 512);
+	ut_asserteq(blocks, blk_dread(dev_desc, 0, blocks, read));
+	ut_asserteq_mem(write, read, blocks * 512);
+	ut_assertok(sandbox_mmc_get_stats(dev, &transfers, &max_blocks,
+					  &max_queued));
+	ut_asserteq(8, transfers);
+	ut_asserteq(128, max_blocks);
+	ut_asserteq(0, max_queued);
+
+#if CONFIG_IS_ENABLED(MMC_CQE)
+	/* the emulated card is an SD card; pretend that it can queue */
+	mmc_get_mmc_dev(dev)->cmdq_depth = 3;
+	memset(read, '\0', blocks * 512);
+	ut_asserteq(blocks, blk_dread(dev_desc, 0, blocks, read));
+	ut_asserteq_mem(write, read, blocks * 512);
+	ut_assertok(sandbox_mmc_get_stats(dev, &transfers, &max_blocks,
+					  &max_queued));
+	ut_asserteq(8, transfers);
+	ut_asserteq(128, max_blocks);
+	ut_asserteq(3, max_queued);
+
+	/* queueing is switched off again for plain commands */
+	ut_asserteq(4, blk_dwrite(dev_desc, 0, 4, write));
+	mmc_get_mmc_dev(dev)->cmdq_depth = 0;
+#endif
+
+	sandbox_mmc_set_b_max(dev, U32_MAX);
+	free(read);
+	free(write);
+
+	return 0;
+}
+DM_TEST(dm_test_mmc_transfers, UTF_SCAN_PDATA | UTF_SCAN_FDT);
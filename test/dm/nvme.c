@@ -0,0 +1,145 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for the NVMe driver, using the sandbox controller emulator
+ */
+
+#include <blk.h>
+#include <dm.h>
+#include <malloc.h>
+#include <asm/test.h>
+#include <dm/device-internal.h>
+#include <dm/lists.h>
+#include <dm/root.h>
+#include <dm/test.h>
+#include <linux/sizes.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+/* Size of the emulated namespace, in 512-byte blocks */
+#define NVME_TEST_BLOCKS	(SZ_8M / 512)
+
+/* Test reading and writing through a deep I/O queue */
+static int dm_test_nvme_rw(struct unit_test_state *uts)
+{
+	uint doorbells, commands, max_batch;
+	struct udevice *dev, *blk;
+	ulong i;
+	u8 *wbuf, *rbuf;
+
+	sandbox_set_enable_memio(true);
+	ut_assertok(device_bind_driver(dm_root(), "sandbox_nvme", "nvme#sb",
+				       &dev));
+	ut_assertok(device_probe(dev));
+	ut_assertok(device_find_first_child_by_uclass(dev, UCLASS_BLK, &blk));
+	ut_assertok(device_probe(blk));
+
+	wbuf = malloc(SZ_1M + 512);
+	rbuf = malloc(SZ_1M + 512);
+	ut_assertnonnull(wbuf);
+	ut_assertnonnull(rbuf);
+	for (i = 0; i < SZ_1M + 512; i++)
+		wbuf[i] = i * 7 + (i >> 9);
+	ut_assertok(sandbox_nvme_get_stats(dev, &doorbells, &commands,
+					   &max_batch));
+
+	/* a 1MB write is split into 128KB commands sent in a single batch */
+	ut_asserteq(SZ_1M / 512, blk_write(blk, 100, SZ_1M / 512, wbuf));
+	ut_assertok(sandbox_nvme_get_stats(dev, &doorbells, &commands,
+					   &max_batch));
+	ut_asserteq(SZ_1M / SZ_128K, commands);
+	if (CONFIG_NVME_QUEUE_DEPTH > SZ_1M / SZ_128K) {
+		ut_asserteq(1, doorbells);
+		ut_asserteq(SZ_1M / SZ_128K, max_batch);
+	}
+
+	memset(rbuf, '\0', SZ_1M + 512);
+	ut_asserteq(SZ_1M / 512, blk_read(blk, 100, SZ_1M / 512, rbuf));
+	ut_asserteq_mem(wbuf, rbuf, SZ_1M);
+
+	/* an unaligned buffer needs a PRP list for each command */
+	memset(rbuf, '\0', SZ_1M + 512);
+	ut_asserteq(SZ_1M / 512, blk_read(blk, 100, SZ_1M / 512, rbuf + 512));
+	ut_asserteq_mem(wbuf, rbuf + 512, SZ_1M);
+
+	/* a command failing part-way through reports the blocks before it */
+	ut_assertok(sandbox_nvme_get_stats(dev, &doorbells, &commands,
+					   &max_batch));
+	ut_asserteq(256, blk_read(blk, NVME_TEST_BLOCKS - 256, 1024, rbuf));
+	ut_assertok(sandbox_nvme_get_stats(dev, &doorbells, &commands,
+					   &max_batch));
+	ut_asserteq(4, commands);
+
+	/* reading the whole namespace batches its commands */
+	for (i = 0; i < NVME_TEST_BLOCKS; i += SZ_1M / 512)
+		ut_asserteq(SZ_1M / 512, blk_read(blk, i, SZ_1M / 512, rbuf));
+	ut_assertok(sandbox_nvme_get_stats(dev, &doorbells, &commands,
+					   &max_batch));
+	ut_asserteq(NVME_TEST_BLOCKS / (SZ_128K / 512), commands);
+	ut_assert(doorbells < commands);
+
+	free(rbuf);
+	free(wbuf);
+	ut_assertok(device_remove(dev, DM_REMOVE_NORMAL));
+	ut_assertok(device_unbind(dev));
+	sandbox_set_enable_memio(false);
+
+	return 0;
+}
+DM_TEST(dm_test_nvme_rw, UTF_SCAN_FDT);
+
+/* Test asynchronous reads and writes */
+static int dm_test_nvme_async(struct unit_test_state *uts)
+{
+	struct blk_request req, req2;
+	struct udevice *dev, *blk;
+	u8 *wbuf, *rbuf;
+	ulong i;
+
+	sandbox_set_enable_memio(true);
+	ut_assertok(device_bind_driver(dm_root(), "sandbox_nvme", "nvme#sb",
+				       &dev));
+	ut_assertok(device_probe(dev));
+	ut_assertok(device_find_first_child_by_uclass(dev, UCLASS_BLK, &blk));
+	ut_assertok(device_probe(blk));
+
+	wbuf = malloc(SZ_1M);
+	rbuf = malloc(SZ_1M);
+	ut_assertnonnull(wbuf);
+	ut_assertnonnull(rbuf);
+	for (i = 0; i < SZ_1M; i++)
+		wbuf[i] = i * 3 + (i >> 9);
+
+	ut_assertok(blk_submit_write(blk, 10, SZ_1M / 512, wbuf, &req));
+	ut_asserteq(SZ_1M / 512, blk_wait(blk, &req));
+
+	/* a second request while one is in flight is done synchronously */
+	memset(rbuf, '\0', SZ_1M);
+	ut_assertok(blk_submit_read(blk, 10, SZ_512K / 512, rbuf, &req));
+	ut_assertok(blk_submit_read(blk, 10 + SZ_512K / 512, SZ_512K / 512,
+				    rbuf + SZ_512K, &req2));
+	ut_assert(req2.done);
+	ut_asserteq(SZ_512K / 512, blk_poll(blk, &req2));
+	ut_asserteq(SZ_512K / 512, blk_wait(blk, &req));
+	ut_asserteq_mem(wbuf, rbuf, SZ_1M);
+
+	/* a synchronous read finishes the request in flight first */
+	memset(rbuf, '\0', SZ_1M);
+	ut_assertok(blk_submit_read(blk, 10, 8, rbuf, &req));
+	ut_asserteq(8, blk_read(blk, 18, 8, rbuf + 0x1000));
+	ut_asserteq(8, blk_poll(blk, &req));
+	ut_asserteq_mem(wbuf, rbuf, 0x2000);
+
+	/* a transfer running off the end reports the blocks before that */
+	ut_assertok(blk_submit_read(blk, NVME_TEST_BLOCKS - 256, 1024, rbuf,
+				    &req));
+	ut_asserteq(256, blk_wait(blk, &req));
+
+	free(rbuf);
+	free(wbuf);
+	ut_assertok(device_remove(dev, DM_REMOVE_NORMAL));
+	ut_assertok(device_unbind(dev));
+	sandbox_set_enable_memio(false);
+
+	return 0;
+}
+DM_TEST(dm_test_nvme_async, UTF_SCAN_FDT);
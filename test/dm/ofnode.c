@@ -20,8 +20,10 @@
 #include <dm.h>
 #include <log.h>
 #include <of_live.h>
+#include <asm/global_data.h>
 #include <dm/device-internal.h>
 #include <dm/lists.h>
+#include <dm/of_access.h>
 #include <dm/of_extra.h>
 #include <dm/ofnode_graph.h>
 #include <dm/root.h>
@@ -31,6 +33,8 @@
 #include <test/test.h>
 #include <test/ut.h>
 
+DECLARE_GLOBAL_DATA_PTR;
+
 /**
  * get_other_oftree() - Convert a flat tree into an oftree object
  *
@@ -160,6 +164,71 @@ static int dm_test_ofnode_get_by_phandle_ot(struct unit_test_state *uts)
 DM_TEST(dm_test_ofnode_get_by_phandle_ot,
 	UTF_SCAN_FDT | UTF_OTHER_FDT);
 
+/* check that looking up each phandle finds the same node as a search */
+static int check_phandles(struct unit_test_state *uts)
+{
+	struct device_node *np;
+	int found = 0, offset;
+	uint phandle;
+	ofnode node;
+
+	for (phandle = 1; phandle < 0x100; phandle++) {
+		node = ofnode_get_by_phandle(phandle);
+		if (of_live_active()) {
+			for_each_of_allnodes(np) {
+				if (np->phandle == phandle)
+					break;
+			}
+			ut_asserteq_ptr(np, ofnode_to_np(node));
+		} else {
+			offset = fdt_node_offset_by_phandle(gd->fdt_blob,
+							    phandle);
+			if (offset < 0)
+				ut_assert(!ofnode_valid(node));
+			else
+				ut_asserteq(offset, ofnode_to_offset(node));
+		}
+		if (ofnode_valid(node))
+			found++;
+	}
+
+	return found;
+}
+
+/* test that phandle lookups keep working as the tree changes */
+static int dm_test_ofnode_phandle_cache(struct unit_test_state *uts)
+{
+	oftree otree = get_other_oftree(uts);
+	ofnode node, subnode;
+	int found;
+	u32 idx;
+
+	found = check_phandles(uts);
+	ut_assert(found > 20);
+
+	/*
+	 * with a flat tree this moves all the nodes; changes to the live tree
+	 * are not undone after the test, so only do this with the flat tree
+	 */
+	if (!of_live_active()) {
+		ut_assertok(ofnode_add_subnode(ofnode_root(), "phandle-test",
+					       &subnode));
+		ut_assertok(ofnode_write_u32(subnode, "phandle", 0xff));
+		ut_asserteq(found + 1, check_phandles(uts));
+	}
+
+	/* removing a node removes its phandle */
+	node = oftree_path(otree, "/node");
+	ut_assertok(ofnode_read_u32(node, "other-phandle", &idx));
+	node = oftree_get_by_phandle(otree, idx);
+	ut_asserteq_str("target", ofnode_get_name(node));
+	ut_assertok(ofnode_delete(&node));
+	ut_assert(!ofnode_valid(oftree_get_by_phandle(otree, idx)));
+
+	return 0;
+}
+DM_TEST(dm_test_ofnode_phandle_cache, UTF_SCAN_FDT | UTF_OTHER_FDT);
+
 static int check_prop_values(struct unit_test_state *uts, ofnode start,
 			     const char *propname, const char *propval,
 			     int expect_count)
@@ -0,0 +1,159 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for probing devices in parallel
+ */
+
+#include <dm.h>
+#include <dm/device-internal.h>
+#include <dm/root.h>
+#include <dm/test.h>
+#include <linux/delay.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+/**
+ * struct probe_delay_plat - a device which takes a while to probe
+ *
+ * @delay_ms: Time to wait in probe(), as if for the hardware
+ * @supplier: Device to probe first, or NULL
+ * @ret: Error to return from probe(), or 0
+ * @calls: Number of times probe() was called
+ * @start: Value of probe_seq when probe() started waiting
+ * @end: Value of probe_seq when probe() finished waiting
+ * @probed: Set when probe() has finished
+ */
+struct probe_delay_plat {
+	int delay_ms;
+	struct udevice *supplier;
+	int ret;
+	int calls;
+	int start;
+	int end;
+	bool probed;
+};
+
+/* Counts the start and end of each wait, to show the order of events */
+static int probe_seq;
+
+static int probe_delay_bind(struct udevice *dev)
+{
+	dev_or_flags(dev, DM_FLAG_PROBE_AFTER_BIND);
+
+	return 0;
+}
+
+static int probe_delay_probe(struct udevice *dev)
+{
+	struct probe_delay_plat *plat = dev_get_plat(dev);
+	struct probe_delay_plat *parent_plat = dev_get_plat(dev->parent);
+	int ret;
+
+	plat->calls++;
+	/* the parent and supplier must be fully probed, not just started */
+	if (device_get_uclass_id(dev->parent) == UCLASS_TEST_DUMMY &&
+	    !parent_plat->probed)
+		return -EBUSY;
+	if (plat->supplier) {
+		ret = device_probe(plat->supplier);
+		if (ret)
+			return ret;
+		parent_plat = dev_get_plat(plat->supplier);
+		if (!parent_plat->probed)
+			return -EBUSY;
+	}
+	plat->start = ++probe_seq;
+	mdelay(plat->delay_ms);
+	plat->end = ++probe_seq;
+	if (plat->ret)
+		return plat->ret;
+	plat->probed = true;
+
+	return 0;
+}
+
+U_BOOT_DRIVER(probe_delay) = {
+	.name	= "probe_delay",
+	.id	= UCLASS_TEST_DUMMY,
+	.bind	= probe_delay_bind,
+	.probe	= probe_delay_probe,
+};
+
+/* Test that devices waiting for hardware are probed in parallel */
+static int dm_test_probe_parallel(struct unit_test_state *uts)
+{
+	struct probe_delay_plat plat[] = {
+		{ .delay_ms = 100 },
+		{ .delay_ms = 50 },
+		{ .delay_ms = 50 },
+		{ .delay_ms = 50 },
+		{ .delay_ms = 50 },
+	};
+	struct udevice *dev[ARRAY_SIZE(plat)];
+	int i;
+
+	/* dev[3] needs dev[0], which is slow, and dev[4] is a child of dev[1] */
+	for (i = 0; i < 4; i++)
+		ut_assertok(device_bind(dm_root(), DM_DRIVER_GET(probe_delay),
+					"probe-delay", &plat[i], ofnode_null(),
+					&dev[i]));
+	plat[3].supplier = dev[0];
+	ut_assertok(device_bind(dev[1], DM_DRIVER_GET(probe_delay),
+				"probe-delay-child", &plat[4], ofnode_null(),
+				&dev[4]));
+
+	probe_seq = 0;
+	ut_assertok(dm_autoprobe());
+
+	for (i = 0; i < ARRAY_SIZE(plat); i++) {
+		ut_assert(device_active(dev[i]));
+		ut_assert(plat[i].probed);
+		ut_asserteq(1, plat[i].calls);
+	}
+
+	/* one after the other, each wait would end before the next started */
+	ut_assert(plat[1].start < plat[0].end);
+	ut_assert(plat[2].start < plat[0].end);
+
+	/* a supplier or parent is still probed first */
+	ut_assert(plat[3].start > plat[0].end);
+	ut_assert(plat[4].start > plat[1].end);
+
+	return 0;
+}
+DM_TEST(dm_test_probe_parallel, 0);
+
+/* Test that the children of a device which fails to probe are skipped */
+static int dm_test_probe_parallel_fail(struct unit_test_state *uts)
+{
+	struct probe_delay_plat plat[] = {
+		{ .delay_ms = 20, .ret = -EIO },
+		{ .delay_ms = 10 },
+		{ .delay_ms = 10 },
+	};
+	struct udevice *dev[ARRAY_SIZE(plat)];
+
+	/* dev[1] is a child of dev[0], which fails */
+	ut_assertok(device_bind(dm_root(), DM_DRIVER_GET(probe_delay),
+				"probe-fail", &plat[0], ofnode_null(), &dev[0]));
+	ut_assertok(device_bind(dev[0], DM_DRIVER_GET(probe_delay),
+				"probe-fail-child", &plat[1], ofnode_null(),
+				&dev[1]));
+	ut_assertok(device_bind(dm_root(), DM_DRIVER_GET(probe_delay),
+				"probe-delay", &plat[2], ofnode_null(), &dev[2]));
+
+	/* as when probing one at a time, only a failing root is an error */
+	ut_assertok(dm_autoprobe());
+
+	ut_assert(!device_active(dev[0]));
+	ut_asserteq(1, plat[0].calls);
+
+	/* probing the child would have probed its parent again */
+	ut_assert(!device_active(dev[1]));
+	ut_asserteq(0, plat[1].calls);
+
+	ut_assert(device_active(dev[2]));
+	ut_assert(plat[2].probed);
+
+	return 0;
+}
+DM_TEST(dm_test_probe_parallel_fail, 0);
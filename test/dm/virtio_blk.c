@@ -0,0 +1,119 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for the virtio block driver
+ */
+
+#include <blk.h>
+#include <dm.h>
+#include <malloc.h>
+#include <virtio_types.h>
+#include <virtio.h>
+#include <virtio_ring.h>
+#include <asm/test.h>
+#include <dm/device-internal.h>
+#include <dm/test.h>
+#include <linux/sizes.h>
+#include <test/test.h>
+#include <test/ut.h>
+#include "../../drivers/virtio/virtio_blk.h"
+
+/* Size of each request, as set by the sandbox device */
+#define REQ_BLKS	(SZ_64K / 512)
+
+/* Check a write and read-back of @blkcnt blocks, returning the notifications */
+static int check_xfer(struct unit_test_state *uts, struct udevice *bus,
+		      struct udevice *dev, lbaint_t blkcnt, u8 *wbuf, u8 *rbuf,
+		      uint *notifiesp)
+{
+	uint notifies, requests, max_batch;
+	lbaint_t i;
+
+	for (i = 0; i < blkcnt * 512; i++)
+		wbuf[i] = i * 7 + i / 512;
+	memset(rbuf, '\0', blkcnt * 512);
+	ut_assertok(sandbox_virtio_get_stats(bus, &notifies, &requests,
+					     &max_batch));
+
+	ut_asserteq(blkcnt, blk_write(dev, 8, blkcnt, wbuf));
+	ut_assertok(sandbox_virtio_get_stats(bus, &notifies, &requests,
+					     &max_batch));
+	ut_asserteq(DIV_ROUND_UP(blkcnt, REQ_BLKS), requests);
+
+	ut_asserteq(blkcnt, blk_read(dev, 8, blkcnt, rbuf));
+	ut_assertok(sandbox_virtio_get_stats(bus, notifiesp, &requests,
+					     &max_batch));
+	ut_asserteq(DIV_ROUND_UP(blkcnt, REQ_BLKS), requests);
+	ut_asserteq_mem(wbuf, rbuf, blkcnt * 512);
+
+	return 0;
+}
+
+/* Test that large transfers are split into requests which are batched */
+static int dm_test_virtio_blk(struct unit_test_state *uts)
+{
+	struct blk_request req[2];
+	struct udevice *bus, *dev;
+	struct blk_desc *desc;
+	uint notifies;
+	const lbaint_t blkcnt = SZ_1M / 512;
+	u8 *wbuf, *rbuf;
+
+	ut_assertok(uclass_get_device_by_name(UCLASS_VIRTIO,
+					      "sandbox-virtio-blk", &bus));
+	ut_assertok(device_find_first_child_by_uclass(bus, UCLASS_BLK, &dev));
+	ut_assertok(device_probe(dev));
+	desc = dev_get_uclass_plat(dev);
+	ut_asserteq(SZ_4M / 512, desc->lba);
+	ut_assert(virtio_has_feature(dev, VIRTIO_RING_F_INDIRECT_DESC));
+	ut_assert(virtio_has_feature(dev, VIRTIO_RING_F_EVENT_IDX));
+
+	wbuf = malloc(blkcnt * 512);
+	rbuf = malloc(blkcnt * 512);
+	ut_assertnonnull(wbuf);
+	ut_assertnonnull(rbuf);
+
+	/*
+	 * With indirect descriptors, each 64KB request takes one slot in the
+	 * 16-entry ring, so all 16 go to the device with a single notification
+	 */
+	ut_assertok(check_xfer(uts, bus, dev, blkcnt, wbuf, rbuf, &notifies));
+	ut_asserteq(1, notifies);
+
+	/* a transfer which is not a whole number of requests */
+	ut_assertok(check_xfer(uts, bus, dev, REQ_BLKS * 3 + 5, wbuf, rbuf,
+			       &notifies));
+	ut_asserteq(1, notifies);
+
+	/* two asynchronous transfers share the ring */
+	memset(rbuf, '\0', blkcnt * 512);
+	ut_assertok(blk_submit_read(dev, 8, blkcnt / 2, rbuf, &req[0]));
+	ut_assertok(blk_submit_read(dev, 8 + blkcnt / 2, blkcnt / 2,
+				    rbuf + blkcnt / 2 * 512, &req[1]));
+	ut_asserteq(blkcnt / 2, blk_wait(dev, &req[1]));
+	ut_asserteq(blkcnt / 2, blk_wait(dev, &req[0]));
+	ut_asserteq_mem(wbuf, rbuf, blkcnt * 512);
+
+	/* write zeroes */
+	ut_asserteq(4, blk_erase(dev, 8, 4));
+	ut_asserteq(4, blk_read(dev, 8, 4, rbuf));
+	memset(wbuf, '\0', 4 * 512);
+	ut_asserteq_mem(wbuf, rbuf, 4 * 512);
+
+	/*
+	 * Without indirect descriptors a request takes three descriptors, so
+	 * only five fit and the device must be notified more often
+	 */
+	ut_assertok(device_remove(dev, DM_REMOVE_NORMAL));
+	sandbox_virtio_set_features(bus, BIT_ULL(VIRTIO_F_VERSION_1) |
+				    BIT_ULL(VIRTIO_BLK_F_SIZE_MAX));
+	ut_assertok(device_probe(dev));
+	ut_assert(!virtio_has_feature(dev, VIRTIO_RING_F_INDIRECT_DESC));
+	ut_assertok(check_xfer(uts, bus, dev, blkcnt, wbuf, rbuf, &notifies));
+	ut_asserteq(DIV_ROUND_UP(blkcnt / REQ_BLKS, 5), notifies);
+
+	free(wbuf);
+	free(rbuf);
+
+	return 0;
+}
+DM_TEST(dm_test_virtio_blk, UTF_SCAN_FDT);
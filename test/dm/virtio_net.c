@@ -0,0 +1,90 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for the virtio network driver
+ */
+
+#include <dm.h>
+#include <net.h>
+#include <virtio_types.h>
+#include <virtio.h>
+#include <asm/test.h>
+#include <dm/device-internal.h>
+#include <dm/root.h>
+#include <dm/test.h>
+#include <test/test.h>
+#include <test/ut.h>
+#include "../../drivers/virtio/virtio_net.h"
+
+/* Receive a packet and check it arrives intact, with the checksum state */
+static int check_rx(struct unit_test_state *uts, struct udevice *bus,
+		    struct udevice *dev, const u8 *pkt, int len, u8 flags,
+		    uint nbufs, bool csum_valid)
+{
+	const struct eth_ops *ops = eth_get_ops(dev);
+	uchar *rx;
+
+	ut_assertok(sandbox_virtio_net_rx(bus, pkt, len, flags, nbufs));
+	ut_asserteq(len, ops->recv(dev, 0, &rx));
+	ut_asserteq(csum_valid, net_rx_csum_valid);
+	ut_asserteq_mem(pkt, rx, len);
+	ut_assertok(ops->free_pkt(dev, rx, len));
+
+	return 0;
+}
+
+/* Test receive checksum offload and packets merged from several buffers */
+static int dm_test_virtio_net(struct unit_test_state *uts)
+{
+	const struct eth_ops *ops;
+	struct udevice *bus, *dev;
+	u8 pkt[1500];
+	uchar *rx;
+	u8 valid;
+	int i;
+
+	ut_assertok(device_bind(dm_root(), DM_DRIVER_GET(virtio_sandbox1),
+				"sandbox-virtio-net", NULL,
+				ofnode_path("/sandbox-virtio-net"), &bus));
+	ut_assertok(device_probe(bus));
+	ut_assertok(device_find_first_child_by_uclass(bus, UCLASS_ETH, &dev));
+	ut_assertok(device_probe(dev));
+	ut_assert(virtio_has_feature(dev, VIRTIO_NET_F_MRG_RXBUF));
+
+	/* lwIP checks every checksum itself, so none are offloaded */
+	valid = VIRTIO_NET_HDR_F_DATA_VALID;
+	if (IS_ENABLED(CONFIG_NET_LWIP)) {
+		ut_assert(!virtio_has_feature(dev, VIRTIO_NET_F_GUEST_CSUM));
+		valid = 0;
+	} else {
+		ut_assert(virtio_has_feature(dev, VIRTIO_NET_F_GUEST_CSUM));
+	}
+
+	for (i = 0; i < sizeof(pkt); i++)
+		pkt[i] = i * 7 + i / 256;
+	ops = eth_get_ops(dev);
+	ut_assertok(ops->start(dev));
+	ut_assertok(ops->send(dev, pkt, 60));
+	ut_asserteq(-EAGAIN, ops->recv(dev, 0, &rx));
+
+	/* the device checked the checksum, or the packet came from the host */
+	if (valid) {
+		ut_assertok(check_rx(uts, bus, dev, pkt, 100,
+				     VIRTIO_NET_HDR_F_DATA_VALID, 1, true));
+		ut_assertok(check_rx(uts, bus, dev, pkt, 100,
+				     VIRTIO_NET_HDR_F_NEEDS_CSUM, 1, true));
+	}
+	ut_assertok(check_rx(uts, bus, dev, pkt, 100, 0, 1, false));
+
+	/*
+	 * Merged packets must be put back together and their buffers reposted,
+	 * so this goes round the receive queue several times
+	 */
+	for (i = 0; i < 32; i++)
+		ut_assertok(check_rx(uts, bus, dev, pkt, sizeof(pkt),
+				     i & 1 ? valid : 0, 2 + i % 3,
+				     valid && (i & 1)));
+	ut_asserteq(-EAGAIN, ops->recv(dev, 0, &rx));
+
+	return 0;
+}
+DM_TEST(dm_test_virtio_net, UTF_SCAN_FDT);
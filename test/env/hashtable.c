@@ -6,14 +6,18 @@
 
 #include <command.h>
 #include <log.h>
+#include <malloc.h>
 #include <search.h>
 #include <stdio.h>
 #include <vsprintf.h>
 #include <test/env.h>
 #include <test/ut.h>
+#include <linux/sizes.h>
 
 #define SIZE 32
 #define ITERATIONS 10000
+#define GROW_SIZE 1000
+#define IMPORT_VARS 2000
 
 static int htab_fill(struct unit_test_state *uts,
 		     struct hsearch_data *htab, size_t size)
@@ -122,3 +126,109 @@ static int env_test_htab_deletes(struct unit_test_state *uts)
 	return 0;
 }
 ENV_TEST(env_test_htab_deletes, 0);
+
+/* Grow a small hash table well beyond its initial size */
+static int env_test_htab_grow(struct unit_test_state *uts)
+{
+	struct hsearch_data htab;
+	struct env_entry item, *ritem;
+	char *res = NULL, *p, *prev, *next;
+	char key[20];
+	int i;
+
+	memset(&htab, 0, sizeof(htab));
+	ut_asserteq(1, hcreate_r(8, &htab));
+
+	ut_assertok(htab_fill(uts, &htab, GROW_SIZE));
+	ut_assertok(htab_check_fill(uts, &htab, GROW_SIZE));
+	ut_asserteq(GROW_SIZE, htab.filled);
+
+	for (i = 0; i < GROW_SIZE; i += 2) {
+		sprintf(key, "%d", i);
+		ut_assertok(hdelete_r(key, &htab, 0));
+	}
+	ut_asserteq(GROW_SIZE / 2, htab.filled);
+	for (i = 0; i < GROW_SIZE; i++) {
+		sprintf(key, "%d", i);
+		item.key = key;
+		hsearch_r(item, ENV_FIND, &ritem, &htab, 0);
+		if (i & 1)
+			ut_asserteq_str(key, ritem->key);
+		else
+			ut_assertnull(ritem);
+	}
+
+	/* the export is sorted by key */
+	ut_assert(hexport_r(&htab, '\n', 0, &res, 0, 0, NULL) > 0);
+	for (i = 0, prev = NULL, p = res; *p; i++, p = next) {
+		next = strchr(p, '\n');
+		*next++ = '\0';
+		*strchr(p, '=') = '\0';
+		if (prev)
+			ut_assert(strcmp(prev, p) < 0);
+		prev = p;
+	}
+	ut_asserteq(GROW_SIZE / 2, i);
+	free(res);
+
+	hdestroy_r(&htab);
+	return 0;
+}
+ENV_TEST(env_test_htab_grow, 0);
+
+/* Import a large environment, as stored, and export it back */
+static int env_test_htab_import(struct unit_test_state *uts)
+{
+	const size_t size = SZ_256K;
+	struct hsearch_data htab;
+	struct env_entry item, *ritem;
+	char *env, *res = NULL, *p;
+	ssize_t len;
+	int i;
+
+	env = calloc(1, size);
+	ut_assertnonnull(env);
+	for (i = 0, p = env; i < IMPORT_VARS; i++)
+		p += sprintf(p, "serial_%04d=%08x-provisioning-data", i,
+			     i * 2654435761U) + 1;
+	len = p - env + 1;
+
+	memset(&htab, 0, sizeof(htab));
+	ut_asserteq(1, himport_r(&htab, env, size, '\0', 0, 0, 0, NULL));
+	ut_asserteq(IMPORT_VARS, htab.filled);
+
+	ut_asserteq(len, hexport_r(&htab, '\0', 0, &res, 0, 0, NULL));
+	ut_asserteq_mem(env, res, len);
+	free(res);
+	res = NULL;
+
+	/* overwrite half of them, add some out of order */
+	for (i = 0, p = env; i < IMPORT_VARS; i += 2)
+		p += sprintf(p, "serial_%04d=new", IMPORT_VARS - 1 - i) + 1;
+	*p = '\0';
+	ut_asserteq(1, himport_r(&htab, env, size, '\0', H_NOCLEAR, 0, 0,
+				 NULL));
+	ut_asserteq(IMPORT_VARS, htab.filled);
+	for (i = 0; i < IMPORT_VARS; i++) {
+		sprintf(env, "serial_%04d", i);
+		item.key = env;
+		hsearch_r(item, ENV_FIND, &ritem, &htab, 0);
+		ut_assertnonnull(ritem);
+		if (i & 1)
+			ut_asserteq_str("new", ritem->data);
+		else
+			ut_assert(strcmp("new", ritem->data));
+	}
+
+	/* the export is still sorted */
+	ut_assert(hexport_r(&htab, '\n', 0, &res, 0, 0, NULL) > 0);
+	ut_assert(!strncmp(res, "serial_0000=", 12));
+	ut_assertnonnull(strstr(res, "serial_0001=new\nserial_0002="));
+	free(res);
+
+	hdestroy_r(&htab);
+	free(env);
+
+	return 0;
+}
+ENV_TEST(env_test_htab_import, 0);
@@ -11,7 +11,9 @@
 #include <log.h>
 #include <malloc.h>
 #include <mapmem.h>
+#include <workers.h>
 #include <asm/io.h>
+#include <asm/unaligned.h>
 
 #include <u-boot/lz4.h>
 #include <u-boot/zlib.h>
@@ -22,6 +24,7 @@
 #include <lzma/LzmaTools.h>
 
 #include <linux/lzo.h>
+#include <linux/xxhash.h>
 #include <linux/zstd.h>
 #include <test/lib.h>
 #include <test/ut.h>
@@ -505,6 +508,128 @@ static int compression_test_zstd(struct unit_test_state *uts)
 }
 LIB_TEST(compression_test_zstd, 0);
 
+#define TEST_FRAMES	9
+
+/* Skippable frame, which is the same for zstd and lz4 */
+static const char skippable_frame[] = "\x5a\x2a\x4d\x18\x04\x00\x00\x00junk";
+static const unsigned long skippable_frame_size = sizeof(skippable_frame) - 1;
+
+/*
+ * Check decompressing TEST_FRAMES frames holding a copy of plain[] each, with
+ * a skippable frame after the first one and junk after the last, both on the
+ * worker pool and on the boot CPU only
+ */
+static int run_frames_test(struct unit_test_state *uts, const char *hdr,
+			   ulong hdr_size, const char *frame, ulong frame_size,
+			   int (*uncompress)(void *in, ulong in_size,
+					     void *out, ulong *out_size))
+{
+	ulong plain_size = strlen(plain);
+	ulong in_size, out_size, short_size;
+	char *in, *out, *ptr;
+	int i, limit;
+
+	in = malloc(TEST_FRAMES * (hdr_size + frame_size) +
+		    skippable_frame_size + 4);
+	out = malloc(TEST_FRAMES * plain_size + 1);
+	ut_assertnonnull(in);
+	ut_assertnonnull(out);
+
+	for (i = 0, ptr = in; i < TEST_FRAMES; i++) {
+		memcpy(ptr, hdr, hdr_size);
+		ptr += hdr_size;
+		memcpy(ptr, frame, frame_size);
+		ptr += frame_size;
+		if (!i) {
+			memcpy(ptr, skippable_frame, skippable_frame_size);
+			ptr += skippable_frame_size;
+		}
+	}
+	memset(ptr, '\xa5', 4);
+	in_size = ptr + 4 - in;
+
+	for (limit = 0; limit < 2; limit++) {
+		workers_set_limit(limit);
+		memset(out, '\0', TEST_FRAMES * plain_size + 1);
+		out_size = TEST_FRAMES * plain_size + 1;
+		ut_assertok(uncompress(in, in_size, out, &out_size));
+		ut_asserteq(TEST_FRAMES * plain_size, out_size);
+		for (i = 0; i < TEST_FRAMES; i++)
+			ut_asserteq_mem(plain, out + i * plain_size,
+					plain_size);
+		ut_asserteq('\0', out[out_size]);
+
+		/*
+		 * The output must not overflow a short buffer: the byte just
+		 * past it would hold text, so the canary must survive
+		 */
+		short_size = TEST_FRAMES * plain_size - 1;
+		out[short_size] = '\xa5';
+		out_size = short_size;
+		ut_assert(uncompress(in, in_size, out, &out_size));
+		ut_asserteq('\xa5', out[short_size]);
+	}
+	workers_set_limit(0);
+
+	free(out);
+	free(in);
+
+	return 0;
+}
+
+static int uncompress_zstd_frames(void *in, ulong in_size, void *out,
+				  ulong *out_size)
+{
+	struct abuf in_buf, out_buf;
+	int ret;
+
+	abuf_init_set(&in_buf, in, in_size);
+	abuf_init_set(&out_buf, out, *out_size);
+	ret = zstd_decompress(&in_buf, &out_buf);
+	if (ret < 0)
+		return ret;
+	*out_size = ret;
+
+	return 0;
+}
+
+static int compression_test_zstd_frames(struct unit_test_state *uts)
+{
+	return run_frames_test(uts, NULL, 0, zstd_compressed,
+			       zstd_compressed_size, uncompress_zstd_frames);
+}
+LIB_TEST(compression_test_zstd_frames, 0);
+
+static int uncompress_lz4_frames(void *in, ulong in_size, void *out,
+				 ulong *out_size)
+{
+	size_t size = *out_size;
+	int ret;
+
+	ret = ulz4fn_parallel(in, in_size, out, &size);
+	*out_size = size;
+
+	return ret;
+}
+
+static int compression_test_lz4_frames(struct unit_test_state *uts)
+{
+	char hdr[15];
+
+	/*
+	 * Frames can only be decompressed in parallel if they record their
+	 * content size, so add it to the header of lz4_compressed[]
+	 */
+	memcpy(hdr, lz4_compressed, 6);
+	hdr[4] |= 0x08;
+	put_unaligned_le64(strlen(plain), hdr + 6);
+	hdr[14] = xxh32(hdr + 4, 10, 0) >> 8;
+
+	return run_frames_test(uts, hdr, sizeof(hdr), lz4_compressed + 7,
+			       lz4_compressed_size - 7, uncompress_lz4_frames);
+}
+LIB_TEST(compression_test_lz4_frames, 0);
+
 static int compress_using_none(struct unit_test_state *uts,
 			       void *in, unsigned long in_size,
 			       void *out, unsigned long out_max,
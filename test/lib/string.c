@@ -11,7 +11,10 @@
 
 #include <command.h>
 #include <log.h>
+#include <malloc.h>
 #include <string.h>
+#include <time.h>
+#include <linux/sizes.h>
 #include <test/lib.h>
 #include <test/test.h>
 #include <test/ut.h>
@@ -193,6 +196,151 @@ static int lib_memmove(struct unit_test_state *uts)
 }
 LIB_TEST(lib_memmove, 0);
 
+/* Byte at @i of the buffers used by lib_mem_long(), xor'ed with @mask */
+static u8 long_pattern(uint i, u8 mask)
+{
+	return (i * 7 ^ i >> 8) ^ mask;
+}
+
+/**
+ * test_mem_long() - check a buffer of lib_mem_long()
+ *
+ * @uts:	unit test state
+ * @buf:	buffer
+ * @size:	size of the buffer
+ * @mask:	xor mask of the pattern outside the changed region
+ * @dst:	start of the changed region in the buffer
+ * @src:	start of the source region in a buffer filled with mask 0, or
+ *		-1 if the region was set to @mask ^ 0xff by memset()
+ * @len:	length of the changed region
+ * Return:	0 = success, 1 = failure
+ */
+static int test_mem_long(struct unit_test_state *uts, const u8 *buf,
+			 uint size, u8 mask, uint dst, int src, uint len)
+{
+	uint i;
+
+	for (i = 0; i < size; i++) {
+		u8 expect = long_pattern(i, mask);
+
+		if (i >= dst && i < dst + len)
+			expect = src < 0 ? mask ^ 0xff :
+				long_pattern(src + i - dst, 0);
+		ut_asserteq(expect, buf[i]);
+	}
+
+	return 0;
+}
+
+/**
+ * lib_mem_long() - unit test for longer memcpy(), memmove() and memset()
+ *
+ * Architectures may hand regions above some length to a different, e.g.
+ * vectorised, implementation. Test lengths around the usual thresholds with
+ * varied alignment, and memmove() with overlaps in both directions.
+ *
+ * @uts:	unit test state
+ * Return:	0 = success, 1 = failure
+ */
+static int lib_mem_long(struct unit_test_state *uts)
+{
+	static const uint lens[] = { 63, 64, 65, 127, 128, 129, 255, 256, 257,
+				     1000, 4096, 4103 };
+	static const int shifts[] = { -129, -64, -9, -1, 1, 9, 64, 129 };
+	const uint size = 4103 + 2 * 160;
+	uint i, j, off, dst, k;
+	u8 *buf1, *buf2;
+	void *ptr;
+
+	buf1 = malloc(size);
+	buf2 = malloc(size);
+	ut_assertnonnull(buf1);
+	ut_assertnonnull(buf2);
+	for (k = 0; k < size; k++)
+		buf1[k] = long_pattern(k, 0);
+
+	for (i = 0; i < ARRAY_SIZE(lens); i++) {
+		for (off = 0; off < SWEEP; off++) {
+			dst = 160 + off;
+
+			for (k = 0; k < size; k++)
+				buf2[k] = long_pattern(k, MASK);
+			ptr = memset(buf2 + dst, MASK ^ 0xff, lens[i]);
+			ut_asserteq_ptr(buf2 + dst, ptr);
+			ut_assertok(test_mem_long(uts, buf2, size, MASK, dst,
+						  -1, lens[i]));
+
+			for (k = 0; k < size; k++)
+				buf2[k] = long_pattern(k, MASK);
+			ptr = memcpy(buf2 + dst, buf1 + 160 + off / 2, lens[i]);
+			ut_asserteq_ptr(buf2 + dst, ptr);
+			ut_assertok(test_mem_long(uts, buf2, size, MASK, dst,
+						  160 + off / 2, lens[i]));
+
+			for (j = 0; j < ARRAY_SIZE(shifts); j++) {
+				for (k = 0; k < size; k++)
+					buf2[k] = long_pattern(k, 0);
+				ptr = memmove(buf2 + dst, buf2 + dst + shifts[j],
+					      lens[i]);
+				ut_asserteq_ptr(buf2 + dst, ptr);
+				ut_assertok(test_mem_long(uts, buf2, size, 0,
+							  dst, dst + shifts[j],
+							  lens[i]));
+			}
+		}
+	}
+	free(buf2);
+	free(buf1);
+
+	return 0;
+}
+LIB_TEST(lib_mem_long, 0);
+
+/*
+ * Measure the throughput of memcpy(), memmove() and memset() for a range of
+ * sizes. Run it manually, e.g. on QEMU with and without the vector
+ * extension, to compare implementations.
+ */
+static int lib_mem_speed_norun(struct unit_test_state *uts)
+{
+	static const uint sizes[] = { SZ_256, SZ_4K, SZ_64K, SZ_1M };
+	const uint total = SZ_64M;
+	ulong start, us[3];
+	uint i, n, loops;
+	u8 *buf;
+
+	buf = malloc(2 * SZ_1M + 64);
+	ut_assertnonnull(buf);
+	memset(buf, 0x5a, 2 * SZ_1M + 64);
+
+	for (i = 0; i < ARRAY_SIZE(sizes); i++) {
+		loops = total / sizes[i];
+
+		start = timer_get_us();
+		for (n = 0; n < loops; n++)
+			memcpy(buf + SZ_1M + 64, buf + 1, sizes[i]);
+		us[0] = max(timer_get_us() - start, 1UL);
+
+		start = timer_get_us();
+		for (n = 0; n < loops; n++)
+			memmove(buf + 7, buf, sizes[i]);
+		us[1] = max(timer_get_us() - start, 1UL);
+
+		start = timer_get_us();
+		for (n = 0; n < loops; n++)
+			memset(buf + 3, n, sizes[i]);
+		us[2] = max(timer_get_us() - start, 1UL);
+
+		printf("%8u bytes: memcpy %lu MB/s, memmove %lu MB/s, memset %lu MB/s\n",
+		       sizes[i], (ulong)total / us[0], (ulong)total / us[1],
+		       (ulong)total / us[2]);
+	}
+	free(buf);
+
+	return 0;
+}
+LIB_TEST(lib_mem_speed_norun, UTF_MANUAL);
+
 /** lib_memdup() - unit test for memdup() */
 static int lib_memdup(struct unit_test_state *uts)
 {
@@ -0,0 +1,105 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Unit tests for crc32, comparing the selected implementation with the
+ * portable one and a bitwise reference
+ */
+
+#include <malloc.h>
+#include <time.h>
+#include <linux/sizes.h>
+#include <test/lib.h>
+#include <test/ut.h>
+#include <u-boot/crc.h>
+
+/* bitwise reference, without one's complement */
+static u32 crc32_ref(u32 crc, const u8 *buf, uint len)
+{
+	int k;
+
+	while (len--) {
+		crc ^= *buf++;
+		for (k = 0; k < 8; k++)
+			crc = crc & 1 ? (crc >> 1) ^ 0xedb88320 : crc >> 1;
+	}
+
+	return crc;
+}
+
+static void fill(u8 *buf, uint len)
+{
+	u32 x = 0x12345678;
+	uint i;
+
+	for (i = 0; i < len; i++) {
+		x = x * 1103515245 + 12345;
+		buf[i] = x >> 16;
+	}
+}
+
+static int lib_crc32(struct unit_test_state *uts)
+{
+	static const uint lens[] = { 0, 1, 3, 7, 8, 15, 16, 63, 64, 65, 255,
+				     256, 257, 1000, 4096, 4099 };
+	const uint size = 4200;
+	uint i, off;
+	u8 *buf;
+
+	ut_asserteq(0xcbf43926, crc32(0, (const u8 *)"123456789", 9));
+
+	buf = malloc(size);
+	ut_assertnonnull(buf);
+	fill(buf, size);
+
+	/* every alignment and a range of lengths around the block sizes */
+	for (off = 0; off < 16; off++) {
+		for (i = 0; i < ARRAY_SIZE(lens); i++) {
+			u32 expect = crc32_ref(~0, buf + off, lens[i]);
+
+			ut_asserteq(expect,
+				    crc32_no_comp(~0, buf + off, lens[i]));
+			ut_asserteq(expect, crc32_no_comp_generic(~0, buf + off,
+								  lens[i]));
+		}
+	}
+
+	/* chaining must give the same result as a single call */
+	ut_asserteq(crc32(0, buf, size),
+		    crc32(crc32(0, buf, 1001), buf + 1001, size - 1001));
+
+	free(buf);
+
+	return 0;
+}
+LIB_TEST(lib_crc32, 0);
+
+/*
+ * Compare the throughput of the selected and the portable implementations.
+ * This only runs when requested with 'ut -f'.
+ */
+static int lib_crc32_speed_norun(struct unit_test_state *uts)
+{
+	const uint size = SZ_8M;
+	ulong start, fast_us, soft_us;
+	u32 fast, soft;
+	u8 *buf;
+
+	buf = malloc(size);
+	ut_assertnonnull(buf);
+	fill(buf, size);
+
+	start = timer_get_us();
+	fast = crc32_no_comp(0, buf, size);
+	fast_us = max(timer_get_us() - start, 1UL);
+
+	start = timer_get_us();
+	soft = crc32_no_comp_generic(0, buf, size);
+	soft_us = max(timer_get_us() - start, 1UL);
+
+	ut_asserteq(soft, fast);
+	printf("crc32: %lu MB/s, generic %lu MB/s\n", (ulong)size / fast_us,
+	       (ulong)size / soft_us);
+	free(buf);
+
+	return 0;
+}
+LIB_TEST(lib_crc32_speed_norun, UTF_MANUAL);
@@ -0,0 +1,173 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Unit tests for the hash algorithms, comparing the accelerated block
+ * functions with the portable ones, and a benchmark across buffer sizes
+ */
+
+#include <malloc.h>
+#include <hash.h>
+#include <time.h>
+#include <linux/sizes.h>
+#include <test/lib.h>
+#include <test/ut.h>
+#include <u-boot/sha256.h>
+#include <u-boot/sha512.h>
+
+static const char *const algos[] = { "sha1", "sha256", "sha384", "sha512" };
+
+/* Digests of "abc" from FIPS 180-2 */
+static const struct {
+	const char *algo;
+	const char *digest;
+} vectors[] = {
+	{ "sha256",
+	  "\xba\x78\x16\xbf\x8f\x01\xcf\xea\x41\x41\x40\xde\x5d\xae\x22\x23"
+	  "\xb0\x03\x61\xa3\x96\x17\x7a\x9c\xb4\x10\xff\x61\xf2\x00\x15\xad" },
+	{ "sha384",
+	  "\xcb\x00\x75\x3f\x45\xa3\x5e\x8b\xb5\xa0\x3d\x69\x9a\xc6\x50\x07"
+	  "\x27\x2c\x32\xab\x0e\xde\xd1\x63\x1a\x8b\x60\x5a\x43\xff\x5b\xed"
+	  "\x80\x86\x07\x2b\xa1\xe7\xcc\x23\x58\xba\xec\xa1\x34\xc8\x25\xa7" },
+	{ "sha512",
+	  "\xdd\xaf\x35\xa1\x93\x61\x7a\xba\xcc\x41\x73\x49\xae\x20\x41\x31"
+	  "\x12\xe6\xfa\x4e\x89\xa9\x7e\xa2\x0a\x9e\xee\xe6\x4b\x55\xd3\x9a"
+	  "\x21\x92\x99\x2a\x27\x4f\xc1\xa8\x36\xba\x3c\x23\xa3\xfe\xeb\xbd"
+	  "\x45\x4d\x44\x23\x64\x3c\xe8\x0e\x2a\x9a\xc9\x4f\xa5\x4c\xa4\x9f" },
+};
+
+static void fill(u8 *buf, uint len)
+{
+	u32 x = 0x12345678;
+	uint i;
+
+	for (i = 0; i < len; i++) {
+		x = x * 1103515245 + 12345;
+		buf[i] = x >> 16;
+	}
+}
+
+/* Hash @len bytes of @buf through the progressive API, @chunk at a time */
+static int hash_chunks(struct hash_algo *algo, const u8 *buf, uint len,
+		       uint chunk, u8 *out)
+{
+	uint size;
+	void *ctx;
+	int ret;
+
+	ret = algo->hash_init(algo, &ctx);
+	if (ret)
+		return ret;
+	do {
+		size = min(chunk, len);
+		ret = algo->hash_update(algo, ctx, buf, size, size == len);
+		if (ret)
+			return ret;
+		buf += size;
+		len -= size;
+	} while (len);
+
+	return algo->hash_finish(algo, ctx, out, algo->digest_size);
+}
+
+static int lib_hash(struct unit_test_state *uts)
+{
+	static const uint chunks[] = { 1, 63, 64, 65, 127, 128, 129, 1000 };
+	const uint size = 4099;
+	u8 one[HASH_MAX_DIGEST_SIZE], prog[HASH_MAX_DIGEST_SIZE];
+	struct hash_algo *algo;
+	uint i, j;
+	u8 *buf;
+
+	for (i = 0; i < ARRAY_SIZE(vectors); i++) {
+		if (hash_lookup_algo(vectors[i].algo, &algo))
+			continue;
+		algo->hash_func_ws((const u8 *)"abc", 3, one, algo->chunk_size);
+		ut_asserteq_mem(vectors[i].digest, one, algo->digest_size);
+	}
+
+	buf = malloc(size);
+	ut_assertnonnull(buf);
+	fill(buf, size);
+
+	/* splitting the data must not change the result */
+	for (i = 0; i < ARRAY_SIZE(algos); i++) {
+		if (hash_progressive_lookup_algo(algos[i], &algo))
+			continue;
+		algo->hash_func_ws(buf, size, one, algo->chunk_size);
+		for (j = 0; j < ARRAY_SIZE(chunks); j++) {
+			ut_assertok(hash_chunks(algo, buf, size, chunks[j],
+						prog));
+			ut_asserteq_mem(one, prog, algo->digest_size);
+		}
+	}
+
+#if CONFIG_IS_ENABLED(SHA256_LEGACY)
+	for (i = 1; i < 20; i++) {
+		sha256_context fast, soft;
+
+		sha256_starts(&fast);
+		soft = fast;
+		sha256_process(&fast, buf + i, i);
+		sha256_process_generic(&soft, buf + i, i);
+		ut_asserteq_mem(soft.state, fast.state, sizeof(soft.state));
+	}
+#endif
+#if CONFIG_IS_ENABLED(SHA512_LEGACY)
+	for (i = 1; i < 20; i++) {
+		sha512_context fast, soft;
+
+		sha512_starts(&fast);
+		soft = fast;
+		sha512_process(&fast, buf + i, i);
+		sha512_process_generic(&soft, buf + i, i);
+		ut_asserteq_mem(soft.state, fast.state, sizeof(soft.state));
+	}
+#endif
+	free(buf);
+
+	return 0;
+}
+LIB_TEST(lib_hash, 0);
+
+/*
+ * Report the throughput of each algorithm through hash_lookup_algo(), as
+ * used for FIT verification, over 1MB to 256MB. The data is a 1MB buffer
+ * hashed repeatedly, so the cache behaviour is that of a 1MB image. This
+ * takes a while, so it only runs when requested with 'ut -f'.
+ */
+static int lib_hash_speed_norun(struct unit_test_state *uts)
+{
+	u8 out[HASH_MAX_DIGEST_SIZE];
+	const uint size = SZ_1M;
+	struct hash_algo *algo;
+	ulong start, us;
+	uint i, mb, left;
+	void *ctx;
+	u8 *buf;
+
+	buf = malloc(size);
+	ut_assertnonnull(buf);
+	fill(buf, size);
+
+	for (i = 0; i < ARRAY_SIZE(algos); i++) {
+		if (hash_progressive_lookup_algo(algos[i], &algo))
+			continue;
+		printf("%-7s", algos[i]);
+		for (mb = 1; mb <= 256; mb *= 4) {
+			start = timer_get_us();
+			ut_assertok(algo->hash_init(algo, &ctx));
+			for (left = mb; left; left--) {
+				ut_assertok(algo->hash_update(algo, ctx, buf,
+							      size, left == 1));
+			}
+			ut_assertok(algo->hash_finish(algo, ctx, out,
+						      algo->digest_size));
+			us = max(timer_get_us() - start, 1UL);
+			printf(" %3uMB: %4lu MB/s", mb, (ulong)mb * size / us);
+		}
+		printf("\n");
+	}
+	free(buf);
+
+	return 0;
+}
+LIB_TEST(lib_hash_speed_norun, UTF_MANUAL);
@@ -0,0 +1,189 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Unit tests for inflate, comparing the chunked fast path with the stock one
+ */
+
+#include <gzip.h>
+#include <malloc.h>
+#include <rand.h>
+#include <time.h>
+#include <linux/sizes.h>
+#include <test/lib.h>
+#include <test/ut.h>
+#include <u-boot/zlib.h>
+#ifdef CONFIG_SANDBOX
+#include <os.h>
+#include <asm/state.h>
+#else
+#include <asm/global_data.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+#endif
+
+/*
+ * Inflate a gzip stream, handing out at most @chunk bytes of output space at
+ * a time so that matches also get copied from the sliding window
+ */
+static int inflate_gz(void *dst, uint dstlen, void *src, uint srclen,
+		      uint chunk, bool fast)
+{
+	z_stream s = {};
+	int off, ret;
+
+	off = gzip_parse_header(src, srclen);
+	if (off < 0)
+		return off;
+
+	if (inflateInit2(&s, -MAX_WBITS) != Z_OK)
+		return -EINVAL;
+	if (inflateChunk(&s, fast) != Z_OK) {
+		inflateEnd(&s);
+		return -ENOSYS;
+	}
+
+	s.next_in = src + off;
+	s.avail_in = srclen - off;
+	s.next_out = dst;
+	do {
+		s.avail_out = min(chunk, dstlen - (uint)s.total_out);
+		ret = inflate(&s, Z_SYNC_FLUSH);
+	} while (ret == Z_OK && s.total_out < dstlen);
+	inflateEnd(&s);
+
+	if (ret != Z_STREAM_END && ret != Z_OK)
+		return -EINVAL;
+
+	return s.total_out;
+}
+
+/*
+ * Make text-like data with repeats at short and long distances, so that
+ * inflate copies matches from near and far back in the window
+ */
+static void make_text(u8 *buf, uint len)
+{
+	uint i = 0, n, dist;
+
+	srand(1234);
+	while (i < len) {
+		n = min(rand() % 300 + 3, len - i);
+		dist = rand() % 40 + 1;
+		if (rand() & 1)
+			dist *= 800;
+		if (dist <= i && rand() % 4) {
+			for (; n; n--, i++)
+				buf[i] = buf[i - dist];
+		} else {
+			for (; n; n--, i++)
+				buf[i] = 'a' + rand() % 26;
+		}
+	}
+}
+
+static int lib_inflate(struct unit_test_state *uts)
+{
+	static const uint chunks[] = { 1, 258, 300, 1000, 4099, SZ_64K, SZ_1M };
+	const uint size = SZ_256K;
+	unsigned long gzlen = size * 2;
+	u8 *buf, *gz, *out;
+	uint i;
+
+	buf = malloc(size);
+	gz = malloc(gzlen);
+	out = malloc(size);
+	ut_assertnonnull(buf);
+	ut_assertnonnull(gz);
+	ut_assertnonnull(out);
+	make_text(buf, size);
+	ut_assertok(gzip(gz, &gzlen, buf, size));
+
+	for (i = 0; i < ARRAY_SIZE(chunks); i++) {
+		memset(out, '\0', size);
+		ut_asserteq(size, inflate_gz(out, size, gz, gzlen, chunks[i],
+					     false));
+		ut_asserteq_mem(buf, out, size);
+
+		if (!CONFIG_IS_ENABLED(ZLIB_INFLATE_CHUNK))
+			continue;
+		memset(out, '\0', size);
+		ut_asserteq(size, inflate_gz(out, size, gz, gzlen, chunks[i],
+					     true));
+		ut_asserteq_mem(buf, out, size);
+	}
+
+	/* gunzip() must also stop exactly at the end of a tight buffer */
+	memset(out, '\0', size);
+	ut_assertok(gunzip(out, size, gz, &gzlen));
+	ut_asserteq(size, gzlen);
+	ut_asserteq_mem(buf, out, size);
+
+	free(out);
+	free(gz);
+	free(buf);
+
+	return 0;
+}
+LIB_TEST(lib_inflate, 0);
+
+/*
+ * Compare the throughput of the chunked and the stock fast paths on a real
+ * executable, which is what gunzip mostly sees (kernel Image.gz). This
+ * takes a while, so it only runs when requested with 'ut -f'.
+ */
+static int lib_inflate_speed_norun(struct unit_test_state *uts)
+{
+	ulong start, fast_us, stock_us;
+	unsigned long gzlen;
+	u8 *image, *gz, *out;
+	uint size;
+
+	if (!CONFIG_IS_ENABLED(ZLIB_INFLATE_CHUNK))
+		return -EAGAIN;
+
+#ifdef CONFIG_SANDBOX
+	{
+		struct sandbox_state *state = state_get_current();
+		void *file;
+		int fsize;
+
+		ut_assertok(os_read_file(state->argv[0], &file, &fsize));
+		size = min(fsize, SZ_8M);
+		image = malloc(size);
+		ut_assertnonnull(image);
+		memcpy(image, file, size);
+		os_free(file);
+	}
+#else
+	size = min_t(ulong, gd->mon_len, SZ_8M);
+	image = malloc(size);
+	ut_assertnonnull(image);
+	memcpy(image, (void *)gd->relocaddr, size);
+#endif
+
+	gzlen = size;
+	gz = malloc(gzlen);
+	out = malloc(size);
+	ut_assertnonnull(gz);
+	ut_assertnonnull(out);
+	ut_assertok(gzip(gz, &gzlen, image, size));
+
+	start = timer_get_us();
+	ut_asserteq(size, inflate_gz(out, size, gz, gzlen, size, true));
+	fast_us = max(timer_get_us() - start, 1UL);
+	ut_asserteq_mem(image, out, size);
+
+	memset(out, '\0', size);
+	start = timer_get_us();
+	ut_asserteq(size, inflate_gz(out, size, gz, gzlen, size, false));
+	stock_us = max(timer_get_us() - start, 1UL);
+	ut_asserteq_mem(image, out, size);
+
+	printf("inflate: %lu MB/s, stock %lu MB/s (%u bytes from %lu)\n",
+	       (ulong)size / fast_us, (ulong)size / stock_us, size, gzlen);
+	free(out);
+	free(gz);
+	free(image);
+
+	return 0;
+}
+LIB_TEST(lib_inflate_speed_norun, UTF_MANUAL);
@@ -0,0 +1,95 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Unit test for the worker pool
+ */
+
+#include <test/lib.h>
+#include <test/ut.h>
+#include <workers.h>
+#include <linux/errno.h>
+
+#define TEST_JOBS	100
+
+/**
+ * struct workers_test - State shared by the jobs of the test
+ *
+ * @runs: Number of times each job ran
+ * @worker: Index of the worker which ran each job
+ * @fail: Job which fails, or -1 for none
+ */
+struct workers_test {
+	int runs[TEST_JOBS];
+	uint worker[TEST_JOBS];
+	int fail;
+};
+
+static int test_job(void *priv, uint job, uint worker)
+{
+	struct workers_test *test = priv;
+
+	test->runs[job]++;
+	test->worker[job] = worker;
+
+	return job == test->fail ? -EIO : 0;
+}
+
+/* Jobs run from a job must all run on the worker which started them */
+static int nested_job(void *priv, uint job, uint worker)
+{
+	struct workers_test *test = (struct workers_test *)priv + job;
+	uint i;
+	int ret;
+
+	ret = workers_run(test_job, test, TEST_JOBS);
+	for (i = 0; i < TEST_JOBS; i++) {
+		if (test->runs[i] != 1 || test->worker[i] != worker)
+			return -EINVAL;
+	}
+
+	return ret;
+}
+
+static int lib_workers(struct unit_test_state *uts)
+{
+	struct workers_test test, nested[2];
+	uint i;
+
+	/* sandbox always has at least one worker thread */
+	ut_assert(workers_count() > 1);
+	ut_assert(workers_count() <= CONFIG_WORKERS_MAX);
+
+	memset(&test, '\0', sizeof(test));
+	test.fail = -1;
+	ut_assertok(workers_run(test_job, &test, TEST_JOBS));
+	for (i = 0; i < TEST_JOBS; i++) {
+		ut_asserteq(1, test.runs[i]);
+		ut_assert(test.worker[i] < workers_count());
+	}
+
+	/* a failing job is reported, without stopping the others */
+	memset(&test, '\0', sizeof(test));
+	test.fail = TEST_JOBS / 3;
+	ut_asserteq(-EIO, workers_run(test_job, &test, TEST_JOBS));
+	for (i = 0; i < TEST_JOBS; i++)
+		ut_asserteq(1, test.runs[i]);
+
+	/* with a limit of one worker, everything runs on the boot CPU */
+	workers_set_limit(1);
+	ut_asserteq(1, workers_count());
+	memset(&test, '\0', sizeof(test));
+	test.fail = -1;
+	ut_assertok(workers_run(test_job, &test, TEST_JOBS));
+	for (i = 0; i < TEST_JOBS; i++) {
+		ut_asserteq(1, test.runs[i]);
+		ut_asserteq(0, test.worker[i]);
+	}
+	workers_set_limit(0);
+
+	memset(nested, '\0', sizeof(nested));
+	nested[0].fail = -1;
+	nested[1].fail = -1;
+	ut_assertok(workers_run(nested_job, nested, ARRAY_SIZE(nested)));
+
+	return 0;
+}
+LIB_TEST(lib_workers, 0);
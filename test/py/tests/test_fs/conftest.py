@@ -18,6 +18,7 @@ supported_fs_mkdir = ['fat12', 'fat16', 'fat32', 'exfat', 'fs_generic']
 supported_fs_unlink = ['fat12', 'fat16', 'fat32', 'exfat', 'fs_generic']
 supported_fs_symlink = ['ext4']
 supported_fs_rename = ['fat12', 'fat16', 'fat32', 'exfat', 'fs_generic']
+supported_hash_htree = ['legacy', 'half_md4', 'tea']
 
 #
 # Filesystem test specific setup
@@ -104,6 +105,9 @@ def pytest_generate_tests(metafunc):
     if 'fs_obj_rename' in metafunc.fixturenames:
         metafunc.parametrize('fs_obj_rename', supported_fs_rename,
             indirect=True, scope='module')
+    if 'fs_obj_htree' in metafunc.fixturenames:
+        metafunc.parametrize('fs_obj_htree', supported_hash_htree,
+            indirect=True, scope='module')
 
 #
 # Helper functions
@@ -558,6 +562,56 @@ def fs_obj_symlink(request, u_boot_config):
         call('rm -rf %s' % scratch_dir, shell=True)
         call('rm -f %s' % fs_img, shell=True)
 
+#
+# Fixture for htree test
+#
+@pytest.fixture()
+def fs_obj_htree(request, u_boot_config):
+    """Set up an ext4 file system with hash-indexed directories.
+
+    The file system holds HTREE_DIR with HTREE_FILES entries, indexed with
+    the hash algorithm given as the fixture parameter.
+
+    Args:
+        request: Pytest request object.
+        u_boot_config: U-Boot configuration.
+
+    Return:
+        A fixture for htree tests, i.e. a duplet of hash algorithm and
+        volume file name.
+    """
+    hash_alg = request.param
+    fs_img = ''
+
+    check_ubconfig(u_boot_config, 'ext4')
+
+    scratch_dir = u_boot_config.persistent_data_dir + '/scratch'
+
+    try:
+        check_call('mkdir -p %s/%s' % (scratch_dir, HTREE_DIR), shell=True)
+        for i in range(HTREE_FILES):
+            with open('%s/%s/%s%d' % (scratch_dir, HTREE_DIR, HTREE_PREFIX, i),
+                      'w') as outf:
+                outf.write('%d\n' % i)
+
+        # mkfs creates linear directories; e2fsck -D indexes them
+        fs_img = fs_helper.mk_fs(u_boot_config, 'ext4', 0x4000000,
+                                 'htree-' + hash_alg, scratch_dir)
+        check_call('tune2fs -E hash_alg=%s %s' % (hash_alg, fs_img),
+                   shell=True)
+        # e2fsck returns 1 when it has changed the file system
+        ret = call('e2fsck -fyD %s' % fs_img, shell=True)
+        if ret not in (0, 1):
+            raise CalledProcessError(ret, 'e2fsck')
+    except CalledProcessError as err:
+        pytest.skip('Setup failed for htree test (%s). %s' % (hash_alg, err))
+        return
+    else:
+        yield [hash_alg, fs_img]
+    finally:
+        call('rm -rf %s' % scratch_dir, shell=True)
+        call('rm -f %s' % fs_img, shell=True)
+
 #
 # Fixture for rename test
 #
@@ -12,5 +12,10 @@ MEDIUM_FILE='10MB.file'
 # $BIG_FILE is the name of the 2.5GB file in the file system image
 BIG_FILE='2.5GB.file'
 
+# $HTREE_DIR holds $HTREE_FILES files named $HTREE_PREFIX<n>, containing "<n>"
+HTREE_DIR='modules'
+HTREE_FILES=6000
+HTREE_PREFIX='kernel-module-with-a-long-name-'
+
 ADDR=0x01000008
 LENGTH=0x00100000
@@ -8,8 +8,14 @@
 This test verifies fat specific file system behaviour.
 """
 
+import hashlib
+import os
+import random
 import pytest
 import re
+from subprocess import call, check_call, CalledProcessError
+from tests import fs_helper
+import utils
 
 @pytest.mark.boardspec('sandbox')
 @pytest.mark.slow
@@ -23,3 +29,88 @@ class TestFsFat(object):
                 'host bind 0 %s' % fs_img,
                 'fatinfo host 0:0'])
             assert(re.search('Filesystem: %s' % fs_type.upper(), ''.join(output)))
+
+@pytest.mark.boardspec('sandbox')
+@pytest.mark.buildconfigspec('cmd_blkmap')
+@pytest.mark.buildconfigspec('fat_write')
+def test_fs_fat_fragmented(ubman):
+    """Test reading a fragmented file, also after raw writes to the device
+
+    The file is written around a hole left by a deleted file, so its cluster
+    chain has two runs. Two versions of the volume are then written over the
+    device with raw block writes, with the file at the same place and of the
+    same size but with a different chain, which must not be read through a
+    stale cluster map.
+    """
+    # the smallest size that mkfs.vfat makes into FAT16, see fs_obj_fat()
+    size = 0x900000
+    scratch = os.path.join(ubman.config.persistent_data_dir, 'fat_frag')
+    check_call(f'rm -rf {scratch}; mkdir -p {scratch}', shell=True)
+    fs_img = None
+    try:
+        fs_img = fs_helper.mk_fs(ubman.config, 'fat16', size, 'fat_frag')
+    except CalledProcessError:
+        pytest.skip('Setup failed for filesystem: fat16')
+
+    rnd = random.Random(1234)
+    files = {}
+    for name, length in [('small', 0x4000), ('d1', 0x10000),
+                         ('d2', 0x10000)]:
+        data = bytes(rnd.getrandbits(8) for _ in range(length))
+        with open(os.path.join(scratch, name), 'wb') as outf:
+            outf.write(data)
+        files[name] = data
+
+    def md5(data):
+        return hashlib.md5(data).hexdigest()
+
+    base = utils.find_ram_base(ubman)
+    disk, snap1, snap2 = [f'{base + n * size:x}' for n in range(3)]
+    buf = f'{base + 3 * size:x}'
+    dst = f'{base + 4 * size:x}'
+    blocks = f'{size // 512:x}'
+    try:
+        ubman.run_command_list([
+            f'host load hostfs - {disk} {fs_img}',
+            'blkmap create frag',
+            f'blkmap map frag 0 {blocks} mem {disk}',
+            'blkmap get frag dev bdev',
+            'blkmap dev ${bdev}',
+            f'host load hostfs - {buf} {scratch}/small',
+            f'fatwrite blkmap ${{bdev}}:0 {buf} a 4000',
+            f'fatwrite blkmap ${{bdev}}:0 {buf} b 4000',
+            f'fatwrite blkmap ${{bdev}}:0 {buf} c 4000',
+            'fatrm blkmap ${bdev}:0 b',
+            f'host load hostfs - {buf} {scratch}/d1',
+            # fills the hole left by b, then continues after c
+            f'fatwrite blkmap ${{bdev}}:0 {buf} big 10000',
+            f'cp.b {disk} {snap1} {size:x}',
+            'fatrm blkmap ${bdev}:0 big',
+            'fatrm blkmap ${bdev}:0 c',
+            f'host load hostfs - {buf} {scratch}/d2',
+            # starts at the same cluster, but is now contiguous
+            f'fatwrite blkmap ${{bdev}}:0 {buf} big 10000',
+            f'cp.b {disk} {snap2} {size:x}',
+            f'blkmap write {snap1} 0 {blocks}'])
+
+        # the whole file, then the part after the hole
+        ubman.run_command(f'load blkmap ${{bdev}}:0 {dst} big')
+        output = ubman.run_command(f'md5sum {dst} 10000')
+        assert md5(files['d1']) in output
+        ubman.run_command(f'load blkmap ${{bdev}}:0 {dst} big 8000 8000')
+        output = ubman.run_command(f'md5sum {dst} 8000')
+        assert md5(files['d1'][0x8000:]) in output
+
+        # the volume is rewritten under the filesystem
+        ubman.run_command(f'blkmap write {snap2} 0 {blocks}')
+        ubman.run_command(f'load blkmap ${{bdev}}:0 {dst} big 8000 8000')
+        output = ubman.run_command(f'md5sum {dst} 8000')
+        assert md5(files['d2'][0x8000:]) in output
+        ubman.run_command(f'load blkmap ${{bdev}}:0 {dst} big')
+        output = ubman.run_command(f'md5sum {dst} 10000')
+        assert md5(files['d2']) in output
+    finally:
+        ubman.run_command('blkmap destroy frag')
+        call(f'rm -rf {scratch}', shell=True)
+        if fs_img:
+            call(f'rm -f {fs_img}', shell=True)
@@ -0,0 +1,99 @@
+# SPDX-License-Identifier:      GPL-2.0+
+#
+# U-Boot File System: ext4 hash tree (dir_index) lookup test
+
+"""
+This test verifies that files in large, hash-indexed ext4 directories can be
+found, for each of the hash algorithms, and reports the time taken.
+"""
+
+import re
+import time
+import pytest
+from subprocess import check_call, check_output
+from fstest_defs import *
+
+@pytest.mark.boardspec('sandbox')
+@pytest.mark.slow
+class TestHtree(object):
+    def test_htree1(self, ubman, fs_obj_htree):
+        """
+        Test Case 1 - look up every 50th entry of a large directory
+        """
+        hash_alg, fs_img = fs_obj_htree
+        with ubman.log.section('Test Case 1 - lookup (%s)' % hash_alg):
+            ubman.run_command('host bind 0 %s' % fs_img)
+            start = time.time()
+            for i in range(0, HTREE_FILES, 50):
+                output = ubman.run_command_list([
+                    'setenv filesize',
+                    'ext4load host 0:0 %x /%s/%s%d' % (ADDR, HTREE_DIR,
+                                                       HTREE_PREFIX, i),
+                    'printenv filesize'])
+                assert 'filesize=%x' % len('%d\n' % i) in ''.join(output)
+            ubman.log.info('%d lookups in %.2fs' %
+                           (HTREE_FILES // 50, time.time() - start))
+
+    def test_htree2(self, ubman, fs_obj_htree):
+        """
+        Test Case 2 - the right file is found, and missing ones are not
+        """
+        hash_alg, fs_img = fs_obj_htree
+        with ubman.log.section('Test Case 2 - contents (%s)' % hash_alg):
+            last = HTREE_FILES - 1
+            output = ubman.run_command_list([
+                'host bind 0 %s' % fs_img,
+                'mw.b %x 0 10' % ADDR,
+                'ext4load host 0:0 %x /%s/%s%d' % (ADDR, HTREE_DIR,
+                                                   HTREE_PREFIX, last),
+                'md.b %x %x' % (ADDR, len(str(last)))])
+            assert ' '.join('%02x' % ord(c) for c in str(last)) in \
+                ''.join(output)
+
+            output = ubman.run_command(
+                'ext4load host 0:0 %x /%s/%smissing' % (ADDR, HTREE_DIR,
+                                                        HTREE_PREFIX))
+            assert 'Failed to load' in output
+
+    def test_htree3(self, ubman, fs_obj_htree):
+        """
+        Test Case 3 - lookups go through the hash tree
+
+        The block after the root of the tree is broken so that a linear scan
+        of the directory stops there. The hash tree only misses the entries
+        in that block, if it is a leaf.
+        """
+        hash_alg, fs_img = fs_obj_htree
+        with ubman.log.section('Test Case 3 - index used (%s)' % hash_alg):
+            bad_img = fs_img + '.bad'
+            check_call('cp %s %s' % (fs_img, bad_img), shell=True)
+            try:
+                out = check_output('dumpe2fs -h %s' % bad_img, shell=True,
+                                   text=True)
+                blksz = int(re.search(r'Block size:\s+(\d+)', out).group(1))
+                out = check_output("debugfs -R 'bmap /%s 1' %s" %
+                                   (HTREE_DIR, bad_img), shell=True,
+                                   text=True)
+                block = int(out.split()[-1])
+
+                # a zero rec_len in the first entry ends a linear scan
+                with open(bad_img, 'r+b') as fd:
+                    fd.seek(block * blksz + 4)
+                    fd.write(b'\0\0')
+
+                ubman.run_command('host bind 0 %s' % bad_img)
+                tried = found = 0
+                for i in range(0, HTREE_FILES, 50):
+                    output = ubman.run_command_list([
+                        'setenv filesize',
+                        'ext4load host 0:0 %x /%s/%s%d' % (ADDR, HTREE_DIR,
+                                                           HTREE_PREFIX, i),
+                        'printenv filesize'])
+                    tried += 1
+                    if 'filesize=%x' % len('%d\n' % i) in ''.join(output):
+                        found += 1
+
+                # a linear scan finds none of them
+                assert found >= tried * 9 // 10
+            finally:
+                check_call('rm -f %s' % bad_img, shell=True)
@@ -92,6 +92,36 @@ def sqfs_load_files_at_subdir(ubman):
     address = '$kernel_addr_r'
     sqfs_load_files(ubman, files, sizes, address)
 
+def sqfs_load_partial_files(ubman):
+    """ Loads only the beginning of files and asserts their checksums.
+
+    This test checks that a load ending in the middle of a data block or of a
+    fragment does not write past the requested length.
+
+    Args:
+        ubman: provides the means to interact with U-Boot's console.
+    """
+    build_dir = ubman.config.build_dir
+    address = '$kernel_addr_r'
+    for (file, size) in [('f5096', 4097), ('f4096', 100), ('f1000', 999)]:
+        ubman.run_command('mw.b {} 55 {:x}'.format(address, size + 1))
+        out = ubman.run_command('sqfsload host 0 {} {} {:x}'.format(address,
+                                                                  file, size))
+        assert str(size) in out
+
+        u_boot_checksum = uboot_md5sum(ubman, address, hex(size))
+        original_file_path = os.path.join(build_dir, SQFS_SRC_DIR + '/' + file)
+        out = subprocess.run(['head -c {} {} | md5sum'.format(size,
+                                                              original_file_path)],
+                             shell=True, check=True, capture_output=True,
+                             text=True)
+        assert u_boot_checksum == out.stdout.split()[0]
+
+        # the byte following the requested length must be left untouched
+        ubman.run_command('setexpr end {} + {:x}'.format(address, size))
+        out = ubman.run_command('md.b $end 1')
+        assert ': 55' in out
+
 def sqfs_load_non_existent_file(ubman):
     """ Calls sqfs_load_files passing an non-existent file to raise an error.
 
@@ -114,6 +144,9 @@ def sqfs_run_all_load_tests(ubman):
     """
     sqfs_load_files_at_root(ubman)
     sqfs_load_files_at_subdir(ubman)
+    # tables and fragments are now cached, load the files again from there
+    sqfs_load_files_at_root(ubman)
+    sqfs_load_partial_files(ubman)
     sqfs_load_non_existent_file(ubman)
 
 @pytest.mark.boardspec('sandbox')
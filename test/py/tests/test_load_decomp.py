@@ -0,0 +1,137 @@
+# SPDX-License-Identifier: GPL-2.0+
+
+""" Unit test for decompressing files while loading them with 'load -z'
+"""
+
+import hashlib
+import os
+import random
+import struct
+import pytest
+from subprocess import call, check_call, run, CalledProcessError, PIPE
+from tests import fs_helper
+import utils
+
+# Compressors and the options used; lz4 is given small independent blocks
+COMPRESSORS = {
+    'gz': 'gzip -9 -c',
+    'zst': 'zstd -q -c',
+    'lz4': 'lz4 -q -B4 -BX -c',
+}
+
+def make_data(fname):
+    """Write compressible data larger than a few chunks to a file
+
+    Returns:
+        tuple: md5 of the data (str), size of the data (int)
+    """
+    rnd = random.Random(1234)
+    words = [bytes(rnd.choice(b'abcdefgh') for _ in range(rnd.randint(1, 9)))
+             for _ in range(1000)]
+    data = b' '.join(rnd.choice(words) for _ in range(600000))
+    with open(fname, 'wb') as outf:
+        outf.write(data)
+    return hashlib.md5(data).hexdigest(), len(data)
+
+def make_multi_frame(fname, cmd, outname):
+    """Compress a file as several frames, with a skippable frame and padding
+
+    This is what binman produces for parallel decompression, followed by
+    the sort of padding found at the end of a partition.
+    """
+    with open(fname, 'rb') as inf:
+        data = inf.read()
+    third = len(data) // 3
+    parts = [data[:third], data[third:2 * third], data[2 * third:]]
+    frames = [run(cmd, shell=True, input=part, stdout=PIPE,
+                  check=True).stdout for part in parts]
+    # the same skippable frame magic is used by zstd and lz4
+    skippable = struct.pack('<II', 0x184d2a50, 4) + b'skip'
+    with open(outname, 'wb') as outf:
+        outf.write(frames[0] + skippable + frames[1] + frames[2] +
+                   bytes(64))
+
+def make_chunk_boundary(fname, cmd, outname):
+    """Compress a file as frames, with one ending exactly on a chunk boundary
+
+    'load -z' reads the file in 1MiB chunks. A skippable frame between the
+    first two frames pads the second one out to end on the first boundary,
+    so the data read so far ends with a complete frame although more follow.
+    """
+    chunk = 1 << 20
+    with open(fname, 'rb') as inf:
+        data = inf.read()
+    parts = [data[:100000], data[100000:200000], data[200000:]]
+    frames = [run(cmd, shell=True, input=part, stdout=PIPE,
+                  check=True).stdout for part in parts]
+    pad = chunk - len(frames[0]) - len(frames[1]) - 8
+    assert pad >= 0
+    skippable = struct.pack('<II', 0x184d2a50, pad) + bytes(pad)
+    with open(outname, 'wb') as outf:
+        outf.write(frames[0] + skippable + frames[1] + frames[2])
+
+@pytest.mark.boardspec('sandbox')
+@pytest.mark.buildconfigspec('image_decomp_stream')
+@pytest.mark.buildconfigspec('cmd_fs_generic')
+def test_load_decomp(ubman):
+    """Test that 'load -z' decompresses gzip, zstd and lz4 files
+
+    The zstd and lz4 files are also tried as several frames back to back,
+    including with a frame ending exactly where a read chunk ends.
+
+    Args:
+        ubman -- U-Boot console
+    """
+    scratch_dir = ubman.config.persistent_data_dir + '/load_decomp'
+    fs_img = None
+    try:
+        check_call(f'rm -rf {scratch_dir}; mkdir -p {scratch_dir}',
+                   shell=True)
+        data = os.path.join(scratch_dir, 'data')
+        md5, size = make_data(data)
+        for ext, cmd in COMPRESSORS.items():
+            check_call(f'{cmd} {data} > {data}.{ext}', shell=True)
+        for ext in ['zst', 'lz4']:
+            make_multi_frame(data, COMPRESSORS[ext], f'{data}.multi.{ext}')
+            make_chunk_boundary(data, COMPRESSORS[ext],
+                                f'{data}.boundary.{ext}')
+        # a truncated file must fail
+        check_call(f'head -c 100000 {data}.gz > {data}.short.gz', shell=True)
+
+        fs_img = fs_helper.mk_fs(ubman.config, 'ext4', 0x1000000,
+                                 'test_load_decomp', scratch_dir)
+    except CalledProcessError:
+        pytest.skip('Preparing test_load_decomp image failed')
+        call(f'rm -rf {scratch_dir}', shell=True)
+        return
+
+    try:
+        addr = '%x' % utils.find_ram_base(ubman)
+        ubman.run_command(f'host bind 0 {fs_img}')
+        for ext in ['gz', 'zst', 'lz4', 'multi.zst', 'multi.lz4',
+                    'boundary.zst', 'boundary.lz4']:
+            # from the host filesystem and from a block device
+            for load in [f'host load -z hostfs - {addr} {data}.{ext}',
+                         f'load -z host 0 {addr} data.{ext}']:
+                ubman.run_command(f'setenv filesize; {load}')
+                assert ubman.run_command('printenv filesize') == \
+                    f'filesize={size:x}'
+                response = ubman.run_command(f'md5sum {addr} {size:x}')
+                assert md5 in response
+
+        # an uncompressed file is loaded as it is
+        ubman.run_command(f'load -z host 0 {addr} data')
+        assert md5 in ubman.run_command(f'md5sum {addr} {size:x}')
+
+        # the output must fit into 'bytes'
+        response = ubman.run_command(f'load -z host 0 {addr} data.gz 1000; '
+                                     'echo rc=$?')
+        assert 'rc=1' in response
+
+        response = ubman.run_command(f'load -z host 0 {addr} data.short.gz; '
+                                     'echo rc=$?')
+        assert 'rc=1' in response
+    finally:
+        ubman.run_command('host unbind 0')
+        call(f'rm -rf {scratch_dir}', shell=True)
+        call(f'rm -f {fs_img}', shell=True)
@@ -548,11 +548,14 @@ class BintoolPacker(Bintool):
             fetch_package = name
         self.fetch_package = fetch_package
 
-    def compress(self, indata):
+    def compress(self, indata, content_size=False):
         """Compress data
 
         Args:
             indata (bytes): Data to compress
+            content_size (bool): True to record the uncompressed size in the
+                output. This is ignored here, since the tools record it
+                anyway when compressing a file
 
         Returns:
             bytes: Compressed data
@@ -78,11 +78,13 @@ class Bintoollz4(bintool.Bintool):
     def __init__(self, name):
         super().__init__(name, 'lz4 compression', r'.* (v[0-9.]*),.*')
 
-    def compress(self, indata):
+    def compress(self, indata, content_size=False):
         """Compress data with lz4
 
         Args:
             indata (bytes): Data to compress
+            content_size (bool): True to record the uncompressed size in the
+                frame header
 
         Returns:
             bytes: Compressed data
@@ -91,6 +93,8 @@ class Bintoollz4(bintool.Bintool):
                                          dir=tools.get_output_dir()) as tmp:
             tools.write_file(tmp.name, indata)
             args = ['--no-frame-crc', '-B4', '-5', '-c', tmp.name]
+            if content_size:
+                args.insert(0, '--content-size')
             return self.run_cmd(*args, binary=True)
 
     def decompress(self, indata):
@@ -72,6 +72,8 @@ class Entry(object):
         uncomp_data: Original uncompressed data, if this entry is compressed,
             else None
         compress: Compression algoithm used (e.g. 'lz4'), 'none' if none
+        compress_frame_size: Size of the uncompressed data in each frame, if
+            the data is compressed as independent frames, else None
         orig_offset: Original offset value read from node
         orig_size: Original size value read from node
         missing: True if this entry is missing its contents. Note that if it is
@@ -142,6 +144,7 @@ class Entry(object):
         self.image_pos = None
         self.extend_size = False
         self.compress = 'none'
+        self.compress_frame_size = None
         self.missing = False
         self.faked = False
         self.external = False
@@ -324,6 +327,14 @@ class Entry(object):
 
         # This is only supported by blobs and sections at present
         self.compress = fdt_util.GetString(self._node, 'compress', 'none')
+        self.compress_frame_size = fdt_util.GetInt(self._node,
+                                                   'compress-frame-size')
+        if self.compress_frame_size is not None:
+            if self.compress not in ['lz4', 'zstd']:
+                self.Raise("Compression '%s' does not support frames" %
+                           self.compress)
+            if self.compress_frame_size <= 0:
+                self.Raise('Frame size must be positive')
         self.offset_from_elf = fdt_util.GetPhandleNameOffset(self._node,
                                                              'offset-from-elf')
 
@@ -1217,7 +1228,10 @@ features to produce new behaviours.
         if self.compress != 'none':
             self.uncomp_size = len(indata)
             if self.comp_bintool.is_present():
-                data = self.comp_bintool.compress(indata)
+                if self.compress_frame_size:
+                    data = self.CompressFrames(indata)
+                else:
+                    data = self.comp_bintool.compress(indata)
                 uniq = self.GetUniqueName()
                 fname = tools.get_output_filename(f'comp.{uniq}')
                 tools.write_file(fname, data)
@@ -1228,6 +1242,26 @@ features to produce new behaviours.
             data = indata
         return data
 
+    def CompressFrames(self, indata):
+        """Compress data as independent frames
+
+        Each frame holds compress_frame_size bytes of the data (the last one
+        may be smaller) and records its uncompressed size, so that U-Boot can
+        decompress the frames in parallel. The decompressors handle frames
+        back to back, so the result is still valid compressed data.
+
+        Args:
+            indata: Data to compress
+
+        Returns:
+            Compressed data
+        """
+        size = self.compress_frame_size
+        return b''.join(
+            self.comp_bintool.compress(indata[pos:pos + size],
+                                       content_size=True)
+            for pos in range(0, len(indata), size))
+
     def DecompressData(self, indata):
         """Decompress data according to the entry's compression method
 
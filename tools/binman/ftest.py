@@ -8100,5 +8100,31 @@ fdt         fdtmap                Extract the devicetree blob from the fdtmap
         self.assertEqual(len(subnode4.props), 0,
                         "subnode shouldn't have any properties")
 
+    def testCompressFrames(self):
+        """Test compression of a blob as independent frames"""
+        self._CheckLz4()
+        data = self._DoReadFile('350_compress_frames.dts')
+        self.assertEqual(COMPRESS_DATA, self._decompress(data))
+
+        # Each 8-byte piece of the data has its own frame with its size
+        magic = struct.pack('<I', 0x184d2204)
+        self.assertEqual(5, data.count(magic))
+        self.assertTrue(data.startswith(magic))
+        self.assertTrue(data[4] & 0x08)
+
+    def testCompressFramesBadAlgo(self):
+        """Test compression as frames with an unsupported algorithm"""
+        with self.assertRaises(ValueError) as exc:
+            self._DoReadFile('351_compress_frames_bad.dts')
+        self.assertIn("Node '/binman/blob': Compression 'gzip' does not support frames",
+                      str(exc.exception))
+
+    def testCompressFramesBadSize(self):
+        """Test compression as frames with an invalid frame size"""
+        with self.assertRaises(ValueError) as exc:
+            self._DoReadFile('352_compress_frames_size.dts')
+        self.assertIn("Node '/binman/blob': Frame size must be positive",
+                      str(exc.exception))
+
 if __name__ == "__main__":
     unittest.main()